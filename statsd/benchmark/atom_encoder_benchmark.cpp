@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "stats_log_util.h"
+#include "tests/statsd_test_util.h"
+#include "utils/AtomEncoder.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using android::util::ProtoOutputStream;
+
+// Number of atoms written to the output per iteration, like a dump of an event metric.
+static const int kAtomsPerOutput = 100;
+
+static std::unique_ptr<LogEvent> createAttributionEvent() {
+    return CreateBleScanResultReceivedEvent(/*timestampNs=*/1000, {1001, 1002, 1003},
+                                            {"tag1", "tag2", "tag3"}, /*numResults=*/42);
+}
+
+static std::unique_ptr<LogEvent> createRepeatedFieldsEvent() {
+    bool repeatedBoolField[] = {true, false};
+    return CreateTestAtomReportedEvent(
+            /*timestampNs=*/1000, {1001}, {"tag1"}, /*intField=*/1, /*longField=*/2L,
+            /*floatField=*/3.0f, /*stringField=*/"string", /*boolField=*/true,
+            TestAtomReported::ON, /*bytesField=*/{1, 2, 3}, /*repeatedIntField=*/{1, 2, 3},
+            /*repeatedLongField=*/{4L, 5L}, /*repeatedFloatField=*/{6.0f},
+            /*repeatedStringField=*/{"str1", "str2"}, repeatedBoolField,
+            /*repeatedBoolFieldLength=*/2, /*repeatedEnumField=*/{TestAtomReported::OFF});
+}
+
+static void writeWithHelper(benchmark::State& state, const LogEvent& event) {
+    for (auto _ : state) {
+        ProtoOutputStream proto;
+        for (int i = 0; i < kAtomsPerOutput; i++) {
+            writeFieldValueTreeToStream(event.GetTagId(), event.getValues(), &proto);
+        }
+        benchmark::DoNotOptimize(proto.size());
+    }
+    state.SetItemsProcessed(state.iterations() * kAtomsPerOutput);
+}
+
+static void writeWithEncoder(benchmark::State& state, const LogEvent& event) {
+    AtomEncoder encoder;
+    for (auto _ : state) {
+        ProtoOutputStream proto;
+        for (int i = 0; i < kAtomsPerOutput; i++) {
+            encoder.write(event.GetTagId(), event.getValues(), &proto);
+        }
+        benchmark::DoNotOptimize(proto.size());
+    }
+    state.SetItemsProcessed(state.iterations() * kAtomsPerOutput);
+}
+
+static void BM_WriteFieldValueTreeAttributionChain(benchmark::State& state) {
+    writeWithHelper(state, *createAttributionEvent());
+}
+BENCHMARK(BM_WriteFieldValueTreeAttributionChain);
+
+static void BM_AtomEncoderAttributionChain(benchmark::State& state) {
+    writeWithEncoder(state, *createAttributionEvent());
+}
+BENCHMARK(BM_AtomEncoderAttributionChain);
+
+static void BM_WriteFieldValueTreeRepeatedFields(benchmark::State& state) {
+    writeWithHelper(state, *createRepeatedFieldsEvent());
+}
+BENCHMARK(BM_WriteFieldValueTreeRepeatedFields);
+
+static void BM_AtomEncoderRepeatedFields(benchmark::State& state) {
+    writeWithEncoder(state, *createRepeatedFieldsEvent());
+}
+BENCHMARK(BM_AtomEncoderRepeatedFields);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "src/metrics/BucketFinalizer.h"
+#include "tests/statsd_test_util.h"
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Measures the latency of the first event after a bucket boundary, which flushes the buckets of
+// every metric, with bucket finalization inline (state.range(0) == 0) or deferred to the
+// BucketFinalizer thread (state.range(0) == 1). The p99 over all iterations is reported as a
+// counter.
+static void BM_BucketBoundaryEventLatency(benchmark::State& state) {
+    const int kNumMetrics = 50;
+    const int kNumDimensions = 100;
+    const int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(TEN_MINUTES) * 1000000LL;
+
+    StatsdConfig config;
+    const AtomMatcher wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = wakelockAcquireMatcher;
+    for (int i = 0; i < kNumMetrics; i++) {
+        CountMetric* metric = config.add_count_metric();
+        *metric = createCountMetric("Count" + to_string(i), wakelockAcquireMatcher.id(),
+                                    /*condition=*/nullopt, /*states=*/{});
+        *metric->mutable_dimensions_in_what() =
+                CreateAttributionUidDimensions(util::WAKELOCK_STATE_CHANGED, {Position::FIRST});
+    }
+
+    ConfigKey cfgKey;
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, cfgKey);
+    BucketFinalizer::setEnabled(state.range(0) == 1);
+
+    vector<double> latenciesNs;
+    int64_t bucketStartNs = 1;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int uid = 0; uid < kNumDimensions; uid++) {
+            unique_ptr<LogEvent> event = CreateAcquireWakelockEvent(
+                    bucketStartNs + 10 + uid, {1000 + uid}, {"tag"}, "wl");
+            processor->OnLogEvent(event.get());
+        }
+        bucketStartNs += bucketSizeNs;
+        unique_ptr<LogEvent> boundaryEvent =
+                CreateAcquireWakelockEvent(bucketStartNs + 5, {1000}, {"tag"}, "wl");
+        state.ResumeTiming();
+
+        const auto start = std::chrono::steady_clock::now();
+        processor->OnLogEvent(boundaryEvent.get());
+        const auto end = std::chrono::steady_clock::now();
+
+        state.PauseTiming();
+        latenciesNs.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        BucketFinalizer::getInstance().waitForIdle();
+        vector<uint8_t> buffer;
+        processor->onDumpReport(cfgKey, bucketStartNs + 10,
+                                /*include_current_partial_bucket=*/false, /*erase_data=*/true,
+                                ADB_DUMP, FAST, &buffer);
+        state.ResumeTiming();
+    }
+    BucketFinalizer::setEnabled(false);
+
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    if (!latenciesNs.empty()) {
+        state.counters["p99_ns"] = latenciesNs[latenciesNs.size() * 99 / 100];
+    }
+}
+BENCHMARK(BM_BucketBoundaryEventLatency)->Arg(0)->Arg(1);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -111,6 +111,42 @@ static void BM_createDbTables(benchmark::State& state) {
 }
 
 BENCHMARK(BM_createDbTables);
+
+// Measures ttl enforcement over a metric whose rows span ten days, expiring the oldest three.
+static void BM_enforceTtl(benchmark::State& state) {
+    ConfigKey key = ConfigKey(111, 222);
+    int64_t metricId = 0;
+    int64_t bucketStartTimeNs = 10000000000;
+    const int64_t nsPerDay = 24 * 3600 * NS_PER_SEC;
+    const int64_t numDays = 10;
+    const int64_t batchSize = 1000;
+
+    unique_ptr<LogEvent> event =
+            CreateScreenStateChangedEvent(bucketStartTimeNs, android::view::DISPLAY_STATE_OFF);
+    vector<LogEvent> logEvents(batchSize, *event.get());
+    string err;
+    for (auto s : state) {
+        state.PauseTiming();
+        deleteDb(key);
+        createTableIfNeeded(key, metricId, *event.get());
+        sqlite3* dbHandle = getDb(key);
+        for (int64_t row = 0; row < state.range(0); row += batchSize) {
+            const int64_t wallClockNs = (row * numDays / state.range(0)) * nsPerDay;
+            for (LogEvent& logEvent : logEvents) {
+                logEvent.setLogdWallClockTimestampNs(wallClockNs);
+            }
+            insert(dbHandle, metricId, logEvents, err);
+        }
+        state.ResumeTiming();
+        flushTtl(dbHandle, metricId, 3 * nsPerDay - 1);
+        state.PauseTiming();
+        closeDb(dbHandle);
+        state.ResumeTiming();
+    }
+    deleteDb(key);
+}
+
+BENCHMARK(BM_enforceTtl)->Arg(100000)->Arg(1000000)->Arg(10000000)->Iterations(1);
 }  // namespace dbutils
 }  // namespace statsd
 }  // namespace os
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <sys/resource.h>
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "tests/statsd_test_util.h"
+#include "utils/ProtoOutputStreamPool.h"
+
+using namespace std;
+namespace android {
+namespace os {
+namespace statsd {
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_STRING;
+using android::util::ProtoOutputStream;
+
+static void setPeakRssCounter(benchmark::State& state) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        state.counters["peak_rss_kb"] = usage.ru_maxrss;
+    }
+}
+
+static void writeReport(ProtoOutputStream* proto, int sizeKb) {
+    const string chunk(1024, 'a');
+    for (int i = 0; i < sizeKb; i++) {
+        proto->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | 1, chunk);
+    }
+    vector<uint8_t> output;
+    proto->serializeToVector(&output);
+    benchmark::DoNotOptimize(output.data());
+}
+
+static void BM_ReportWithNewProtoOutputStream(benchmark::State& state) {
+    for (auto _ : state) {
+        ProtoOutputStream proto;
+        writeReport(&proto, state.range(0));
+    }
+    setPeakRssCounter(state);
+}
+BENCHMARK(BM_ReportWithNewProtoOutputStream)->Arg(64)->Arg(1024)->Arg(4096);
+
+static void BM_ReportWithPooledProtoOutputStream(benchmark::State& state) {
+    for (auto _ : state) {
+        ProtoOutputStreamPool::Stream proto = ProtoOutputStreamPool::getInstance().acquire();
+        writeReport(proto.get(), state.range(0));
+    }
+    ProtoOutputStreamPool::getInstance().trim();
+    setPeakRssCounter(state);
+}
+BENCHMARK(BM_ReportWithPooledProtoOutputStream)->Arg(64)->Arg(1024)->Arg(4096);
+
+// Repeated dumps of a config with many event metrics that all hold data.
+static void BM_RepeatedDumpReportOfLargeConfig(benchmark::State& state) {
+    StatsdConfig config;
+    for (int atomId = 1000; atomId < 1500; atomId++) {
+        auto matcher = CreateSimpleAtomMatcher("name" + to_string(atomId), atomId);
+        *config.add_atom_matcher() = matcher;
+        *config.add_event_metric() = createEventMetric("Event" + to_string(atomId), matcher.id(),
+                                                       /* condition */ nullopt);
+    }
+
+    ConfigKey cfgKey;
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, cfgKey);
+    for (int atomId = 1000; atomId < 1500; atomId++) {
+        for (int i = 0; i < 20; i++) {
+            shared_ptr<LogEvent> event = makeUidLogEvent(atomId, 2 + i, /*uid=*/1000 + i,
+                                                         /*data1=*/i, /*data2=*/atomId);
+            processor->OnLogEvent(event.get());
+        }
+    }
+
+    int64_t dumpTimeNs = 1000;
+    for (auto _ : state) {
+        vector<uint8_t> output;
+        processor->onDumpReport(cfgKey, dumpTimeNs++, /*include_current_partial_bucket=*/true,
+                                /*erase_data=*/false, ADB_DUMP, FAST, &output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    setPeakRssCounter(state);
+}
+BENCHMARK(BM_RepeatedDumpReportOfLargeConfig);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
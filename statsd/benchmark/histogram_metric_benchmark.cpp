@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "tests/statsd_test_util.h"
+
+using namespace std;
+namespace android {
+namespace os {
+namespace statsd {
+
+// Compares three ways of collecting the distribution of a latency-like value per uid: uploading
+// every sample with an EventMetric, a KllMetric sketch and a ValueMetric with HISTOGRAM
+// aggregation. Each iteration logs state.range(0) samples and dumps the report. The size of the
+// report is reported as report_bytes.
+
+static const int kAtomId = 1000;
+static const int kNumUids = 10;
+
+static StatsdConfig createConfig(
+        const function<void(StatsdConfig&, const AtomMatcher&)>& addMetric) {
+    StatsdConfig config;
+    AtomMatcher matcher = CreateSimpleAtomMatcher("Latency", kAtomId);
+    *config.add_atom_matcher() = matcher;
+    addMetric(config, matcher);
+    return config;
+}
+
+static void runDistributionBenchmark(benchmark::State& state, const StatsdConfig& config) {
+    const int numSamples = state.range(0);
+    size_t reportBytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        ConfigKey cfgKey;
+        sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, cfgKey);
+        vector<shared_ptr<LogEvent>> events;
+        events.reserve(numSamples);
+        for (int i = 0; i < numSamples; i++) {
+            // Spread of values between 0 and ~1000 that is skewed towards small values.
+            const int latency = (i * 7919) % 1000 * ((i % 3) + 1) / 3;
+            events.push_back(makeUidLogEvent(kAtomId, 2 + i, /*uid=*/1000 + i % kNumUids,
+                                             /*data1=*/latency, /*data2=*/0));
+        }
+        state.ResumeTiming();
+
+        for (const shared_ptr<LogEvent>& event : events) {
+            processor->OnLogEvent(event.get());
+        }
+        vector<uint8_t> output;
+        processor->onDumpReport(cfgKey, numSamples + 10, /*include_current_partial_bucket=*/true,
+                                /*erase_data=*/true, ADB_DUMP, FAST, &output);
+        reportBytes = output.size();
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.counters["report_bytes"] = reportBytes;
+}
+
+static void BM_DistributionWithEventMetric(benchmark::State& state) {
+    const StatsdConfig config =
+            createConfig([](StatsdConfig& config, const AtomMatcher& matcher) {
+                *config.add_event_metric() =
+                        createEventMetric("Event", matcher.id(), /*condition=*/nullopt);
+            });
+    runDistributionBenchmark(state, config);
+}
+BENCHMARK(BM_DistributionWithEventMetric)->Arg(100)->Arg(1000)->Arg(10000);
+
+static void BM_DistributionWithKllMetric(benchmark::State& state) {
+    const StatsdConfig config =
+            createConfig([](StatsdConfig& config, const AtomMatcher& matcher) {
+                KllMetric metric =
+                        createKllMetric("Kll", matcher, /*kllField=*/2, /*condition=*/nullopt);
+                *metric.mutable_dimensions_in_what() = CreateDimensions(kAtomId, {1 /* uid */});
+                *config.add_kll_metric() = metric;
+            });
+    runDistributionBenchmark(state, config);
+}
+BENCHMARK(BM_DistributionWithKllMetric)->Arg(100)->Arg(1000)->Arg(10000);
+
+static void BM_DistributionWithHistogramValueMetric(benchmark::State& state) {
+    const StatsdConfig config =
+            createConfig([](StatsdConfig& config, const AtomMatcher& matcher) {
+                ValueMetric metric = createValueMetric("Histogram", matcher, /*valueField=*/2,
+                                                       /*condition=*/nullopt, /*states=*/{});
+                *metric.mutable_dimensions_in_what() = CreateDimensions(kAtomId, {1 /* uid */});
+                metric.set_aggregation_type(ValueMetric::HISTOGRAM);
+                HistogramBinConfig::GeneratedBins* bins =
+                        metric.add_histogram_bin_configs()->mutable_generated_bins();
+                bins->set_min(1);
+                bins->set_max(1000);
+                bins->set_count(20);
+                bins->set_strategy(HistogramBinConfig::GeneratedBins::EXPONENTIAL);
+                *config.add_value_metric() = metric;
+            });
+    runDistributionBenchmark(state, config);
+}
+BENCHMARK(BM_DistributionWithHistogramValueMetric)->Arg(100)->Arg(1000)->Arg(10000);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
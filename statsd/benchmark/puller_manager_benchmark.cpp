@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <aidl/android/os/BnPullAtomCallback.h>
+#include <aidl/android/os/IPullAtomResultReceiver.h>
+#include <aidl/android/util/StatsEventParcel.h>
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "src/external/StatsPullerManager.h"
+#include "stats_event.h"
+
+using aidl::android::os::BnPullAtomCallback;
+using aidl::android::os::IPullAtomResultReceiver;
+using aidl::android::util::StatsEventParcel;
+using ndk::ScopedAStatus;
+using ndk::SharedRefBase;
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Measures the throughput of StatsPullerManager::Pull when several threads pull at the same time,
+// each one pulling its own atom. The pullers answer in process and most pulls are served from
+// their cache, so the cost is dominated by the bookkeeping of the manager.
+
+static const int kUid = 1000;
+static const int kFirstAtomId = 10000;
+static const int kNumAtoms = 16;
+
+namespace {
+
+class InProcessPullAtomCallback : public BnPullAtomCallback {
+public:
+    ScopedAStatus onPullAtom(int atomTag,
+                             const shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        AStatsEvent* event = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(event, atomTag);
+        AStatsEvent_writeInt32(event, kUid);
+        AStatsEvent_build(event);
+        size_t size;
+        uint8_t* buffer = AStatsEvent_getBuffer(event, &size);
+        StatsEventParcel parcel;
+        parcel.buffer.assign(buffer, buffer + size);
+        AStatsEvent_release(event);
+        resultReceiver->pullFinished(atomTag, /*success=*/true, {parcel});
+        return ScopedAStatus::ok();
+    }
+};
+
+}  // anonymous namespace
+
+static sp<StatsPullerManager> getPullerManager() {
+    static sp<StatsPullerManager> pullerManager = [] {
+        sp<StatsPullerManager> manager = new StatsPullerManager();
+        shared_ptr<InProcessPullAtomCallback> callback =
+                SharedRefBase::make<InProcessPullAtomCallback>();
+        for (int i = 0; i < kNumAtoms; i++) {
+            manager->RegisterPullAtomCallback(kUid, kFirstAtomId + i, NS_PER_SEC, NS_PER_SEC, {},
+                                              callback);
+        }
+        return manager;
+    }();
+    return pullerManager;
+}
+
+static void BM_ConcurrentPulls(benchmark::State& state) {
+    sp<StatsPullerManager> pullerManager = getPullerManager();
+    const int atomId = kFirstAtomId + state.thread_index() % kNumAtoms;
+    const vector<int32_t> uids = {kUid};
+    int64_t eventTimeNs = 1;
+    for (auto _ : state) {
+        vector<shared_ptr<LogEvent>> data;
+        benchmark::DoNotOptimize(pullerManager->Pull(atomId, uids, eventTimeNs++, &data));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ConcurrentPulls)->ThreadRange(1, 16)->UseRealTime();
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
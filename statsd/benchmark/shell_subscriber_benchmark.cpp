@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <aidl/android/os/BnStatsSubscriptionCallback.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "src/shell/ShellSubscriber.h"
+#include "tests/statsd_test_util.h"
+
+using aidl::android::os::BnStatsSubscriptionCallback;
+using aidl::android::os::StatsSubscriptionCallbackReason;
+using ndk::ScopedAStatus;
+using ndk::SharedRefBase;
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Measures the cost of delivering a pushed atom to state.range(0) callback subscriptions with the
+// same config.
+
+namespace {
+
+class DiscardingSubscriptionCallback : public BnStatsSubscriptionCallback {
+public:
+    ScopedAStatus onSubscriptionData(StatsSubscriptionCallbackReason reason,
+                                     const vector<uint8_t>& subscriptionPayload) override {
+        benchmark::DoNotOptimize(subscriptionPayload.data());
+        return ScopedAStatus::ok();
+    }
+};
+
+// Simulates a subscriber that is slow to take its data.
+class SlowSubscriptionCallback : public BnStatsSubscriptionCallback {
+public:
+    ScopedAStatus onSubscriptionData(StatsSubscriptionCallbackReason reason,
+                                     const vector<uint8_t>& subscriptionPayload) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        return ScopedAStatus::ok();
+    }
+};
+
+}  // anonymous namespace
+
+static void BM_ShellSubscriberIdenticalSubscriptions(benchmark::State& state) {
+    sp<ShellSubscriber> shellSubscriber =
+            new ShellSubscriber(new UidMap(), new StatsPullerManager(),
+                                std::make_shared<LogEventFilter>());
+
+    ShellSubscription config;
+    config.add_pushed()->set_atom_id(util::SCREEN_STATE_CHANGED);
+    const vector<uint8_t> configBytes = protoToBytes(config);
+    vector<shared_ptr<DiscardingSubscriptionCallback>> callbacks;
+    for (int i = 0; i < state.range(0); i++) {
+        callbacks.push_back(SharedRefBase::make<DiscardingSubscriptionCallback>());
+        shellSubscriber->startNewSubscription(configBytes, callbacks.back());
+    }
+
+    unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+            /*timestampNs=*/1000, android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    for (auto _ : state) {
+        shellSubscriber->onLogEvent(*event);
+    }
+
+    for (const shared_ptr<DiscardingSubscriptionCallback>& callback : callbacks) {
+        shellSubscriber->unsubscribe(callback);
+    }
+}
+BENCHMARK(BM_ShellSubscriberIdenticalSubscriptions)->Arg(1)->Arg(5)->Arg(20);
+
+// Measures the time the log reader thread spends handing a pushed atom to a slow subscription.
+// state.range(0) selects inline delivery (0) or delivery through the dispatch queue (1).
+static void BM_ShellSubscriberSlowSubscription(benchmark::State& state) {
+    sp<ShellSubscriber> shellSubscriber =
+            new ShellSubscriber(new UidMap(), new StatsPullerManager(),
+                                std::make_shared<LogEventFilter>());
+
+    ShellSubscription config;
+    config.add_pushed()->set_atom_id(util::SCREEN_STATE_CHANGED);
+    shared_ptr<SlowSubscriptionCallback> callback =
+            SharedRefBase::make<SlowSubscriptionCallback>();
+    shellSubscriber->startNewSubscription(protoToBytes(config), callback);
+
+    const bool queued = state.range(0) != 0;
+    int64_t timestampNs = 1000;
+    for (auto _ : state) {
+        unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+                timestampNs++, android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+        if (queued) {
+            shellSubscriber->enqueueLogEvent(std::move(event));
+        } else {
+            shellSubscriber->onLogEvent(*event);
+        }
+    }
+
+    shellSubscriber->unsubscribe(callback);
+}
+BENCHMARK(BM_ShellSubscriberSlowSubscription)->Arg(0)->Arg(1);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "tests/statsd_test_util.h"
+
+using namespace std;
+namespace android {
+namespace os {
+namespace statsd {
+
+// Measures the fan-out of a state change to the metrics sliced by that state. The config has
+// state.range(0) count metrics sliced by screen state, and each iteration logs a screen state
+// change that every one of them is notified of.
+
+static const int kAtomId = 1000;
+
+static StatsdConfig createConfig(int numMetrics) {
+    StatsdConfig config;
+    AtomMatcher matcher = CreateSimpleAtomMatcher("Atom", kAtomId);
+    *config.add_atom_matcher() = matcher;
+    State state = CreateScreenState();
+    *config.add_state() = state;
+    for (int i = 0; i < numMetrics; i++) {
+        *config.add_count_metric() = createCountMetric("Count" + to_string(i), matcher.id(),
+                                                       /*condition=*/nullopt, {state.id()});
+    }
+    return config;
+}
+
+static void BM_StateChangeFanOut(benchmark::State& state) {
+    ConfigKey cfgKey;
+    sp<StatsLogProcessor> processor =
+            CreateStatsLogProcessor(1, 1, createConfig(state.range(0)), cfgKey);
+    int64_t timestampNs = 2;
+    bool screenOn = false;
+    for (auto _ : state) {
+        screenOn = !screenOn;
+        unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+                timestampNs++, screenOn ? android::view::DisplayStateEnum::DISPLAY_STATE_ON
+                                        : android::view::DisplayStateEnum::DISPLAY_STATE_OFF);
+        processor->OnLogEvent(event.get());
+    }
+}
+BENCHMARK(BM_StateChangeFanOut)->Arg(1)->Arg(100)->Arg(500);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
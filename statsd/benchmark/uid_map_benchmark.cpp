@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string>
+
+#include "benchmark/benchmark.h"
+#include "src/packages/UidMap.h"
+#include "tests/statsd_test_util.h"
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+UidData createUidData(int packageCount) {
+    UidData uidData;
+    for (int i = 0; i < packageCount; i++) {
+        *uidData.add_app_info() =
+                createApplicationInfo(/*uid*/ 10000 + i, /*version*/ 1, "v1",
+                                      "com.example.package" + to_string(i));
+    }
+    return uidData;
+}
+
+}  // anonymous namespace
+
+// Measures refreshing a uid map of state.range(0) installed packages with an identical snapshot,
+// as happens when StatsCompanionService resends the full map.
+static void BM_UidMapNoOpRefresh(benchmark::State& state) {
+    sp<UidMap> uidMap = new UidMap();
+    const UidData uidData = createUidData(state.range(0));
+    uidMap->updateMap(/*timestamp*/ 1, uidData);
+
+    int64_t timestamp = 2;
+    for (auto _ : state) {
+        uidMap->updateMap(timestamp++, uidData);
+    }
+}
+BENCHMARK(BM_UidMapNoOpRefresh)->Arg(300)->Arg(3000);
+
+// Same as above, with one package upgraded on every refresh.
+static void BM_UidMapSinglePackageRefresh(benchmark::State& state) {
+    sp<UidMap> uidMap = new UidMap();
+    UidData uidData = createUidData(state.range(0));
+    uidMap->updateMap(/*timestamp*/ 1, uidData);
+
+    int64_t timestamp = 2;
+    for (auto _ : state) {
+        uidData.mutable_app_info(0)->set_version(timestamp);
+        uidMap->updateMap(timestamp++, uidData);
+    }
+}
+BENCHMARK(BM_UidMapSinglePackageRefresh)->Arg(300)->Arg(3000);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <fuzzer/FuzzedDataProvider.h>
+#include <regex.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "utils/Regex.h"
+
+using android::os::statsd::Regex;
+using std::string;
+
+// Checks that every pattern accepted by Regex is valid POSIX extended regex and that both find the
+// same match.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    FuzzedDataProvider provider(data, size);
+    const string pattern = provider.ConsumeRandomLengthString(64);
+    // regexec stops at the first NUL character.
+    string str = provider.ConsumeRemainingBytesAsString();
+    str = str.substr(0, str.find('\0'));
+
+    std::unique_ptr<Regex> re = Regex::create(pattern);
+    if (re == nullptr) {
+        return 0;
+    }
+
+    regex_t impl;
+    if (regcomp(&impl, pattern.c_str(), REG_EXTENDED) != 0) {
+        abort();
+    }
+    regmatch_t posixMatch;
+    const bool posixMatched = regexec(&impl, str.c_str(), 1, &posixMatch, 0) == 0;
+    regfree(&impl);
+
+    size_t start;
+    size_t end;
+    const bool matched = re->match(str, &start, &end);
+    if (matched != posixMatched) {
+        abort();
+    }
+    if (matched && (start != (size_t)posixMatch.rm_so || end != (size_t)posixMatch.rm_eo)) {
+        abort();
+    }
+    return 0;
+}
@@ -301,6 +301,28 @@ bool containsLinkedStateValues(const HashableDimensionKey& whatKey,
     return true;
 }
 
+bool containsTranslatedStateValues(const HashableDimensionKey& whatKey,
+                                   const HashableDimensionKey& linkedKey) {
+    if (whatKey.getValues().size() < linkedKey.getValues().size()) {
+        ALOGE("Contains translated values false: whatKey is too small");
+        return false;
+    }
+
+    for (const auto& linkedValue : linkedKey.getValues()) {
+        bool found = false;
+        for (const auto& whatValue : whatKey.getValues()) {
+            if (linkedValue.mField == whatValue.mField && linkedValue.mValue == whatValue.mValue) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool linked(const vector<Metric2State>& stateLinks, const int32_t stateAtomId,
             const Field& stateField, const Field& metricField) {
     for (auto stateLink : stateLinks) {
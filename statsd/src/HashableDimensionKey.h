@@ -259,6 +259,14 @@ bool containsLinkedStateValues(const HashableDimensionKey& whatKey,
                                const std::vector<Metric2State>& stateLinks,
                                const int32_t stateAtomId);
 
+/**
+ * Returns true if the linkedKey values are a subset of the whatKey values. The linkedKey holds the
+ * values of a state primary key under the linked what fields, so unlike
+ * containsLinkedStateValues, no link is looked up.
+ */
+bool containsTranslatedStateValues(const HashableDimensionKey& whatKey,
+                                   const HashableDimensionKey& linkedKey);
+
 /**
  * Returns true if there is a Metric2State link that links the stateField and
  * the metricField (they are equal fields from different atoms).
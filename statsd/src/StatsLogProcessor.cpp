@@ -24,6 +24,10 @@
 #include <src/active_config_list.pb.h>
 #include <src/experiment_ids.pb.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include "StatsService.h"
 #include "android-base/stringprintf.h"
 #include "external/StatsPullerManager.h"
@@ -35,7 +39,9 @@
 #include "stats_log_util.h"
 #include "stats_util.h"
 #include "statslog_statsd.h"
+#include "storage/FileCompression.h"
 #include "storage/StorageManager.h"
+#include "utils/ProtoOutputStreamPool.h"
 
 using namespace android;
 using android::base::StringPrintf;
@@ -89,6 +95,12 @@ constexpr const char* kPermissionUsage = "android.permission.PACKAGE_USAGE_STATS
 // Cool down period for writing data to disk to avoid overwriting files.
 #define WRITE_DATA_COOL_DOWN_SEC 15
 
+// Max number of threads writing config data to disk in parallel on shutdown.
+#define SHUTDOWN_WRITE_THREAD_COUNT 4
+
+// Max number of threads compressing and writing files to disk in parallel.
+#define FILE_WRITE_THREAD_COUNT 4
+
 StatsLogProcessor::StatsLogProcessor(
         const sp<UidMap>& uidMap, const sp<StatsPullerManager>& pullerManager,
         const sp<AlarmMonitor>& anomalyAlarmMonitor, const sp<AlarmMonitor>& periodicAlarmMonitor,
@@ -150,15 +162,8 @@ void StatsLogProcessor::onPeriodicAlarmFired(
 }
 
 void StatsLogProcessor::mapIsolatedUidToHostUidIfNecessaryLocked(LogEvent* event) const {
-    if (std::pair<size_t, size_t> indexRange; event->hasAttributionChain(&indexRange)) {
-        vector<FieldValue>* const fieldValues = event->getMutableValues();
-        for (size_t i = indexRange.first; i <= indexRange.second; i++) {
-            FieldValue& fieldValue = fieldValues->at(i);
-            if (isAttributionUidField(fieldValue)) {
-                const int hostUid = mUidMap->getHostUidOrSelf(fieldValue.mValue.int_value);
-                fieldValue.mValue.setInt(hostUid);
-            }
-        }
+    if (event->hasAttributionChain()) {
+        mapIsolatedUidsToHostUidInAttributionChain(mUidMap, *event);
     } else {
         mapIsolatedUidsToHostUidInLogEvent(mUidMap, *event);
     }
@@ -392,8 +397,16 @@ void StatsLogProcessor::OnLogEvent(LogEvent* event) {
 }
 
 void StatsLogProcessor::OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    vector<PendingFile> pendingFiles;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        OnLogEventLocked(event, elapsedRealtimeNs);
+        pendingFiles = takePendingFilesLocked();
+    }
+    writePendingFiles(pendingFiles);
+}
 
+void StatsLogProcessor::OnLogEventLocked(LogEvent* event, int64_t elapsedRealtimeNs) {
     // Tell StatsdStats about new event
     const int64_t eventElapsedTimeNs = event->GetElapsedTimestampNs();
     const int atomId = event->GetTagId();
@@ -542,9 +555,14 @@ void StatsLogProcessor::GetActiveConfigsLocked(const int uid, vector<int64_t>& o
 void StatsLogProcessor::OnConfigUpdated(const int64_t timestampNs, const int64_t wallClockNs,
                                         const ConfigKey& key, const StatsdConfig& config,
                                         bool modularUpdate) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
-    WriteDataToDiskLocked(key, timestampNs, wallClockNs, CONFIG_UPDATED, NO_TIME_CONSTRAINTS);
-    OnConfigUpdatedLocked(timestampNs, key, config, modularUpdate);
+    vector<PendingFile> pendingFiles;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        WriteDataToDiskLocked(key, timestampNs, wallClockNs, CONFIG_UPDATED, NO_TIME_CONSTRAINTS);
+        OnConfigUpdatedLocked(timestampNs, key, config, modularUpdate);
+        pendingFiles = takePendingFilesLocked();
+    }
+    writePendingFiles(pendingFiles);
 }
 
 void StatsLogProcessor::OnConfigUpdated(const int64_t timestampNs, const ConfigKey& key,
@@ -659,8 +677,23 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      const bool include_current_partial_bucket,
                                      const bool erase_data, const DumpReportReason dumpReportReason,
                                      const DumpLatency dumpLatency, ProtoOutputStream* proto) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    vector<PendingFile> pendingFiles;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        onDumpReportLocked(key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket,
+                           erase_data, dumpReportReason, dumpLatency, proto);
+        pendingFiles = takePendingFilesLocked();
+    }
+    writePendingFiles(pendingFiles);
+}
 
+void StatsLogProcessor::onDumpReportLocked(const ConfigKey& key, const int64_t dumpTimeStampNs,
+                                           const int64_t wallClockNs,
+                                           const bool include_current_partial_bucket,
+                                           const bool erase_data,
+                                           const DumpReportReason dumpReportReason,
+                                           const DumpLatency dumpLatency,
+                                           ProtoOutputStream* proto) {
     auto it = mMetricsManagers.find(key);
     if (it != mMetricsManagers.end() && it->second->hasRestrictedMetricsDelegate()) {
         VLOG("Unexpected call to StatsLogProcessor::onDumpReport for restricted metrics.");
@@ -722,12 +755,12 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      const bool include_current_partial_bucket,
                                      const bool erase_data, const DumpReportReason dumpReportReason,
                                      const DumpLatency dumpLatency, vector<uint8_t>* outData) {
-    ProtoOutputStream proto;
+    ProtoOutputStreamPool::Stream proto = ProtoOutputStreamPool::getInstance().acquire();
     onDumpReport(key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data,
-                 dumpReportReason, dumpLatency, &proto);
+                 dumpReportReason, dumpLatency, proto.get());
 
     if (outData != nullptr) {
-        flushProtoToBuffer(proto, outData);
+        flushProtoToBuffer(*proto, outData);
         VLOG("output data size %zu", outData->size());
     }
 }
@@ -769,50 +802,51 @@ void StatsLogProcessor::onConfigMetricsReportLocked(
 
     std::set<string> str_set;
 
-    ProtoOutputStream tempProto;
+    ProtoOutputStreamPool::Stream tempProto = ProtoOutputStreamPool::getInstance().acquire();
     // First, fill in ConfigMetricsReport using current data on memory, which
     // starts from filling in StatsLogReport's.
     it->second->onDumpReport(dumpTimeStampNs, wallClockNs, include_current_partial_bucket,
-                             erase_data, dumpLatency, &str_set, &tempProto);
+                             erase_data, dumpLatency, &str_set, tempProto.get());
 
     // Fill in UidMap if there is at least one metric to report.
     // This skips the uid map if it's an empty config.
     if (it->second->getNumMetrics() > 0) {
-        uint64_t uidMapToken = tempProto.start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
+        uint64_t uidMapToken = tempProto->start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
         mUidMap->appendUidMap(dumpTimeStampNs, key, it->second->versionStringsInReport(),
                               it->second->installerInReport(),
                               it->second->packageCertificateHashSizeBytes(),
-                              it->second->hashStringInReport() ? &str_set : nullptr, &tempProto);
-        tempProto.end(uidMapToken);
+                              it->second->hashStringInReport() ? &str_set : nullptr,
+                              tempProto.get());
+        tempProto->end(uidMapToken);
     }
 
     // Fill in the timestamps.
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
-                    (long long)lastReportTimeNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
-                    (long long)dumpTimeStampNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
-                    (long long)lastReportWallClockNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
-                    (long long)wallClockNs);
+    tempProto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
+                     (long long)lastReportTimeNs);
+    tempProto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
+                     (long long)dumpTimeStampNs);
+    tempProto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
+                     (long long)lastReportWallClockNs);
+    tempProto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
+                     (long long)wallClockNs);
     // Dump report reason
-    tempProto.write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
+    tempProto->write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
 
     for (const auto& str : str_set) {
-        tempProto.write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
+        tempProto->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
     }
 
     // Data corrupted reason
-    writeDataCorruptedReasons(tempProto);
+    writeDataCorruptedReasons(*tempProto);
 
-    flushProtoToBuffer(tempProto, buffer);
+    flushProtoToBuffer(*tempProto, buffer);
 
     // save buffer to disk if needed
     if (erase_data && !dataSavedOnDisk && it->second->shouldPersistLocalHistory()) {
         VLOG("save history to disk");
         string file_name = StorageManager::getDataHistoryFileName((long)getWallClockSec(),
                                                                   key.GetUid(), key.GetId());
-        StorageManager::writeFile(file_name.c_str(), buffer->data(), buffer->size());
+        mPendingFiles.push_back({file_name, *buffer});
     }
 }
 
@@ -849,7 +883,16 @@ void StatsLogProcessor::resetIfConfigTtlExpiredLocked(const int64_t eventTimeNs)
 }
 
 void StatsLogProcessor::OnConfigRemoved(const ConfigKey& key) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    vector<PendingFile> pendingFiles;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        OnConfigRemovedLocked(key);
+        pendingFiles = takePendingFilesLocked();
+    }
+    writePendingFiles(pendingFiles);
+}
+
+void StatsLogProcessor::OnConfigRemovedLocked(const ConfigKey& key) {
     auto it = mMetricsManagers.find(key);
     if (it != mMetricsManagers.end()) {
         WriteDataToDiskLocked(key, getElapsedRealtimeNs(), getWallClockNs(), CONFIG_REMOVED,
@@ -1122,6 +1165,8 @@ void StatsLogProcessor::flushIfNecessaryLocked(const ConfigKey& key,
         // Too late. We need to start clearing data.
         metricsManager.dropData(elapsedRealtimeNs);
         StatsdStats::getInstance().noteDataDropped(key, totalBytes);
+        // Give back the memory held by idle report buffers too.
+        ProtoOutputStreamPool::getInstance().trim();
         VLOG("StatsD had to toss out metrics for %s", key.ToString().c_str());
     } else if ((totalBytes > kBytesPerConfig) ||
                (mOnDiskDataConfigs.find(key) != mOnDiskDataConfigs.end())) {
@@ -1159,24 +1204,136 @@ void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key, const int64_
                                               const int64_t wallClockNs,
                                               const DumpReportReason dumpReportReason,
                                               const DumpLatency dumpLatency) {
-    if (mMetricsManagers.find(key) == mMetricsManagers.end() ||
-        !mMetricsManagers.find(key)->second->shouldWriteToDisk()) {
-        return;
+    PendingFile file;
+    if (serializeConfigReportForDiskLocked(key, timestampNs, wallClockNs, dumpReportReason,
+                                           dumpLatency, &file)) {
+        // We were able to write the ConfigMetricsReport to disk, so we should trigger collection
+        // ASAP.
+        mPendingFiles.push_back(std::move(file));
+        mOnDiskDataConfigs.insert(key);
+    }
+}
+
+bool StatsLogProcessor::serializeConfigReportForDiskLocked(const ConfigKey& key,
+                                                           const int64_t timestampNs,
+                                                           const int64_t wallClockNs,
+                                                           const DumpReportReason dumpReportReason,
+                                                           const DumpLatency dumpLatency,
+                                                           PendingFile* file) {
+    const auto it = mMetricsManagers.find(key);
+    if (it == mMetricsManagers.end() || !it->second->shouldWriteToDisk()) {
+        return false;
     }
-    if (mMetricsManagers.find(key)->second->hasRestrictedMetricsDelegate()) {
-        mMetricsManagers.find(key)->second->flushRestrictedData();
-        return;
+    if (it->second->hasRestrictedMetricsDelegate()) {
+        it->second->flushRestrictedData();
+        return false;
     }
-    vector<uint8_t> buffer;
     onConfigMetricsReportLocked(key, timestampNs, wallClockNs,
                                 true /* include_current_partial_bucket*/, true /* erase_data */,
-                                dumpReportReason, dumpLatency, true, &buffer);
-    string file_name =
+                                dumpReportReason, dumpLatency, true, &file->content);
+    file->name =
             StorageManager::getDataFileName((long)getWallClockSec(), key.GetUid(), key.GetId());
-    StorageManager::writeFile(file_name.c_str(), buffer.data(), buffer.size());
+    return true;
+}
 
-    // We were able to write the ConfigMetricsReport to disk, so we should trigger collection ASAP.
-    mOnDiskDataConfigs.insert(key);
+void StatsLogProcessor::WriteDataToDiskOnShutdownLocked(const DumpReportReason dumpReportReason,
+                                                        const DumpLatency dumpLatency,
+                                                        const int64_t elapsedRealtimeNs,
+                                                        const int64_t wallClockNs) {
+    const int64_t deadlineNs = getElapsedRealtimeNs() + mShutdownPersistenceStartDeadlineNs;
+    const vector<sp<MetricsManager>> metricsManagers = getShutdownPersistenceOrderLocked();
+
+    // Each config is serialized by exactly one worker. Workers only read mMetricsManagers, which
+    // cannot change since mMetricsMutex is held by this thread until all workers are joined.
+    // Configs that have not started by the deadline are skipped. A config that has started is
+    // written in full even if the deadline passes meanwhile.
+    vector<PendingFile> files(metricsManagers.size());
+    vector<uint8_t> written(metricsManagers.size(), false);
+    vector<uint8_t> missed(metricsManagers.size(), false);
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        for (size_t i = nextIndex++; i < metricsManagers.size(); i = nextIndex++) {
+            if (getElapsedRealtimeNs() >= deadlineNs) {
+                missed[i] = true;
+                continue;
+            }
+            written[i] = serializeConfigReportForDiskLocked(metricsManagers[i]->getConfigKey(),
+                                                            elapsedRealtimeNs, wallClockNs,
+                                                            dumpReportReason, dumpLatency,
+                                                            &files[i]);
+        }
+    };
+    const size_t threadCount =
+            std::min(metricsManagers.size(), (size_t)SHUTDOWN_WRITE_THREAD_COUNT);
+    vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < metricsManagers.size(); i++) {
+        const ConfigKey key = metricsManagers[i]->getConfigKey();
+        if (written[i]) {
+            mPendingFiles.push_back(std::move(files[i]));
+            mOnDiskDataConfigs.insert(key);
+        } else if (missed[i]) {
+            ALOGW("Statsd did not write data of %s to disk before the shutdown deadline",
+                  key.ToString().c_str());
+            metricsManagers[i]->notePersistenceDeadlineMissed();
+            StatsdStats::getInstance().noteDataPersistenceDeadlineMissed(key);
+        }
+    }
+}
+
+vector<StatsLogProcessor::PendingFile> StatsLogProcessor::takePendingFilesLocked() {
+    vector<PendingFile> pendingFiles;
+    pendingFiles.swap(mPendingFiles);
+    return pendingFiles;
+}
+
+void StatsLogProcessor::writePendingFiles(const vector<PendingFile>& files) {
+    std::atomic<size_t> nextIndex(0);
+    auto worker = [&]() {
+        for (size_t i = nextIndex++; i < files.size(); i = nextIndex++) {
+            StorageManager::writeCompressibleFile(files[i].name.c_str(), files[i].content.data(),
+                                                  files[i].content.size());
+        }
+    };
+    const size_t threadCount = std::min(files.size(), (size_t)FILE_WRITE_THREAD_COUNT);
+    vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+vector<sp<MetricsManager>> StatsLogProcessor::getShutdownPersistenceOrderLocked() const {
+    vector<sp<MetricsManager>> metricsManagers;
+    metricsManagers.reserve(mMetricsManagers.size());
+    for (const auto& pair : mMetricsManagers) {
+        metricsManagers.push_back(pair.second);
+    }
+    // Configs of the same priority are ordered by key, so that the order does not depend on the
+    // hash map.
+    std::sort(metricsManagers.begin(), metricsManagers.end(),
+              [](const sp<MetricsManager>& a, const sp<MetricsManager>& b) {
+                  if (a->getPersistencePriority() != b->getPersistencePriority()) {
+                      return a->getPersistencePriority() > b->getPersistencePriority();
+                  }
+                  return a->getConfigKey() < b->getConfigKey();
+              });
+    return metricsManagers;
+}
+
+void StatsLogProcessor::setShutdownPersistenceStartDeadlineNs(const int64_t startDeadlineNs) {
+    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    mShutdownPersistenceStartDeadlineNs = startDeadlineNs;
 }
 
 void StatsLogProcessor::SaveActiveConfigsToDisk(int64_t currentTimeNs) {
@@ -1191,8 +1348,8 @@ void StatsLogProcessor::SaveActiveConfigsToDisk(int64_t currentTimeNs) {
     }
     mLastActiveMetricsWriteNs = timeNs;
 
-    ProtoOutputStream proto;
-    WriteActiveConfigsToProtoOutputStreamLocked(currentTimeNs, DEVICE_SHUTDOWN, &proto);
+    ProtoOutputStreamPool::Stream proto = ProtoOutputStreamPool::getInstance().acquire();
+    WriteActiveConfigsToProtoOutputStreamLocked(currentTimeNs, DEVICE_SHUTDOWN, proto.get());
 
     string file_name = StringPrintf("%s/active_metrics", STATS_ACTIVE_METRIC_DIR);
     StorageManager::deleteFile(file_name.c_str());
@@ -1202,12 +1359,22 @@ void StatsLogProcessor::SaveActiveConfigsToDisk(int64_t currentTimeNs) {
         ALOGE("Attempt to write %s but failed", file_name.c_str());
         return;
     }
-    proto.flush(fd.get());
+    proto->flush(fd.get());
 }
 
 void StatsLogProcessor::SaveMetadataToDisk(int64_t currentWallClockTimeNs,
                                            int64_t systemElapsedTimeNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
+    vector<PendingFile> pendingFiles;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        SaveMetadataToDiskLocked(currentWallClockTimeNs, systemElapsedTimeNs);
+        pendingFiles = takePendingFilesLocked();
+    }
+    writePendingFiles(pendingFiles);
+}
+
+void StatsLogProcessor::SaveMetadataToDiskLocked(int64_t currentWallClockTimeNs,
+                                                 int64_t systemElapsedTimeNs) {
     // Do not write to disk if we already have in the last few seconds.
     if (static_cast<unsigned long long> (systemElapsedTimeNs) <
             mLastMetadataWriteNs + WRITE_DATA_COOL_DOWN_SEC * NS_PER_SEC) {
@@ -1229,9 +1396,16 @@ void StatsLogProcessor::SaveMetadataToDisk(int64_t currentWallClockTimeNs,
         return;
     }
 
-    std::string data;
-    metadataList.SerializeToString(&data);
-    StorageManager::writeFile(file_name.c_str(), data.c_str(), data.size());
+    PendingFile file;
+    file.name = file_name;
+    file.content.resize(metadataList.ByteSizeLong());
+    metadataList.SerializeToArray(file.content.data(), file.content.size());
+    mPendingFiles.push_back(std::move(file));
+
+    // The missed shutdown writes are now reported from the metadata after reboot.
+    for (const auto& pair : mMetricsManagers) {
+        pair.second->clearPersistenceDeadlineMissed();
+    }
 }
 
 void StatsLogProcessor::WriteMetadataToProto(int64_t currentWallClockTimeNs,
@@ -1276,7 +1450,7 @@ void StatsLogProcessor::LoadMetadataFromDisk(int64_t currentWallClockTimeNs,
     close(fd);
 
     metadata::StatsMetadataList statsMetadataList;
-    if (!statsMetadataList.ParseFromString(content)) {
+    if (!decompressFileContent(&content) || !statsMetadataList.ParseFromString(content)) {
         ALOGE("Attempt to read %s but failed; failed to metadata", file_name.c_str());
         StorageManager::deleteFile(file_name.c_str());
         return;
@@ -1391,6 +1565,11 @@ void StatsLogProcessor::WriteDataToDiskLocked(const DumpReportReason dumpReportR
         return;
     }
     mLastWriteTimeNs = elapsedRealtimeNs;
+    if (dumpReportReason == DEVICE_SHUTDOWN || dumpReportReason == TERMINATION_SIGNAL_RECEIVED) {
+        WriteDataToDiskOnShutdownLocked(dumpReportReason, dumpLatency, elapsedRealtimeNs,
+                                        wallClockNs);
+        return;
+    }
     for (auto& pair : mMetricsManagers) {
         WriteDataToDiskLocked(pair.first, elapsedRealtimeNs, wallClockNs, dumpReportReason,
                               dumpLatency);
@@ -1401,8 +1580,13 @@ void StatsLogProcessor::WriteDataToDisk(const DumpReportReason dumpReportReason,
                                         const DumpLatency dumpLatency,
                                         const int64_t elapsedRealtimeNs,
                                         const int64_t wallClockNs) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
-    WriteDataToDiskLocked(dumpReportReason, dumpLatency, elapsedRealtimeNs, wallClockNs);
+    vector<PendingFile> pendingFiles;
+    {
+        std::lock_guard<std::mutex> lock(mMetricsMutex);
+        WriteDataToDiskLocked(dumpReportReason, dumpLatency, elapsedRealtimeNs, wallClockNs);
+        pendingFiles = takePendingFilesLocked();
+    }
+    writePendingFiles(pendingFiles);
 }
 
 void StatsLogProcessor::informPullAlarmFired(const int64_t timestampNs) {
@@ -1439,12 +1623,13 @@ void StatsLogProcessor::notifyAppRemoved(const int64_t eventTimeNs, const string
     }
 }
 
-void StatsLogProcessor::onUidMapReceived(const int64_t eventTimeNs) {
+void StatsLogProcessor::onUidMapReceived(const int64_t eventTimeNs,
+                                         const std::set<std::string>& changedPackages) {
     std::lock_guard<std::mutex> lock(mMetricsMutex);
-    VLOG("Received uid map");
-    StateManager::getInstance().updateLogSources(mUidMap);
+    VLOG("Received uid map with %zu changed packages", changedPackages.size());
+    StateManager::getInstance().notifyAppsChanged(changedPackages, mUidMap);
     for (const auto& it : mMetricsManagers) {
-        it.second->onUidMapReceived(eventTimeNs);
+        it.second->onUidMapReceived(eventTimeNs, changedPackages);
     }
 }
 
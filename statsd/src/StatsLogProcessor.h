@@ -81,10 +81,20 @@ public:
             int64_t timestampNs,
             unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>>& alarmSet);
 
-    /* Flushes data to disk. Data on memory will be gone after written to disk. */
+    /* Flushes data to disk. Data on memory will be gone after written to disk.
+     * On shutdown, configs are written in parallel by persistence priority, and configs that are
+     * not started before the shutdown persistence start deadline are skipped and noted in
+     * StatsdStats.
+     */
     void WriteDataToDisk(const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
                          const int64_t elapsedRealtimeNs, int64_t wallClockNs);
 
+    /* Sets how long after a shutdown write begins configs may still start being written. This is
+     * a start deadline: a config that has started is always written in full, however long it
+     * takes, so the shutdown write can run past it by the duration of the slowest config.
+     */
+    void setShutdownPersistenceStartDeadlineNs(int64_t startDeadlineNs);
+
     /* Persist configs containing metrics with active activations to disk. */
     void SaveActiveConfigsToDisk(int64_t currentTimeNs);
 
@@ -126,7 +136,8 @@ public:
     void notifyAppRemoved(int64_t eventTimeNs, const string& apk, int uid) override;
 
     /* Notify all MetricsManagers of uid map snapshots received */
-    void onUidMapReceived(int64_t eventTimeNs) override;
+    void onUidMapReceived(int64_t eventTimeNs,
+                          const std::set<std::string>& changedPackages) override;
 
     /* Notify all metrics managers of boot completed
      * This will force a bucket split when the boot is finished.
@@ -182,6 +193,9 @@ private:
         return mPeriodicAlarmMonitor;
     }
 
+    // Default time after a shutdown write begins by which each config must start being written.
+    static const int64_t kDefaultShutdownPersistenceStartDeadlineNs = 3 * NS_PER_SEC;
+
     mutable mutex mMetricsMutex;
 
     // Guards mNextAnomalyAlarmTime. A separate mutex is needed because alarms are set/cancelled
@@ -224,13 +238,39 @@ private:
 
     std::shared_ptr<LogEventFilter> mLogEventFilter;
 
+    // A report or metadata file serialized while mMetricsMutex is held. The files are compressed,
+    // if enabled, and written by the caller once it has released the mutex, so that compression
+    // does not hold up the log events.
+    struct PendingFile {
+        std::string name;
+        std::vector<uint8_t> content;
+    };
+
+    // Files serialized and not taken for writing yet.
+    std::vector<PendingFile> mPendingFiles;
+
+    std::vector<PendingFile> takePendingFilesLocked();
+
+    // Writes the files, in parallel if there are several. Must not be called with mMetricsMutex
+    // held.
+    static void writePendingFiles(const std::vector<PendingFile>& files);
+
     void OnLogEvent(LogEvent* event, int64_t elapsedRealtimeNs);
 
+    void OnLogEventLocked(LogEvent* event, int64_t elapsedRealtimeNs);
+
     void resetIfConfigTtlExpiredLocked(const int64_t eventTimeNs);
 
     void OnConfigUpdatedLocked(const int64_t currentTimestampNs, const ConfigKey& key,
                                const StatsdConfig& config, bool modularUpdate);
 
+    void OnConfigRemovedLocked(const ConfigKey& key);
+
+    void onDumpReportLocked(const ConfigKey& key, int64_t dumpTimeNs, int64_t wallClockNs,
+                            const bool include_current_partial_bucket, const bool erase_data,
+                            const DumpReportReason dumpReportReason,
+                            const DumpLatency dumpLatency, ProtoOutputStream* proto);
+
     void GetActiveConfigsLocked(const int uid, vector<int64_t>& outActiveConfigs);
 
     void WriteActiveConfigsToProtoOutputStreamLocked(
@@ -247,6 +287,8 @@ private:
                                     int64_t systemElapsedTimeNs,
                                     metadata::StatsMetadataList* metadataList);
 
+    void SaveMetadataToDiskLocked(int64_t currentWallClockTimeNs, int64_t systemElapsedTimeNs);
+
     void WriteDataToDiskLocked(const DumpReportReason dumpReportReason,
                                const DumpLatency dumpLatency, int64_t elapsedRealtimeNs,
                                const int64_t wallClockNs);
@@ -255,6 +297,21 @@ private:
                                const DumpReportReason dumpReportReason,
                                const DumpLatency dumpLatency);
 
+    // Serializes the report of a single config into the file to write to disk. Returns true if
+    // there is a report file to write. Safe to call concurrently for different configs while
+    // mMetricsMutex is held by the caller.
+    bool serializeConfigReportForDiskLocked(const ConfigKey& key, int64_t timestampNs,
+                                            const int64_t wallClockNs,
+                                            const DumpReportReason dumpReportReason,
+                                            const DumpLatency dumpLatency, PendingFile* file);
+
+    void WriteDataToDiskOnShutdownLocked(const DumpReportReason dumpReportReason,
+                                         const DumpLatency dumpLatency, int64_t elapsedRealtimeNs,
+                                         const int64_t wallClockNs);
+
+    // Returns the MetricsManagers in the order they are written to disk on shutdown.
+    std::vector<sp<MetricsManager>> getShutdownPersistenceOrderLocked() const;
+
     void onConfigMetricsReportLocked(
             const ConfigKey& key, int64_t dumpTimeStampNs, int64_t wallClockNs,
             const bool include_current_partial_bucket, const bool erase_data,
@@ -357,6 +414,9 @@ private:
     // Last time we wrote data to disk.
     int64_t mLastWriteTimeNs = 0;
 
+    // Time after a shutdown write begins by which each config must start being written.
+    int64_t mShutdownPersistenceStartDeadlineNs = kDefaultShutdownPersistenceStartDeadlineNs;
+
     // Last time we wrote active metrics to disk.
     int64_t mLastActiveMetricsWriteNs = 0;
 
@@ -385,6 +445,9 @@ private:
     FRIEND_TEST(StatsLogProcessorTest, TestEmptyConfigHasNoUidMap);
     FRIEND_TEST(StatsLogProcessorTest, TestReportIncludesSubConfig);
     FRIEND_TEST(StatsLogProcessorTest, TestPullUidProviderSetOnConfigUpdate);
+    FRIEND_TEST(StatsLogProcessorTest, TestWriteDataToDiskOnShutdownWritesAllConfigs);
+    FRIEND_TEST(StatsLogProcessorTest, TestShutdownPersistenceOrder);
+    FRIEND_TEST(StatsLogProcessorTest, TestWriteDataToDiskOnShutdownStartDeadlineMissed);
     FRIEND_TEST(StatsLogProcessorTestRestricted, TestInconsistentRestrictedMetricsConfigUpdate);
     FRIEND_TEST(StatsLogProcessorTestRestricted, TestRestrictedLogEventPassed);
     FRIEND_TEST(StatsLogProcessorTestRestricted, TestRestrictedLogEventNotPassed);
@@ -20,6 +20,7 @@
 #include "StatsService.h"
 
 #include <android-base/file.h>
+#include <android-base/parseint.h>
 #include <android-base/strings.h>
 #include <android/binder_ibinder_platform.h>
 #include <cutils/multiuser.h>
@@ -39,10 +40,12 @@
 #include "config/ConfigManager.h"
 #include "flags/FlagProvider.h"
 #include "guardrail/StatsdStats.h"
+#include "logd/AtomCapture.h"
 #include "stats_log_util.h"
 #include "storage/StorageManager.h"
 #include "subscriber/SubscriberReporter.h"
 #include "utils/DbUtils.h"
+#include "utils/ProtoOutputStreamPool.h"
 
 using namespace android;
 
@@ -257,9 +260,10 @@ void StatsService::readLogs() {
         // At this point, the LogEventQueue is not blocked, so that the socketListener
         // can read events from the socket and write to buffer to avoid data drop.
         mProcessor->OnLogEvent(event.get());
-        // The ShellSubscriber is only used by shell for local debugging.
+        // The ShellSubscriber is only used by shell for local debugging. It takes over the event
+        // and delivers it on its own thread, so slow subscribers do not hold up this loop.
         if (mShellSubscriber != nullptr) {
-            mShellSubscriber->onLogEvent(*event);
+            mShellSubscriber->enqueueLogEvent(std::move(event));
         }
     }
 }
@@ -339,7 +343,8 @@ void StatsService::dumpStatsdStats(int out, bool verbose, bool proto) {
  * Write stats report data in StatsDataDumpProto incident section format.
  */
 void StatsService::dumpIncidentSection(int out) {
-    ProtoOutputStream proto;
+    ProtoOutputStreamPool::Stream protoStream = ProtoOutputStreamPool::getInstance().acquire();
+    ProtoOutputStream& proto = *protoStream;
     for (const ConfigKey& configKey : mConfigManager->GetAllConfigKeys()) {
         uint64_t reportsListToken =
                 proto.start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS_LIST);
@@ -421,6 +426,10 @@ status_t StatsService::handleShellCommand(int in, int out, int err, const char**
             return cmd_print_logs(out, utf8Args);
         }
 
+        if (!utf8Args[0].compare(String8("capture"))) {
+            return cmd_capture(out, utf8Args);
+        }
+
         if (!utf8Args[0].compare(String8("send-active-configs"))) {
             return cmd_trigger_active_config_broadcast(out, utf8Args);
         }
@@ -559,6 +568,17 @@ void StatsService::print_cmd_help(int out) {
     dprintf(out, "usage: adb shell cmd stats print-logs\n");
     dprintf(out, "  Requires root privileges.\n");
     dprintf(out, "  Can be disabled by calling adb shell cmd stats print-logs 0\n");
+    dprintf(out, "\n");
+    dprintf(out, "usage: adb shell cmd stats capture start [--size BYTES] [ATOM_TAG...]\n");
+    dprintf(out, "usage: adb shell cmd stats capture stop\n");
+    dprintf(out, "  Requires root privileges.\n");
+    dprintf(out, "  Captures the atoms received by statsd, with their uid, pid and receive\n");
+    dprintf(out, "  time, into %s. When the file is full,\n", ATOM_CAPTURE_PATH);
+    dprintf(out, "  the oldest atoms are overwritten. Once stopped, the file can be replayed\n");
+    dprintf(out, "  with statsd_replay.\n");
+    dprintf(out, "  --size BYTES  Size of the capture file. Default is %zu.\n",
+            AtomCapture::kDefaultCapacityBytes);
+    dprintf(out, "  ATOM_TAG      Only capture these atoms. Default is all atoms.\n");
 }
 
 status_t StatsService::cmd_trigger_broadcast(int out, Vector<String8>& args) {
@@ -958,6 +978,55 @@ status_t StatsService::cmd_print_logs(int out, const Vector<String8>& args) {
     return NO_ERROR;
 }
 
+status_t StatsService::cmd_capture(int out, const Vector<String8>& args) {
+    Status status = checkUid(AID_ROOT);
+    if (!status.isOk()) {
+        return PERMISSION_DENIED;
+    }
+
+    if (args.size() >= 2 && !args[1].compare(String8("start"))) {
+        size_t capacityBytes = AtomCapture::kDefaultCapacityBytes;
+        std::unordered_set<int32_t> atomIds;
+        for (size_t i = 2; i < args.size(); i++) {
+            if (!args[i].compare(String8("--size")) && i + 1 < args.size()) {
+                if (!android::base::ParseUint(args[++i].c_str(), &capacityBytes)) {
+                    print_cmd_help(out);
+                    return UNKNOWN_ERROR;
+                }
+                continue;
+            }
+            int32_t atomId;
+            if (!android::base::ParseInt(args[i].c_str(), &atomId)) {
+                print_cmd_help(out);
+                return UNKNOWN_ERROR;
+            }
+            atomIds.insert(atomId);
+        }
+        if (!AtomCapture::getInstance().start(ATOM_CAPTURE_PATH, capacityBytes, atomIds)) {
+            dprintf(out, "Failed to start the capture.\n");
+            return UNKNOWN_ERROR;
+        }
+        dprintf(out, "Capturing into %s\n", ATOM_CAPTURE_PATH);
+        return NO_ERROR;
+    }
+
+    if (args.size() == 2 && !args[1].compare(String8("stop"))) {
+        uint64_t numRecords = 0;
+        uint64_t numOverwritten = 0;
+        if (!AtomCapture::getInstance().stop(&numRecords, &numOverwritten)) {
+            dprintf(out, "No capture running, or the capture could not be written.\n");
+            return UNKNOWN_ERROR;
+        }
+        dprintf(out, "Captured %llu atoms into %s, %llu older atoms were overwritten.\n",
+                (unsigned long long)numRecords, ATOM_CAPTURE_PATH,
+                (unsigned long long)numOverwritten);
+        return NO_ERROR;
+    }
+
+    print_cmd_help(out);
+    return UNKNOWN_ERROR;
+}
+
 bool StatsService::getUidFromArgs(const Vector<String8>& args, size_t uidArgIndex, int32_t& uid) {
     return getUidFromString(args[uidArgIndex].c_str(), uid);
 }
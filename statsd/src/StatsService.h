@@ -361,6 +361,11 @@ private:
      */
     status_t cmd_print_logs(int outFd, const Vector<String8>& args);
 
+    /**
+     * Start or stop capturing the atoms received on the socket.
+     */
+    status_t cmd_capture(int outFd, const Vector<String8>& args);
+
     /**
      * Implementation for request data for the configuration key.
      */
@@ -376,7 +376,7 @@ void ConfigManager::update_saved_configs_locked(const ConfigKey& key,
 
     // Then we save the latest config.
     string file_name =
-        StringPrintf("%s/%ld_%d_%lld", STATS_SERVICE_DIR, time(nullptr),
+        StringPrintf("%s/%ld_%d_%lld", STATS_SERVICE_DIR, (long)getWallClockSec(),
                      key.GetUid(), (long long)key.GetId());
     StorageManager::writeFile(file_name.c_str(), &buffer[0], numBytes);
 }
@@ -54,63 +54,80 @@ StatsPullerManager::StatsPullerManager()
 
 bool StatsPullerManager::Pull(int tagId, const ConfigKey& configKey, const int64_t eventTimeNs,
                               vector<shared_ptr<LogEvent>>* data) {
-    std::lock_guard<std::mutex> _l(mLock);
-    return PullLocked(tagId, configKey, eventTimeNs, data);
+    return PullInternal(tagId, configKey, eventTimeNs, data);
 }
 
 bool StatsPullerManager::Pull(int tagId, const vector<int32_t>& uids, const int64_t eventTimeNs,
                               vector<std::shared_ptr<LogEvent>>* data) {
-    std::lock_guard<std::mutex> _l(mLock);
-    return PullLocked(tagId, uids, eventTimeNs, data);
+    return PullInternal(tagId, uids, eventTimeNs, data);
 }
 
-bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
-                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
-    vector<int32_t> uids;
-    const auto& uidProviderIt = mPullUidProviders.find(configKey);
-    if (uidProviderIt == mPullUidProviders.end()) {
-        ALOGE("Error pulling tag %d. No pull uid provider for config key %s", tagId,
-              configKey.ToString().c_str());
-        StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
-        return false;
+bool StatsPullerManager::PullInternal(int tagId, const ConfigKey& configKey,
+                                      const int64_t eventTimeNs,
+                                      vector<shared_ptr<LogEvent>>* data) {
+    sp<PullUidProvider> pullUidProvider;
+    {
+        std::lock_guard<std::mutex> _l(mUidProvidersLock);
+        const auto& uidProviderIt = mPullUidProviders.find(configKey);
+        if (uidProviderIt == mPullUidProviders.end()) {
+            ALOGE("Error pulling tag %d. No pull uid provider for config key %s", tagId,
+                  configKey.ToString().c_str());
+            StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
+            return false;
+        }
+        pullUidProvider = uidProviderIt->second.promote();
     }
-    sp<PullUidProvider> pullUidProvider = uidProviderIt->second.promote();
     if (pullUidProvider == nullptr) {
         ALOGE("Error pulling tag %d, pull uid provider for config %s is gone.", tagId,
               configKey.ToString().c_str());
         StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
         return false;
     }
-    uids = pullUidProvider->getPullAtomUids(tagId);
-    return PullLocked(tagId, uids, eventTimeNs, data);
+    const vector<int32_t> uids = pullUidProvider->getPullAtomUids(tagId);
+    return PullInternal(tagId, uids, eventTimeNs, data);
 }
 
-bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
-                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
+bool StatsPullerManager::PullInternal(int tagId, const vector<int32_t>& uids,
+                                      const int64_t eventTimeNs,
+                                      vector<shared_ptr<LogEvent>>* data) {
     VLOG("Initiating pulling %d", tagId);
-    for (int32_t uid : uids) {
-        PullerKey key = {.uid = uid, .atomTag = tagId};
-        auto pullerIt = kAllPullAtomInfo.find(key);
-        if (pullerIt != kAllPullAtomInfo.end()) {
-            PullErrorCode status = pullerIt->second->Pull(eventTimeNs, data);
-            VLOG("pulled %zu items", data->size());
-            if (status != PULL_SUCCESS) {
-                StatsdStats::getInstance().notePullFailed(tagId);
+    int pullerUid = -1;
+    sp<StatsPuller> puller;
+    {
+        std::lock_guard<std::mutex> _l(mPullersLock);
+        for (int32_t uid : uids) {
+            auto pullerIt = kAllPullAtomInfo.find({.uid = uid, .atomTag = tagId});
+            if (pullerIt != kAllPullAtomInfo.end()) {
+                pullerUid = uid;
+                puller = pullerIt->second;
+                break;
             }
-            // If we received a dead object exception, it means the client process has died.
-            // We can remove the puller from the map.
-            if (status == PULL_DEAD_OBJECT) {
-                StatsdStats::getInstance().notePullerCallbackRegistrationChanged(
-                        tagId,
-                        /*registered=*/false);
-                kAllPullAtomInfo.erase(pullerIt);
-            }
-            return status == PULL_SUCCESS;
         }
     }
-    StatsdStats::getInstance().notePullerNotFound(tagId);
-    ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
-    return false;  // Return early since we don't know what to pull.
+    if (puller == nullptr) {
+        StatsdStats::getInstance().notePullerNotFound(tagId);
+        ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
+        return false;  // Return early since we don't know what to pull.
+    }
+
+    PullErrorCode status = puller->Pull(eventTimeNs, data);
+    VLOG("pulled %zu items", data->size());
+    if (status != PULL_SUCCESS) {
+        StatsdStats::getInstance().notePullFailed(tagId);
+    }
+    // If we received a dead object exception, it means the client process has died.
+    // We can remove the puller from the map, unless it was replaced during the pull.
+    if (status == PULL_DEAD_OBJECT) {
+        std::lock_guard<std::mutex> _l(mPullersLock);
+        auto pullerIt = kAllPullAtomInfo.find({.uid = pullerUid, .atomTag = tagId});
+        if (pullerIt != kAllPullAtomInfo.end() && pullerIt->second == puller) {
+            StatsdStats::getInstance().notePullerCallbackRegistrationChanged(
+                    tagId,
+                    /*registered=*/false);
+            kAllPullAtomInfo.erase(pullerIt);
+        }
+    }
+    return status == PULL_SUCCESS;
 }
 
 bool StatsPullerManager::PullerForMatcherExists(int tagId) const {
@@ -136,12 +153,15 @@ void StatsPullerManager::updateAlarmLocked() {
 
 void StatsPullerManager::SetStatsCompanionService(
         const shared_ptr<IStatsCompanionService>& statsCompanionService) {
-    std::lock_guard<std::mutex> _l(mLock);
+    {
+        std::lock_guard<std::mutex> _l(mPullersLock);
+        for (const auto& pulledAtom : kAllPullAtomInfo) {
+            pulledAtom.second->SetStatsCompanionService(statsCompanionService);
+        }
+    }
+    std::lock_guard<std::mutex> _l(mReceiversLock);
     shared_ptr<IStatsCompanionService> tmpForLock = mStatsCompanionService;
     mStatsCompanionService = statsCompanionService;
-    for (const auto& pulledAtom : kAllPullAtomInfo) {
-        pulledAtom.second->SetStatsCompanionService(statsCompanionService);
-    }
     if (mStatsCompanionService != nullptr) {
         updateAlarmLocked();
     }
@@ -150,7 +170,7 @@ void StatsPullerManager::SetStatsCompanionService(
 void StatsPullerManager::RegisterReceiver(int tagId, const ConfigKey& configKey,
                                           const wp<PullDataReceiver>& receiver,
                                           int64_t nextPullTimeNs, int64_t intervalNs) {
-    std::lock_guard<std::mutex> _l(mLock);
+    std::lock_guard<std::mutex> _l(mReceiversLock);
     auto& receivers = mReceivers[{.atomTag = tagId, .configKey = configKey}];
     for (auto it = receivers.begin(); it != receivers.end(); it++) {
         if (it->receiver == receiver) {
@@ -185,7 +205,7 @@ void StatsPullerManager::RegisterReceiver(int tagId, const ConfigKey& configKey,
 
 void StatsPullerManager::UnRegisterReceiver(int tagId, const ConfigKey& configKey,
                                             const wp<PullDataReceiver>& receiver) {
-    std::lock_guard<std::mutex> _l(mLock);
+    std::lock_guard<std::mutex> _l(mReceiversLock);
     auto receiversIt = mReceivers.find({.atomTag = tagId, .configKey = configKey});
     if (receiversIt == mReceivers.end()) {
         VLOG("Unknown pull code or no receivers: %d", tagId);
@@ -203,57 +223,74 @@ void StatsPullerManager::UnRegisterReceiver(int tagId, const ConfigKey& configKe
 
 void StatsPullerManager::RegisterPullUidProvider(const ConfigKey& configKey,
                                                  const wp<PullUidProvider>& provider) {
-    std::lock_guard<std::mutex> _l(mLock);
+    std::lock_guard<std::mutex> _l(mUidProvidersLock);
     mPullUidProviders[configKey] = provider;
 }
 
 void StatsPullerManager::UnregisterPullUidProvider(const ConfigKey& configKey,
                                                    const wp<PullUidProvider>& provider) {
-    std::lock_guard<std::mutex> _l(mLock);
+    std::lock_guard<std::mutex> _l(mUidProvidersLock);
     const auto& it = mPullUidProviders.find(configKey);
     if (it != mPullUidProviders.end() && it->second == provider) {
         mPullUidProviders.erase(it);
     }
 }
 
+int64_t StatsPullerManager::getNextPullTimeNs() {
+    std::lock_guard<std::mutex> _l(mReceiversLock);
+    return mNextPullTimeNs;
+}
+
 void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
-    std::lock_guard<std::mutex> _l(mLock);
     int64_t wallClockNs = getWallClockNs();
 
-    int64_t minNextPullTimeNs = NO_ALARM_UPDATE;
-
-    vector<pair<const ReceiverKey*, vector<ReceiverInfo*>>> needToPull;
-    for (auto& pair : mReceivers) {
-        vector<ReceiverInfo*> receivers;
-        if (pair.second.size() != 0) {
+    // The receivers due on this alarm are copied under mReceiversLock and pulled after it is
+    // released, so that a slow puller does not hold up receiver registrations and alarm updates.
+    vector<pair<ReceiverKey, vector<sp<PullDataReceiver>>>> needToPull;
+    vector<sp<PullDataReceiver>> pullNotNeeded;
+    {
+        std::lock_guard<std::mutex> _l(mReceiversLock);
+        int64_t minNextPullTimeNs = NO_ALARM_UPDATE;
+        for (auto& pair : mReceivers) {
+            vector<sp<PullDataReceiver>> receivers;
             for (ReceiverInfo& receiverInfo : pair.second) {
-                // If pullNecessary and enough time has passed for the next bucket, then add
-                // receiver to the list that will pull on this alarm.
-                // If pullNecessary is false, check if next pull time needs to be updated.
-                sp<PullDataReceiver> receiverPtr = receiverInfo.receiver.promote();
-                const bool pullNecessary = receiverPtr != nullptr && receiverPtr->isPullNeeded();
-                if (receiverInfo.nextPullTimeNs <= elapsedTimeNs && pullNecessary) {
-                    receivers.push_back(&receiverInfo);
-                } else {
-                    if (receiverInfo.nextPullTimeNs <= elapsedTimeNs) {
-                        receiverPtr->onDataPulled({}, PullResult::PULL_NOT_NEEDED, elapsedTimeNs);
-                        int numBucketsAhead = (elapsedTimeNs - receiverInfo.nextPullTimeNs) /
-                                              receiverInfo.intervalNs;
-                        receiverInfo.nextPullTimeNs +=
-                                (numBucketsAhead + 1) * receiverInfo.intervalNs;
+                if (receiverInfo.nextPullTimeNs <= elapsedTimeNs) {
+                    // If pullNecessary, add receiver to the list that will pull on this alarm.
+                    sp<PullDataReceiver> receiverPtr = receiverInfo.receiver.promote();
+                    if (receiverPtr == nullptr) {
+                        VLOG("receiver already gone.");
+                    } else if (receiverPtr->isPullNeeded()) {
+                        receivers.push_back(receiverPtr);
+                    } else {
+                        pullNotNeeded.push_back(receiverPtr);
                     }
-                    minNextPullTimeNs = min(receiverInfo.nextPullTimeNs, minNextPullTimeNs);
+                    // We may have just come out of a coma, compute next pull time.
+                    int numBucketsAhead = (elapsedTimeNs - receiverInfo.nextPullTimeNs) /
+                                          receiverInfo.intervalNs;
+                    receiverInfo.nextPullTimeNs += (numBucketsAhead + 1) * receiverInfo.intervalNs;
                 }
+                minNextPullTimeNs = min(receiverInfo.nextPullTimeNs, minNextPullTimeNs);
             }
             if (receivers.size() > 0) {
-                needToPull.push_back(make_pair(&pair.first, receivers));
+                needToPull.push_back(make_pair(pair.first, receivers));
             }
         }
+
+        VLOG("mNextPullTimeNs: %lld updated to %lld", (long long)mNextPullTimeNs,
+             (long long)minNextPullTimeNs);
+        mNextPullTimeNs = minNextPullTimeNs;
+        updateAlarmLocked();
+    }
+
+    for (const sp<PullDataReceiver>& receiverPtr : pullNotNeeded) {
+        receiverPtr->onDataPulled({}, PullResult::PULL_NOT_NEEDED, elapsedTimeNs);
     }
+
     for (const auto& pullInfo : needToPull) {
         vector<shared_ptr<LogEvent>> data;
         PullResult pullResult =
-                PullLocked(pullInfo.first->atomTag, pullInfo.first->configKey, elapsedTimeNs, &data)
+                PullInternal(pullInfo.first.atomTag, pullInfo.first.configKey, elapsedTimeNs,
+                             &data)
                         ? PullResult::PULL_RESULT_SUCCESS
                         : PullResult::PULL_RESULT_FAIL;
         if (pullResult == PullResult::PULL_RESULT_FAIL) {
@@ -272,41 +309,34 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
             event->setLogdWallClockTimestampNs(wallClockNs);
         }
 
-        for (const auto& receiverInfo : pullInfo.second) {
-            sp<PullDataReceiver> receiverPtr = receiverInfo->receiver.promote();
-            if (receiverPtr != nullptr) {
-                receiverPtr->onDataPulled(data, pullResult, elapsedTimeNs);
-                // We may have just come out of a coma, compute next pull time.
-                int numBucketsAhead =
-                        (elapsedTimeNs - receiverInfo->nextPullTimeNs) / receiverInfo->intervalNs;
-                receiverInfo->nextPullTimeNs += (numBucketsAhead + 1) * receiverInfo->intervalNs;
-                minNextPullTimeNs = min(receiverInfo->nextPullTimeNs, minNextPullTimeNs);
-            } else {
-                VLOG("receiver already gone.");
-            }
+        for (const sp<PullDataReceiver>& receiverPtr : pullInfo.second) {
+            receiverPtr->onDataPulled(data, pullResult, elapsedTimeNs);
         }
     }
+}
 
-    VLOG("mNextPullTimeNs: %lld updated to %lld", (long long)mNextPullTimeNs,
-         (long long)minNextPullTimeNs);
-    mNextPullTimeNs = minNextPullTimeNs;
-    updateAlarmLocked();
+vector<sp<StatsPuller>> StatsPullerManager::getAllPullers() {
+    std::lock_guard<std::mutex> _l(mPullersLock);
+    vector<sp<StatsPuller>> pullers;
+    pullers.reserve(kAllPullAtomInfo.size());
+    for (const auto& pulledAtom : kAllPullAtomInfo) {
+        pullers.push_back(pulledAtom.second);
+    }
+    return pullers;
 }
 
 int StatsPullerManager::ForceClearPullerCache() {
-    std::lock_guard<std::mutex> _l(mLock);
     int totalCleared = 0;
-    for (const auto& pulledAtom : kAllPullAtomInfo) {
-        totalCleared += pulledAtom.second->ForceClearCache();
+    for (const sp<StatsPuller>& puller : getAllPullers()) {
+        totalCleared += puller->ForceClearCache();
     }
     return totalCleared;
 }
 
 int StatsPullerManager::ClearPullerCacheIfNecessary(int64_t timestampNs) {
-    std::lock_guard<std::mutex> _l(mLock);
     int totalCleared = 0;
-    for (const auto& pulledAtom : kAllPullAtomInfo) {
-        totalCleared += pulledAtom.second->ClearCacheIfNecessary(timestampNs);
+    for (const sp<StatsPuller>& puller : getAllPullers()) {
+        totalCleared += puller->ClearCacheIfNecessary(timestampNs);
     }
     return totalCleared;
 }
@@ -315,7 +345,6 @@ void StatsPullerManager::RegisterPullAtomCallback(const int uid, const int32_t a
                                                   const int64_t coolDownNs, const int64_t timeoutNs,
                                                   const vector<int32_t>& additiveFields,
                                                   const shared_ptr<IPullAtomCallback>& callback) {
-    std::lock_guard<std::mutex> _l(mLock);
     VLOG("RegisterPullerCallback: adding puller for tag %d", atomTag);
 
     if (callback == nullptr) {
@@ -329,6 +358,7 @@ void StatsPullerManager::RegisterPullAtomCallback(const int uid, const int32_t a
     sp<StatsCallbackPuller> puller = new StatsCallbackPuller(atomTag, callback, actualCoolDownNs,
                                                              actualTimeoutNs, additiveFields);
     PullerKey key = {.uid = uid, .atomTag = atomTag};
+    std::lock_guard<std::mutex> _l(mPullersLock);
     auto it = kAllPullAtomInfo.find(key);
     if (it != kAllPullAtomInfo.end()) {
         StatsdStats::getInstance().notePullerCallbackRegistrationChanged(atomTag,
@@ -339,7 +369,7 @@ void StatsPullerManager::RegisterPullAtomCallback(const int uid, const int32_t a
 }
 
 void StatsPullerManager::UnregisterPullAtomCallback(const int uid, const int32_t atomTag) {
-    std::lock_guard<std::mutex> _l(mLock);
+    std::lock_guard<std::mutex> _l(mPullersLock);
     PullerKey key = {.uid = uid, .atomTag = atomTag};
     if (kAllPullAtomInfo.find(key) != kAllPullAtomInfo.end()) {
         StatsdStats::getInstance().notePullerCallbackRegistrationChanged(atomTag,
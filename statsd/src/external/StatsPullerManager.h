@@ -91,6 +91,9 @@ public:
 
     void OnAlarmFired(int64_t elapsedTimeNs);
 
+    // Elapsed realtime of the next scheduled pull, or INT64_MAX if no pull is scheduled.
+    int64_t getNextPullTimeNs();
+
     // Pulls the most recent data.
     // The data may be served from cache if consecutive pulls come within
     // mCoolDownNs.
@@ -123,11 +126,14 @@ public:
 
     void UnregisterPullAtomCallback(const int uid, const int32_t atomTag);
 
+    // Guarded by mPullersLock.
     std::map<const PullerKey, sp<StatsPuller>> kAllPullAtomInfo;
 
 private:
     const static int64_t kMinCoolDownNs = NS_PER_SEC;
     const static int64_t kMaxTimeoutNs = 10 * NS_PER_SEC;
+
+    // Guarded by mReceiversLock.
     shared_ptr<IStatsCompanionService> mStatsCompanionService = nullptr;
 
     // A struct containing an atom id and a Config Key
@@ -146,23 +152,41 @@ private:
         wp<PullDataReceiver> receiver;
     } ReceiverInfo;
 
-    // mapping from Receiver Key to receivers
+    // mapping from Receiver Key to receivers. Guarded by mReceiversLock.
     std::map<ReceiverKey, std::list<ReceiverInfo>> mReceivers;
 
-    // mapping from Config Key to the PullUidProvider for that config
+    // mapping from Config Key to the PullUidProvider for that config. Guarded by
+    // mUidProvidersLock.
     std::map<ConfigKey, wp<PullUidProvider>> mPullUidProviders;
 
-    bool PullLocked(int tagId, const ConfigKey& configKey, int64_t eventTimeNs,
-                    vector<std::shared_ptr<LogEvent>>* data);
+    // These do not hold any lock while the puller runs, so pulls of different atoms run in
+    // parallel. Pulls of the same atom are serialized by the lock of its StatsPuller.
+    bool PullInternal(int tagId, const ConfigKey& configKey, int64_t eventTimeNs,
+                      vector<std::shared_ptr<LogEvent>>* data);
+
+    bool PullInternal(int tagId, const vector<int32_t>& uids, int64_t eventTimeNs,
+                      vector<std::shared_ptr<LogEvent>>* data);
+
+    // Returns a snapshot of the registered pullers, so that their caches can be cleared without
+    // holding mPullersLock.
+    vector<sp<StatsPuller>> getAllPullers();
+
+    // The state is split between three locks so that pulls, puller registrations and alarms do
+    // not wait on each other. No two of them are ever held together, and none is held while
+    // pulling or calling into a PullDataReceiver.
+
+    // lock for data receivers, the pulling alarm and StatsCompanionService changes
+    std::mutex mReceiversLock;
 
-    bool PullLocked(int tagId, const vector<int32_t>& uids, int64_t eventTimeNs,
-                    vector<std::shared_ptr<LogEvent>>* data);
+    // lock for the registered pullers. It is only held to look up or update the map.
+    std::mutex mPullersLock;
 
-    // locks for data receiver and StatsCompanionService changes
-    std::mutex mLock;
+    // lock for the pull uid providers
+    std::mutex mUidProvidersLock;
 
     void updateAlarmLocked();
 
+    // Guarded by mReceiversLock.
     int64_t mNextPullTimeNs;
 
     FRIEND_TEST(GaugeMetricE2ePulledTest, TestFirstNSamplesPulledNoTrigger);
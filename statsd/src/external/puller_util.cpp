@@ -51,8 +51,7 @@ void mapAndMergeIsolatedUidsToHostUid(vector<shared_ptr<LogEvent>>& data, const
                                       int tagId, const vector<int>& additiveFieldsVec) {
     // Check the first LogEvent for attribution chain or a uid field as either all atoms with this
     // tagId have them or none of them do.
-    std::pair<size_t, size_t> attrIndexRange;
-    const bool hasAttributionChain = data[0]->hasAttributionChain(&attrIndexRange);
+    const bool hasAttributionChain = data[0]->hasAttributionChain();
     const uint8_t numUidFields = data[0]->getNumUidFields();
 
     if (!hasAttributionChain && numUidFields == 0) {
@@ -67,14 +66,7 @@ void mapAndMergeIsolatedUidsToHostUid(vector<shared_ptr<LogEvent>>& data, const
             return;
         }
         if (hasAttributionChain) {
-            vector<FieldValue>* const fieldValues = event->getMutableValues();
-            for (size_t i = attrIndexRange.first; i <= attrIndexRange.second; i++) {
-                FieldValue& fieldValue = fieldValues->at(i);
-                if (isAttributionUidField(fieldValue)) {
-                    const int hostUid = uidMap->getHostUidOrSelf(fieldValue.mValue.int_value);
-                    fieldValue.mValue.setInt(hostUid);
-                }
-            }
+            mapIsolatedUidsToHostUidInAttributionChain(uidMap, *event);
         } else {
             mapIsolatedUidsToHostUidInLogEvent(uidMap, *event);
         }
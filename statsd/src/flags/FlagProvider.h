@@ -40,6 +40,12 @@ const std::string STATSD_NATIVE_BOOT_NAMESPACE = "statsd_native_boot";
 
 const std::string STATSD_INIT_COMPLETED_NO_DELAY_FLAG = "statsd_init_completed_no_delay";
 
+const std::string STATSD_COMPRESS_FILES_FLAG = "statsd_compress_files";
+
+const std::string STATSD_ASYNC_BUCKET_FINALIZATION_FLAG = "statsd_async_bucket_finalization";
+
+const std::string STATSD_CONFIG_COST_CEILINGS_FLAG = "statsd_config_cost_ceilings";
+
 const std::string FLAG_TRUE = "true";
 const std::string FLAG_FALSE = "false";
 const std::string FLAG_EMPTY = "";
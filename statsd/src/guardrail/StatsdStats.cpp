@@ -24,6 +24,7 @@
 #include "shell/ShellSubscriber.h"
 #include "statslog_statsd.h"
 #include "storage/StorageManager.h"
+#include "utils/ProtoOutputStreamPool.h"
 #include "utils/ShardOffsetProvider.h"
 
 namespace android {
@@ -136,6 +137,7 @@ const int FIELD_ID_DB_DELETION_CONFIG_INVALID = 34;
 const int FIELD_ID_DB_DELETION_TOO_OLD = 35;
 const int FIELD_ID_DB_DELETION_CONFIG_REMOVED = 36;
 const int FIELD_ID_DB_DELETION_CONFIG_UPDATED = 37;
+const int FIELD_ID_DATA_PERSISTENCE_DEADLINE_MISSED = 38;
 
 const int FIELD_ID_INVALID_CONFIG_REASON_ENUM = 1;
 const int FIELD_ID_INVALID_CONFIG_REASON_METRIC_ID = 2;
@@ -192,6 +194,7 @@ const int FIELD_ID_RESTRICTED_STATS_CATEGORY_CHANGED_COUNT = 6;
 
 const int FIELD_ID_SUBSCRIPTION_STATS_PER_SUBSCRIPTION_STATS = 1;
 const int FIELD_ID_SUBSCRIPTION_STATS_PULL_THREAD_WAKEUP_COUNT = 2;
+const int FIELD_ID_SUBSCRIPTION_STATS_EVENT_DROPPED_COUNT = 3;
 
 const int FIELD_ID_PER_SUBSCRIPTION_STATS_ID = 1;
 const int FIELD_ID_PER_SUBSCRIPTION_STATS_PUSHED_ATOM_COUNT = 2;
@@ -525,6 +528,16 @@ void StatsdStats::noteDbDeletionConfigUpdated(const ConfigKey& key) {
     it->second->db_deletion_config_updated++;
 }
 
+void StatsdStats::noteDataPersistenceDeadlineMissed(const ConfigKey& key, const int32_t count) {
+    lock_guard<std::mutex> lock(mLock);
+    auto it = mConfigStats.find(key);
+    if (it == mConfigStats.end()) {
+        ALOGE("Config key %s not found!", key.ToString().c_str());
+        return;
+    }
+    it->second->data_persistence_deadline_missed += count;
+}
+
 void StatsdStats::noteUidMapDropped(int deltas) {
     lock_guard<std::mutex> lock(mLock);
     mUidMapStats.dropped_changes += mUidMapStats.dropped_changes + deltas;
@@ -1015,6 +1028,11 @@ void StatsdStats::noteSubscriptionPullThreadWakeup() {
     mSubscriptionPullThreadWakeupCount++;
 }
 
+void StatsdStats::noteSubscriptionEventDropped() {
+    lock_guard<std::mutex> lock(mLock);
+    mSubscriptionEventDroppedCount++;
+}
+
 StatsdStats::AtomMetricStats& StatsdStats::getAtomMetricStats(int64_t metricId) {
     auto atomMetricStatsIter = mAtomMetricStats.find(metricId);
     if (atomMetricStatsIter != mAtomMetricStats.end()) {
@@ -1068,6 +1086,7 @@ void StatsdStats::resetInternalLocked() {
         config.second->db_deletion_too_old = 0;
         config.second->db_deletion_config_removed = 0;
         config.second->db_deletion_config_updated = 0;
+        config.second->data_persistence_deadline_missed = 0;
     }
     for (auto& pullStats : mPulledAtomStats) {
         pullStats.second.totalPull = 0;
@@ -1100,6 +1119,7 @@ void StatsdStats::resetInternalLocked() {
     mPushedAtomDropsStats.clear();
     mRestrictedMetricQueryStats.clear();
     mSubscriptionPullThreadWakeupCount = 0;
+    mSubscriptionEventDroppedCount = 0;
 
     for (auto it = mSubscriptionStats.begin(); it != mSubscriptionStats.end();) {
         if (it->second.end_time_sec > 0) {
@@ -1184,6 +1204,10 @@ void StatsdStats::dumpStats(int out) const {
                     configStats->db_deletion_too_old, configStats->db_deletion_config_removed,
                     configStats->db_deletion_config_updated);
         }
+        if (configStats->data_persistence_deadline_missed > 0) {
+            dprintf(out, ", data_persistence_deadline_missed=%d",
+                    configStats->data_persistence_deadline_missed);
+        }
         dprintf(out, "\n");
         if (!configStats->is_valid) {
             dprintf(out, "\tinvalid config reason: %s\n",
@@ -1256,6 +1280,10 @@ void StatsdStats::dumpStats(int out) const {
                     configStats->db_deletion_too_old, configStats->db_deletion_config_removed,
                     configStats->db_deletion_config_updated);
         }
+        if (configStats->data_persistence_deadline_missed > 0) {
+            dprintf(out, ", data_persistence_deadline_missed=%d",
+                    configStats->data_persistence_deadline_missed);
+        }
         dprintf(out, "\n");
         if (!configStats->is_valid) {
             dprintf(out, "\tinvalid config reason: %s\n",
@@ -1459,6 +1487,7 @@ void StatsdStats::dumpStats(int out) const {
 
     dprintf(out, "********Atom Subscription stats***********\n");
     dprintf(out, "Pull thread wakeup count: %d\n", mSubscriptionPullThreadWakeupCount);
+    dprintf(out, "Dropped event count: %d\n", mSubscriptionEventDroppedCount);
     for (const auto& [id, subStats] : mSubscriptionStats) {
         dprintf(out,
                 "Subscription %d: pushed_atom_count=%d, pulled_atom_count=%d, flush_count=%d\n", id,
@@ -1682,6 +1711,8 @@ void addConfigStatsToProto(const ConfigStats& configStats, ProtoOutputStream* pr
                              configStats.db_deletion_config_removed, proto);
     writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_DB_DELETION_CONFIG_UPDATED,
                              configStats.db_deletion_config_updated, proto);
+    writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_DATA_PERSISTENCE_DEADLINE_MISSED,
+                             configStats.data_persistence_deadline_missed, proto);
     for (int64_t latency : configStats.total_flush_latency_ns) {
         proto->write(FIELD_TYPE_INT64 | FIELD_ID_CONFIG_STATS_RESTRICTED_CONFIG_FLUSH_LATENCY |
                              FIELD_COUNT_REPEATED,
@@ -1703,7 +1734,8 @@ void addConfigStatsToProto(const ConfigStats& configStats, ProtoOutputStream* pr
 void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
     lock_guard<std::mutex> lock(mLock);
 
-    ProtoOutputStream proto;
+    ProtoOutputStreamPool::Stream protoStream = ProtoOutputStreamPool::getInstance().acquire();
+    ProtoOutputStream& proto = *protoStream;
     proto.write(FIELD_TYPE_INT32 | FIELD_ID_BEGIN_TIME, mStartTimeSec);
     proto.write(FIELD_TYPE_INT32 | FIELD_ID_END_TIME, (int32_t)getWallClockSec());
 
@@ -1887,6 +1919,8 @@ void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
     writeNonZeroStatToStream(
             FIELD_TYPE_INT32 | FIELD_ID_SUBSCRIPTION_STATS_PULL_THREAD_WAKEUP_COUNT,
             mSubscriptionPullThreadWakeupCount, &proto);
+    writeNonZeroStatToStream(FIELD_TYPE_INT32 | FIELD_ID_SUBSCRIPTION_STATS_EVENT_DROPPED_COUNT,
+                             mSubscriptionEventDroppedCount, &proto);
     proto.end(token);
 
     // libstatssocket specific stats
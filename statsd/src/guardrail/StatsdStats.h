@@ -91,6 +91,7 @@ struct ConfigStats {
     int32_t db_deletion_too_old = 0;
     int32_t db_deletion_config_removed = 0;
     int32_t db_deletion_config_updated = 0;
+    int32_t data_persistence_deadline_missed = 0;
 
     // Stores reasons for why config is valid or not
     std::optional<InvalidConfigReason> reason;
@@ -385,6 +386,12 @@ public:
      */
     void noteDbDeletionConfigUpdated(const ConfigKey& key);
 
+    /**
+     * Report that the data of a config was not written to disk before the shutdown persistence
+     * deadline. count is the number of missed writes, which may come from a previous boot.
+     */
+    void noteDataPersistenceDeadlineMissed(const ConfigKey& key, int32_t count = 1);
+
     /**
      * Report the size of output tuple of a condition.
      *
@@ -706,6 +713,11 @@ public:
      */
     void noteSubscriptionPullThreadWakeup();
 
+    /**
+     * Report a pushed event was dropped because the subscription dispatch queue was full.
+     */
+    void noteSubscriptionEventDropped();
+
     /**
      * Reset the historical stats. Including all stats in icebox, and the tracked stats about
      * metrics, matchers, and atoms. The active configs will be kept and StatsdStats will continue
@@ -972,6 +984,8 @@ private:
 
     int32_t mSubscriptionPullThreadWakeupCount = 0;
 
+    int32_t mSubscriptionEventDroppedCount = 0;
+
     // Maps Subscription ID to the corresponding SubscriptionStats struct object.
     // Size of this map is capped by ShellSubscriber::kMaxSubscriptions.
     std::map<int32_t, SubscriptionStats> mSubscriptionStats;
@@ -1048,6 +1062,7 @@ private:
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionEnded);
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionFlushed);
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionPullThreadWakeup);
+    FRIEND_TEST(StatsdStatsTest, TestSubscriptionEventDropped);
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionStarted);
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionStartedMaxActiveSubscriptions);
     FRIEND_TEST(StatsdStatsTest, TestSubscriptionStartedRemoveFinishedSubscription);
@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "logd/AtomCapture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::unordered_set;
+using std::vector;
+
+namespace {
+
+// Copies size bytes starting at offset out of a ring of capacity bytes.
+void readFromRing(const uint8_t* ring, uint64_t capacity, uint64_t offset, void* out,
+                  size_t size) {
+    uint8_t* bytes = static_cast<uint8_t*>(out);
+    const size_t first = std::min<uint64_t>(size, capacity - offset);
+    memcpy(bytes, ring + offset, first);
+    memcpy(bytes + first, ring, size - first);
+}
+
+}  // anonymous namespace
+
+std::atomic<bool> AtomCapture::sCapturing(false);
+
+AtomCapture& AtomCapture::getInstance() {
+    static AtomCapture capture;
+    return capture;
+}
+
+bool AtomCapture::start(const string& path, size_t capacityBytes,
+                        const unordered_set<int32_t>& atomIds) {
+    lock_guard<mutex> lock(mMutex);
+    if (mMapped != nullptr) {
+        ALOGE("Atom capture already running");
+        return false;
+    }
+    capacityBytes = std::clamp(capacityBytes, kMinCapacityBytes, kMaxCapacityBytes);
+
+    mFd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (mFd < 0) {
+        ALOGE("Failed to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    const size_t mappedSize = sizeof(AtomRingHeader) + capacityBytes;
+    if (ftruncate(mFd, mappedSize) != 0) {
+        ALOGE("Failed to size %s: %s", path.c_str(), strerror(errno));
+        close(mFd);
+        mFd = -1;
+        return false;
+    }
+    void* mapped = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+    if (mapped == MAP_FAILED) {
+        ALOGE("Failed to map %s: %s", path.c_str(), strerror(errno));
+        close(mFd);
+        mFd = -1;
+        return false;
+    }
+
+    mPath = path;
+    mAtomIds = atomIds;
+    mMapped = static_cast<uint8_t*>(mapped);
+    mMappedSize = mappedSize;
+    mHeader = reinterpret_cast<AtomRingHeader*>(mMapped);
+    mData = mMapped + sizeof(AtomRingHeader);
+    *mHeader = {kAtomRingMagic, kAtomStreamVersion, capacityBytes, /*head=*/0, /*size=*/0,
+                /*numRecords=*/0, /*numOverwritten=*/0};
+    sCapturing = true;
+    return true;
+}
+
+bool AtomCapture::stop(uint64_t* numRecords, uint64_t* numOverwritten) {
+    vector<AtomRecord> records;
+    string path;
+    {
+        lock_guard<mutex> lock(mMutex);
+        if (mMapped == nullptr) {
+            return false;
+        }
+        sCapturing = false;
+        *numRecords = mHeader->numRecords;
+        *numOverwritten = mHeader->numOverwritten;
+        readAtomRing(mMapped, mMappedSize, &records);
+        path = mPath;
+        unmapLocked();
+    }
+    return writeAtomStreamFile(path, records);
+}
+
+void AtomCapture::noteAtom(const uint8_t* payload, uint32_t size, int32_t atomId, int32_t uid,
+                           int32_t pid) {
+    lock_guard<mutex> lock(mMutex);
+    if (mMapped == nullptr || (!mAtomIds.empty() && mAtomIds.find(atomId) == mAtomIds.end())) {
+        return;
+    }
+    const uint64_t recordSize = sizeof(AtomRecordHeader) + size;
+    if (recordSize > mHeader->capacity) {
+        return;
+    }
+
+    // Make room by dropping the oldest records.
+    while (mHeader->capacity - mHeader->size < recordSize) {
+        AtomRecordHeader oldest;
+        readFromRing(mData, mHeader->capacity, mHeader->head, &oldest, sizeof(oldest));
+        const uint64_t oldestSize = sizeof(oldest) + oldest.payloadSize;
+        mHeader->head = (mHeader->head + oldestSize) % mHeader->capacity;
+        mHeader->size -= oldestSize;
+        mHeader->numRecords--;
+        mHeader->numOverwritten++;
+    }
+
+    const AtomRecordHeader header = {size, atomId, uid, pid, getElapsedRealtimeNs()};
+    writeLocked(&header, sizeof(header));
+    writeLocked(payload, size);
+    mHeader->numRecords++;
+}
+
+void AtomCapture::writeLocked(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    const uint64_t offset = (mHeader->head + mHeader->size) % mHeader->capacity;
+    const size_t first = std::min<uint64_t>(size, mHeader->capacity - offset);
+    memcpy(mData + offset, bytes, first);
+    memcpy(mData, bytes + first, size - first);
+    mHeader->size += size;
+}
+
+void AtomCapture::unmapLocked() {
+    munmap(mMapped, mMappedSize);
+    close(mFd);
+    mFd = -1;
+    mMapped = nullptr;
+    mMappedSize = 0;
+    mHeader = nullptr;
+    mData = nullptr;
+    mAtomIds.clear();
+}
+
+bool AtomCapture::readAtomRing(const uint8_t* buffer, size_t size, vector<AtomRecord>* records) {
+    AtomRingHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if (header.magic != kAtomRingMagic || header.version != kAtomStreamVersion ||
+        header.capacity != size - sizeof(header) || header.head >= header.capacity ||
+        header.size > header.capacity) {
+        ALOGE("Invalid atom ring");
+        return false;
+    }
+
+    const uint8_t* data = buffer + sizeof(header);
+    uint64_t offset = header.head;
+    uint64_t remaining = header.size;
+    while (remaining >= sizeof(AtomRecordHeader)) {
+        AtomRecordHeader recordHeader;
+        readFromRing(data, header.capacity, offset, &recordHeader, sizeof(recordHeader));
+        const uint64_t recordSize = sizeof(recordHeader) + recordHeader.payloadSize;
+        if (recordSize > remaining) {
+            ALOGE("Truncated atom ring record");
+            return false;
+        }
+
+        AtomRecord record;
+        record.atomId = recordHeader.atomId;
+        record.uid = recordHeader.uid;
+        record.pid = recordHeader.pid;
+        record.receiveElapsedNs = recordHeader.receiveElapsedNs;
+        record.payload.resize(recordHeader.payloadSize);
+        readFromRing(data, header.capacity, (offset + sizeof(recordHeader)) % header.capacity,
+                     record.payload.data(), recordHeader.payloadSize);
+        records->push_back(std::move(record));
+
+        offset = (offset + recordSize) % header.capacity;
+        remaining -= recordSize;
+    }
+    return true;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "logd/AtomStream.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+#define ATOM_CAPTURE_PATH "/data/misc/stats-data/atom-capture.bin"
+
+/**
+ * Header of the ring file an AtomCapture writes to. The header is followed by `capacity` bytes
+ * holding the AtomStream records of the captured atoms, starting at `head` and wrapping around
+ * the end of the data region. The records are in the AtomStream layout of the same version.
+ */
+const uint32_t kAtomRingMagic = 0x474e4952;  // "RING"
+
+struct AtomRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    // Offset in the data region of the oldest record.
+    uint64_t head;
+    // Bytes of records in the data region.
+    uint64_t size;
+    uint64_t numRecords;
+    // Records overwritten by newer ones because the ring was full.
+    uint64_t numOverwritten;
+};
+
+static_assert(sizeof(AtomRingHeader) == 48, "AtomRingHeader layout changed");
+
+/**
+ * Captures the atoms received on the statsd socket, exactly as the clients sent them, so that
+ * they can be replayed offline (see src/replay). Started and stopped with
+ * "adb shell cmd stats capture".
+ *
+ * While capturing, every atom that passes the atom id filter is appended to a memory-mapped ring
+ * file of bounded size, overwriting the oldest atoms when the ring is full. Stopping the capture
+ * rewrites the file as a plain atom stream, oldest atom first.
+ */
+class AtomCapture {
+public:
+    static AtomCapture& getInstance();
+
+    // Whether a capture is running. This is the only cost of the capture when it is not running.
+    static inline bool isCapturing() {
+        return sCapturing.load(std::memory_order_relaxed);
+    }
+
+    static constexpr size_t kDefaultCapacityBytes = 16 * 1024 * 1024;
+    static constexpr size_t kMinCapacityBytes = 64 * 1024;
+    static constexpr size_t kMaxCapacityBytes = 256 * 1024 * 1024;
+
+    // Starts capturing into a ring of capacityBytes bytes mapped from path. Only the atoms in
+    // atomIds are captured, or all of them if atomIds is empty. Returns false if a capture is
+    // already running or the file could not be mapped.
+    bool start(const std::string& path, size_t capacityBytes,
+               const std::unordered_set<int32_t>& atomIds);
+
+    // Stops the capture and rewrites the file as an atom stream that readAtomStreamFile can read.
+    // Returns false if no capture was running or the file could not be written.
+    bool stop(uint64_t* numRecords, uint64_t* numOverwritten);
+
+    // Records an atom received from the socket. payload is the StatsEvent encoding of the atom.
+    void noteAtom(const uint8_t* payload, uint32_t size, int32_t atomId, int32_t uid,
+                  int32_t pid);
+
+    // Reads the records of a ring file, oldest first. Returns false if buffer is not a ring of a
+    // supported version.
+    static bool readAtomRing(const uint8_t* buffer, size_t size, std::vector<AtomRecord>* records);
+
+private:
+    AtomCapture() = default;
+
+    void writeLocked(const void* data, size_t size);
+
+    void unmapLocked();
+
+    static std::atomic<bool> sCapturing;
+
+    std::mutex mMutex;
+
+    std::string mPath;
+
+    std::unordered_set<int32_t> mAtomIds;
+
+    int mFd = -1;
+
+    uint8_t* mMapped = nullptr;
+
+    size_t mMappedSize = 0;
+
+    // Points into mMapped.
+    AtomRingHeader* mHeader = nullptr;
+
+    uint8_t* mData = nullptr;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "logd/AtomStream.h"
+
+#include <android-base/file.h>
+#include <string.h>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+void appendBytes(const void* data, size_t size, vector<uint8_t>* out) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out->insert(out->end(), bytes, bytes + size);
+}
+
+}  // anonymous namespace
+
+unique_ptr<LogEvent> AtomRecord::toLogEvent() const {
+    unique_ptr<LogEvent> event = std::make_unique<LogEvent>(uid, pid);
+    if (!event->parseBuffer(payload.data(), payload.size())) {
+        return nullptr;
+    }
+    return event;
+}
+
+void writeAtomStreamHeader(vector<uint8_t>* out) {
+    const AtomStreamHeader header = {kAtomStreamMagic, kAtomStreamVersion};
+    appendBytes(&header, sizeof(header), out);
+}
+
+void writeAtomRecord(const AtomRecord& record, vector<uint8_t>* out) {
+    const AtomRecordHeader header = {static_cast<uint32_t>(record.payload.size()), record.atomId,
+                                     record.uid, record.pid, record.receiveElapsedNs};
+    appendBytes(&header, sizeof(header), out);
+    appendBytes(record.payload.data(), record.payload.size(), out);
+}
+
+bool readAtomStream(const uint8_t* buffer, size_t size, vector<AtomRecord>* records) {
+    AtomStreamHeader streamHeader;
+    if (size < sizeof(streamHeader)) {
+        ALOGE("Atom stream is missing its header");
+        return false;
+    }
+    memcpy(&streamHeader, buffer, sizeof(streamHeader));
+    if (streamHeader.magic != kAtomStreamMagic) {
+        ALOGE("Not an atom stream");
+        return false;
+    }
+    if (streamHeader.version != kAtomStreamVersion) {
+        ALOGE("Unsupported atom stream version %u", streamHeader.version);
+        return false;
+    }
+
+    size_t offset = sizeof(streamHeader);
+    while (offset < size) {
+        AtomRecordHeader header;
+        if (size - offset < sizeof(header)) {
+            ALOGE("Truncated atom record header at offset %zu", offset);
+            return false;
+        }
+        memcpy(&header, buffer + offset, sizeof(header));
+        offset += sizeof(header);
+        if (size - offset < header.payloadSize) {
+            ALOGE("Truncated atom record payload at offset %zu", offset);
+            return false;
+        }
+
+        AtomRecord record;
+        record.atomId = header.atomId;
+        record.uid = header.uid;
+        record.pid = header.pid;
+        record.receiveElapsedNs = header.receiveElapsedNs;
+        record.payload.assign(buffer + offset, buffer + offset + header.payloadSize);
+        records->push_back(std::move(record));
+        offset += header.payloadSize;
+    }
+    return true;
+}
+
+bool readAtomStreamFile(const string& path, vector<AtomRecord>* records) {
+    string content;
+    if (!android::base::ReadFileToString(path, &content)) {
+        ALOGE("Failed to read atom stream %s", path.c_str());
+        return false;
+    }
+    return readAtomStream(reinterpret_cast<const uint8_t*>(content.data()), content.size(),
+                          records);
+}
+
+bool writeAtomStreamFile(const string& path, const vector<AtomRecord>& records) {
+    vector<uint8_t> buffer;
+    writeAtomStreamHeader(&buffer);
+    for (const AtomRecord& record : records) {
+        writeAtomRecord(record, &buffer);
+    }
+    const string content(buffer.begin(), buffer.end());
+    if (!android::base::WriteStringToFile(content, path)) {
+        ALOGE("Failed to write atom stream %s", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
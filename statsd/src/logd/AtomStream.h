@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "logd/LogEvent.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * A recorded stream of atoms, as received by statsd.
+ *
+ * The stream starts with an AtomStreamHeader followed by records. Each record is an
+ * AtomRecordHeader followed by payloadSize bytes holding the StatsEvent encoding of the atom, the
+ * same bytes that statsd reads from the socket and hands to LogEvent::parseBuffer.
+ * All the integers are in the byte order of the device that wrote the stream (little endian on
+ * every supported architecture).
+ */
+const uint32_t kAtomStreamMagic = 0x4d525453;  // "STRM"
+
+// Bump when the layout of the headers changes.
+const uint32_t kAtomStreamVersion = 1;
+
+struct AtomStreamHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct AtomRecordHeader {
+    uint32_t payloadSize;
+    int32_t atomId;
+    int32_t uid;
+    int32_t pid;
+    // Elapsed realtime at which statsd received the atom.
+    int64_t receiveElapsedNs;
+};
+
+static_assert(sizeof(AtomStreamHeader) == 8, "AtomStreamHeader layout changed");
+static_assert(sizeof(AtomRecordHeader) == 24, "AtomRecordHeader layout changed");
+
+struct AtomRecord {
+    int32_t atomId = 0;
+    int32_t uid = 0;
+    int32_t pid = 0;
+    int64_t receiveElapsedNs = 0;
+    std::vector<uint8_t> payload;
+
+    // Parses the payload. Returns nullptr if it is not a valid StatsEvent encoding.
+    std::unique_ptr<LogEvent> toLogEvent() const;
+};
+
+// Appends the stream header to out.
+void writeAtomStreamHeader(std::vector<uint8_t>* out);
+
+// Appends record to out.
+void writeAtomRecord(const AtomRecord& record, std::vector<uint8_t>* out);
+
+// Parses a whole stream. Returns false if the header is missing, the version is not supported or a
+// record is truncated. Records that were parsed before the error are still appended to records.
+bool readAtomStream(const uint8_t* buffer, size_t size, std::vector<AtomRecord>* records);
+
+bool readAtomStreamFile(const std::string& path, std::vector<AtomRecord>* records);
+
+bool writeAtomStreamFile(const std::string& path, const std::vector<AtomRecord>& records);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
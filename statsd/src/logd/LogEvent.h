@@ -211,6 +211,36 @@ public:
     // of the AttributionChain within mValues.
     bool hasAttributionChain(std::pair<size_t, size_t>* indexRange = nullptr) const;
 
+    // Attribution chain view. The chain is stored in mValues as (uid, tag) pairs, so node i has
+    // its uid at getAttributionChainStartIndex() + 2 * i and its tag right after it. This lets
+    // callers walk the nodes without decoding the position of every FieldValue.
+    //
+    // Returns the number of nodes in the AttributionChain, or 0 if there is none.
+    inline size_t getAttributionChainNodeCount() const {
+        if (!mAttributionChainStartIndex || !mAttributionChainEndIndex) {
+            return 0;
+        }
+        return (mAttributionChainEndIndex.value() - mAttributionChainStartIndex.value() + 1) / 2;
+    }
+
+    // Only valid if getAttributionChainNodeCount() > 0.
+    inline size_t getAttributionChainStartIndex() const {
+        return mAttributionChainStartIndex.value();
+    }
+
+    // Only valid for node < getAttributionChainNodeCount().
+    inline const FieldValue& getAttributionUid(size_t node) const {
+        return mValues[mAttributionChainStartIndex.value() + 2 * node];
+    }
+
+    inline FieldValue& getMutableAttributionUid(size_t node) {
+        return mValues[mAttributionChainStartIndex.value() + 2 * node];
+    }
+
+    inline const FieldValue& getAttributionTag(size_t node) const {
+        return mValues[mAttributionChainStartIndex.value() + 2 * node + 1];
+    }
+
     // Returns the index of the exclusive state field within the FieldValues vector if
     // an exclusive state exists. If there is no exclusive state field, returns -1.
     //
@@ -31,8 +31,11 @@
 
 #include "StatsService.h"
 #include "flags/FlagProvider.h"
+#include "metrics/BucketFinalizer.h"
+#include "metrics/parsing_utils/config_cost_estimator.h"
 #include "packages/UidMap.h"
 #include "socket/StatsSocketListener.h"
+#include "storage/StorageManager.h"
 
 using namespace android;
 using namespace android::os::statsd;
@@ -88,7 +91,17 @@ int main(int /*argc*/, char** /*argv*/) {
     ABinderProcess_startThreadPool();
 
     // Initialize boot flags
-    FlagProvider::getInstance().initBootFlags({STATSD_INIT_COMPLETED_NO_DELAY_FLAG});
+    FlagProvider::getInstance().initBootFlags(
+            {STATSD_INIT_COMPLETED_NO_DELAY_FLAG, STATSD_COMPRESS_FILES_FLAG,
+             STATSD_ASYNC_BUCKET_FINALIZATION_FLAG, STATSD_CONFIG_COST_CEILINGS_FLAG});
+
+    StorageManager::setCompressFiles(
+            FlagProvider::getInstance().getBootFlagBool(STATSD_COMPRESS_FILES_FLAG, FLAG_FALSE));
+    BucketFinalizer::setEnabled(FlagProvider::getInstance().getBootFlagBool(
+            STATSD_ASYNC_BUCKET_FINALIZATION_FLAG, FLAG_FALSE));
+    if (FlagProvider::getInstance().getBootFlagBool(STATSD_CONFIG_COST_CEILINGS_FLAG, FLAG_FALSE)) {
+        setConfigCostCeilings(getDefaultConfigCostCeilings());
+    }
 
     std::shared_ptr<LogEventQueue> eventQueue =
             std::make_shared<LogEventQueue>(50000); /*buffer limit. Buffer is NOT pre-allocated*/
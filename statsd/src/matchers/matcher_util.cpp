@@ -184,6 +184,43 @@ static pair<int, int> getStartEndAtDepth(int targetField, int start, int end, in
     return {newStart, newEnd};
 }
 
+/*
+ * Computes the ranges of computeRanges for a matcher on the event's attribution chain, using the
+ * chain's (uid, tag) layout to find the nodes instead of scanning the FieldValues.
+ */
+static vector<pair<int, int>> computeAttributionChainRanges(const FieldValueMatcher& matcher,
+                                                            const LogEvent& event, int& depth) {
+    const int numNodes = event.getAttributionChainNodeCount();
+    const int start = event.getAttributionChainStartIndex();
+    const int end = start + 2 * numNodes;
+
+    if (!matcher.has_position()) {
+        return {{start, end}};
+    }
+    depth++;
+    switch (matcher.position()) {
+        case Position::FIRST:
+            return {{start, start + 2}};
+        case Position::LAST:
+            return {{end - 2, end}};
+        case Position::ALL:
+        case Position::ANY: {
+            if (matcher.value_matcher_case() != FieldValueMatcher::kMatchesTuple) {
+                return {{start, end}};
+            }
+            vector<pair<int, int>> ranges;
+            ranges.reserve(numNodes);
+            for (int node = start; node < end; node += 2) {
+                ranges.push_back(std::make_pair(node, node + 2));
+            }
+            return ranges;
+        }
+        case Position::POSITION_UNKNOWN:
+            break;
+    }
+    return {};
+}
+
 /*
  * Returns pairs of start-end indices in vector<FieldValue> that pariticipate in matching.
  * The returned vector is empty if an error was encountered.
@@ -194,8 +231,14 @@ static pair<int, int> getStartEndAtDepth(int targetField, int start, int end, in
  * Also updates the depth reference parameter if matcher has Position specified.
  */
 static vector<pair<int, int>> computeRanges(const FieldValueMatcher& matcher,
-                                            const vector<FieldValue>& values, int start, int end,
+                                            const LogEvent& event, int start, int end,
                                             int& depth) {
+    if (depth == 0 && event.getAttributionChainNodeCount() > 0 &&
+        matcher.field() == event.getAttributionUid(0).mField.getPosAtDepth(0)) {
+        return computeAttributionChainRanges(matcher, event, depth);
+    }
+
+    const vector<FieldValue>& values = event.getValues();
     // Now we have zoomed in to a new range
     std::tie(start, end) = getStartEndAtDepth(matcher.field(), start, end, depth, values);
 
@@ -294,8 +337,7 @@ static MatchResult matchesSimple(const sp<UidMap>& uidMap, const FieldValueMatch
         return {false, nullptr};
     }
 
-    const vector<pair<int, int>> ranges =
-            computeRanges(matcher, event.getValues(), start, end, depth);
+    const vector<pair<int, int>> ranges = computeRanges(matcher, event, start, end, depth);
 
     if (ranges.empty()) {
         // No such field found.
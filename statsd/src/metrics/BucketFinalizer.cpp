@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "BucketFinalizer.h"
+
+#include <thread>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+std::atomic<bool> BucketFinalizer::sEnabled = false;
+
+BucketFinalizer& BucketFinalizer::getInstance() {
+    // The finalizer thread is never joined, so the instance is intentionally leaked.
+    static BucketFinalizer* instance = new BucketFinalizer();
+    return *instance;
+}
+
+void BucketFinalizer::setEnabled(bool enabled) {
+    sEnabled = enabled;
+}
+
+bool BucketFinalizer::isEnabled() {
+    return sEnabled;
+}
+
+void BucketFinalizer::schedule(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mThreadStarted) {
+            std::thread([this] { runTasks(); }).detach();
+            mThreadStarted = true;
+        }
+        mTasks.push_back(std::move(task));
+    }
+    mTaskCV.notify_one();
+}
+
+void BucketFinalizer::waitForIdle() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mIdleCV.wait(lock, [this] { return mTasks.empty() && !mRunning; });
+}
+
+void BucketFinalizer::runTasks() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mTaskCV.wait(lock, [this] { return !mTasks.empty(); });
+        std::function<void()> task = std::move(mTasks.front());
+        mTasks.pop_front();
+        mRunning = true;
+        lock.unlock();
+
+        task();
+
+        lock.lock();
+        mRunning = false;
+        if (mTasks.empty()) {
+            mIdleCV.notify_all();
+        }
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Runs the finalization of sealed metric buckets on a background thread.
+ *
+ * When the first event after a bucket boundary arrives, a MetricProducer seals its current bucket
+ * and starts a fresh one. Turning the sealed bucket into past buckets (iterating its dimensions,
+ * building the bucket entries) is handed to this class so that the event that crossed the boundary
+ * does not pay for every metric on the device. Producers finalize any outstanding buckets
+ * themselves before reading their past buckets, so reports are the same either way.
+ */
+class BucketFinalizer {
+public:
+    static BucketFinalizer& getInstance();
+
+    // Whether producers defer bucket finalization to this thread. Off by default.
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled();
+
+    // Runs task on the finalizer thread. Tasks run in the order they were scheduled.
+    void schedule(std::function<void()> task);
+
+    // Blocks until all the tasks scheduled so far have run.
+    void waitForIdle();
+
+private:
+    BucketFinalizer() = default;
+
+    void runTasks();
+
+    static std::atomic<bool> sEnabled;
+
+    std::mutex mMutex;
+
+    std::condition_variable mTaskCV;
+
+    std::condition_variable mIdleCV;
+
+    std::deque<std::function<void()>> mTasks;
+
+    // Whether the finalizer thread is running a task it has taken off mTasks.
+    bool mRunning = false;
+
+    bool mThreadStarted = false;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
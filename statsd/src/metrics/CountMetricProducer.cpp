@@ -62,6 +62,7 @@ const int FIELD_ID_DIMENSION_IN_WHAT = 1;
 const int FIELD_ID_SLICE_BY_STATE = 6;
 const int FIELD_ID_BUCKET_INFO = 3;
 const int FIELD_ID_DIMENSION_LEAF_IN_WHAT = 4;
+const int FIELD_ID_IS_OVERFLOW = 7;
 // for CountBucketInfo
 const int FIELD_ID_COUNT = 3;
 const int FIELD_ID_BUCKET_NUM = 4;
@@ -82,7 +83,8 @@ CountMetricProducer::CountMetricProducer(
                      stateGroupMap, getAppUpgradeBucketSplit(metric)),
       mDimensionGuardrailHit(false),
       mDimensionHardLimit(
-              StatsdStats::clampDimensionKeySizeLimit(metric.max_dimensions_per_bucket())) {
+              StatsdStats::clampDimensionKeySizeLimit(metric.max_dimensions_per_bucket())),
+      mRollUpOverflowDimensions(metric.roll_up_overflow_dimensions()) {
     if (metric.has_bucket()) {
         mBucketSizeNs =
                 TimeUnitToBucketSizeInMillisGuardrailed(key.GetUid(), metric.bucket()) * 1000000;
@@ -133,6 +135,7 @@ CountMetricProducer::CountMetricProducer(
 
 CountMetricProducer::~CountMetricProducer() {
     VLOG("~CountMetricProducer() called");
+    cancelBucketFinalization();
 }
 
 optional<InvalidConfigReason> CountMetricProducer::onConfigUpdatedLocked(
@@ -213,6 +216,7 @@ void CountMetricProducer::onSlicedConditionMayChangeLocked(bool overallCondition
 
 
 void CountMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
+    mPendingBuckets.clear();
     mPastBuckets.clear();
 }
 
@@ -226,6 +230,7 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
+    finalizePendingBucketsLocked();
 
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
     protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
@@ -262,7 +267,9 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         // First fill dimension.
-        if (mShouldUseNestedDimensions) {
+        if (isOverflowDimensionKey(dimensionKey)) {
+            protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_OVERFLOW, true);
+        } else if (mShouldUseNestedDimensions) {
             uint64_t dimensionToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
             writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
@@ -320,6 +327,7 @@ void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
 void CountMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
+    mPendingBuckets.clear();
     mPastBuckets.clear();
 }
 
@@ -347,7 +355,8 @@ bool CountMetricProducer::hitGuardRailLocked(const MetricDimensionKey& newKey) {
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (newTupleCount > mDimensionHardLimit) {
             if (!mHasHitGuardrail) {
-                ALOGE("CountMetric %lld dropping data for dimension key %s", (long long)mMetricId,
+                ALOGE("CountMetric %lld %s data for dimension key %s", (long long)mMetricId,
+                      mRollUpOverflowDimensions ? "rolling up" : "dropping",
                       newKey.toString().c_str());
                 mHasHitGuardrail = true;
             }
@@ -371,31 +380,35 @@ void CountMetricProducer::onMatchedLogEventInternalLocked(
         return;
     }
 
+    const MetricDimensionKey* countKey = &eventKey;
     auto it = mCurrentSlicedCounter->find(eventKey);
     if (it == mCurrentSlicedCounter->end()) {
         // ===========GuardRail==============
         if (hitGuardRailLocked(eventKey)) {
-            return;
+            if (!mRollUpOverflowDimensions) {
+                return;
+            }
+            countKey = &OVERFLOW_METRIC_DIMENSION_KEY;
         }
-        // create a counter for the new key
-        (*mCurrentSlicedCounter)[eventKey] = 1;
+        // create a counter for the new key, or increment the overflow counter
+        (*mCurrentSlicedCounter)[*countKey]++;
     } else {
         // increment the existing value
         auto& count = it->second;
         count++;
     }
     for (auto& tracker : mAnomalyTrackers) {
-        int64_t countWholeBucket = mCurrentSlicedCounter->find(eventKey)->second;
-        auto prev = mCurrentFullCounters->find(eventKey);
+        int64_t countWholeBucket = mCurrentSlicedCounter->find(*countKey)->second;
+        auto prev = mCurrentFullCounters->find(*countKey);
         if (prev != mCurrentFullCounters->end()) {
             countWholeBucket += prev->second;
         }
-        tracker->detectAndDeclareAnomaly(eventTimeNs, mCurrentBucketNum, mMetricId, eventKey,
+        tracker->detectAndDeclareAnomaly(eventTimeNs, mCurrentBucketNum, mMetricId, *countKey,
                                          countWholeBucket);
     }
 
-    VLOG("metric %lld %s->%lld", (long long)mMetricId, eventKey.toString().c_str(),
-         (long long)(*mCurrentSlicedCounter)[eventKey]);
+    VLOG("metric %lld %s->%lld", (long long)mMetricId, countKey->toString().c_str(),
+         (long long)(*mCurrentSlicedCounter)[*countKey]);
 }
 
 // When a new matched event comes in, we check if event falls into the current
@@ -451,16 +464,6 @@ void CountMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
             mConditionTimer.newBucketStart(eventTimeNs, nextBucketStartTimeNs);
     info.mConditionTrueNs = globalConditionTrueNs;
 
-    for (const auto& counter : *mCurrentSlicedCounter) {
-        if (countPassesThreshold(counter.second)) {
-            info.mCount = counter.second;
-            auto& bucketList = mPastBuckets[counter.first];
-            bucketList.push_back(info);
-            VLOG("metric %lld, dump key value: %s -> %lld", (long long)mMetricId,
-                 counter.first.toString().c_str(), (long long)counter.second);
-        }
-    }
-
     // Only update mCurrentFullCounters if any anomaly tackers are present.
     if (mAnomalyTrackers.size() > 0) {
         // If we have finished a full bucket, then send this to anomaly tracker.
@@ -489,12 +492,34 @@ void CountMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
     }
 
     StatsdStats::getInstance().noteBucketCount(mMetricId);
+    // The sealed counters are moved into mPastBuckets by finalizePendingBucketsLocked.
+    if (!mCurrentSlicedCounter->empty()) {
+        mPendingBuckets.push_back({mCurrentSlicedCounter, info});
+    }
     // Only resets the counters, but doesn't setup the times nor numbers.
-    // (Do not clear since the old one is still referenced in mAnomalyTrackers).
+    // (Do not clear since the old one is still referenced in mAnomalyTrackers and
+    // mPendingBuckets).
     mCurrentSlicedCounter = std::make_shared<DimToValMap>();
     mCurrentBucketStartTimeNs = nextBucketStartTimeNs;
     // Reset mHasHitGuardrail boolean since bucket was reset
     mHasHitGuardrail = false;
+    scheduleBucketFinalizationLocked();
+}
+
+void CountMetricProducer::finalizePendingBucketsLocked() {
+    for (PendingBucket& pendingBucket : mPendingBuckets) {
+        CountBucket& info = pendingBucket.info;
+        for (const auto& counter : *pendingBucket.counters) {
+            if (countPassesThreshold(counter.second)) {
+                info.mCount = counter.second;
+                auto& bucketList = mPastBuckets[counter.first];
+                bucketList.push_back(info);
+                VLOG("metric %lld, dump key value: %s -> %lld", (long long)mMetricId,
+                     counter.first.toString().c_str(), (long long)counter.second);
+            }
+        }
+    }
+    mPendingBuckets.clear();
 }
 
 // Rough estimate of CountMetricProducer buffer stored. This number will be
@@ -505,6 +530,9 @@ size_t CountMetricProducer::byteSizeLocked() const {
     for (const auto& pair : mPastBuckets) {
         totalSize += pair.second.size() * kBucketSize;
     }
+    for (const PendingBucket& pendingBucket : mPendingBuckets) {
+        totalSize += pendingBucket.counters->size() * kBucketSize;
+    }
     return totalSize;
 }
 
@@ -98,6 +98,8 @@ private:
 
     void flushCurrentBucketLocked(int64_t eventTimeNs, int64_t nextBucketStartTimeNs) override;
 
+    void finalizePendingBucketsLocked() override;
+
     void onActiveStateChangedLocked(const int64_t eventTimeNs, const bool isActive) override;
 
     optional<InvalidConfigReason> onConfigUpdatedLocked(
@@ -118,6 +120,14 @@ private:
 
     std::unordered_map<MetricDimensionKey, std::vector<CountBucket>> mPastBuckets;
 
+    // A bucket sealed by flushCurrentBucketLocked whose counts are not in mPastBuckets yet.
+    struct PendingBucket {
+        std::shared_ptr<DimToValMap> counters;
+        CountBucket info;
+    };
+
+    std::vector<PendingBucket> mPendingBuckets;
+
     // The current bucket (may be a partial bucket).
     std::shared_ptr<DimToValMap> mCurrentSlicedCounter = std::make_shared<DimToValMap>();
 
@@ -136,13 +146,20 @@ private:
 
     const size_t mDimensionHardLimit;
 
+    // Whether events of new dimensions past mDimensionHardLimit are counted in the overflow key
+    // instead of being dropped.
+    const bool mRollUpOverflowDimensions;
+
     FRIEND_TEST(CountMetricProducerTest, TestNonDimensionalEvents);
     FRIEND_TEST(CountMetricProducerTest, TestEventsWithNonSlicedCondition);
     FRIEND_TEST(CountMetricProducerTest, TestEventsWithSlicedCondition);
     FRIEND_TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced);
     FRIEND_TEST(CountMetricProducerTest, TestFirstBucket);
+    FRIEND_TEST(CountMetricProducerTest, TestDeferredBucketFinalization);
     FRIEND_TEST(CountMetricProducerTest, TestOneWeekTimeUnit);
     FRIEND_TEST(CountMetricProducerTest, TestSplitOnAppUpgradeDisabled);
+    FRIEND_TEST(CountMetricProducerTest, TestRollUpOverflowDimensions);
+    FRIEND_TEST(CountMetricProducerTest, TestDropOverflowDimensionsByDefault);
 
     FRIEND_TEST(CountMetricProducerTest_PartialBucket, TestSplitInCurrentBucket);
     FRIEND_TEST(CountMetricProducerTest_PartialBucket, TestSplitInNextBucket);
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "DistinctCountMetricProducer.h"
+
+#include <limits.h>
+#include <stdlib.h>
+
+#include "guardrail/StatsdStats.h"
+#include "hash.h"
+#include "metrics/parsing_utils/metrics_manager_util.h"
+#include "stats_log_util.h"
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_BYTES;
+using android::util::FIELD_TYPE_INT32;
+using android::util::FIELD_TYPE_INT64;
+using android::util::FIELD_TYPE_MESSAGE;
+using android::util::ProtoOutputStream;
+using std::nullopt;
+using std::optional;
+using std::string;
+using std::unique_ptr;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// for StatsLogReport
+const int FIELD_ID_DISTINCT_COUNT_METRICS = 19;
+// for DistinctCountBucketInfo
+const int FIELD_ID_SKETCH_INDEX = 1;
+const int FIELD_ID_SKETCH_ESTIMATE = 2;
+const int FIELD_ID_SKETCH_REGISTERS = 3;
+const int FIELD_ID_SKETCHES = 3;
+const int FIELD_ID_BUCKET_NUM = 4;
+const int FIELD_ID_START_BUCKET_ELAPSED_MILLIS = 5;
+const int FIELD_ID_END_BUCKET_ELAPSED_MILLIS = 6;
+const int FIELD_ID_CONDITION_TRUE_NS = 7;
+
+namespace {
+
+template <typename T>
+uint64_t hashBytes(const T& value) {
+    return Hash64(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+optional<uint64_t> getHashFromEvent(const LogEvent& event, const Matcher& matcher) {
+    for (const FieldValue& value : event.getValues()) {
+        if (value.mField.matches(matcher)) {
+            switch (value.mValue.type) {
+                case INT:
+                    return {hashBytes(value.mValue.int_value)};
+                case LONG:
+                    return {hashBytes(value.mValue.long_value)};
+                case FLOAT:
+                    return {hashBytes(value.mValue.float_value)};
+                case DOUBLE:
+                    return {hashBytes(value.mValue.double_value)};
+                case STRING:
+                    return {Hash64(value.mValue.str_value)};
+                case STORAGE: {
+                    const std::vector<uint8_t>& bytes = value.mValue.storage_value;
+                    return {Hash64(reinterpret_cast<const char*>(bytes.data()), bytes.size())};
+                }
+                default:
+                    return nullopt;
+            }
+        }
+    }
+    return nullopt;
+}
+
+}  // anonymous namespace
+
+DistinctCountMetricProducer::DistinctCountMetricProducer(
+        const ConfigKey& key, const DistinctCountMetric& metric, const uint64_t protoHash,
+        const PullOptions& pullOptions, const BucketOptions& bucketOptions,
+        const WhatOptions& whatOptions, const ConditionOptions& conditionOptions,
+        const StateOptions& stateOptions, const ActivationOptions& activationOptions,
+        const GuardrailOptions& guardrailOptions)
+    : ValueMetricProducer(metric.id(), key, protoHash, pullOptions, bucketOptions, whatOptions,
+                          conditionOptions, stateOptions, activationOptions, guardrailOptions),
+      mPrecision(metric.precision()) {
+}
+
+DistinctCountMetricProducer::DumpProtoFields DistinctCountMetricProducer::getDumpProtoFields()
+        const {
+    return {FIELD_ID_DISTINCT_COUNT_METRICS,
+            FIELD_ID_BUCKET_NUM,
+            FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+            FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+            FIELD_ID_CONDITION_TRUE_NS,
+            /*conditionCorrectionNsFieldId=*/nullopt};
+}
+
+void DistinctCountMetricProducer::writePastBucketAggregateToProto(
+        const int aggIndex, const unique_ptr<HyperLogLog>& sketch, const int sampleSize,
+        ProtoOutputStream* const protoOutput) const {
+    uint64_t sketchesToken =
+            protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKETCHES);
+    protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_SKETCH_INDEX, aggIndex);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKETCH_ESTIMATE,
+                       (long long)sketch->estimate());
+    const std::vector<uint8_t>& registers = sketch->getRegisters();
+    protoOutput->write(FIELD_TYPE_BYTES | FIELD_ID_SKETCH_REGISTERS,
+                       reinterpret_cast<const char*>(registers.data()), registers.size());
+
+    VLOG("\t\t sketch %d: ~%lld distinct values", aggIndex, (long long)sketch->estimate());
+    protoOutput->end(sketchesToken);
+}
+
+bool DistinctCountMetricProducer::aggregateFields(const int64_t eventTimeNs,
+                                                  const MetricDimensionKey& eventKey,
+                                                  const LogEvent& event,
+                                                  vector<Interval>& intervals, Empty& empty) {
+    bool seenNewData = false;
+    for (size_t i = 0; i < mFieldMatchers.size(); i++) {
+        const Matcher& matcher = mFieldMatchers[i];
+        Interval& interval = intervals[i];
+        interval.aggIndex = i;
+        const optional<uint64_t> hashOpt = getHashFromEvent(event, matcher);
+        if (!hashOpt) {
+            VLOG("Failed to get value %zu from event %s", i, event.ToString().c_str());
+            StatsdStats::getInstance().noteBadValueType(mMetricId);
+            return seenNewData;
+        }
+
+        // interval.aggregate is nullptr after default construction of the Interval and after its
+        // ownership is transferred to a PastBucket when flushing.
+        if (!interval.aggregate) {
+            interval.aggregate = std::make_unique<HyperLogLog>(mPrecision);
+        }
+        seenNewData = true;
+        interval.aggregate->add(hashOpt.value());
+        interval.sampleSize += 1;
+    }
+    return seenNewData;
+}
+
+PastBucket<unique_ptr<HyperLogLog>> DistinctCountMetricProducer::buildPartialBucket(
+        int64_t bucketEndTimeNs, vector<Interval>& intervals) {
+    PastBucket<unique_ptr<HyperLogLog>> bucket;
+    bucket.mBucketStartNs = mCurrentBucketStartTimeNs;
+    bucket.mBucketEndNs = bucketEndTimeNs;
+    for (Interval& interval : intervals) {
+        if (interval.hasValue()) {
+            bucket.aggIndex.push_back(interval.aggIndex);
+            // Transfer ownership of unique_ptr<HyperLogLog> from interval.aggregate to
+            // bucket.aggregates vector. interval.aggregate is guaranteed to be nullptr after this.
+            bucket.aggregates.push_back(std::move(interval.aggregate));
+        }
+    }
+    return bucket;
+}
+
+size_t DistinctCountMetricProducer::byteSizeLocked() const {
+    size_t totalSize = 0;
+    for (const auto& [_, buckets] : mPastBuckets) {
+        totalSize += buckets.size() * kBucketSize;
+        for (const auto& bucket : buckets) {
+            static const size_t kIntSize = sizeof(int);
+            totalSize += bucket.aggIndex.size() * kIntSize;
+            for (const auto& sketch : bucket.aggregates) {
+                totalSize += sketch->getSizeBytes();
+            }
+        }
+    }
+    return totalSize;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
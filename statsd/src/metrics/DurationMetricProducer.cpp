@@ -24,6 +24,7 @@
 #include <stdlib.h>
 
 #include "guardrail/StatsdStats.h"
+#include "metrics/parsing_utils/histogram_parsing_utils.h"
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "stats_log_util.h"
 #include "stats_util.h"
@@ -60,12 +61,28 @@ const int FIELD_ID_DIMENSION_IN_WHAT = 1;
 const int FIELD_ID_BUCKET_INFO = 3;
 const int FIELD_ID_DIMENSION_LEAF_IN_WHAT = 4;
 const int FIELD_ID_SLICE_BY_STATE = 6;
+const int FIELD_ID_IS_OVERFLOW = 7;
 // for DurationBucketInfo
 const int FIELD_ID_DURATION = 3;
 const int FIELD_ID_BUCKET_NUM = 4;
 const int FIELD_ID_START_BUCKET_ELAPSED_MILLIS = 5;
 const int FIELD_ID_END_BUCKET_ELAPSED_MILLIS = 6;
 const int FIELD_ID_CONDITION_TRUE_NS = 7;
+const int FIELD_ID_DURATION_HISTOGRAM = 8;
+
+namespace {
+
+shared_ptr<const BinStarts> getDurationBinStarts(const DurationMetric& metric) {
+    if (!metric.has_duration_histogram()) {
+        return nullptr;
+    }
+    // The bin config is validated when the metric is created.
+    auto binStarts = std::make_shared<BinStarts>();
+    generateBinStarts(metric.id(), metric.duration_histogram(), *binStarts);
+    return binStarts;
+}
+
+}  // anonymous namespace
 
 DurationMetricProducer::DurationMetricProducer(
         const ConfigKey& key, const DurationMetric& metric, const int conditionIndex,
@@ -87,7 +104,9 @@ DurationMetricProducer::DurationMetricProducer(
       mNested(nesting),
       mContainANYPositionInInternalDimensions(false),
       mDimensionHardLimit(
-              StatsdStats::clampDimensionKeySizeLimit(metric.max_dimensions_per_bucket())) {
+              StatsdStats::clampDimensionKeySizeLimit(metric.max_dimensions_per_bucket())),
+      mRollUpOverflowDimensions(metric.roll_up_overflow_dimensions()),
+      mDurationBinStarts(getDurationBinStarts(metric)) {
     if (metric.has_bucket()) {
         mBucketSizeNs =
                 TimeUnitToBucketSizeInMillisGuardrailed(key.GetUid(), metric.bucket()) * 1000000;
@@ -318,6 +337,36 @@ void DurationMetricProducer::onStateChanged(const int64_t eventTimeNs, const int
                                             const HashableDimensionKey& primaryKey,
                                             const FieldValue& oldState,
                                             const FieldValue& newState) {
+    onStateChangedInternal(eventTimeNs, atomId, primaryKey, /*linkedKey=*/nullptr, newState);
+}
+
+StateFieldLinks DurationMetricProducer::getStateFieldLinks(const int32_t atomId) const {
+    StateFieldLinks links;
+    for (const Metric2State& stateLink : mMetric2StateLinks) {
+        if (stateLink.stateAtomId != atomId) {
+            continue;
+        }
+        for (size_t i = 0; i < stateLink.stateFields.size(); i++) {
+            links.emplace_back(stateLink.stateFields[i].mMatcher,
+                               stateLink.metricFields[i].mMatcher);
+        }
+    }
+    return links;
+}
+
+void DurationMetricProducer::onLinkedStateChanged(const int64_t eventTimeNs, const int32_t atomId,
+                                                  const HashableDimensionKey& primaryKey,
+                                                  const HashableDimensionKey& linkedKey,
+                                                  const FieldValue& oldState,
+                                                  const FieldValue& newState) {
+    onStateChangedInternal(eventTimeNs, atomId, primaryKey, &linkedKey, newState);
+}
+
+void DurationMetricProducer::onStateChangedInternal(const int64_t eventTimeNs,
+                                                    const int32_t atomId,
+                                                    const HashableDimensionKey& primaryKey,
+                                                    const HashableDimensionKey* linkedKey,
+                                                    const FieldValue& newState) {
     // Check if this metric has a StateMap. If so, map the new state value to
     // the correct state group id.
     FieldValue newStateCopy = newState;
@@ -336,7 +385,12 @@ void DurationMetricProducer::onStateChanged(const int64_t eventTimeNs, const int
     // If the state change primaryKey = uid: 1001, we only notify DurationTracker1 of a state
     // change.
     for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
-        if (!containsLinkedStateValues(whatIt.first, primaryKey, mMetric2StateLinks, atomId)) {
+        const bool contains =
+                linkedKey != nullptr
+                        ? containsTranslatedStateValues(whatIt.first, *linkedKey)
+                        : containsLinkedStateValues(whatIt.first, primaryKey, mMetric2StateLinks,
+                                                    atomId);
+        if (!contains) {
             continue;
         }
         whatIt.second->onStateChanged(eventTimeNs, atomId, newStateCopy);
@@ -345,18 +399,25 @@ void DurationMetricProducer::onStateChanged(const int64_t eventTimeNs, const int
 
 unique_ptr<DurationTracker> DurationMetricProducer::createDurationTracker(
         const MetricDimensionKey& eventKey) const {
+    unique_ptr<DurationTracker> tracker;
     switch (mAggregationType) {
         case DurationMetric_AggregationType_SUM:
-            return make_unique<OringDurationTracker>(
+            tracker = make_unique<OringDurationTracker>(
                     mConfigKey, mMetricId, eventKey, mWizard, mConditionTrackerIndex, mNested,
                     mCurrentBucketStartTimeNs, mCurrentBucketNum, mTimeBaseNs, mBucketSizeNs,
                     mConditionSliced, mHasLinksToAllConditionDimensionsInTracker, mAnomalyTrackers);
+            break;
         case DurationMetric_AggregationType_MAX_SPARSE:
-            return make_unique<MaxDurationTracker>(
+            tracker = make_unique<MaxDurationTracker>(
                     mConfigKey, mMetricId, eventKey, mWizard, mConditionTrackerIndex, mNested,
                     mCurrentBucketStartTimeNs, mCurrentBucketNum, mTimeBaseNs, mBucketSizeNs,
                     mConditionSliced, mHasLinksToAllConditionDimensionsInTracker, mAnomalyTrackers);
+            break;
     }
+    if (tracker != nullptr) {
+        tracker->setDurationBinStarts(mDurationBinStarts);
+    }
+    return tracker;
 }
 
 // SlicedConditionChange optimization case 1:
@@ -392,6 +453,11 @@ void DurationMetricProducer::onSlicedConditionMayChangeLocked_opt1(const int64_t
         const map<HashableDimensionKey, int>* slicedConditionMap =
                 mWizard->getSlicedDimensionMap(mConditionTrackerIndex);
         for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
+            if (whatIt.first == OVERFLOW_DIMENSION_KEY) {
+                // The overflow tracker mixes dimensions, so each of them is queried.
+                whatIt.second->onSlicedConditionMayChange(eventTime);
+                continue;
+            }
             HashableDimensionKey linkedConditionDimensionKey;
             getDimensionForCondition(whatIt.first.getValues(), mMetric2ConditionLinks[0],
                                      &linkedConditionDimensionKey);
@@ -404,6 +470,10 @@ void DurationMetricProducer::onSlicedConditionMayChangeLocked_opt1(const int64_t
         // Handle the condition change from the sliced predicate.
         if (currentUnSlicedPartCondition) {
             for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
+                if (whatIt.first == OVERFLOW_DIMENSION_KEY) {
+                    whatIt.second->onSlicedConditionMayChange(eventTime);
+                    continue;
+                }
                 HashableDimensionKey linkedConditionDimensionKey;
                 getDimensionForCondition(whatIt.first.getValues(), mMetric2ConditionLinks[0],
                                          &linkedConditionDimensionKey);
@@ -550,7 +620,9 @@ void DurationMetricProducer::onDumpReportLocked(
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         // First fill dimension.
-        if (mShouldUseNestedDimensions) {
+        if (isOverflowDimensionKey(dimensionKey)) {
+            protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_OVERFLOW, true);
+        } else if (mShouldUseNestedDimensions) {
             uint64_t dimensionToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
             writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
@@ -580,6 +652,12 @@ void DurationMetricProducer::onDumpReportLocked(
                                    (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
             }
             protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_DURATION, (long long)bucket.mDuration);
+            if (!bucket.mDurationHistogram.isEmpty()) {
+                uint64_t histogramToken =
+                        protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DURATION_HISTOGRAM);
+                bucket.mDurationHistogram.toProto(*protoOutput);
+                protoOutput->end(histogramToken);
+            }
 
             // We only write the condition timer value if the metric has a
             // condition and isn't sliced by state or condition.
@@ -665,8 +743,10 @@ bool DurationMetricProducer::hitGuardRailLocked(const MetricDimensionKey& newKey
             // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
             if (newTupleCount > mDimensionHardLimit) {
                 if (!mHasHitGuardrail) {
-                    ALOGE("DurationMetric %lld dropping data for what dimension key %s",
-                          (long long)mMetricId, newKey.getDimensionKeyInWhat().toString().c_str());
+                    ALOGE("DurationMetric %lld %s data for what dimension key %s",
+                          (long long)mMetricId,
+                          mRollUpOverflowDimensions ? "rolling up" : "dropping",
+                          newKey.getDimensionKeyInWhat().toString().c_str());
                     mHasHitGuardrail = true;
                 }
                 StatsdStats::getInstance().noteHardDimensionLimitReached(mMetricId);
@@ -685,6 +765,10 @@ void DurationMetricProducer::handleStartEvent(const MetricDimensionKey& eventKey
     auto whatIt = mCurrentSlicedDurationTrackerMap.find(whatKey);
     if (whatIt == mCurrentSlicedDurationTrackerMap.end()) {
         if (hitGuardRailLocked(eventKey)) {
+            if (mRollUpOverflowDimensions) {
+                handleOverflowStartEvent(eventKey, conditionKeys, condition, eventTimeNs,
+                                         eventValues);
+            }
             return;
         }
         mCurrentSlicedDurationTrackerMap[whatKey] = createDurationTracker(eventKey);
@@ -707,6 +791,48 @@ void DurationMetricProducer::handleStartEvent(const MetricDimensionKey& eventKey
     }
 }
 
+void DurationMetricProducer::handleOverflowStartEvent(const MetricDimensionKey& eventKey,
+                                                      const ConditionKey& conditionKeys,
+                                                      bool condition, int64_t eventTimeNs,
+                                                      const vector<FieldValue>& eventValues) {
+    unique_ptr<DurationTracker>& tracker = mCurrentSlicedDurationTrackerMap[OVERFLOW_DIMENSION_KEY];
+    if (tracker == nullptr) {
+        tracker = createDurationTracker(
+                MetricDimensionKey(OVERFLOW_DIMENSION_KEY, eventKey.getStateValuesKey()));
+    }
+    tracker->noteStart(getOverflowInternalDimensionKey(eventKey.getDimensionKeyInWhat(),
+                                                       eventValues),
+                       condition, eventTimeNs, conditionKeys, mDimensionHardLimit);
+}
+
+void DurationMetricProducer::handleOverflowStopEvent(const HashableDimensionKey& whatKey,
+                                                     const vector<FieldValue>& eventValues,
+                                                     int64_t eventTimeNs) {
+    auto whatIt = mCurrentSlicedDurationTrackerMap.find(OVERFLOW_DIMENSION_KEY);
+    if (whatIt == mCurrentSlicedDurationTrackerMap.end()) {
+        return;
+    }
+    whatIt->second->noteStop(getOverflowInternalDimensionKey(whatKey, eventValues), eventTimeNs,
+                             false);
+    if (!whatIt->second->hasAccumulatedDuration()) {
+        VLOG("erase bucket for key %s", whatIt->first.toString().c_str());
+        mCurrentSlicedDurationTrackerMap.erase(whatIt);
+    }
+}
+
+HashableDimensionKey DurationMetricProducer::getOverflowInternalDimensionKey(
+        const HashableDimensionKey& whatKey, const vector<FieldValue>& eventValues) const {
+    HashableDimensionKey overflowInternalKey = whatKey;
+    if (!mUseWhatDimensionAsInternalDimension && !mInternalDimensions.empty()) {
+        HashableDimensionKey internalDimensionKey = DEFAULT_DIMENSION_KEY;
+        filterValues(mInternalDimensions, eventValues, &internalDimensionKey);
+        for (const FieldValue& value : internalDimensionKey.getValues()) {
+            overflowInternalKey.addValue(value);
+        }
+    }
+    return overflowInternalKey;
+}
+
 void DurationMetricProducer::onMatchedLogEventInternalLocked(
         const size_t matcherIndex, const MetricDimensionKey& eventKey,
         const ConditionKey& conditionKeys, bool condition, const LogEvent& event,
@@ -791,6 +917,12 @@ void DurationMetricProducer::handleMatchedLogEventValuesLocked(const size_t matc
 
     // Handles Stop events.
     if ((int)matcherIndex == mStopIndex) {
+        // The dimension may have started while past the hard limit, even if it now has its
+        // own tracker.
+        if (mRollUpOverflowDimensions) {
+            handleOverflowStopEvent(dimensionInWhat, values, eventTimeNs);
+        }
+
         if (mUseWhatDimensionAsInternalDimension) {
             auto whatIt = mCurrentSlicedDurationTrackerMap.find(dimensionInWhat);
             if (whatIt != mCurrentSlicedDurationTrackerMap.end()) {
@@ -845,6 +977,9 @@ size_t DurationMetricProducer::byteSizeLocked() const {
     size_t totalSize = 0;
     for (const auto& pair : mPastBuckets) {
         totalSize += pair.second.size() * kBucketSize;
+        for (const auto& bucket : pair.second) {
+            totalSize += bucket.mDurationHistogram.getSize();
+        }
     }
     return totalSize;
 }
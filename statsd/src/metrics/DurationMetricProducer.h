@@ -62,6 +62,13 @@ public:
                         const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                         const FieldValue& newState) override;
 
+    StateFieldLinks getStateFieldLinks(const int32_t atomId) const override;
+
+    void onLinkedStateChanged(const int64_t eventTimeNs, const int32_t atomId,
+                              const HashableDimensionKey& primaryKey,
+                              const HashableDimensionKey& linkedKey, const FieldValue& oldState,
+                              const FieldValue& newState) override;
+
     MetricType getMetricType() const override {
         return METRIC_TYPE_DURATION;
     }
@@ -75,6 +82,12 @@ protected:
             const std::map<int, HashableDimensionKey>& statePrimaryKeys) override;
 
 private:
+    // Notifies the duration trackers whose dimension in what contains the state primary key. The
+    // key is matched through linkedKey if it is set, else through the state links.
+    void onStateChangedInternal(const int64_t eventTimeNs, const int32_t atomId,
+                                const HashableDimensionKey& primaryKey,
+                                const HashableDimensionKey* linkedKey, const FieldValue& newState);
+
     // Initializes true dimensions of the 'what' predicate. Only to be called during initialization.
     void initTrueDimensions(const int whatIndex, int64_t startTimeNs);
 
@@ -85,6 +98,19 @@ private:
                           bool condition, int64_t eventTimeNs,
                           const vector<FieldValue>& eventValues);
 
+    // Tracks a dimension past the hard limit in the overflow tracker.
+    void handleOverflowStartEvent(const MetricDimensionKey& eventKey,
+                                  const ConditionKey& conditionKeys, bool condition,
+                                  int64_t eventTimeNs, const vector<FieldValue>& eventValues);
+
+    void handleOverflowStopEvent(const HashableDimensionKey& whatKey,
+                                 const vector<FieldValue>& eventValues, int64_t eventTimeNs);
+
+    // The overflow tracker mixes dimensions in what, so its internal dimension includes the
+    // dimension in what for the starts and stops of each dimension to still be paired.
+    HashableDimensionKey getOverflowInternalDimensionKey(
+            const HashableDimensionKey& whatKey, const vector<FieldValue>& eventValues) const;
+
     void onDumpReportLocked(const int64_t dumpTimeNs,
                             const bool include_current_partial_bucket,
                             const bool erase_data,
@@ -172,6 +198,14 @@ private:
 
     const size_t mDimensionHardLimit;
 
+    // Whether new dimensions past mDimensionHardLimit are tracked by the overflow tracker instead
+    // of being dropped.
+    const bool mRollUpOverflowDimensions;
+
+    // Bin starts of the interval length histogram in milliseconds, shared with the duration
+    // trackers. nullptr if the metric has no duration_histogram.
+    const std::shared_ptr<const BinStarts> mDurationBinStarts;
+
     // Helper function to create a duration tracker given the metric aggregation type.
     std::unique_ptr<DurationTracker> createDurationTracker(
             const MetricDimensionKey& eventKey) const;
@@ -188,6 +222,8 @@ private:
 
     FRIEND_TEST(DurationMetricProducerTest, TestSumDurationAppUpgradeSplitDisabled);
     FRIEND_TEST(DurationMetricProducerTest, TestClearCurrentSlicedTrackerMapWhenStop);
+    FRIEND_TEST(DurationMetricProducerTest, TestRollUpOverflowDimensions);
+    FRIEND_TEST(DurationMetricProducerTest, TestDurationHistogram);
     FRIEND_TEST(DurationMetricProducerTest_PartialBucket, TestSumDuration);
     FRIEND_TEST(DurationMetricProducerTest_PartialBucket,
                 TestSumDurationWithSplitInFollowingBucket);
@@ -27,6 +27,7 @@
 #include "MetricProducer.h"
 #include "src/statsd_config.pb.h"
 #include "stats_util.h"
+#include "utils/AtomEncoder.h"
 
 namespace android {
 namespace os {
@@ -99,6 +100,8 @@ private:
     // Maps the field/value pairs of an atom to a list of timestamps used to deduplicate atoms.
     std::unordered_map<AtomDimensionKey, std::vector<int64_t>> mAggregatedAtoms;
 
+    AtomEncoder mAtomEncoder;
+
     const int mSamplingPercentage;
 };
 
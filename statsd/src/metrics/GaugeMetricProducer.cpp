@@ -64,6 +64,7 @@ const int FIELD_ID_DROP_TIME = 2;
 const int FIELD_ID_DIMENSION_IN_WHAT = 1;
 const int FIELD_ID_BUCKET_INFO = 3;
 const int FIELD_ID_DIMENSION_LEAF_IN_WHAT = 4;
+const int FIELD_ID_IS_OVERFLOW = 7;
 // for GaugeBucketInfo
 const int FIELD_ID_BUCKET_NUM = 6;
 const int FIELD_ID_START_BUCKET_ELAPSED_MILLIS = 7;
@@ -99,6 +100,7 @@ GaugeMetricProducer::GaugeMetricProducer(
                                                       : StatsdStats::kPullMaxDelayNs),
       mDimensionSoftLimit(dimensionSoftLimit),
       mDimensionHardLimit(dimensionHardLimit),
+      mRollUpOverflowDimensions(metric.roll_up_overflow_dimensions()),
       mGaugeAtomsPerDimensionLimit(metric.max_num_gauge_atoms_per_bucket()),
       mDimensionGuardrailHit(false),
       mSamplingPercentage(metric.sampling_percentage()) {
@@ -149,6 +151,7 @@ GaugeMetricProducer::GaugeMetricProducer(
 
 GaugeMetricProducer::~GaugeMetricProducer() {
     VLOG("~GaugeMetricProducer() called");
+    cancelBucketFinalization();
     if (mIsPulled && isRandomNSamples()) {
         mPullerManager->UnRegisterReceiver(mPullTagId, mConfigKey, this);
     }
@@ -238,6 +241,7 @@ void GaugeMetricProducer::dumpStatesLocked(int out, bool verbose) const {
 
 void GaugeMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     flushIfNeededLocked(dumpTimeNs);
+    mPendingBuckets.clear();
     mPastBuckets.clear();
     mSkippedBuckets.clear();
 }
@@ -254,6 +258,7 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
+    finalizePendingBucketsLocked();
 
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
     protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
@@ -308,7 +313,9 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         // First fill dimension.
-        if (mShouldUseNestedDimensions) {
+        if (isOverflowDimensionKey(dimensionKey)) {
+            protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_OVERFLOW, true);
+        } else if (mShouldUseNestedDimensions) {
             uint64_t dimensionToken = protoOutput->start(
                     FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
             writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
@@ -340,9 +347,8 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
                             FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_AGGREGATED_ATOM);
                     uint64_t atomToken =
                             protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM_VALUE);
-                    writeFieldValueTreeToStream(mAtomId,
-                                                atomDimensionKey.getAtomFieldValues().getValues(),
-                                                protoOutput);
+                    mAtomEncoder.write(mAtomId, atomDimensionKey.getAtomFieldValues().getValues(),
+                                       protoOutput);
                     protoOutput->end(atomToken);
                     for (int64_t timestampNs : elapsedTimestampsNs) {
                         protoOutput->write(
@@ -523,7 +529,8 @@ bool GaugeMetricProducer::hitGuardRailLocked(const MetricDimensionKey& newKey) {
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (newTupleCount > mDimensionHardLimit) {
             if (!mHasHitGuardrail) {
-                ALOGE("GaugeMetric %lld dropping data for dimension key %s", (long long)mMetricId,
+                ALOGE("GaugeMetric %lld %s data for dimension key %s", (long long)mMetricId,
+                      mRollUpOverflowDimensions ? "rolling up" : "dropping",
                       newKey.toString().c_str());
                 mHasHitGuardrail = true;
             }
@@ -565,22 +572,26 @@ void GaugeMetricProducer::onMatchedLogEventInternalLocked(
         return;
     }
 
+    const MetricDimensionKey* gaugeKey = &eventKey;
+    if (hitGuardRailLocked(eventKey)) {
+        if (!mRollUpOverflowDimensions) {
+            return;
+        }
+        gaugeKey = &OVERFLOW_METRIC_DIMENSION_KEY;
+    }
     // When gauge metric wants to randomly sample the output atom, we just simply use the first
     // gauge in the given bucket.
-    if (mCurrentSlicedBucket->find(eventKey) != mCurrentSlicedBucket->end() &&
+    if (mCurrentSlicedBucket->find(*gaugeKey) != mCurrentSlicedBucket->end() &&
         mSamplingType == GaugeMetric::RANDOM_ONE_SAMPLE) {
         return;
     }
-    if (hitGuardRailLocked(eventKey)) {
-        return;
-    }
-    if ((*mCurrentSlicedBucket)[eventKey].size() >= mGaugeAtomsPerDimensionLimit) {
+    if ((*mCurrentSlicedBucket)[*gaugeKey].size() >= mGaugeAtomsPerDimensionLimit) {
         return;
     }
 
     const int64_t truncatedElapsedTimestampNs = truncateTimestampIfNecessary(event);
     GaugeAtom gaugeAtom(getGaugeFields(event), truncatedElapsedTimestampNs);
-    (*mCurrentSlicedBucket)[eventKey].push_back(gaugeAtom);
+    (*mCurrentSlicedBucket)[*gaugeKey].push_back(gaugeAtom);
     // Anomaly detection on gauge metric only works when there is one numeric
     // field specified.
     if (mAnomalyTrackers.size() > 0) {
@@ -594,7 +605,7 @@ void GaugeMetricProducer::onMatchedLogEventInternalLocked(
             }
             for (auto& tracker : mAnomalyTrackers) {
                 tracker->detectAndDeclareAnomaly(eventTimeNs, mCurrentBucketNum, mMetricId,
-                                                 eventKey, gaugeVal);
+                                                 *gaugeKey, gaugeVal);
             }
         }
     }
@@ -619,6 +630,7 @@ void GaugeMetricProducer::updateCurrentSlicedBucketForAnomaly() {
 void GaugeMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
+    mPendingBuckets.clear();
     mPastBuckets.clear();
 }
 
@@ -658,18 +670,10 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
     // Add bucket to mPastBuckets if bucket is large enough.
     // Otherwise, drop the bucket data and add bucket metadata to mSkippedBuckets.
     bool isBucketLargeEnough = info.mBucketEndNs - mCurrentBucketStartTimeNs >= mMinBucketSizeNs;
+    // The sealed atoms are moved into mPastBuckets by finalizePendingBucketsLocked.
     if (isBucketLargeEnough) {
-        for (const auto& slice : *mCurrentSlicedBucket) {
-            info.mAggregatedAtoms.clear();
-            for (const GaugeAtom& atom : slice.second) {
-                AtomDimensionKey key(mAtomId, HashableDimensionKey(*atom.mFields));
-                vector<int64_t>& elapsedTimestampsNs = info.mAggregatedAtoms[key];
-                elapsedTimestampsNs.push_back(atom.mElapsedTimestampNs);
-            }
-            auto& bucketList = mPastBuckets[slice.first];
-            bucketList.push_back(info);
-            VLOG("Gauge gauge metric %lld, dump key value: %s", (long long)mMetricId,
-                 slice.first.toString().c_str());
+        if (!mCurrentSlicedBucket->empty()) {
+            mPendingBuckets.push_back({mCurrentSlicedBucket, info});
         }
     } else if (mIsActive) {
         mCurrentSkippedBucket.bucketStartTimeNs = mCurrentBucketStartTimeNs;
@@ -700,6 +704,26 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
     mCurrentSkippedBucket.reset();
     // Reset mHasHitGuardrail boolean since bucket was reset
     mHasHitGuardrail = false;
+    scheduleBucketFinalizationLocked();
+}
+
+void GaugeMetricProducer::finalizePendingBucketsLocked() {
+    for (PendingBucket& pendingBucket : mPendingBuckets) {
+        GaugeBucket& info = pendingBucket.info;
+        for (const auto& slice : *pendingBucket.atoms) {
+            info.mAggregatedAtoms.clear();
+            for (const GaugeAtom& atom : slice.second) {
+                AtomDimensionKey key(mAtomId, HashableDimensionKey(*atom.mFields));
+                vector<int64_t>& elapsedTimestampsNs = info.mAggregatedAtoms[key];
+                elapsedTimestampsNs.push_back(atom.mElapsedTimestampNs);
+            }
+            auto& bucketList = mPastBuckets[slice.first];
+            bucketList.push_back(info);
+            VLOG("Gauge gauge metric %lld, dump key value: %s", (long long)mMetricId,
+                 slice.first.toString().c_str());
+        }
+    }
+    mPendingBuckets.clear();
 }
 
 size_t GaugeMetricProducer::byteSizeLocked() const {
@@ -713,6 +737,13 @@ size_t GaugeMetricProducer::byteSizeLocked() const {
             }
         }
     }
+    for (const PendingBucket& pendingBucket : mPendingBuckets) {
+        for (const auto& [dimensionKey, atoms] : *pendingBucket.atoms) {
+            for (const GaugeAtom& atom : atoms) {
+                totalSize += sizeof(FieldValue) * atom.mFields->size() + sizeof(int64_t);
+            }
+        }
+    }
     return totalSize;
 }
 
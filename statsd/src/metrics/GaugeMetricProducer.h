@@ -28,6 +28,7 @@
 #include "MetricProducer.h"
 #include "src/statsd_config.pb.h"
 #include "../stats_util.h"
+#include "../utils/AtomEncoder.h"
 
 namespace android {
 namespace os {
@@ -142,6 +143,8 @@ private:
 
     void flushCurrentBucketLocked(int64_t eventTimeNs, int64_t nextBucketStartTimeNs) override;
 
+    void finalizePendingBucketsLocked() override;
+
     void prepareFirstBucketLocked() override;
 
     // Only call if mCondition == ConditionState::kTrue && metric is active.
@@ -182,12 +185,22 @@ private:
     // tagId for output atom
     const int mAtomId;
 
+    AtomEncoder mAtomEncoder;
+
     // if this is pulled metric
     const bool mIsPulled;
 
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
     std::unordered_map<MetricDimensionKey, std::vector<GaugeBucket>> mPastBuckets;
 
+    // A bucket sealed by flushCurrentBucketLocked whose atoms are not in mPastBuckets yet.
+    struct PendingBucket {
+        std::shared_ptr<DimToGaugeAtomsMap> atoms;
+        GaugeBucket info;
+    };
+
+    std::vector<PendingBucket> mPendingBuckets;
+
     // The current partial bucket.
     std::shared_ptr<DimToGaugeAtomsMap> mCurrentSlicedBucket;
 
@@ -220,6 +233,10 @@ private:
 
     const size_t mDimensionHardLimit;
 
+    // Whether gauges of new dimensions past mDimensionHardLimit are kept in the overflow key
+    // instead of being dropped.
+    const bool mRollUpOverflowDimensions;
+
     const size_t mGaugeAtomsPerDimensionLimit;
 
     // Tracks if the dimension guardrail has been hit in the current report.
@@ -237,6 +254,8 @@ private:
     FRIEND_TEST(GaugeMetricProducerTest, TestPullNWithoutTrigger);
     FRIEND_TEST(GaugeMetricProducerTest, TestRemoveDimensionInOutput);
     FRIEND_TEST(GaugeMetricProducerTest, TestPullDimensionalSampling);
+    FRIEND_TEST(GaugeMetricProducerTest, TestDeferredBucketFinalization);
+    FRIEND_TEST(GaugeMetricProducerTest, TestRollUpOverflowDimensions);
 
     FRIEND_TEST(GaugeMetricProducerTest_PartialBucket, TestPushedEvents);
     FRIEND_TEST(GaugeMetricProducerTest_PartialBucket, TestPulled);
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "HistogramValue.h"
+
+#include <algorithm>
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_SINT32;
+using android::util::ProtoOutputStream;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// for HistogramValue
+const int FIELD_ID_COUNT = 1;
+
+HistogramValue::HistogramValue(vector<int> binCounts) : mBinCounts(std::move(binCounts)) {
+}
+
+void HistogramValue::addValue(double value, const BinStarts& binStarts) {
+    if (mCompacted) {
+        ALOGE("Cannot add a value to a compacted histogram");
+        return;
+    }
+    if (mBinCounts.empty()) {
+        mBinCounts.resize(binStarts.size() + 1, 0);
+    }
+    // The bin of a value is the bin of the last bin start that is not greater than the value, or
+    // the underflow bin if there is none.
+    const size_t binIndex =
+            std::upper_bound(binStarts.begin(), binStarts.end(), value) - binStarts.begin();
+    mBinCounts[binIndex]++;
+}
+
+HistogramValue& HistogramValue::operator+=(const HistogramValue& rhs) {
+    if (mCompacted || rhs.mCompacted) {
+        ALOGE("Cannot add compacted histograms");
+        return *this;
+    }
+    if (mBinCounts.size() < rhs.mBinCounts.size()) {
+        mBinCounts.resize(rhs.mBinCounts.size(), 0);
+    }
+    for (size_t i = 0; i < rhs.mBinCounts.size(); i++) {
+        mBinCounts[i] += rhs.mBinCounts[i];
+    }
+    return *this;
+}
+
+HistogramValue HistogramValue::getCompactedHistogramValue() const {
+    if (mCompacted) {
+        return *this;
+    }
+    HistogramValue compacted;
+    compacted.mCompacted = true;
+    int zeroRunLength = 0;
+    const auto flushZeroRun = [&compacted, &zeroRunLength]() {
+        if (zeroRunLength == 1) {
+            compacted.mBinCounts.push_back(0);
+        } else if (zeroRunLength > 1) {
+            compacted.mBinCounts.push_back(-zeroRunLength);
+        }
+        zeroRunLength = 0;
+    };
+    for (const int count : mBinCounts) {
+        if (count == 0) {
+            zeroRunLength++;
+            continue;
+        }
+        flushZeroRun();
+        compacted.mBinCounts.push_back(count);
+    }
+    flushZeroRun();
+    return compacted;
+}
+
+bool HistogramValue::isEmpty() const {
+    return std::all_of(mBinCounts.begin(), mBinCounts.end(),
+                       [](int count) { return count <= 0; });
+}
+
+void HistogramValue::clear() {
+    mBinCounts.clear();
+    mCompacted = false;
+}
+
+void HistogramValue::toProto(ProtoOutputStream& protoOutput) const {
+    if (!mCompacted) {
+        getCompactedHistogramValue().toProto(protoOutput);
+        return;
+    }
+    for (const int count : mBinCounts) {
+        protoOutput.write(FIELD_TYPE_SINT32 | FIELD_COUNT_REPEATED | FIELD_ID_COUNT, count);
+    }
+}
+
+string HistogramValue::toString() const {
+    string result = mCompacted ? "compacted [" : "[";
+    for (size_t i = 0; i < mBinCounts.size(); i++) {
+        if (i > 0) {
+            result += ", ";
+        }
+        result += to_string(mBinCounts[i]);
+    }
+    return result + "]";
+}
+
+size_t HistogramValue::getSize() const {
+    return sizeof(int) * mBinCounts.size();
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
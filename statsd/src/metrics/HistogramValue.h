@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Lower bound of each bin of a histogram, in strictly increasing order. Values below the first
+// bin start are counted in the underflow bin, and values from the last bin start on are counted in
+// the overflow bin, so a histogram has binStarts.size() + 1 bins.
+using BinStarts = std::vector<float>;
+
+/**
+ * Bin counts of a histogram.
+ *
+ * The counts of the current bucket are dense, one count per bin. Buckets that are done are
+ * compacted with getCompactedHistogramValue(): a run of two or more empty bins is replaced by the
+ * negated length of the run, which is also how the histogram is written to the report.
+ */
+class HistogramValue {
+public:
+    HistogramValue() = default;
+
+    explicit HistogramValue(std::vector<int> binCounts);
+
+    // Counts value in its bin. Only valid on dense histograms.
+    void addValue(double value, const BinStarts& binStarts);
+
+    // Adds the counts of a dense histogram with the same bins.
+    HistogramValue& operator+=(const HistogramValue& rhs);
+
+    HistogramValue getCompactedHistogramValue() const;
+
+    bool isEmpty() const;
+
+    void clear();
+
+    void toProto(android::util::ProtoOutputStream& protoOutput) const;
+
+    std::string toString() const;
+
+    size_t getSize() const;
+
+    inline const std::vector<int>& getBinCounts() const {
+        return mBinCounts;
+    }
+
+    inline bool operator==(const HistogramValue& that) const {
+        return mBinCounts == that.mBinCounts && mCompacted == that.mCompacted;
+    }
+
+private:
+    std::vector<int> mBinCounts;
+
+    bool mCompacted = false;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -20,6 +20,7 @@
 #include "MetricProducer.h"
 
 #include "../guardrail/StatsdStats.h"
+#include "metrics/BucketFinalizer.h"
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "state/StateTracker.h"
 
@@ -214,6 +215,35 @@ void MetricProducer::flushIfExpire(int64_t elapsedTimestampNs) {
     }
 }
 
+void MetricProducer::scheduleBucketFinalizationLocked() {
+    if (!BucketFinalizer::isEnabled()) {
+        finalizePendingBucketsLocked();
+        return;
+    }
+    if (mBucketFinalizationScheduled) {
+        return;
+    }
+    mBucketFinalizationScheduled = true;
+    if (mBucketFinalizationHandle == nullptr) {
+        mBucketFinalizationHandle = std::make_shared<BucketFinalizationHandle>();
+        mBucketFinalizationHandle->producer = this;
+    }
+    BucketFinalizer::getInstance().schedule([handle = mBucketFinalizationHandle] {
+        std::lock_guard<std::mutex> lock(handle->mutex);
+        if (handle->producer != nullptr) {
+            handle->producer->finalizePendingBuckets();
+        }
+    });
+}
+
+void MetricProducer::cancelBucketFinalization() {
+    if (mBucketFinalizationHandle == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mBucketFinalizationHandle->mutex);
+    mBucketFinalizationHandle->producer = nullptr;
+}
+
 void MetricProducer::activateLocked(int activationTrackerIndex, int64_t elapsedTimestampNs) {
     auto it = mEventActivationMap.find(activationTrackerIndex);
     if (it == mEventActivationMap.end()) {
@@ -70,6 +70,8 @@ enum MetricType {
     METRIC_TYPE_GAUGE = 4,
     METRIC_TYPE_VALUE = 5,
     METRIC_TYPE_KLL = 6,
+    METRIC_TYPE_TOP_K = 7,
+    METRIC_TYPE_DISTINCT_COUNT = 8,
 };
 
 struct Activation {
@@ -257,6 +259,14 @@ public:
         return clearPastBucketsLocked(dumpTimeNs);
     }
 
+    // Moves the buckets sealed at past bucket boundaries into the past buckets. Called on the
+    // BucketFinalizer thread when bucket finalization is deferred.
+    void finalizePendingBuckets() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBucketFinalizationScheduled = false;
+        finalizePendingBucketsLocked();
+    }
+
     void prepareFirstBucket() {
         std::lock_guard<std::mutex> lock(mMutex);
         prepareFirstBucketLocked();
@@ -394,6 +404,26 @@ protected:
      */
     virtual void flushCurrentBucketLocked(int64_t eventTimeNs, int64_t nextBucketStartTimeNs){};
 
+    /**
+     * Producers that can defer the expensive part of flushCurrentBucketLocked keep the sealed
+     * bucket aside and call this once it is sealed. It finalizes the sealed buckets inline, or on
+     * the BucketFinalizer thread if deferred finalization is enabled.
+     */
+    void scheduleBucketFinalizationLocked();
+
+    /**
+     * Detaches the producer from the finalization tasks queued for it, waiting for a running one
+     * to return. Producers that call scheduleBucketFinalizationLocked must call this first thing
+     * in their destructor, before their own members are destroyed.
+     */
+    void cancelBucketFinalization();
+
+    /**
+     * Moves the sealed buckets into the past buckets. Producers that defer finalization must call
+     * this before reading their past buckets.
+     */
+    virtual void finalizePendingBucketsLocked(){};
+
     /**
      * Flushes all the data including the current partial bucket.
      */
@@ -542,6 +572,22 @@ protected:
 
     mutable std::mutex mMutex;
 
+    // Whether a finalizePendingBuckets task is queued on the BucketFinalizer.
+    bool mBucketFinalizationScheduled = false;
+
+    // Shared with the tasks queued on the BucketFinalizer. The tasks reach the producer through
+    // it instead of holding a reference, so a producer is never destroyed on the finalizer
+    // thread.
+    struct BucketFinalizationHandle {
+        std::mutex mutex;
+
+        // Cleared by cancelBucketFinalization. Guarded by mutex.
+        MetricProducer* producer;
+    };
+
+    // Created with the first queued task.
+    std::shared_ptr<BucketFinalizationHandle> mBucketFinalizationHandle;
+
     // When the metric producer has multiple activations, these activations are ORed to determine
     // whether the metric producer is ready to generate metrics.
     std::unordered_map<int, std::shared_ptr<Activation>> mEventActivationMap;
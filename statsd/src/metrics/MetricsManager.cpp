@@ -78,7 +78,8 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
       mPullerManager(pullerManager),
       mWhitelistedAtomIds(config.whitelisted_atom_ids().begin(),
                           config.whitelisted_atom_ids().end()),
-      mShouldPersistHistory(config.persist_locally()) {
+      mShouldPersistHistory(config.persist_locally()),
+      mPersistencePriority(config.persistence_priority()) {
     if (!isAtLeastU() && config.has_restricted_metrics_delegate_package_name()) {
         mInvalidConfigReason =
                 InvalidConfigReason(INVALID_CONFIG_REASON_RESTRICTED_METRIC_NOT_ENABLED);
@@ -190,6 +191,7 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
     mWhitelistedAtomIds.insert(config.whitelisted_atom_ids().begin(),
                                config.whitelisted_atom_ids().end());
     mShouldPersistHistory = config.persist_locally();
+    mPersistencePriority = config.persistence_priority();
     mPackageCertificateHashSizeBytes = config.package_certificate_hash_size_bytes();
 
     // Store the sub-configs used.
@@ -406,16 +408,25 @@ void MetricsManager::notifyAppRemoved(const int64_t eventTimeNs, const string& a
     }
 }
 
-void MetricsManager::onUidMapReceived(const int64_t eventTimeNs) {
+void MetricsManager::onUidMapReceived(const int64_t eventTimeNs,
+                                      const std::set<std::string>& changedPackages) {
     // Purposefully don't inform metric producers on a new snapshot
     // because we don't need to flush partial buckets.
     // This occurs if a new user is added/removed or statsd crashes.
-    initPullAtomSources();
+    for (const auto& [_, packages] : mPullAtomPackages) {
+        if (std::any_of(packages.begin(), packages.end(), [&changedPackages](const string& pkg) {
+                return changedPackages.find(pkg) != changedPackages.end();
+            })) {
+            initPullAtomSources();
+            break;
+        }
+    }
 
-    if (mAllowedPkg.size() == 0) {
-        return;
+    if (std::any_of(mAllowedPkg.begin(), mAllowedPkg.end(), [&changedPackages](const string& pkg) {
+            return changedPackages.find(pkg) != changedPackages.end();
+        })) {
+        initAllowedLogSources();
     }
-    initAllowedLogSources();
 }
 
 void MetricsManager::onStatsdInitCompleted(const int64_t eventTimeNs) {
@@ -781,6 +792,11 @@ bool MetricsManager::writeMetadataToProto(int64_t currentWallClockTimeNs,
         }
         metadataWritten |= metricWritten;
     }
+
+    if (mPersistenceDeadlineMissedCount > 0) {
+        statsMetadata->set_persistence_deadline_missed_count(mPersistenceDeadlineMissedCount);
+        metadataWritten = true;
+    }
     return metadataWritten;
 }
 
@@ -806,6 +822,11 @@ void MetricsManager::loadMetadata(const metadata::StatsMetadata& metadata,
         }
         mAllMetricProducers[it->second]->loadMetricMetadataFromProto(metricMetadata);
     }
+    if (metadata.persistence_deadline_missed_count() > 0) {
+        // The missed writes happened before the reboot, so they are only surfaced in StatsdStats.
+        StatsdStats::getInstance().noteDataPersistenceDeadlineMissed(
+                mConfigKey, metadata.persistence_deadline_missed_count());
+    }
 }
 
 void MetricsManager::enforceRestrictedDataTtls(const int64_t wallClockNs) {
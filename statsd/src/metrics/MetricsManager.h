@@ -70,7 +70,7 @@ public:
 
     void notifyAppRemoved(int64_t eventTimeNs, const string& apk, int uid);
 
-    void onUidMapReceived(int64_t eventTimeNs);
+    void onUidMapReceived(int64_t eventTimeNs, const std::set<std::string>& changedPackages);
 
     void onStatsdInitCompleted(int64_t elapsedTimeNs);
 
@@ -86,6 +86,26 @@ public:
         return mShouldPersistHistory;
     }
 
+    inline int32_t getPersistencePriority() const {
+        return mPersistencePriority;
+    }
+
+    // Records that the data of this config was not written before the shutdown deadline. The
+    // count is persisted with the metadata so that it is reported after reboot.
+    inline void notePersistenceDeadlineMissed() {
+        mPersistenceDeadlineMissedCount++;
+    }
+
+    // Called once the metadata holding the missed count is saved to disk. Until the next save,
+    // only new misses are counted.
+    inline void clearPersistenceDeadlineMissed() {
+        mPersistenceDeadlineMissedCount = 0;
+    }
+
+    inline int32_t getPersistenceDeadlineMissedCount() const {
+        return mPersistenceDeadlineMissedCount;
+    }
+
     void dumpStates(int out, bool verbose);
 
     inline bool isInTtl(const int64_t timestampNs) const {
@@ -248,6 +268,11 @@ private:
 
     bool mShouldPersistHistory;
 
+    // Order in which the config data is written to disk on shutdown. Higher goes first.
+    int32_t mPersistencePriority;
+
+    int32_t mPersistenceDeadlineMissedCount = 0;
+
     // All event tags that are interesting to config metrics matchers.
     std::unordered_map<int, std::vector<int>> mTagIdsToMatchersMap;
 
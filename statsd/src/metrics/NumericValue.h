@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "FieldValue.h"
+#include "metrics/HistogramValue.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Aggregate of one value field of a NumericValueMetricProducer.
+// The Value is the SUM, MIN, MAX or AVG aggregate. For HISTOGRAM aggregation it is the sum of the
+// values, and the bin counts are in histogram. histogram is empty for all other aggregation types.
+struct NumericValue : public Value {
+    NumericValue() = default;
+
+    NumericValue(const Value& value) : Value(value) {
+    }
+
+    NumericValue& operator=(const Value& value) {
+        Value::operator=(value);
+        return *this;
+    }
+
+    HistogramValue histogram;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
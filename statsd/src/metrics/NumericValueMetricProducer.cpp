@@ -23,6 +23,7 @@
 #include <stdlib.h>
 
 #include "guardrail/StatsdStats.h"
+#include "metrics/parsing_utils/histogram_parsing_utils.h"
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "stats_log_util.h"
 
@@ -38,6 +39,7 @@ using std::optional;
 using std::shared_ptr;
 using std::string;
 using std::unordered_map;
+using std::vector;
 
 namespace android {
 namespace os {
@@ -50,6 +52,7 @@ const int FIELD_ID_VALUE_INDEX = 1;
 const int FIELD_ID_VALUE_LONG = 2;
 const int FIELD_ID_VALUE_DOUBLE = 3;
 const int FIELD_ID_VALUE_SAMPLESIZE = 4;
+const int FIELD_ID_VALUE_HISTOGRAM = 5;
 const int FIELD_ID_VALUES = 9;
 const int FIELD_ID_BUCKET_NUM = 4;
 const int FIELD_ID_START_BUCKET_ELAPSED_MILLIS = 5;
@@ -60,6 +63,23 @@ const int FIELD_ID_CONDITION_CORRECTION_NS = 11;
 const Value ZERO_LONG((int64_t)0);
 const Value ZERO_DOUBLE(0.0);
 
+namespace {
+
+vector<BinStarts> getBinStartsList(const ValueMetric& metric) {
+    vector<BinStarts> binStartsList;
+    if (metric.aggregation_type() != ValueMetric::HISTOGRAM) {
+        return binStartsList;
+    }
+    // The bin configs are validated when the metric is created.
+    for (const HistogramBinConfig& binConfig : metric.histogram_bin_configs()) {
+        BinStarts& binStarts = binStartsList.emplace_back();
+        generateBinStarts(metric.id(), binConfig, binStarts);
+    }
+    return binStartsList;
+}
+
+}  // anonymous namespace
+
 // ValueMetric has a minimum bucket size of 10min so that we don't pull too frequently
 NumericValueMetricProducer::NumericValueMetricProducer(
         const ConfigKey& key, const ValueMetric& metric, const uint64_t protoHash,
@@ -75,6 +95,7 @@ NumericValueMetricProducer::NumericValueMetricProducer(
                                  ? metric.include_sample_size()
                                  : metric.aggregation_type() == ValueMetric_AggregationType_AVG),
       mUseDiff(metric.has_use_diff() ? metric.use_diff() : isPulled()),
+      mBinStartsList(getBinStartsList(metric)),
       mValueDirection(metric.value_direction()),
       mSkipZeroDiffOutput(metric.skip_zero_diff_output()),
       mUseZeroDefaultBase(metric.use_zero_default_base()),
@@ -115,7 +136,7 @@ void NumericValueMetricProducer::resetBase() {
 }
 
 void NumericValueMetricProducer::writePastBucketAggregateToProto(
-        const int aggIndex, const Value& value, const int sampleSize,
+        const int aggIndex, const NumericValue& value, const int sampleSize,
         ProtoOutputStream* const protoOutput) const {
     uint64_t valueToken =
             protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_VALUES);
@@ -123,7 +144,12 @@ void NumericValueMetricProducer::writePastBucketAggregateToProto(
     if (mIncludeSampleSize) {
         protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_VALUE_SAMPLESIZE, sampleSize);
     }
-    if (value.getType() == LONG) {
+    if (mAggregationType == ValueMetric::HISTOGRAM) {
+        uint64_t histogramToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_VALUE_HISTOGRAM);
+        value.histogram.toProto(*protoOutput);
+        protoOutput->end(histogramToken);
+        VLOG("\t\t value %d: %s", aggIndex, value.histogram.toString().c_str());
+    } else if (value.getType() == LONG) {
         protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_VALUE_LONG, (long long)value.long_value);
         VLOG("\t\t value %d: %lld", aggIndex, (long long)value.long_value);
     } else if (value.getType() == DOUBLE) {
@@ -332,12 +358,13 @@ void NumericValueMetricProducer::accumulateEvents(const vector<shared_ptr<LogEve
     mHasGlobalBase = true;
 
     // If we reach the guardrail, we might have dropped some data which means the bucket is
-    // incomplete.
+    // incomplete. No data is dropped if overflow dimensions are rolled up, which is only allowed
+    // without diff.
     //
     // The base also needs to be reset. If we do not have the full data, we might
     // incorrectly compute the diff when mUseZeroDefaultBase is true since an existing key
     // might be missing from mCurrentSlicedBucket.
-    if (hasReachedGuardRailLimit()) {
+    if (hasReachedGuardRailLimit() && !mRollUpOverflowDimensions) {
         invalidateCurrentBucket(eventElapsedTimeNs, BucketDropReason::DIMENSION_GUARDRAIL_REACHED);
         mCurrentSlicedBucket.clear();
     }
@@ -346,7 +373,9 @@ void NumericValueMetricProducer::accumulateEvents(const vector<shared_ptr<LogEve
 bool NumericValueMetricProducer::hitFullBucketGuardRailLocked(const MetricDimensionKey& newKey) {
     // ===========GuardRail==============
     // 1. Report the tuple count if the tuple count > soft limit
-    if (mCurrentFullBucket.find(newKey) != mCurrentFullBucket.end()) {
+    // The overflow key is never dropped, it stands for the dimensions that were.
+    if (mCurrentFullBucket.find(newKey) != mCurrentFullBucket.end() ||
+        isOverflowDimensionKey(newKey)) {
         return false;
     }
     if (mCurrentFullBucket.size() > mDimensionSoftLimit - 1) {
@@ -482,19 +511,27 @@ bool NumericValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
                 case ValueMetric::SUM:
                     // for AVG, we add up and take average when flushing the bucket
                 case ValueMetric::AVG:
+                    // for HISTOGRAM, the sum is kept for anomaly detection and upload thresholds
+                case ValueMetric::HISTOGRAM:
                     interval.aggregate += value;
                     break;
                 case ValueMetric::MIN:
-                    interval.aggregate = min(value, interval.aggregate);
+                    interval.aggregate = std::min<Value>(value, interval.aggregate);
                     break;
                 case ValueMetric::MAX:
-                    interval.aggregate = max(value, interval.aggregate);
+                    interval.aggregate = std::max<Value>(value, interval.aggregate);
                     break;
                 default:
                     break;
             }
         } else {
             interval.aggregate = value;
+            interval.aggregate.histogram.clear();
+        }
+        if (mAggregationType == ValueMetric::HISTOGRAM) {
+            interval.aggregate.histogram.addValue(
+                    value.type == LONG ? (double)value.long_value : value.double_value,
+                    mBinStartsList[i]);
         }
         interval.sampleSize += 1;
     }
@@ -516,9 +553,9 @@ bool NumericValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
     return seenNewData;
 }
 
-PastBucket<Value> NumericValueMetricProducer::buildPartialBucket(int64_t bucketEndTimeNs,
-                                                                 vector<Interval>& intervals) {
-    PastBucket<Value> bucket;
+PastBucket<NumericValue> NumericValueMetricProducer::buildPartialBucket(
+        int64_t bucketEndTimeNs, vector<Interval>& intervals) {
+    PastBucket<NumericValue> bucket;
     bucket.mBucketStartNs = mCurrentBucketStartTimeNs;
     bucket.mBucketEndNs = bucketEndTimeNs;
 
@@ -529,14 +566,18 @@ PastBucket<Value> NumericValueMetricProducer::buildPartialBucket(int64_t bucketE
     }
 
     for (const Interval& interval : intervals) {
-        // skip the output if the diff is zero
+        // skip the output if the diff is zero. A histogram of zero diffs still has counts.
         if (!interval.hasValue() ||
-            (mSkipZeroDiffOutput && mUseDiff && interval.aggregate.isZero())) {
+            (mSkipZeroDiffOutput && mUseDiff && mAggregationType != ValueMetric::HISTOGRAM &&
+             interval.aggregate.isZero())) {
             continue;
         }
 
         bucket.aggIndex.push_back(interval.aggIndex);
-        bucket.aggregates.push_back(getFinalValue(interval));
+        NumericValue& aggregate = bucket.aggregates.emplace_back(getFinalValue(interval));
+        if (mAggregationType == ValueMetric::HISTOGRAM) {
+            aggregate.histogram = interval.aggregate.histogram.getCompactedHistogramValue();
+        }
         if (mIncludeSampleSize) {
             bucket.sampleSizes.push_back(interval.sampleSize);
         }
@@ -631,6 +672,13 @@ size_t NumericValueMetricProducer::byteSizeLocked() const {
     for (const auto& [_, buckets] : mPastBuckets) {
         totalSize += buckets.size() * kBucketSize;
         // TODO(b/189283526): Add bytes used to store PastBucket.aggIndex vector
+        if (mAggregationType == ValueMetric::HISTOGRAM) {
+            for (const PastBucket<NumericValue>& bucket : buckets) {
+                for (const NumericValue& aggregate : bucket.aggregates) {
+                    totalSize += aggregate.histogram.getSize();
+                }
+            }
+        }
     }
     return totalSize;
 }
@@ -21,6 +21,7 @@
 #include <optional>
 
 #include "ValueMetricProducer.h"
+#include "metrics/NumericValue.h"
 
 namespace android {
 namespace os {
@@ -28,7 +29,7 @@ namespace statsd {
 
 // TODO(b/185796344): don't use Value from FieldValue.
 using ValueBases = std::vector<std::optional<Value>>;
-class NumericValueMetricProducer : public ValueMetricProducer<Value, ValueBases> {
+class NumericValueMetricProducer : public ValueMetricProducer<NumericValue, ValueBases> {
 public:
     NumericValueMetricProducer(const ConfigKey& key, const ValueMetric& valueMetric,
                                const uint64_t protoHash, const PullOptions& pullOptions,
@@ -80,8 +81,9 @@ private:
                                           const ConditionState newCondition,
                                           const int64_t eventTimeNs) override;
 
-    inline std::string aggregatedValueToString(const Value& value) const override {
-        return value.toString();
+    inline std::string aggregatedValueToString(const NumericValue& value) const override {
+        return mAggregationType == ValueMetric::HISTOGRAM ? value.histogram.toString()
+                                                          : value.toString();
     }
 
     // Mark the data as invalid.
@@ -104,8 +106,8 @@ private:
     void closeCurrentBucket(const int64_t eventTimeNs,
                             const int64_t nextBucketStartTimeNs) override;
 
-    PastBucket<Value> buildPartialBucket(int64_t bucketEndTime,
-                                         std::vector<Interval>& intervals) override;
+    PastBucket<NumericValue> buildPartialBucket(int64_t bucketEndTime,
+                                                std::vector<Interval>& intervals) override;
 
     bool valuePassesThreshold(const Interval& interval) const;
 
@@ -135,7 +137,7 @@ private:
 
     DumpProtoFields getDumpProtoFields() const override;
 
-    void writePastBucketAggregateToProto(const int aggIndex, const Value& value,
+    void writePastBucketAggregateToProto(const int aggIndex, const NumericValue& value,
                                          const int sampleSize,
                                          ProtoOutputStream* const protoOutput) const override;
 
@@ -153,6 +155,9 @@ private:
 
     const bool mUseDiff;
 
+    // Bins of each value field, only set for HISTOGRAM aggregation.
+    const std::vector<BinStarts> mBinStartsList;
+
     const ValueMetric::ValueDirection mValueDirection;
 
     const bool mSkipZeroDiffOutput;
@@ -188,6 +193,8 @@ private:
     FRIEND_TEST(NumericValueMetricProducerTest, TestEmptyDataResetsBase_onDataPulled);
     FRIEND_TEST(NumericValueMetricProducerTest, TestEventsWithNonSlicedCondition);
     FRIEND_TEST(NumericValueMetricProducerTest, TestFirstBucket);
+    FRIEND_TEST(NumericValueMetricProducerTest, TestHistogramPulledWithDiff);
+    FRIEND_TEST(NumericValueMetricProducerTest, TestHistogramPushedEvents);
     FRIEND_TEST(NumericValueMetricProducerTest, TestLateOnDataPulledWithDiff);
     FRIEND_TEST(NumericValueMetricProducerTest, TestLateOnDataPulledWithoutDiff);
     FRIEND_TEST(NumericValueMetricProducerTest, TestPartialResetOnBucketBoundaries);
@@ -276,6 +283,7 @@ private:
     FRIEND_TEST(NumericValueMetricProducerTest_ConditionCorrection, TestLateStateChangeSlicedAtoms);
 
     FRIEND_TEST(NumericValueMetricProducerTest, TestSubsetDimensions);
+    FRIEND_TEST(NumericValueMetricProducerTest, TestRollUpOverflowDimensions);
 
     FRIEND_TEST(ConfigUpdateTest, TestUpdateValueMetrics);
 
@@ -0,0 +1,400 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "TopKMetricProducer.h"
+
+#include <limits.h>
+
+#include <algorithm>
+
+#include "guardrail/StatsdStats.h"
+#include "metrics/parsing_utils/metrics_manager_util.h"
+#include "stats_log_util.h"
+#include "stats_util.h"
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_BOOL;
+using android::util::FIELD_TYPE_INT64;
+using android::util::FIELD_TYPE_MESSAGE;
+using android::util::ProtoOutputStream;
+using std::map;
+using std::nullopt;
+using std::optional;
+using std::shared_ptr;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// for StatsLogReport
+const int FIELD_ID_ID = 1;
+const int FIELD_ID_TOP_K_METRICS = 18;
+const int FIELD_ID_TIME_BASE = 9;
+const int FIELD_ID_BUCKET_SIZE = 10;
+const int FIELD_ID_DIMENSION_PATH_IN_WHAT = 11;
+const int FIELD_ID_IS_ACTIVE = 14;
+
+// for TopKMetricDataWrapper
+const int FIELD_ID_DATA = 1;
+// for TopKMetricData
+const int FIELD_ID_BUCKET_NUM = 1;
+const int FIELD_ID_START_BUCKET_ELAPSED_MILLIS = 2;
+const int FIELD_ID_END_BUCKET_ELAPSED_MILLIS = 3;
+const int FIELD_ID_ENTRY = 4;
+const int FIELD_ID_TOTAL_VALUE = 5;
+const int FIELD_ID_UNREPORTED_VALUE_BOUND = 6;
+// for TopKEntry
+const int FIELD_ID_DIMENSION_IN_WHAT = 1;
+const int FIELD_ID_DIMENSION_LEAF_IN_WHAT = 2;
+const int FIELD_ID_ESTIMATED_VALUE = 3;
+const int FIELD_ID_MAX_ERROR = 4;
+
+namespace {
+
+optional<int64_t> getWeightFromEvent(const LogEvent& event, const Matcher& matcher) {
+    for (const FieldValue& value : event.getValues()) {
+        if (value.mField.matches(matcher)) {
+            switch (value.mValue.type) {
+                case INT:
+                    return {value.mValue.int_value};
+                case LONG:
+                    return {value.mValue.long_value};
+                default:
+                    return nullopt;
+            }
+        }
+    }
+    return nullopt;
+}
+
+}  // anonymous namespace
+
+TopKMetricProducer::TopKMetricProducer(
+        const ConfigKey& key, const TopKMetric& metric, const int conditionIndex,
+        const vector<ConditionState>& initialConditionCache, const sp<ConditionWizard>& wizard,
+        const uint64_t protoHash, const int64_t timeBaseNs, const int64_t startTimeNs,
+        const unordered_map<int, shared_ptr<Activation>>& eventActivationMap,
+        const unordered_map<int, vector<shared_ptr<Activation>>>& eventDeactivationMap)
+    : MetricProducer(metric.id(), key, timeBaseNs, conditionIndex, initialConditionCache, wizard,
+                     protoHash, eventActivationMap, eventDeactivationMap, /*slicedStateAtoms=*/{},
+                     /*stateGroupMap=*/{}, getAppUpgradeBucketSplit(metric)),
+      mK(metric.k()),
+      mCurrentSummary(metric.has_num_counters() ? metric.num_counters() : 4 * metric.k()) {
+    if (metric.has_bucket()) {
+        mBucketSizeNs =
+                TimeUnitToBucketSizeInMillisGuardrailed(key.GetUid(), metric.bucket()) * 1000000;
+    } else {
+        mBucketSizeNs = LLONG_MAX;
+    }
+
+    translateFieldMatcher(metric.dimensions_in_what(), &mDimensionsInWhat);
+    mContainANYPositionInDimensionsInWhat = HasPositionANY(metric.dimensions_in_what());
+    mShouldUseNestedDimensions = ShouldUseNestedDimensions(metric.dimensions_in_what());
+
+    if (metric.has_value_field()) {
+        vector<Matcher> valueFields;
+        translateFieldMatcher(metric.value_field(), &valueFields);
+        if (!valueFields.empty()) {
+            mValueField = valueFields[0];
+        }
+    }
+
+    if (metric.links().size() > 0) {
+        for (const auto& link : metric.links()) {
+            Metric2Condition mc;
+            mc.conditionId = link.condition();
+            translateFieldMatcher(link.fields_in_what(), &mc.metricFields);
+            translateFieldMatcher(link.fields_in_condition(), &mc.conditionFields);
+            mMetric2ConditionLinks.push_back(mc);
+        }
+        mConditionSliced = true;
+    }
+
+    flushIfNeededLocked(startTimeNs);
+    // Adjust start for partial bucket
+    mCurrentBucketStartTimeNs = startTimeNs;
+
+    VLOG("metric %lld created. bucket size %lld start_time: %lld k: %zu counters: %zu",
+         (long long)mMetricId, (long long)mBucketSizeNs, (long long)mTimeBaseNs, mK,
+         mCurrentSummary.getCapacity());
+}
+
+TopKMetricProducer::~TopKMetricProducer() {
+    VLOG("~TopKMetricProducer() called");
+}
+
+sp<AnomalyTracker> TopKMetricProducer::addAnomalyTracker(
+        const Alert& alert, const sp<AlarmMonitor>& anomalyAlarmMonitor,
+        const UpdateStatus& updateStatus, const int64_t updateTimeNs) {
+    ALOGW("TopKMetric %lld does not support alerts", (long long)mMetricId);
+    return nullptr;
+}
+
+optional<InvalidConfigReason> TopKMetricProducer::onConfigUpdatedLocked(
+        const StatsdConfig& config, const int configIndex, const int metricIndex,
+        const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+        const unordered_map<int64_t, int>& oldAtomMatchingTrackerMap,
+        const unordered_map<int64_t, int>& newAtomMatchingTrackerMap,
+        const sp<EventMatcherWizard>& matcherWizard,
+        const vector<sp<ConditionTracker>>& allConditionTrackers,
+        const unordered_map<int64_t, int>& conditionTrackerMap, const sp<ConditionWizard>& wizard,
+        const unordered_map<int64_t, int>& metricToActivationMap,
+        unordered_map<int, vector<int>>& trackerToMetricMap,
+        unordered_map<int, vector<int>>& conditionToMetricMap,
+        unordered_map<int, vector<int>>& activationAtomTrackerToMetricMap,
+        unordered_map<int, vector<int>>& deactivationAtomTrackerToMetricMap,
+        vector<int>& metricsWithActivation) {
+    optional<InvalidConfigReason> invalidConfigReason = MetricProducer::onConfigUpdatedLocked(
+            config, configIndex, metricIndex, allAtomMatchingTrackers, oldAtomMatchingTrackerMap,
+            newAtomMatchingTrackerMap, matcherWizard, allConditionTrackers, conditionTrackerMap,
+            wizard, metricToActivationMap, trackerToMetricMap, conditionToMetricMap,
+            activationAtomTrackerToMetricMap, deactivationAtomTrackerToMetricMap,
+            metricsWithActivation);
+    if (invalidConfigReason.has_value()) {
+        return invalidConfigReason;
+    }
+
+    const TopKMetric& metric = config.top_k_metric(configIndex);
+    int trackerIndex;
+    // Update appropriate indices, specifically mConditionIndex and MetricsManager maps.
+    invalidConfigReason = handleMetricWithAtomMatchingTrackers(
+            metric.what(), mMetricId, metricIndex, false, allAtomMatchingTrackers,
+            newAtomMatchingTrackerMap, trackerToMetricMap, trackerIndex);
+    if (invalidConfigReason.has_value()) {
+        return invalidConfigReason;
+    }
+
+    if (metric.has_condition()) {
+        invalidConfigReason = handleMetricWithConditions(
+                metric.condition(), mMetricId, metricIndex, conditionTrackerMap, metric.links(),
+                allConditionTrackers, mConditionTrackerIndex, conditionToMetricMap);
+        if (invalidConfigReason.has_value()) {
+            return invalidConfigReason;
+        }
+    }
+
+    return nullopt;
+}
+
+void TopKMetricProducer::dumpStatesLocked(int out, bool verbose) const {
+    if (mCurrentSummary.empty()) {
+        return;
+    }
+
+    dprintf(out, "TopKMetric %lld tracked dimensions %zu/%zu total %lld\n", (long long)mMetricId,
+            mCurrentSummary.size(), mCurrentSummary.getCapacity(),
+            (long long)mCurrentSummary.getTotalWeight());
+    if (verbose) {
+        for (const auto& entry : mCurrentSummary.getTopK(mK)) {
+            dprintf(out, "\t(what)%s  %lld (error %lld)\n",
+                    entry.key.getDimensionKeyInWhat().toString().c_str(),
+                    (long long)entry.estimate, (long long)entry.error);
+        }
+    }
+}
+
+void TopKMetricProducer::onSlicedConditionMayChangeLocked(bool overallCondition,
+                                                          const int64_t eventTime) {
+    VLOG("Metric %lld onSlicedConditionMayChange", (long long)mMetricId);
+}
+
+void TopKMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
+    mPastBuckets.clear();
+}
+
+void TopKMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
+                                            const bool include_current_partial_bucket,
+                                            const bool erase_data, const DumpLatency dumpLatency,
+                                            std::set<string>* str_set,
+                                            ProtoOutputStream* protoOutput) {
+    if (include_current_partial_bucket) {
+        flushLocked(dumpTimeNs);
+    } else {
+        flushIfNeededLocked(dumpTimeNs);
+    }
+
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
+    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
+
+    if (mPastBuckets.empty()) {
+        return;
+    }
+
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
+    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
+
+    // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
+    if (!mShouldUseNestedDimensions) {
+        uint64_t dimenPathToken =
+                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
+        writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
+        protoOutput->end(dimenPathToken);
+    }
+
+    uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_TOP_K_METRICS);
+
+    for (const auto& bucket : mPastBuckets) {
+        uint64_t bucketToken =
+                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
+        // Partial bucket.
+        if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+                               (long long)NanoToMillis(bucket.mBucketStartNs));
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+                               (long long)NanoToMillis(bucket.mBucketEndNs));
+        } else {
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                               (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+        }
+
+        for (const auto& entry : bucket.mEntries) {
+            uint64_t entryToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                                     FIELD_ID_ENTRY);
+            if (mShouldUseNestedDimensions) {
+                uint64_t dimensionToken =
+                        protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
+                writeDimensionToProto(entry.key.getDimensionKeyInWhat(), str_set, protoOutput);
+                protoOutput->end(dimensionToken);
+            } else {
+                writeDimensionLeafNodesToProto(entry.key.getDimensionKeyInWhat(),
+                                               FIELD_ID_DIMENSION_LEAF_IN_WHAT, str_set,
+                                               protoOutput);
+            }
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ESTIMATED_VALUE,
+                               (long long)entry.estimate);
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_MAX_ERROR, (long long)entry.error);
+            protoOutput->end(entryToken);
+        }
+
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TOTAL_VALUE,
+                           (long long)bucket.mTotalValue);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_UNREPORTED_VALUE_BOUND,
+                           (long long)bucket.mUnreportedValueBound);
+        protoOutput->end(bucketToken);
+        VLOG("\t bucket [%lld - %lld] %zu entries", (long long)bucket.mBucketStartNs,
+             (long long)bucket.mBucketEndNs, bucket.mEntries.size());
+    }
+
+    protoOutput->end(protoToken);
+
+    if (erase_data) {
+        mPastBuckets.clear();
+    }
+}
+
+void TopKMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
+    flushIfNeededLocked(dropTimeNs);
+    StatsdStats::getInstance().noteBucketDropped(mMetricId);
+    mPastBuckets.clear();
+}
+
+void TopKMetricProducer::onConditionChangedLocked(const bool conditionMet,
+                                                  const int64_t eventTime) {
+    VLOG("Metric %lld onConditionChanged", (long long)mMetricId);
+    mCondition = conditionMet ? ConditionState::kTrue : ConditionState::kFalse;
+}
+
+void TopKMetricProducer::onMatchedLogEventInternalLocked(
+        const size_t matcherIndex, const MetricDimensionKey& eventKey,
+        const ConditionKey& conditionKey, bool condition, const LogEvent& event,
+        const map<int, HashableDimensionKey>& statePrimaryKeys) {
+    int64_t eventTimeNs = event.GetElapsedTimestampNs();
+    flushIfNeededLocked(eventTimeNs);
+
+    if (!condition) {
+        return;
+    }
+
+    int64_t weight = 1;
+    if (mValueField) {
+        const optional<int64_t> value = getWeightFromEvent(event, mValueField.value());
+        if (!value || value.value() < 0) {
+            VLOG("Failed to get value from event %s", event.ToString().c_str());
+            StatsdStats::getInstance().noteBadValueType(mMetricId);
+            return;
+        }
+        weight = value.value();
+    }
+
+    // The summary has a fixed number of counters, so there is no dimension guardrail: a new
+    // dimension replaces the lightest tracked one once all counters are in use.
+    mCurrentSummary.add(eventKey, weight);
+
+    VLOG("metric %lld %s += %lld", (long long)mMetricId, eventKey.toString().c_str(),
+         (long long)weight);
+}
+
+// When a new matched event comes in, we check if event falls into the current
+// bucket. If not, flush the old summary to past buckets and initialize the new bucket.
+void TopKMetricProducer::flushIfNeededLocked(const int64_t eventTimeNs) {
+    int64_t currentBucketEndTimeNs = getCurrentBucketEndTimeNs();
+    if (eventTimeNs < currentBucketEndTimeNs) {
+        return;
+    }
+
+    // Setup the bucket start time and number.
+    int64_t numBucketsForward = 1 + (eventTimeNs - currentBucketEndTimeNs) / mBucketSizeNs;
+    int64_t nextBucketNs = currentBucketEndTimeNs + (numBucketsForward - 1) * mBucketSizeNs;
+    flushCurrentBucketLocked(eventTimeNs, nextBucketNs);
+
+    mCurrentBucketNum += numBucketsForward;
+    VLOG("metric %lld: new bucket start time: %lld", (long long)mMetricId,
+         (long long)mCurrentBucketStartTimeNs);
+}
+
+void TopKMetricProducer::flushCurrentBucketLocked(const int64_t eventTimeNs,
+                                                  const int64_t nextBucketStartTimeNs) {
+    if (!mCurrentSummary.empty()) {
+        int64_t fullBucketEndTimeNs = getCurrentBucketEndTimeNs();
+        TopKBucket bucket;
+        bucket.mBucketStartNs = mCurrentBucketStartTimeNs;
+        bucket.mBucketEndNs = std::min(eventTimeNs, fullBucketEndTimeNs);
+        bucket.mTotalValue = mCurrentSummary.getTotalWeight();
+
+        // A dimension that is not reported is either not tracked, so its value is at most the
+        // smallest tracked estimate, or is tracked below the k-th entry.
+        bucket.mEntries = mCurrentSummary.getTopK(mK + 1);
+        bucket.mUnreportedValueBound = mCurrentSummary.getMinEstimate();
+        if (bucket.mEntries.size() > mK) {
+            bucket.mUnreportedValueBound = bucket.mEntries.back().estimate;
+            bucket.mEntries.pop_back();
+        }
+        mPastBuckets.push_back(std::move(bucket));
+    }
+
+    StatsdStats::getInstance().noteBucketCount(mMetricId);
+    mCurrentSummary.clear();
+    mCurrentBucketStartTimeNs = nextBucketStartTimeNs;
+}
+
+// Rough estimate of the past buckets stored. The dimension keys are not counted.
+size_t TopKMetricProducer::byteSizeLocked() const {
+    size_t totalSize = 0;
+    for (const auto& bucket : mPastBuckets) {
+        totalSize += kBucketSize + bucket.mEntries.size() * sizeof(TopKSummary::Counter);
+    }
+    return totalSize;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
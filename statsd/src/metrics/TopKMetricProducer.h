@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+#include <gtest/gtest_prod.h>
+
+#include <optional>
+#include <vector>
+
+#include "MetricProducer.h"
+#include "condition/ConditionTracker.h"
+#include "matchers/matcher_util.h"
+#include "src/statsd_config.pb.h"
+#include "stats_util.h"
+#include "utils/SpaceSavingSummary.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using TopKSummary = SpaceSavingSummary<MetricDimensionKey>;
+
+struct TopKBucket {
+    int64_t mBucketStartNs;
+    int64_t mBucketEndNs;
+    // Up to k heaviest dimensions, heaviest first.
+    std::vector<TopKSummary::Counter> mEntries;
+    int64_t mTotalValue;
+    int64_t mUnreportedValueBound;
+};
+
+// Reports the k dimensions with the largest event count, or the largest sum of a value field, in
+// each bucket. Dimensions are tracked in a Space-Saving summary with a fixed number of counters,
+// so the memory used per bucket does not depend on the number of dimensions in what, and each
+// reported value comes with the bound of its error.
+class TopKMetricProducer : public MetricProducer {
+public:
+    TopKMetricProducer(
+            const ConfigKey& key, const TopKMetric& topKMetric, int conditionIndex,
+            const vector<ConditionState>& initialConditionCache, const sp<ConditionWizard>& wizard,
+            const uint64_t protoHash, int64_t timeBaseNs, int64_t startTimeNs,
+            const std::unordered_map<int, std::shared_ptr<Activation>>& eventActivationMap = {},
+            const std::unordered_map<int, std::vector<std::shared_ptr<Activation>>>&
+                    eventDeactivationMap = {});
+
+    virtual ~TopKMetricProducer();
+
+    MetricType getMetricType() const override {
+        return METRIC_TYPE_TOP_K;
+    }
+
+    // Alerts are not supported since the value of a dimension is only an estimate.
+    sp<AnomalyTracker> addAnomalyTracker(const Alert& alert,
+                                         const sp<AlarmMonitor>& anomalyAlarmMonitor,
+                                         const UpdateStatus& updateStatus,
+                                         const int64_t updateTimeNs) override;
+
+protected:
+    void onMatchedLogEventInternalLocked(
+            const size_t matcherIndex, const MetricDimensionKey& eventKey,
+            const ConditionKey& conditionKey, bool condition, const LogEvent& event,
+            const std::map<int, HashableDimensionKey>& statePrimaryKeys) override;
+
+private:
+    void onDumpReportLocked(const int64_t dumpTimeNs, const bool include_current_partial_bucket,
+                            const bool erase_data, const DumpLatency dumpLatency,
+                            std::set<string>* str_set,
+                            android::util::ProtoOutputStream* protoOutput) override;
+
+    void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
+
+    // Internal interface to handle condition change.
+    void onConditionChangedLocked(const bool conditionMet, int64_t eventTime) override;
+
+    // Internal interface to handle sliced condition change.
+    void onSlicedConditionMayChangeLocked(bool overallCondition, int64_t eventTime) override;
+
+    // Internal function to calculate the current used bytes.
+    size_t byteSizeLocked() const override;
+
+    void dumpStatesLocked(int out, bool verbose) const override;
+
+    void dropDataLocked(const int64_t dropTimeNs) override;
+
+    // Util function to flush the old packet.
+    void flushIfNeededLocked(int64_t newEventTime) override;
+
+    void flushCurrentBucketLocked(int64_t eventTimeNs, int64_t nextBucketStartTimeNs) override;
+
+    optional<InvalidConfigReason> onConfigUpdatedLocked(
+            const StatsdConfig& config, int configIndex, int metricIndex,
+            const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+            const std::unordered_map<int64_t, int>& oldAtomMatchingTrackerMap,
+            const std::unordered_map<int64_t, int>& newAtomMatchingTrackerMap,
+            const sp<EventMatcherWizard>& matcherWizard,
+            const std::vector<sp<ConditionTracker>>& allConditionTrackers,
+            const std::unordered_map<int64_t, int>& conditionTrackerMap,
+            const sp<ConditionWizard>& wizard,
+            const std::unordered_map<int64_t, int>& metricToActivationMap,
+            std::unordered_map<int, std::vector<int>>& trackerToMetricMap,
+            std::unordered_map<int, std::vector<int>>& conditionToMetricMap,
+            std::unordered_map<int, std::vector<int>>& activationAtomTrackerToMetricMap,
+            std::unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
+            std::vector<int>& metricsWithActivation) override;
+
+    // Number of dimensions reported per bucket.
+    const size_t mK;
+
+    // Field summed per dimension. The events are counted if not set.
+    std::optional<Matcher> mValueField;
+
+    // Heavy hitters of the current bucket (may be a partial bucket).
+    TopKSummary mCurrentSummary;
+
+    std::vector<TopKBucket> mPastBuckets;
+
+    static const size_t kBucketSize = sizeof(TopKBucket{});
+
+    FRIEND_TEST(TopKMetricProducerTest, TestTopKByCount);
+    FRIEND_TEST(TopKMetricProducerTest, TestTopKByValueField);
+    FRIEND_TEST(TopKMetricProducerTest, TestEventsWithNonSlicedCondition);
+    FRIEND_TEST(TopKMetricProducerTest, TestBoundedMemory);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
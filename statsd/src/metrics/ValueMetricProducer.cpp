@@ -26,9 +26,11 @@
 #include "FieldValue.h"
 #include "HashableDimensionKey.h"
 #include "guardrail/StatsdStats.h"
+#include "metrics/NumericValue.h"
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "stats_log_util.h"
 #include "stats_util.h"
+#include "utils/HyperLogLog.h"
 
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
@@ -69,6 +71,7 @@ const int FIELD_ID_DIMENSION_IN_WHAT = 1;
 const int FIELD_ID_BUCKET_INFO = 3;
 const int FIELD_ID_DIMENSION_LEAF_IN_WHAT = 4;
 const int FIELD_ID_SLICE_BY_STATE = 6;
+const int FIELD_ID_IS_OVERFLOW = 7;
 
 template <typename AggregatedValue, typename DimExtras>
 ValueMetricProducer<AggregatedValue, DimExtras>::ValueMetricProducer(
@@ -90,6 +93,7 @@ ValueMetricProducer<AggregatedValue, DimExtras>::ValueMetricProducer(
       mMinBucketSizeNs(bucketOptions.minBucketSizeNs),
       mDimensionSoftLimit(guardrailOptions.dimensionSoftLimit),
       mDimensionHardLimit(guardrailOptions.dimensionHardLimit),
+      mRollUpOverflowDimensions(guardrailOptions.rollUpOverflowDimensions),
       mCurrentBucketIsSkipped(false),
       mConditionCorrectionThresholdNs(bucketOptions.conditionCorrectionThresholdNs) {
     // TODO(b/185722221): inject directly via initializer list in MetricProducer.
@@ -369,7 +373,9 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
                 protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
 
         // First fill dimension.
-        if (mShouldUseNestedDimensions) {
+        if (isOverflowDimensionKey(metricDimensionKey)) {
+            protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_OVERFLOW, true);
+        } else if (mShouldUseNestedDimensions) {
             uint64_t dimensionToken =
                     protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
             writeDimensionToProto(metricDimensionKey.getDimensionKeyInWhat(), strSet, protoOutput);
@@ -628,8 +634,9 @@ bool ValueMetricProducer<AggregatedValue, DimExtras>::hitGuardRailLocked(
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (hasReachedGuardRailLimit()) {
             if (!mHasHitGuardrail) {
-                ALOGE("ValueMetricProducer %lld dropping data for dimension key %s",
-                      (long long)mMetricId, newKey.toString().c_str());
+                ALOGE("ValueMetricProducer %lld %s data for dimension key %s",
+                      (long long)mMetricId, mRollUpOverflowDimensions ? "rolling up" : "dropping",
+                      newKey.toString().c_str());
                 mHasHitGuardrail = true;
             }
             StatsdStats::getInstance().noteHardDimensionLimitReached(mMetricId);
@@ -662,8 +669,7 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onMatchedLogEventInternalL
         return;
     }
 
-    const auto whatKey = eventKey.getDimensionKeyInWhat();
-    mMatchedMetricDimensionKeys.insert(whatKey);
+    mMatchedMetricDimensionKeys.insert(eventKey.getDimensionKeyInWhat());
 
     if (!isPulled()) {
         // Only flushing for pushed because for pulled metrics, we need to do a pull first.
@@ -674,9 +680,17 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onMatchedLogEventInternalL
         return;
     }
 
+    const MetricDimensionKey* aggregateKey = &eventKey;
+    std::optional<MetricDimensionKey> overflowKey;
     if (hitGuardRailLocked(eventKey)) {
-        return;
+        if (!mRollUpOverflowDimensions) {
+            return;
+        }
+        // The overflow key keeps the unknown state so that it never sees a state change.
+        overflowKey.emplace(OVERFLOW_DIMENSION_KEY, getUnknownStateKey());
+        aggregateKey = &overflowKey.value();
     }
+    const auto& whatKey = aggregateKey->getDimensionKeyInWhat();
 
     const auto& returnVal = mDimInfos.emplace(whatKey, DimensionsInWhatInfo(getUnknownStateKey()));
     DimensionsInWhatInfo& dimensionsInWhatInfo = returnVal.first->second;
@@ -685,7 +699,7 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onMatchedLogEventInternalL
 
     // Ensure we turn on the condition timer in the case where dimensions
     // were missing on a previous pull due to a state change.
-    const auto stateKey = eventKey.getStateValuesKey();
+    const auto stateKey = aggregateKey->getStateValuesKey();
     const bool stateChange = oldStateKey != stateKey || !dimensionsInWhatInfo.hasCurrentState;
 
     // We need to get the intervals stored with the previous state key so we can
@@ -699,8 +713,8 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onMatchedLogEventInternalL
     dimensionsInWhatInfo.hasCurrentState = true;
     dimensionsInWhatInfo.currentState = stateKey;
 
-    dimensionsInWhatInfo.seenNewData |= aggregateFields(eventTimeNs, eventKey, event, intervals,
-                                                        dimensionsInWhatInfo.dimExtras);
+    dimensionsInWhatInfo.seenNewData |= aggregateFields(eventTimeNs, *aggregateKey, event,
+                                                        intervals, dimensionsInWhatInfo.dimExtras);
 
     // State change.
     if (!mSlicedStateAtoms.empty() && stateChange) {
@@ -891,8 +905,9 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::initNextSlicedBucket(
 }
 
 // Explicit template instantiations
-template class ValueMetricProducer<Value, vector<optional<Value>>>;
+template class ValueMetricProducer<NumericValue, vector<optional<Value>>>;
 template class ValueMetricProducer<unique_ptr<KllQuantile>, Empty>;
+template class ValueMetricProducer<unique_ptr<HyperLogLog>, Empty>;
 
 }  // namespace statsd
 }  // namespace os
@@ -112,6 +112,7 @@ public:
     struct GuardrailOptions {
         const size_t dimensionSoftLimit;
         const size_t dimensionHardLimit;
+        const bool rollUpOverflowDimensions;
     };
 
     virtual ~ValueMetricProducer();
@@ -350,6 +351,10 @@ protected:
 
     const size_t mDimensionHardLimit;
 
+    // Whether events of new dimensions past mDimensionHardLimit are aggregated into the overflow
+    // key instead of being dropped.
+    const bool mRollUpOverflowDimensions;
+
     // This is to track whether or not the bucket is skipped for any of the reasons listed in
     // BucketDropReason, many of which make the bucket potentially invalid.
     bool mCurrentBucketIsSkipped;
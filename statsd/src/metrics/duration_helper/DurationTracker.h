@@ -20,6 +20,7 @@
 #include "anomaly/DurationAnomalyTracker.h"
 #include "condition/ConditionWizard.h"
 #include "config/ConfigKey.h"
+#include "metrics/HistogramValue.h"
 #include "metrics/parsing_utils/config_update_utils.h"
 #include "stats_util.h"
 
@@ -56,6 +57,8 @@ struct DurationBucket {
     int64_t mBucketEndNs;
     int64_t mDuration;
     int64_t mConditionTrueNs;
+    // Compacted histogram of the interval lengths, empty if the metric has no duration_histogram.
+    HistogramValue mDurationHistogram;
 
     DurationBucket() : mBucketStartNs(0), mBucketEndNs(0), mDuration(0), mConditionTrueNs(0){};
 };
@@ -68,6 +71,9 @@ struct DurationValues {
     // Used for anomaly detection.
     int64_t mDurationFullBucket;
 
+    // Lengths of the intervals that ended in the current partial bucket.
+    HistogramValue mDurationHistogram;
+
     DurationValues() : mDuration(0), mDurationFullBucket(0){};
 };
 
@@ -142,6 +148,11 @@ public:
 
     virtual bool hasAccumulatedDuration() const = 0;
 
+    // Enables the histogram of the interval lengths. binStarts are in milliseconds.
+    void setDurationBinStarts(const std::shared_ptr<const BinStarts>& binStarts) {
+        mDurationBinStarts = binStarts;
+    }
+
     void addAnomalyTracker(sp<AnomalyTracker>& anomalyTracker, const UpdateStatus& updateStatus,
                            const int64_t updateTimeNs) {
         mAnomalyTrackers.push_back(anomalyTracker);
@@ -217,6 +228,13 @@ protected:
         mEventKey = eventKey;
     }
 
+    // Counts the length of an interval that ended in the histogram, if it is enabled.
+    void recordDurationInterval(HistogramValue& histogram, int64_t durationNs) const {
+        if (mDurationBinStarts != nullptr && durationNs > 0) {
+            histogram.addValue(durationNs / 1e6, *mDurationBinStarts);
+        }
+    }
+
     bool durationPassesThreshold(const optional<UploadThreshold>& uploadThreshold,
                                  int64_t duration) {
         if (duration <= 0) {
@@ -274,6 +292,9 @@ protected:
 
     mutable bool mHasHitGuardrail;
 
+    // Bin starts of the interval length histogram, or nullptr if it is disabled.
+    std::shared_ptr<const BinStarts> mDurationBinStarts;
+
     FRIEND_TEST(OringDurationTrackerTest, TestPredictAnomalyTimestamp);
     FRIEND_TEST(OringDurationTrackerTest, TestAnomalyDetectionExpiredAlarm);
     FRIEND_TEST(OringDurationTrackerTest, TestAnomalyDetectionFiredAlarm);
@@ -145,6 +145,7 @@ void MaxDurationTracker::noteStop(const HashableDimensionKey& key, const int64_t
     // Once an atom duration ends, we erase it. Next time, if we see another atom event with the
     // same name, they are still considered as different atom durations.
     if (duration.state == DurationState::kStopped) {
+        recordDurationInterval(mDurationHistogram, duration.lastDuration);
         mInfos.erase(key);
     }
 }
@@ -212,6 +213,7 @@ bool MaxDurationTracker::flushCurrentBucket(
         info.mBucketEndNs = currentBucketEndTimeNs;
         info.mDuration = mDuration;
         info.mConditionTrueNs = globalConditionTrueNs;
+        info.mDurationHistogram = mDurationHistogram.getCompactedHistogramValue();
         (*output)[mEventKey].push_back(info);
         VLOG("  final duration for last bucket: %lld", (long long)mDuration);
     } else {
@@ -226,6 +228,7 @@ bool MaxDurationTracker::flushCurrentBucket(
     }
 
     mDuration = 0;
+    mDurationHistogram.clear();
     // Reset mHasHitGuardrail boolean since bucket was reset
     mHasHitGuardrail = false;
     // If this tracker has no pending events, tell owner to remove.
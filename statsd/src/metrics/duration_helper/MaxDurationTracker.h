@@ -76,6 +76,9 @@ private:
 
     int64_t mDuration;  // current recorded duration result (for partial bucket)
 
+    // Lengths of the durations that stopped in the current partial bucket.
+    HistogramValue mDurationHistogram;
+
     void noteConditionChanged(const HashableDimensionKey& key, bool conditionMet,
                               const int64_t timestamp);
 
@@ -36,7 +36,8 @@ OringDurationTracker::OringDurationTracker(const ConfigKey& key, const int64_t i
                       currentBucketNum, startTimeNs, bucketSizeNs, conditionSliced, fullLink,
                       anomalyTrackers),
       mStarted(),
-      mPaused() {
+      mPaused(),
+      mIntervalDurationNs(0) {
     mLastStartTime = 0;
 }
 
@@ -98,8 +99,7 @@ void OringDurationTracker::noteStop(const HashableDimensionKey& key, const int64
             mConditionKeyMap.erase(key);
         }
         if (mStarted.empty()) {
-            mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
-                    (timestamp - mLastStartTime);
+            recordDuration(timestamp);
             detectAndDeclareAnomaly(
                     timestamp, mCurrentBucketNum,
                     getCurrentStateKeyDuration() + getCurrentStateKeyFullBucketDuration());
@@ -119,13 +119,15 @@ void OringDurationTracker::noteStop(const HashableDimensionKey& key, const int64
     }
     if (mStarted.empty()) {
         stopAnomalyAlarm(timestamp);
+        if (mPaused.empty()) {
+            endDurationInterval();
+        }
     }
 }
 
 void OringDurationTracker::noteStopAll(const int64_t timestamp) {
     if (!mStarted.empty()) {
-        mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
-                (timestamp - mLastStartTime);
+        recordDuration(timestamp);
         VLOG("Oring Stop all: record duration %lld, total duration %lld for state key %s",
              (long long)timestamp - mLastStartTime, (long long)getCurrentStateKeyDuration(),
              mEventKey.getStateValuesKey().toString().c_str());
@@ -135,6 +137,7 @@ void OringDurationTracker::noteStopAll(const int64_t timestamp) {
     }
 
     stopAnomalyAlarm(timestamp);
+    endDurationInterval();
     mStarted.clear();
     mPaused.clear();
     mConditionKeyMap.clear();
@@ -165,8 +168,7 @@ bool OringDurationTracker::flushCurrentBucket(
     // Process the current bucket.
     if (mStarted.size() > 0) {
         // Calculate the duration for the current state key.
-        mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
-                (currentBucketEndTimeNs - mLastStartTime);
+        recordDuration(currentBucketEndTimeNs);
     }
     // Store DurationBucket info for each whatKey, stateKey pair.
     // Note: The whatKey stored in mEventKey is constant for each DurationTracker, while the
@@ -181,6 +183,8 @@ bool OringDurationTracker::flushCurrentBucket(
             current_info.mBucketEndNs = currentBucketEndTimeNs;
             current_info.mDuration = durationIt.second.mDuration;
             current_info.mConditionTrueNs = globalConditionTrueNs;
+            current_info.mDurationHistogram =
+                    durationIt.second.mDurationHistogram.getCompactedHistogramValue();
             (*output)[MetricDimensionKey(mEventKey.getDimensionKeyInWhat(), durationIt.first)]
                     .push_back(current_info);
             VLOG("  duration: %lld", (long long)current_info.mDuration);
@@ -196,6 +200,7 @@ bool OringDurationTracker::flushCurrentBucket(
                     getCurrentStateKeyFullBucketDuration(), mCurrentBucketNum);
         }
         durationIt.second.mDuration = 0;
+        durationIt.second.mDurationHistogram.clear();
     }
     // Full bucket is only needed when we have anomaly trackers.
     if (isFullBucket || mAnomalyTrackers.empty()) {
@@ -208,6 +213,7 @@ bool OringDurationTracker::flushCurrentBucket(
             info.mBucketStartNs = fullBucketEnd + mBucketSizeNs * (i - 1);
             info.mBucketEndNs = info.mBucketStartNs + mBucketSizeNs;
             info.mDuration = mBucketSizeNs;
+            mIntervalDurationNs += mBucketSizeNs;
             // Full duration buckets are attributed to the current stateKey.
             (*output)[mEventKey].push_back(info);
             // Safe to send these buckets to anomaly tracker since they must be full buckets.
@@ -273,8 +279,7 @@ void OringDurationTracker::onSlicedConditionMayChange(const int64_t timestamp) {
         }
 
         if (mStarted.empty()) {
-            mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
-                    (timestamp - mLastStartTime);
+            recordDuration(timestamp);
             VLOG("record duration %lld, total duration %lld for state key %s",
                  (long long)(timestamp - mLastStartTime), (long long)getCurrentStateKeyDuration(),
                  mEventKey.getStateValuesKey().toString().c_str());
@@ -336,8 +341,7 @@ void OringDurationTracker::onConditionChanged(bool condition, const int64_t time
     } else {
         if (!mStarted.empty()) {
             VLOG("Condition false, all paused");
-            mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
-                    (timestamp - mLastStartTime);
+            recordDuration(timestamp);
             mPaused.insert(mStarted.begin(), mStarted.end());
             mStarted.clear();
             detectAndDeclareAnomaly(
@@ -357,16 +361,32 @@ void OringDurationTracker::onStateChanged(const int64_t timestamp, const int32_t
     // For these cases, no keys are being tracked in mStarted, so update
     // the current state key and return.
     if (mStarted.empty()) {
+        endDurationInterval();
         updateCurrentStateKey(atomId, newState);
         return;
     }
     // Add the current duration length to the previous state key and then update
     // the last start time and current state key.
-    mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration += (timestamp - mLastStartTime);
+    recordDuration(timestamp);
+    endDurationInterval();
     mLastStartTime = timestamp;
     updateCurrentStateKey(atomId, newState);
 }
 
+void OringDurationTracker::recordDuration(const int64_t timestamp) {
+    mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration += (timestamp - mLastStartTime);
+    mIntervalDurationNs += (timestamp - mLastStartTime);
+}
+
+void OringDurationTracker::endDurationInterval() {
+    if (mDurationBinStarts != nullptr && mIntervalDurationNs > 0) {
+        recordDurationInterval(
+                mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDurationHistogram,
+                mIntervalDurationNs);
+    }
+    mIntervalDurationNs = 0;
+}
+
 bool OringDurationTracker::hasAccumulatedDuration() const {
     return !mStarted.empty() || !mPaused.empty() || !mStateKeyDurationMap.empty();
 }
@@ -80,6 +80,15 @@ private:
     int64_t mLastStartTime;
     std::unordered_map<HashableDimensionKey, ConditionKey> mConditionKeyMap;
 
+    // Condition true time of the current interval, up to mLastStartTime.
+    int64_t mIntervalDurationNs;
+
+    // Adds the duration since mLastStartTime to the current state key and interval.
+    void recordDuration(int64_t timestamp);
+
+    // Counts the current interval in the histogram of the current state key.
+    void endDurationInterval();
+
     // return true if we should not allow newKey to be tracked because we are above the threshold
     bool hitGuardRail(const HashableDimensionKey& newKey, size_t dimensionHardLimit) const;
 
@@ -0,0 +1,489 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "metrics/parsing_utils/config_cost_estimator.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+
+#include "config/ConfigKey.h"
+#include "metrics/parsing_utils/metrics_manager_util.h"
+#include "packages/UidMap.h"
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::map;
+using std::mutex;
+using std::nullopt;
+using std::optional;
+using std::set;
+using std::unordered_map;
+using std::vector;
+
+namespace {
+
+// Bucket size of the metrics that do not set one, as in initMetrics.
+const int64_t kDefaultBucketSizeNs = 60 * 60 * NS_PER_SEC;
+
+// Bytes of a dimension key, plus bytes per field in the key.
+const int64_t kDimensionKeyBytes = 16;
+const int64_t kDimensionFieldBytes = 16;
+
+// Bytes of one bucket of a dimension, besides the aggregated values.
+const int64_t kBucketBytes = 16;
+
+// Bytes of one aggregated value: a count, a duration or a value field.
+const int64_t kValueBytes = 8;
+
+// Bytes of a KLL sketch once it has seen enough values to be full.
+const int64_t kKllSketchBytes = 2048;
+
+mutex gCeilingsMutex;
+optional<ConfigCostCeilings> gCeilings;
+
+class ConfigCostCalculator {
+public:
+    ConfigCostCalculator(const StatsdConfig& config, const ConfigCostPriors& priors,
+                         const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+                         const unordered_map<int64_t, int>& atomMatchingTrackerMap)
+        : mConfig(config),
+          mPriors(priors),
+          mAllAtomMatchingTrackers(allAtomMatchingTrackers),
+          mAtomMatchingTrackerMap(atomMatchingTrackerMap) {
+    }
+
+    double eventsPerSec(int atomId) const {
+        const auto it = mPriors.eventsPerSec.find(atomId);
+        return it == mPriors.eventsPerSec.end() ? mPriors.defaultEventsPerSec : it->second;
+    }
+
+    // Events per second matched by an atom matcher.
+    double matcherEventsPerSec(int64_t matcherId) const {
+        double rate = 0;
+        for (int atomId : atomIds(matcherId)) {
+            rate += eventsPerSec(atomId);
+        }
+        return rate;
+    }
+
+    // Atom that a simple matcher matches. 0 for combination matchers.
+    int whatAtomId(int64_t matcherId) const {
+        const set<int>& ids = atomIds(matcherId);
+        return ids.size() == 1 ? *ids.begin() : 0;
+    }
+
+    template <typename States>
+    int64_t dimensionFanOut(const FieldMatcher& dimensions, const States& sliceByState,
+                            int maxDimensionsPerBucket) const {
+        int64_t fanOut = 1;
+        for (const FieldMatcher& child : dimensions.child()) {
+            const auto it = mPriors.fieldCardinalities.find({dimensions.field(), child.field()});
+            fanOut *= it == mPriors.fieldCardinalities.end() ? mPriors.defaultFieldCardinality
+                                                              : it->second;
+        }
+        for (const int64_t stateId : sliceByState) {
+            fanOut *= stateCardinality(stateId);
+        }
+        const size_t hardLimit =
+                StatsdStats::getAtomDimensionKeySizeLimits(
+                        dimensions.field(),
+                        StatsdStats::clampDimensionKeySizeLimit(maxDimensionsPerBucket))
+                        .second;
+        return std::min<int64_t>(fanOut, hardLimit);
+    }
+
+    int64_t dimensionKeyBytes(const FieldMatcher& dimensions, int numStates) const {
+        return kDimensionKeyBytes + (dimensions.child_size() + numStates) * kDimensionFieldBytes;
+    }
+
+    // Fills in the memory of a metric that reports bucketBytes per dimension per bucket.
+    void setBucketedCost(MetricCost& cost, int64_t dimensionBytes, int64_t bucketBytes) const {
+        cost.reportBytesPerBucket = cost.dimensionFanOut * (dimensionBytes + bucketBytes);
+        const int64_t bucketsPerReport =
+                std::max<int64_t>(1, mPriors.reportPeriodSec * NS_PER_SEC / cost.bucketSizeNs);
+        cost.memoryBytes = cost.reportBytesPerBucket * (bucketsPerReport + 1);
+    }
+
+    void setPullCost(MetricCost& cost, int atomId, double pullsPerHour) const {
+        if (!isPulledAtom(atomId)) {
+            return;
+        }
+        const auto it = mPriors.atomsPerPull.find(atomId);
+        const int64_t atomsPerPull =
+                it == mPriors.atomsPerPull.end() ? mPriors.defaultAtomsPerPull : it->second;
+        cost.pulled = true;
+        cost.pullsPerHour = pullsPerHour;
+        cost.pullPayloadBytes = atomsPerPull * mPriors.bytesPerAtom;
+    }
+
+    static int64_t bucketSizeNs(TimeUnit unit) {
+        return unit == TIME_UNIT_UNSPECIFIED ? kDefaultBucketSizeNs
+                                             : MillisToNano(TimeUnitToBucketSizeInMillis(unit));
+    }
+
+    static double pullsPerHourForBuckets(int64_t bucketSizeNs) {
+        return 3600.0 * NS_PER_SEC / bucketSizeNs;
+    }
+
+    const ConfigCostPriors& priors() const {
+        return mPriors;
+    }
+
+private:
+    const set<int>& atomIds(int64_t matcherId) const {
+        static const set<int> kNoAtoms;
+        const auto it = mAtomMatchingTrackerMap.find(matcherId);
+        return it == mAtomMatchingTrackerMap.end()
+                       ? kNoAtoms
+                       : mAllAtomMatchingTrackers[it->second]->getAtomIds();
+    }
+
+    int64_t stateCardinality(int64_t stateId) const {
+        for (const State& state : mConfig.state()) {
+            if (state.id() != stateId) {
+                continue;
+            }
+            if (state.has_map()) {
+                return std::max(1, state.map().group_size());
+            }
+            const auto it = mPriors.stateCardinalities.find(state.atom_id());
+            return it == mPriors.stateCardinalities.end() ? mPriors.defaultStateCardinality
+                                                          : it->second;
+        }
+        return mPriors.defaultStateCardinality;
+    }
+
+    const StatsdConfig& mConfig;
+    const ConfigCostPriors& mPriors;
+    const vector<sp<AtomMatchingTracker>>& mAllAtomMatchingTrackers;
+    const unordered_map<int64_t, int>& mAtomMatchingTrackerMap;
+};
+
+// Count, duration, value, kll and distinct count metrics share the same shape.
+template <typename Metric>
+MetricCost estimateSlicedMetricCost(const ConfigCostCalculator& calculator, const Metric& metric,
+                                    int64_t valueBytes) {
+    MetricCost cost;
+    cost.metricId = metric.id();
+    cost.bucketSizeNs = ConfigCostCalculator::bucketSizeNs(metric.bucket());
+    cost.dimensionFanOut = calculator.dimensionFanOut(metric.dimensions_in_what(),
+                                                      metric.slice_by_state(),
+                                                      metric.max_dimensions_per_bucket());
+    calculator.setBucketedCost(
+            cost,
+            calculator.dimensionKeyBytes(metric.dimensions_in_what(), metric.slice_by_state_size()),
+            kBucketBytes + valueBytes);
+    return cost;
+}
+
+void addMetricCosts(const StatsdConfig& config, const ConfigCostCalculator& calculator,
+                    vector<MetricCost>& metricCosts) {
+    const ConfigCostPriors& priors = calculator.priors();
+    const vector<int64_t> noStates;
+
+    for (const CountMetric& metric : config.count_metric()) {
+        metricCosts.push_back(estimateSlicedMetricCost(calculator, metric, kValueBytes));
+    }
+
+    for (const DurationMetric& metric : config.duration_metric()) {
+        int64_t valueBytes = kValueBytes;
+        if (metric.has_duration_histogram()) {
+            // One count per bin, including the underflow and overflow bins.
+            valueBytes += kValueBytes * (metric.duration_histogram().explicit_bins().bin_size() +
+                                         metric.duration_histogram().generated_bins().count() + 2);
+        }
+        MetricCost cost = estimateSlicedMetricCost(calculator, metric, valueBytes);
+        // Each dimension also tracks the start time of its running durations.
+        cost.memoryBytes += cost.dimensionFanOut * kValueBytes;
+        metricCosts.push_back(cost);
+    }
+
+    for (const EventMetric& metric : config.event_metric()) {
+        // Every event is kept until the next report.
+        MetricCost cost;
+        cost.metricId = metric.id();
+        const double eventsPerReport = calculator.matcherEventsPerSec(metric.what()) *
+                                       priors.reportPeriodSec * metric.sampling_percentage() /
+                                       100;
+        cost.reportBytesPerBucket = static_cast<int64_t>(eventsPerReport * priors.bytesPerAtom);
+        cost.memoryBytes = cost.reportBytesPerBucket;
+        metricCosts.push_back(cost);
+    }
+
+    for (const ValueMetric& metric : config.value_metric()) {
+        MetricCost cost = estimateSlicedMetricCost(
+                calculator, metric,
+                kValueBytes * std::max(1, metric.value_field().child_size()));
+        calculator.setPullCost(cost, calculator.whatAtomId(metric.what()),
+                               ConfigCostCalculator::pullsPerHourForBuckets(cost.bucketSizeNs));
+        metricCosts.push_back(cost);
+    }
+
+    for (const KllMetric& metric : config.kll_metric()) {
+        MetricCost cost = estimateSlicedMetricCost(calculator, metric, kKllSketchBytes);
+        calculator.setPullCost(cost, calculator.whatAtomId(metric.what()),
+                               ConfigCostCalculator::pullsPerHourForBuckets(cost.bucketSizeNs));
+        metricCosts.push_back(cost);
+    }
+
+    for (const DistinctCountMetric& metric : config.distinct_count_metric()) {
+        metricCosts.push_back(
+                estimateSlicedMetricCost(calculator, metric, int64_t{1} << metric.precision()));
+    }
+
+    for (const GaugeMetric& metric : config.gauge_metric()) {
+        MetricCost cost;
+        cost.metricId = metric.id();
+        cost.bucketSizeNs = ConfigCostCalculator::bucketSizeNs(metric.bucket());
+        cost.dimensionFanOut = calculator.dimensionFanOut(metric.dimensions_in_what(), noStates,
+                                                          metric.max_dimensions_per_bucket());
+        calculator.setBucketedCost(
+                cost, calculator.dimensionKeyBytes(metric.dimensions_in_what(), 0),
+                kBucketBytes + metric.max_num_gauge_atoms_per_bucket() * priors.bytesPerAtom);
+        const double pullsPerHour =
+                metric.has_trigger_event()
+                        ? calculator.matcherEventsPerSec(metric.trigger_event()) * 3600
+                        : ConfigCostCalculator::pullsPerHourForBuckets(cost.bucketSizeNs);
+        calculator.setPullCost(cost, calculator.whatAtomId(metric.what()), pullsPerHour);
+        metricCosts.push_back(cost);
+    }
+
+    for (const TopKMetric& metric : config.top_k_metric()) {
+        // Only the tracked counters are held, whatever the dimension fan-out.
+        MetricCost cost;
+        cost.metricId = metric.id();
+        cost.bucketSizeNs = ConfigCostCalculator::bucketSizeNs(metric.bucket());
+        const int64_t numCounters =
+                metric.has_num_counters() ? metric.num_counters() : 4 * metric.k();
+        cost.dimensionFanOut = std::min(
+                numCounters, calculator.dimensionFanOut(metric.dimensions_in_what(), noStates,
+                                                        /*maxDimensionsPerBucket=*/0));
+        const int64_t counterBytes =
+                calculator.dimensionKeyBytes(metric.dimensions_in_what(), 0) + kValueBytes;
+        cost.reportBytesPerBucket = std::min<int64_t>(metric.k(), cost.dimensionFanOut) *
+                                    counterBytes;
+        const int64_t bucketsPerReport =
+                std::max<int64_t>(1, priors.reportPeriodSec * NS_PER_SEC / cost.bucketSizeNs);
+        cost.memoryBytes = cost.dimensionFanOut * counterBytes +
+                           cost.reportBytesPerBucket * bucketsPerReport;
+        metricCosts.push_back(cost);
+    }
+}
+
+void addToSet(const unordered_map<int, vector<int>>& map, int key, set<int>& out) {
+    const auto it = map.find(key);
+    if (it != map.end()) {
+        out.insert(it->second.begin(), it->second.end());
+    }
+}
+
+}  // anonymous namespace
+
+ConfigCostCeilings getDefaultConfigCostCeilings() {
+    ConfigCostCeilings ceilings;
+    ceilings.maxWorkUnitsPerSec = 100000;
+    ceilings.maxMemoryBytes = StatsdStats::kHardMaxMetricsBytesPerConfig;
+    ceilings.maxReportBytes = StatsdStats::kHardMaxMetricsBytesPerConfig;
+    ceilings.maxPullsPerHour = 3600;
+    return ceilings;
+}
+
+void setConfigCostCeilings(const optional<ConfigCostCeilings>& ceilings) {
+    std::lock_guard<mutex> lock(gCeilingsMutex);
+    gCeilings = ceilings;
+}
+
+optional<ConfigCostCeilings> getConfigCostCeilings() {
+    std::lock_guard<mutex> lock(gCeilingsMutex);
+    return gCeilings;
+}
+
+optional<InvalidConfigReason> estimateConfigCost(const StatsdConfig& config,
+                                                 const ConfigCostPriors& priors,
+                                                 ConfigCostEstimate& estimate) {
+    // The trackers are only built to validate the config and to map atoms to matchers,
+    // conditions and metrics. Nothing is pulled, no alarm is set and the metrics do not listen to
+    // the global StateManager, so the estimate can run next to the live configs.
+    const ConfigKey key(0, config.id());
+    const sp<UidMap> uidMap = new UidMap();
+    const sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    const int64_t timeBaseNs = getElapsedRealtimeNs();
+    unordered_map<int, vector<int>> allTagIdsToMatchersMap;
+    vector<sp<AtomMatchingTracker>> allAtomMatchingTrackers;
+    unordered_map<int64_t, int> atomMatchingTrackerMap;
+    vector<sp<ConditionTracker>> allConditionTrackers;
+    unordered_map<int64_t, int> conditionTrackerMap;
+    vector<sp<MetricProducer>> allMetricProducers;
+    unordered_map<int64_t, int> metricProducerMap;
+    vector<sp<AnomalyTracker>> allAnomalyTrackers;
+    vector<sp<AlarmTracker>> allPeriodicAlarmTrackers;
+    unordered_map<int, vector<int>> conditionToMetricMap;
+    unordered_map<int, vector<int>> trackerToMetricMap;
+    unordered_map<int, vector<int>> trackerToConditionMap;
+    unordered_map<int, vector<int>> activationAtomTrackerToMetricMap;
+    unordered_map<int, vector<int>> deactivationAtomTrackerToMetricMap;
+    unordered_map<int64_t, int> alertTrackerMap;
+    vector<int> metricsWithActivation;
+    map<int64_t, uint64_t> stateProtoHashes;
+    set<int64_t> noReportMetricIds;
+
+    const optional<InvalidConfigReason> invalidConfigReason = initStatsdConfig(
+            key, config, uidMap, pullerManager, /*anomalyAlarmMonitor=*/nullptr,
+            /*periodicAlarmMonitor=*/nullptr, timeBaseNs, timeBaseNs, allTagIdsToMatchersMap,
+            allAtomMatchingTrackers, atomMatchingTrackerMap, allConditionTrackers,
+            conditionTrackerMap, allMetricProducers, metricProducerMap, allAnomalyTrackers,
+            allPeriodicAlarmTrackers, conditionToMetricMap, trackerToMetricMap,
+            trackerToConditionMap, activationAtomTrackerToMetricMap,
+            deactivationAtomTrackerToMetricMap, alertTrackerMap, metricsWithActivation,
+            stateProtoHashes, noReportMetricIds, /*registerStateListeners=*/false);
+    if (invalidConfigReason.has_value()) {
+        return invalidConfigReason;
+    }
+
+    estimate = computeConfigCost(config, priors, allTagIdsToMatchersMap, allAtomMatchingTrackers,
+                                 atomMatchingTrackerMap, trackerToConditionMap,
+                                 trackerToMetricMap, conditionToMetricMap);
+    return nullopt;
+}
+
+ConfigCostEstimate computeConfigCost(
+        const StatsdConfig& config, const ConfigCostPriors& priors,
+        const unordered_map<int, vector<int>>& allTagIdsToMatchersMap,
+        const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+        const unordered_map<int64_t, int>& atomMatchingTrackerMap,
+        const unordered_map<int, vector<int>>& trackerToConditionMap,
+        const unordered_map<int, vector<int>>& trackerToMetricMap,
+        const unordered_map<int, vector<int>>& conditionToMetricMap) {
+    ConfigCostEstimate estimate;
+    const ConfigCostCalculator calculator(config, priors, allAtomMatchingTrackers,
+                                          atomMatchingTrackerMap);
+
+    // Every event of an atom goes through all the matchers of the atom. In the worst case every
+    // matcher matches, so every condition and metric that depends on them is updated.
+    for (const auto& [atomId, matcherIndices] : allTagIdsToMatchersMap) {
+        set<int> conditionIndices;
+        set<int> metricIndices;
+        for (const int matcherIndex : matcherIndices) {
+            addToSet(trackerToConditionMap, matcherIndex, conditionIndices);
+            addToSet(trackerToMetricMap, matcherIndex, metricIndices);
+        }
+        for (const int conditionIndex : conditionIndices) {
+            addToSet(conditionToMetricMap, conditionIndex, metricIndices);
+        }
+
+        AtomCost cost;
+        cost.atomId = atomId;
+        cost.eventsPerSec = calculator.eventsPerSec(atomId);
+        cost.matchersPerEvent = matcherIndices.size();
+        cost.conditionsPerEvent = conditionIndices.size();
+        cost.metricsPerEvent = metricIndices.size();
+        cost.workUnitsPerSec =
+                cost.eventsPerSec *
+                (cost.matchersPerEvent + cost.conditionsPerEvent + cost.metricsPerEvent);
+        estimate.totalWorkUnitsPerSec += cost.workUnitsPerSec;
+        estimate.atomCosts.push_back(cost);
+    }
+    std::sort(estimate.atomCosts.begin(), estimate.atomCosts.end(),
+              [](const AtomCost& a, const AtomCost& b) { return a.atomId < b.atomId; });
+
+    addMetricCosts(config, calculator, estimate.metricCosts);
+    for (const MetricCost& cost : estimate.metricCosts) {
+        estimate.totalMemoryBytes += cost.memoryBytes;
+        estimate.totalPullsPerHour += cost.pullsPerHour;
+        const int64_t bucketsPerReport =
+                cost.bucketSizeNs == 0
+                        ? 1
+                        : std::max<int64_t>(1, priors.reportPeriodSec * NS_PER_SEC /
+                                                       cost.bucketSizeNs);
+        estimate.totalReportBytes += cost.reportBytesPerBucket * bucketsPerReport;
+    }
+    return estimate;
+}
+
+optional<InvalidConfigReason> checkConfigCost(const ConfigCostEstimate& estimate,
+                                              const ConfigCostCeilings& ceilings) {
+    if ((ceilings.maxWorkUnitsPerSec > 0 &&
+         estimate.totalWorkUnitsPerSec > ceilings.maxWorkUnitsPerSec) ||
+        (ceilings.maxMemoryBytes > 0 && estimate.totalMemoryBytes > ceilings.maxMemoryBytes) ||
+        (ceilings.maxReportBytes > 0 && estimate.totalReportBytes > ceilings.maxReportBytes) ||
+        (ceilings.maxPullsPerHour > 0 &&
+         estimate.totalPullsPerHour > ceilings.maxPullsPerHour)) {
+        ALOGE("Config cost exceeds ceilings: %.1f work units/s, %" PRId64
+              " bytes in memory, %" PRId64 " report bytes, %.1f pulls/h",
+              estimate.totalWorkUnitsPerSec, estimate.totalMemoryBytes, estimate.totalReportBytes,
+              estimate.totalPullsPerHour);
+        return InvalidConfigReason(INVALID_CONFIG_REASON_CONFIG_COST_EXCEEDS_CEILING);
+    }
+    return nullopt;
+}
+
+optional<InvalidConfigReason> checkConfigCostCeilings(
+        const StatsdConfig& config, const unordered_map<int, vector<int>>& allTagIdsToMatchersMap,
+        const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+        const unordered_map<int64_t, int>& atomMatchingTrackerMap,
+        const unordered_map<int, vector<int>>& trackerToConditionMap,
+        const unordered_map<int, vector<int>>& trackerToMetricMap,
+        const unordered_map<int, vector<int>>& conditionToMetricMap) {
+    const optional<ConfigCostCeilings> ceilings = getConfigCostCeilings();
+    if (!ceilings.has_value()) {
+        return nullopt;
+    }
+    const ConfigCostEstimate estimate = computeConfigCost(
+            config, ConfigCostPriors(), allTagIdsToMatchersMap, allAtomMatchingTrackers,
+            atomMatchingTrackerMap, trackerToConditionMap, trackerToMetricMap,
+            conditionToMetricMap);
+    return checkConfigCost(estimate, *ceilings);
+}
+
+void printConfigCostEstimate(const ConfigCostEstimate& estimate, FILE* out) {
+    fprintf(out, "Total: %.1f work units/s, %" PRId64 " bytes in memory, %" PRId64
+                 " report bytes, %.1f pulls/h\n",
+            estimate.totalWorkUnitsPerSec, estimate.totalMemoryBytes, estimate.totalReportBytes,
+            estimate.totalPullsPerHour);
+    fprintf(out, "Atoms:\n");
+    for (const AtomCost& cost : estimate.atomCosts) {
+        fprintf(out,
+                "  %d: %.2f events/s, %d matchers, %d conditions, %d metrics, %.1f work "
+                "units/s\n",
+                cost.atomId, cost.eventsPerSec, cost.matchersPerEvent, cost.conditionsPerEvent,
+                cost.metricsPerEvent, cost.workUnitsPerSec);
+    }
+    fprintf(out, "Metrics:\n");
+    for (const MetricCost& cost : estimate.metricCosts) {
+        fprintf(out,
+                "  %" PRId64 ": %" PRId64 " dimensions, %" PRId64 " report bytes/bucket, %" PRId64
+                " bytes in memory",
+                cost.metricId, cost.dimensionFanOut, cost.reportBytesPerBucket, cost.memoryBytes);
+        if (cost.pulled) {
+            fprintf(out, ", %.1f pulls/h of %" PRId64 " bytes", cost.pullsPerHour,
+                    cost.pullPayloadBytes);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
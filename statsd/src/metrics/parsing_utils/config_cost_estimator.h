@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "guardrail/StatsdStats.h"
+#include "matchers/AtomMatchingTracker.h"
+#include "src/statsd_config.pb.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// What the estimator assumes about the atoms a config receives. Atoms and fields that have no
+// entry use the defaults.
+struct ConfigCostPriors {
+    // Events logged per second, per atom id.
+    std::unordered_map<int, double> eventsPerSec;
+    double defaultEventsPerSec = 0.1;
+
+    // Atoms returned by one pull, per pulled atom id.
+    std::unordered_map<int, int64_t> atomsPerPull;
+    int64_t defaultAtomsPerPull = 10;
+
+    // Distinct values of a top level field, keyed by {atom id, field number}.
+    std::map<std::pair<int, int>, int64_t> fieldCardinalities;
+    int64_t defaultFieldCardinality = 10;
+
+    // Distinct values of a state atom, per atom id. Not used for states with groups, which have
+    // one value per group.
+    std::unordered_map<int, int64_t> stateCardinalities;
+    int64_t defaultStateCardinality = 5;
+
+    // Encoded size of one atom.
+    int64_t bytesPerAtom = 64;
+
+    // Time between two reports of the config. Past buckets are held in memory until reported.
+    int64_t reportPeriodSec = 24 * 60 * 60;
+};
+
+struct AtomCost {
+    int atomId = 0;
+
+    double eventsPerSec = 0;
+
+    // Matchers, conditions and metrics each event of the atom is fed to.
+    int matchersPerEvent = 0;
+    int conditionsPerEvent = 0;
+    int metricsPerEvent = 0;
+
+    // eventsPerSec times the matchers, conditions and metrics per event.
+    double workUnitsPerSec = 0;
+};
+
+struct MetricCost {
+    int64_t metricId = 0;
+
+    // Dimensions the metric can hold in a bucket, capped by the dimension guardrail.
+    int64_t dimensionFanOut = 1;
+
+    int64_t bucketSizeNs = 0;
+
+    int64_t reportBytesPerBucket = 0;
+
+    // The current bucket plus the past buckets of a report period.
+    int64_t memoryBytes = 0;
+
+    bool pulled = false;
+    double pullsPerHour = 0;
+    int64_t pullPayloadBytes = 0;
+};
+
+struct ConfigCostEstimate {
+    // Sorted by atom id.
+    std::vector<AtomCost> atomCosts;
+
+    // In the order of the metrics in the config.
+    std::vector<MetricCost> metricCosts;
+
+    double totalWorkUnitsPerSec = 0;
+    int64_t totalMemoryBytes = 0;
+    int64_t totalReportBytes = 0;
+    double totalPullsPerHour = 0;
+};
+
+// Limits past which a config is too expensive to be accepted. A zero limit is not checked.
+struct ConfigCostCeilings {
+    double maxWorkUnitsPerSec = 0;
+    int64_t maxMemoryBytes = 0;
+    int64_t maxReportBytes = 0;
+    double maxPullsPerHour = 0;
+};
+
+// Ceilings used by the statsd_config_cost_ceilings boot flag.
+ConfigCostCeilings getDefaultConfigCostCeilings();
+
+// Sets the ceilings initStatsdConfig checks every new config against, with the default priors.
+// Configs are not checked if ceilings is nullopt, which is the default.
+void setConfigCostCeilings(const std::optional<ConfigCostCeilings>& ceilings);
+
+std::optional<ConfigCostCeilings> getConfigCostCeilings();
+
+// Validates a config the way statsd does when the config is added, then estimates its cost.
+// input:
+// [config]: the config to estimate
+// [priors]: the atom rates and cardinalities to assume
+// output:
+// [estimate]: the cost of the config, only set if the config is valid
+// Returns the InvalidConfigReason if the config is invalid or exceeds the ceilings set with
+// setConfigCostCeilings.
+std::optional<InvalidConfigReason> estimateConfigCost(const StatsdConfig& config,
+                                                      const ConfigCostPriors& priors,
+                                                      ConfigCostEstimate& estimate);
+
+// Estimates the cost of a config that initStatsdConfig has already validated, from the trackers
+// and maps it built.
+ConfigCostEstimate computeConfigCost(
+        const StatsdConfig& config, const ConfigCostPriors& priors,
+        const std::unordered_map<int, std::vector<int>>& allTagIdsToMatchersMap,
+        const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+        const std::unordered_map<int64_t, int>& atomMatchingTrackerMap,
+        const std::unordered_map<int, std::vector<int>>& trackerToConditionMap,
+        const std::unordered_map<int, std::vector<int>>& trackerToMetricMap,
+        const std::unordered_map<int, std::vector<int>>& conditionToMetricMap);
+
+// Returns INVALID_CONFIG_REASON_CONFIG_COST_EXCEEDS_CEILING if the estimate exceeds a ceiling.
+std::optional<InvalidConfigReason> checkConfigCost(const ConfigCostEstimate& estimate,
+                                                   const ConfigCostCeilings& ceilings);
+
+// Checks a config built by initStatsdConfig or updateStatsdConfig against the ceilings set with
+// setConfigCostCeilings, with the default priors. Returns nullopt if no ceilings are set.
+std::optional<InvalidConfigReason> checkConfigCostCeilings(
+        const StatsdConfig& config,
+        const std::unordered_map<int, std::vector<int>>& allTagIdsToMatchersMap,
+        const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+        const std::unordered_map<int64_t, int>& atomMatchingTrackerMap,
+        const std::unordered_map<int, std::vector<int>>& trackerToConditionMap,
+        const std::unordered_map<int, std::vector<int>>& trackerToMetricMap,
+        const std::unordered_map<int, std::vector<int>>& conditionToMetricMap);
+
+void printConfigCostEstimate(const ConfigCostEstimate& estimate, FILE* out);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
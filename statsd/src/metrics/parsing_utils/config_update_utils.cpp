@@ -19,6 +19,7 @@
 
 #include "config_update_utils.h"
 
+#include "config_cost_estimator.h"
 #include "external/StatsPullerManager.h"
 #include "hash.h"
 #include "matchers/EventMatcherWizard.h"
@@ -672,6 +673,38 @@ optional<InvalidConfigReason> determineAllMetricUpdateStatuses(
         }
     }
 
+    for (int i = 0; i < config.top_k_metric_size(); i++, metricIndex++) {
+        const TopKMetric& metric = config.top_k_metric(i);
+        set<int64_t> conditionDependencies;
+        if (metric.has_condition()) {
+            conditionDependencies.insert(metric.condition());
+        }
+        invalidConfigReason = determineMetricUpdateStatus(
+                config, metric, metric.id(), METRIC_TYPE_TOP_K, {metric.what()},
+                conditionDependencies, ::google::protobuf::RepeatedField<int64_t>(), metric.links(),
+                oldMetricProducerMap, oldMetricProducers, metricToActivationMap, replacedMatchers,
+                replacedConditions, replacedStates, metricsToUpdate[metricIndex]);
+        if (invalidConfigReason.has_value()) {
+            return invalidConfigReason;
+        }
+    }
+
+    for (int i = 0; i < config.distinct_count_metric_size(); i++, metricIndex++) {
+        const DistinctCountMetric& metric = config.distinct_count_metric(i);
+        set<int64_t> conditionDependencies;
+        if (metric.has_condition()) {
+            conditionDependencies.insert(metric.condition());
+        }
+        invalidConfigReason = determineMetricUpdateStatus(
+                config, metric, metric.id(), METRIC_TYPE_DISTINCT_COUNT, {metric.what()},
+                conditionDependencies, metric.slice_by_state(), metric.links(),
+                oldMetricProducerMap, oldMetricProducers, metricToActivationMap, replacedMatchers,
+                replacedConditions, replacedStates, metricsToUpdate[metricIndex]);
+        if (invalidConfigReason.has_value()) {
+            return invalidConfigReason;
+        }
+    }
+
     return nullopt;
 }
 
@@ -741,7 +774,9 @@ optional<InvalidConfigReason> updateMetrics(
     sp<EventMatcherWizard> matcherWizard = new EventMatcherWizard(allAtomMatchingTrackers);
     const int allMetricsCount = config.count_metric_size() + config.duration_metric_size() +
                                 config.event_metric_size() + config.gauge_metric_size() +
-                                config.value_metric_size() + config.kll_metric_size();
+                                config.value_metric_size() + config.kll_metric_size() +
+                                config.top_k_metric_size() +
+                                config.distinct_count_metric_size();
     newMetricProducers.reserve(allMetricsCount);
     optional<InvalidConfigReason> invalidConfigReason;
 
@@ -1030,6 +1065,91 @@ optional<InvalidConfigReason> updateMetrics(
         newMetricProducers.push_back(producer.value());
     }
 
+    for (int i = 0; i < config.top_k_metric_size(); i++, metricIndex++) {
+        const TopKMetric& metric = config.top_k_metric(i);
+        newMetricProducerMap[metric.id()] = metricIndex;
+        optional<sp<MetricProducer>> producer;
+        switch (metricsToUpdate[metricIndex]) {
+            case UPDATE_PRESERVE: {
+                producer = updateMetric(
+                        config, i, metricIndex, metric.id(), allAtomMatchingTrackers,
+                        oldAtomMatchingTrackerMap, newAtomMatchingTrackerMap, matcherWizard,
+                        allConditionTrackers, conditionTrackerMap, wizard, oldMetricProducerMap,
+                        oldMetricProducers, metricToActivationMap, trackerToMetricMap,
+                        conditionToMetricMap, activationAtomTrackerToMetricMap,
+                        deactivationAtomTrackerToMetricMap, metricsWithActivation,
+                        invalidConfigReason);
+                break;
+            }
+            case UPDATE_REPLACE:
+                replacedMetrics.insert(metric.id());
+                [[fallthrough]];  // Intentionally fallthrough to create the new metric producer.
+            case UPDATE_NEW: {
+                producer = createTopKMetricProducerAndUpdateMetadata(
+                        key, config, timeBaseNs, currentTimeNs, metric, metricIndex,
+                        allAtomMatchingTrackers, newAtomMatchingTrackerMap, allConditionTrackers,
+                        conditionTrackerMap, initialConditionCache, wizard, metricToActivationMap,
+                        trackerToMetricMap, conditionToMetricMap, activationAtomTrackerToMetricMap,
+                        deactivationAtomTrackerToMetricMap, metricsWithActivation,
+                        invalidConfigReason);
+                break;
+            }
+            default: {
+                ALOGE("Metric \"%lld\" update state is unknown. This should never happen",
+                      (long long)metric.id());
+                return InvalidConfigReason(INVALID_CONFIG_REASON_METRIC_UPDATE_STATUS_UNKNOWN,
+                                           metric.id());
+            }
+        }
+        if (!producer) {
+            return invalidConfigReason;
+        }
+        newMetricProducers.push_back(producer.value());
+    }
+
+    for (int i = 0; i < config.distinct_count_metric_size(); i++, metricIndex++) {
+        const DistinctCountMetric& metric = config.distinct_count_metric(i);
+        newMetricProducerMap[metric.id()] = metricIndex;
+        optional<sp<MetricProducer>> producer;
+        switch (metricsToUpdate[metricIndex]) {
+            case UPDATE_PRESERVE: {
+                producer = updateMetric(
+                        config, i, metricIndex, metric.id(), allAtomMatchingTrackers,
+                        oldAtomMatchingTrackerMap, newAtomMatchingTrackerMap, matcherWizard,
+                        allConditionTrackers, conditionTrackerMap, wizard, oldMetricProducerMap,
+                        oldMetricProducers, metricToActivationMap, trackerToMetricMap,
+                        conditionToMetricMap, activationAtomTrackerToMetricMap,
+                        deactivationAtomTrackerToMetricMap, metricsWithActivation,
+                        invalidConfigReason);
+                break;
+            }
+            case UPDATE_REPLACE:
+                replacedMetrics.insert(metric.id());
+                [[fallthrough]];  // Intentionally fallthrough to create the new metric producer.
+            case UPDATE_NEW: {
+                producer = createDistinctCountMetricProducerAndUpdateMetadata(
+                        key, config, timeBaseNs, currentTimeNs, pullerManager, metric, metricIndex,
+                        allAtomMatchingTrackers, newAtomMatchingTrackerMap, allConditionTrackers,
+                        conditionTrackerMap, initialConditionCache, wizard, matcherWizard,
+                        stateAtomIdMap, allStateGroupMaps, metricToActivationMap,
+                        trackerToMetricMap, conditionToMetricMap, activationAtomTrackerToMetricMap,
+                        deactivationAtomTrackerToMetricMap, metricsWithActivation,
+                        invalidConfigReason);
+                break;
+            }
+            default: {
+                ALOGE("Metric \"%lld\" update state is unknown. This should never happen",
+                      (long long)metric.id());
+                return InvalidConfigReason(INVALID_CONFIG_REASON_METRIC_UPDATE_STATUS_UNKNOWN,
+                                           metric.id());
+            }
+        }
+        if (!producer) {
+            return invalidConfigReason;
+        }
+        newMetricProducers.push_back(producer.value());
+    }
+
     for (int i = 0; i < config.no_report_metric_size(); ++i) {
         const int64_t noReportMetric = config.no_report_metric(i);
         if (newMetricProducerMap.find(noReportMetric) == newMetricProducerMap.end()) {
@@ -1072,6 +1192,11 @@ optional<InvalidConfigReason> updateMetrics(
         if (it == newMetricProducerMap.end() ||
             replacedMetrics.find(oldMetricProducer->getMetricId()) != replacedMetrics.end()) {
             oldMetricProducer->onMetricRemove();
+            // The replacements are already registered, so the StateTrackers still in use are
+            // kept.
+            for (int atomId : oldMetricProducer->getSlicedStateAtoms()) {
+                StateManager::getInstance().unregisterListener(atomId, oldMetricProducer);
+            }
         }
     }
     return nullopt;
@@ -1291,6 +1416,14 @@ optional<InvalidConfigReason> updateStatsdConfig(
         ALOGE("initAlarms failed");
         return invalidConfigReason;
     }
+
+    invalidConfigReason = checkConfigCostCeilings(
+            config, allTagIdsToMatchersMap, newAtomMatchingTrackers, newAtomMatchingTrackerMap,
+            trackerToConditionMap, trackerToMetricMap, conditionToMetricMap);
+    if (invalidConfigReason.has_value()) {
+        ALOGE("checkConfigCostCeilings failed");
+        return invalidConfigReason;
+    }
     return nullopt;
 }
 
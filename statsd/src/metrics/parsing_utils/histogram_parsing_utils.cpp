@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "histogram_parsing_utils.h"
+
+#include <math.h>
+
+using std::nullopt;
+using std::optional;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+optional<InvalidConfigReason> generateBinStarts(int64_t metricId,
+                                                const HistogramBinConfig::GeneratedBins& bins,
+                                                BinStarts& binStarts) {
+    const float min = bins.min();
+    const float max = bins.max();
+    const int count = bins.count();
+    if (!bins.has_min() || !bins.has_max() || !bins.has_count() || !(min < max) || count < 1) {
+        ALOGE("Invalid generated bins in metric \"%lld\"", (long long)metricId);
+        return InvalidConfigReason(
+                INVALID_CONFIG_REASON_VALUE_METRIC_HIST_GENERATED_BINS_INVALID_ARGS, metricId);
+    }
+    // count bins between min and max take count + 1 bin starts, the last one being the start of
+    // the overflow bin.
+    if ((size_t)count + 1 > kMaxHistogramBinStarts) {
+        ALOGE("Too many bins in metric \"%lld\"", (long long)metricId);
+        return InvalidConfigReason(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_TOO_MANY_BINS, metricId);
+    }
+
+    binStarts.clear();
+    binStarts.reserve(count + 1);
+    switch (bins.strategy()) {
+        case HistogramBinConfig::GeneratedBins::LINEAR: {
+            const double width = ((double)max - min) / count;
+            for (int i = 0; i < count; i++) {
+                binStarts.push_back(min + width * i);
+            }
+            break;
+        }
+        case HistogramBinConfig::GeneratedBins::EXPONENTIAL: {
+            if (min <= 0) {
+                ALOGE("Exponential bins must start above 0 in metric \"%lld\"",
+                      (long long)metricId);
+                return InvalidConfigReason(
+                        INVALID_CONFIG_REASON_VALUE_METRIC_HIST_GENERATED_BINS_INVALID_ARGS,
+                        metricId);
+            }
+            const double factor = pow((double)max / min, 1.0 / count);
+            double binStart = min;
+            for (int i = 0; i < count; i++) {
+                binStarts.push_back(binStart);
+                binStart *= factor;
+            }
+            break;
+        }
+        default:
+            ALOGE("Unknown bin strategy in metric \"%lld\"", (long long)metricId);
+            return InvalidConfigReason(
+                    INVALID_CONFIG_REASON_VALUE_METRIC_HIST_GENERATED_BINS_INVALID_ARGS, metricId);
+    }
+    // Use max as is instead of accumulating rounding errors into it.
+    binStarts.push_back(max);
+
+    // Rounding to float can collapse neighbouring bin starts of very narrow bins.
+    for (size_t i = 1; i < binStarts.size(); i++) {
+        if (binStarts[i - 1] >= binStarts[i]) {
+            ALOGE("Generated bins are too narrow in metric \"%lld\"", (long long)metricId);
+            return InvalidConfigReason(
+                    INVALID_CONFIG_REASON_VALUE_METRIC_HIST_GENERATED_BINS_INVALID_ARGS, metricId);
+        }
+    }
+    return nullopt;
+}
+
+optional<InvalidConfigReason> generateBinStarts(int64_t metricId,
+                                                const HistogramBinConfig::ExplicitBins& bins,
+                                                BinStarts& binStarts) {
+    if ((size_t)bins.bin_size() < kMinHistogramBinStarts) {
+        ALOGE("Too few bins in metric \"%lld\"", (long long)metricId);
+        return InvalidConfigReason(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_TOO_FEW_BINS, metricId);
+    }
+    if ((size_t)bins.bin_size() > kMaxHistogramBinStarts) {
+        ALOGE("Too many bins in metric \"%lld\"", (long long)metricId);
+        return InvalidConfigReason(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_TOO_MANY_BINS, metricId);
+    }
+    for (int i = 1; i < bins.bin_size(); i++) {
+        if (!(bins.bin(i - 1) < bins.bin(i))) {
+            ALOGE("Bins are not strictly increasing in metric \"%lld\"",
+                  (long long)metricId);
+            return InvalidConfigReason(
+                    INVALID_CONFIG_REASON_VALUE_METRIC_HIST_EXPLICIT_BINS_NOT_STRICTLY_ORDERED,
+                    metricId);
+        }
+    }
+    binStarts.assign(bins.bin().begin(), bins.bin().end());
+    return nullopt;
+}
+
+}  // anonymous namespace
+
+optional<InvalidConfigReason> generateBinStarts(int64_t metricId,
+                                                const HistogramBinConfig& binConfig,
+                                                BinStarts& binStarts) {
+    switch (binConfig.binning_strategy_case()) {
+        case HistogramBinConfig::kGeneratedBins:
+            return generateBinStarts(metricId, binConfig.generated_bins(), binStarts);
+        case HistogramBinConfig::kExplicitBins:
+            return generateBinStarts(metricId, binConfig.explicit_bins(), binStarts);
+        default:
+            ALOGE("Missing bins in metric \"%lld\"", (long long)metricId);
+            return InvalidConfigReason(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_MISSING_BIN_CONFIG,
+                                       metricId);
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <optional>
+
+#include "guardrail/StatsdStats.h"
+#include "metrics/HistogramValue.h"
+#include "src/statsd_config.pb.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Minimum and maximum number of bin starts of a histogram, not counting the underflow and
+// overflow bins.
+constexpr size_t kMinHistogramBinStarts = 2;
+constexpr size_t kMaxHistogramBinStarts = 100;
+
+// Generates the bin starts of a HistogramBinConfig.
+// input:
+// [metricId]: id of the metric the config belongs to, for logging
+// [binConfig]: the HistogramBinConfig from the ValueMetric or DurationMetric
+// output:
+// [binStarts]: the lower bound of each bin, in increasing order
+// Returns an InvalidConfigReason if the config is malformed.
+std::optional<InvalidConfigReason> generateBinStarts(int64_t metricId,
+                                                     const HistogramBinConfig& binConfig,
+                                                     BinStarts& binStarts);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -31,6 +31,7 @@
 #include "matchers/EventMatcherWizard.h"
 #include "matchers/SimpleAtomMatchingTracker.h"
 #include "metrics/CountMetricProducer.h"
+#include "metrics/DistinctCountMetricProducer.h"
 #include "metrics/DurationMetricProducer.h"
 #include "metrics/EventMetricProducer.h"
 #include "metrics/GaugeMetricProducer.h"
@@ -38,8 +39,12 @@
 #include "metrics/MetricProducer.h"
 #include "metrics/NumericValueMetricProducer.h"
 #include "metrics/RestrictedEventMetricProducer.h"
+#include "metrics/TopKMetricProducer.h"
+#include "metrics/parsing_utils/config_cost_estimator.h"
+#include "metrics/parsing_utils/histogram_parsing_utils.h"
 #include "state/StateManager.h"
 #include "stats_util.h"
+#include "utils/Regex.h"
 
 using google::protobuf::MessageLite;
 using std::set;
@@ -100,6 +105,22 @@ optional<InvalidConfigReasonEnum> validateFvmPositionAllAndAny(
     return nullopt;
 }
 
+// Returns true if the string replacements in the FieldValueMatcher and in its nested matchers all
+// use a regex that Regex supports.
+bool hasValidStringReplaceRegex(const FieldValueMatcher& fvm) {
+    if (fvm.has_replace_string() && Regex::create(fvm.replace_string().regex()) == nullptr) {
+        return false;
+    }
+    if (fvm.value_matcher_case() == FieldValueMatcher::kMatchesTuple) {
+        for (const FieldValueMatcher& childFvm : fvm.matches_tuple().field_value_matcher()) {
+            if (!hasValidStringReplaceRegex(childFvm)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 optional<InvalidConfigReason> validateSimpleAtomMatcher(int64_t matcherId,
                                                         const SimpleAtomMatcher& simpleMatcher) {
     for (const FieldValueMatcher& fvm : simpleMatcher.field_value_matcher()) {
@@ -119,6 +140,10 @@ optional<InvalidConfigReason> validateSimpleAtomMatcher(int64_t matcherId,
                     INVALID_CONFIG_REASON_MATCHER_INVALID_VALUE_MATCHER_WITH_STRING_REPLACE,
                     matcherId);
         }
+        if (!hasValidStringReplaceRegex(fvm)) {
+            return createInvalidConfigReasonWithMatcher(
+                    INVALID_CONFIG_REASON_MATCHER_STRING_REPLACE_INVALID_REGEX, matcherId);
+        }
         vector<FieldValueMatcher const*> visited;
         const optional<InvalidConfigReasonEnum> reasonEnum = validateFvmPositionAllAndAny(
                 fvm, false /* inPositionAll */, false /* inPositionAny */, visited);
@@ -775,6 +800,15 @@ optional<sp<MetricProducer>> createDurationMetricProducerAndUpdateMetadata(
         }
     }
 
+    if (metric.has_duration_histogram()) {
+        BinStarts binStarts;
+        invalidConfigReason =
+                generateBinStarts(metric.id(), metric.duration_histogram(), binStarts);
+        if (invalidConfigReason.has_value()) {
+            return nullopt;
+        }
+    }
+
     sp<MetricProducer> metricProducer = new DurationMetricProducer(
             key, metric, conditionIndex, initialConditionCache, whatIndex, startIndex, stopIndex,
             stopAllIndex, nesting, wizard, metricHash, internalDimensions, timeBaseNs,
@@ -921,6 +955,23 @@ optional<sp<MetricProducer>> createNumericValueMetricProducerAndUpdateMetadata(
                 INVALID_CONFIG_REASON_VALUE_METRIC_HAS_INCORRECT_VALUE_FIELD, metric.id());
         return nullopt;
     }
+    if (metric.aggregation_type() == ValueMetric::HISTOGRAM) {
+        if ((size_t)metric.histogram_bin_configs_size() != fieldMatchers.size()) {
+            ALOGE("histogram_bin_configs count does not match value_field count in ValueMetric "
+                  "\"%lld\"",
+                  (long long)metric.id());
+            invalidConfigReason = InvalidConfigReason(
+                    INVALID_CONFIG_REASON_VALUE_METRIC_HIST_COUNT_DNE_VALUE_FIELD, metric.id());
+            return nullopt;
+        }
+        for (const HistogramBinConfig& binConfig : metric.histogram_bin_configs()) {
+            BinStarts binStarts;
+            invalidConfigReason = generateBinStarts(metric.id(), binConfig, binStarts);
+            if (invalidConfigReason.has_value()) {
+                return nullopt;
+            }
+        }
+    }
 
     int trackerIndex;
     invalidConfigReason = handleMetricWithAtomMatchingTrackers(
@@ -935,6 +986,15 @@ optional<sp<MetricProducer>> createNumericValueMetricProducerAndUpdateMetadata(
     int atomTagId = *(atomMatcher->getAtomIds().begin());
     int pullTagId = pullerManager->PullerForMatcherExists(atomTagId) ? atomTagId : -1;
 
+    const bool useDiff = metric.has_use_diff() ? metric.use_diff() : pullTagId != -1;
+    if (metric.roll_up_overflow_dimensions() && useDiff) {
+        ALOGE("ValueMetric %lld cannot roll up overflow dimensions when using diff",
+              (long long)metric.id());
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_VALUE_METRIC_ROLL_UP_OVERFLOW_WITH_DIFF, metric.id());
+        return nullopt;
+    }
+
     int conditionIndex = -1;
     if (metric.has_condition()) {
         invalidConfigReason = handleMetricWithConditions(
@@ -1022,7 +1082,8 @@ optional<sp<MetricProducer>> createNumericValueMetricProducerAndUpdateMetadata(
              matcherWizard, metric.dimensions_in_what(), fieldMatchers},
             {conditionIndex, metric.links(), initialConditionCache, wizard},
             {metric.state_link(), slicedStateAtoms, stateGroupMap},
-            {eventActivationMap, eventDeactivationMap}, {dimensionSoftLimit, dimensionHardLimit});
+            {eventActivationMap, eventDeactivationMap},
+            {dimensionSoftLimit, dimensionHardLimit, metric.roll_up_overflow_dimensions()});
 
     SamplingInfo samplingInfo;
     if (metric.has_dimensional_sampling_info()) {
@@ -1175,7 +1236,8 @@ optional<sp<MetricProducer>> createKllMetricProducerAndUpdateMetadata(
              matcherWizard, metric.dimensions_in_what(), fieldMatchers},
             {conditionIndex, metric.links(), initialConditionCache, wizard},
             {metric.state_link(), slicedStateAtoms, stateGroupMap},
-            {eventActivationMap, eventDeactivationMap}, {dimensionSoftLimit, dimensionHardLimit});
+            {eventActivationMap, eventDeactivationMap},
+            {dimensionSoftLimit, dimensionHardLimit, /*rollUpOverflowDimensions=*/false});
 
     SamplingInfo samplingInfo;
     if (metric.has_dimensional_sampling_info()) {
@@ -1342,6 +1404,274 @@ optional<sp<MetricProducer>> createGaugeMetricProducerAndUpdateMetadata(
     return metricProducer;
 }
 
+optional<sp<MetricProducer>> createTopKMetricProducerAndUpdateMetadata(
+        const ConfigKey& key, const StatsdConfig& config, const int64_t timeBaseNs,
+        const int64_t currentTimeNs, const TopKMetric& metric, const int metricIndex,
+        const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+        const unordered_map<int64_t, int>& atomMatchingTrackerMap,
+        vector<sp<ConditionTracker>>& allConditionTrackers,
+        const unordered_map<int64_t, int>& conditionTrackerMap,
+        const vector<ConditionState>& initialConditionCache, const sp<ConditionWizard>& wizard,
+        const unordered_map<int64_t, int>& metricToActivationMap,
+        unordered_map<int, vector<int>>& trackerToMetricMap,
+        unordered_map<int, vector<int>>& conditionToMetricMap,
+        unordered_map<int, vector<int>>& activationAtomTrackerToMetricMap,
+        unordered_map<int, vector<int>>& deactivationAtomTrackerToMetricMap,
+        vector<int>& metricsWithActivation, optional<InvalidConfigReason>& invalidConfigReason) {
+    if (!metric.has_id() || !metric.has_what()) {
+        ALOGE("cannot find metric id or \"what\" in TopKMetric \"%lld\"", (long long)metric.id());
+        invalidConfigReason =
+                InvalidConfigReason(INVALID_CONFIG_REASON_METRIC_MISSING_ID_OR_WHAT, metric.id());
+        return nullopt;
+    }
+    if (!metric.has_dimensions_in_what()) {
+        ALOGE("cannot find \"dimensions_in_what\" in TopKMetric \"%lld\"",
+              (long long)metric.id());
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_TOP_K_METRIC_MISSING_DIMENSIONS, metric.id());
+        return nullopt;
+    }
+    if (metric.k() <= 0 || metric.k() > StatsdStats::kDimensionKeySizeHardLimitMax) {
+        ALOGE("invalid k %d in TopKMetric \"%lld\"", metric.k(), (long long)metric.id());
+        invalidConfigReason =
+                InvalidConfigReason(INVALID_CONFIG_REASON_TOP_K_METRIC_INVALID_K, metric.id());
+        return nullopt;
+    }
+    if (metric.has_num_counters() &&
+        (metric.num_counters() < metric.k() ||
+         metric.num_counters() > StatsdStats::kDimensionKeySizeHardLimitMax)) {
+        ALOGE("invalid num_counters %d in TopKMetric \"%lld\"", metric.num_counters(),
+              (long long)metric.id());
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_TOP_K_METRIC_INVALID_NUM_COUNTERS, metric.id());
+        return nullopt;
+    }
+    if (metric.has_value_field()) {
+        std::vector<Matcher> valueFields;
+        translateFieldMatcher(metric.value_field(), &valueFields);
+        if (valueFields.size() != 1 || HasPositionALL(metric.value_field())) {
+            ALOGE("incorrect \"value_field\" in TopKMetric \"%lld\"", (long long)metric.id());
+            invalidConfigReason = InvalidConfigReason(
+                    INVALID_CONFIG_REASON_TOP_K_METRIC_HAS_INCORRECT_VALUE_FIELD, metric.id());
+            return nullopt;
+        }
+    }
+
+    int trackerIndex;
+    invalidConfigReason = handleMetricWithAtomMatchingTrackers(
+            metric.what(), metric.id(), metricIndex, metric.has_dimensions_in_what(),
+            allAtomMatchingTrackers, atomMatchingTrackerMap, trackerToMetricMap, trackerIndex);
+    if (invalidConfigReason.has_value()) {
+        return nullopt;
+    }
+
+    int conditionIndex = -1;
+    if (metric.has_condition()) {
+        invalidConfigReason = handleMetricWithConditions(
+                metric.condition(), metric.id(), metricIndex, conditionTrackerMap, metric.links(),
+                allConditionTrackers, conditionIndex, conditionToMetricMap);
+        if (invalidConfigReason.has_value()) {
+            return nullopt;
+        }
+    } else if (metric.links_size() > 0) {
+        ALOGW("metrics has a MetricConditionLink but doesn't have a condition");
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_METRIC_CONDITIONLINK_NO_CONDITION, metric.id());
+        return nullopt;
+    }
+
+    unordered_map<int, shared_ptr<Activation>> eventActivationMap;
+    unordered_map<int, vector<shared_ptr<Activation>>> eventDeactivationMap;
+    invalidConfigReason = handleMetricActivation(
+            config, metric.id(), metricIndex, metricToActivationMap, atomMatchingTrackerMap,
+            activationAtomTrackerToMetricMap, deactivationAtomTrackerToMetricMap,
+            metricsWithActivation, eventActivationMap, eventDeactivationMap);
+    if (invalidConfigReason.has_value()) {
+        return nullopt;
+    }
+
+    uint64_t metricHash;
+    invalidConfigReason =
+            getMetricProtoHash(config, metric, metric.id(), metricToActivationMap, metricHash);
+    if (invalidConfigReason.has_value()) {
+        return nullopt;
+    }
+
+    sp<MetricProducer> metricProducer =
+            new TopKMetricProducer(key, metric, conditionIndex, initialConditionCache, wizard,
+                                   metricHash, timeBaseNs, currentTimeNs, eventActivationMap,
+                                   eventDeactivationMap);
+    return metricProducer;
+}
+
+optional<sp<MetricProducer>> createDistinctCountMetricProducerAndUpdateMetadata(
+        const ConfigKey& key, const StatsdConfig& config, const int64_t timeBaseNs,
+        const int64_t currentTimeNs, const sp<StatsPullerManager>& pullerManager,
+        const DistinctCountMetric& metric, const int metricIndex,
+        const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+        const unordered_map<int64_t, int>& atomMatchingTrackerMap,
+        vector<sp<ConditionTracker>>& allConditionTrackers,
+        const unordered_map<int64_t, int>& conditionTrackerMap,
+        const vector<ConditionState>& initialConditionCache, const sp<ConditionWizard>& wizard,
+        const sp<EventMatcherWizard>& matcherWizard,
+        const unordered_map<int64_t, int>& stateAtomIdMap,
+        const unordered_map<int64_t, unordered_map<int, int64_t>>& allStateGroupMaps,
+        const unordered_map<int64_t, int>& metricToActivationMap,
+        unordered_map<int, vector<int>>& trackerToMetricMap,
+        unordered_map<int, vector<int>>& conditionToMetricMap,
+        unordered_map<int, vector<int>>& activationAtomTrackerToMetricMap,
+        unordered_map<int, vector<int>>& deactivationAtomTrackerToMetricMap,
+        vector<int>& metricsWithActivation, optional<InvalidConfigReason>& invalidConfigReason) {
+    if (!metric.has_id() || !metric.has_what()) {
+        ALOGE("cannot find metric id or \"what\" in DistinctCountMetric \"%lld\"",
+              (long long)metric.id());
+        invalidConfigReason =
+                InvalidConfigReason(INVALID_CONFIG_REASON_METRIC_MISSING_ID_OR_WHAT, metric.id());
+        return nullopt;
+    }
+    if (!metric.has_distinct_field()) {
+        ALOGE("cannot find \"distinct_field\" in DistinctCountMetric \"%lld\"",
+              (long long)metric.id());
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_DISTINCT_COUNT_METRIC_MISSING_DISTINCT_FIELD, metric.id());
+        return nullopt;
+    }
+    if (HasPositionALL(metric.distinct_field())) {
+        ALOGE("distinct field with position ALL is not supported. DistinctCountMetric \"%lld\"",
+              (long long)metric.id());
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_DISTINCT_COUNT_METRIC_DISTINCT_FIELD_HAS_POSITION_ALL,
+                metric.id());
+        return nullopt;
+    }
+    std::vector<Matcher> fieldMatchers;
+    translateFieldMatcher(metric.distinct_field(), &fieldMatchers);
+    if (fieldMatchers.empty()) {
+        ALOGE("incorrect \"distinct_field\" in DistinctCountMetric \"%lld\"",
+              (long long)metric.id());
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_DISTINCT_COUNT_METRIC_HAS_INCORRECT_DISTINCT_FIELD,
+                metric.id());
+        return nullopt;
+    }
+    if (metric.precision() < HyperLogLog::kMinPrecision ||
+        metric.precision() > HyperLogLog::kMaxPrecision) {
+        ALOGE("invalid precision %d in DistinctCountMetric \"%lld\"", metric.precision(),
+              (long long)metric.id());
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_DISTINCT_COUNT_METRIC_INVALID_PRECISION, metric.id());
+        return nullopt;
+    }
+
+    int trackerIndex;
+    invalidConfigReason = handleMetricWithAtomMatchingTrackers(
+            metric.what(), metric.id(), metricIndex,
+            /*enforceOneAtom=*/true, allAtomMatchingTrackers, atomMatchingTrackerMap,
+            trackerToMetricMap, trackerIndex);
+    if (invalidConfigReason.has_value()) {
+        return nullopt;
+    }
+
+    int conditionIndex = -1;
+    if (metric.has_condition()) {
+        invalidConfigReason = handleMetricWithConditions(
+                metric.condition(), metric.id(), metricIndex, conditionTrackerMap, metric.links(),
+                allConditionTrackers, conditionIndex, conditionToMetricMap);
+        if (invalidConfigReason.has_value()) {
+            return nullopt;
+        }
+    } else if (metric.links_size() > 0) {
+        ALOGE("metrics has a MetricConditionLink but doesn't have a condition");
+        invalidConfigReason = InvalidConfigReason(
+                INVALID_CONFIG_REASON_METRIC_CONDITIONLINK_NO_CONDITION, metric.id());
+        return nullopt;
+    }
+
+    std::vector<int> slicedStateAtoms;
+    unordered_map<int, unordered_map<int, int64_t>> stateGroupMap;
+    if (metric.slice_by_state_size() > 0) {
+        invalidConfigReason =
+                handleMetricWithStates(config, metric.id(), metric.slice_by_state(), stateAtomIdMap,
+                                       allStateGroupMaps, slicedStateAtoms, stateGroupMap);
+        if (invalidConfigReason.has_value()) {
+            return nullopt;
+        }
+    } else if (metric.state_link_size() > 0) {
+        ALOGE("DistinctCountMetric has a MetricStateLink but doesn't have a sliced state");
+        invalidConfigReason =
+                InvalidConfigReason(INVALID_CONFIG_REASON_METRIC_STATELINK_NO_STATE, metric.id());
+        return nullopt;
+    }
+
+    // Check that all metric state links are a subset of dimensions_in_what fields.
+    std::vector<Matcher> dimensionsInWhat;
+    translateFieldMatcher(metric.dimensions_in_what(), &dimensionsInWhat);
+    for (const auto& stateLink : metric.state_link()) {
+        invalidConfigReason = handleMetricWithStateLink(metric.id(), stateLink.fields_in_what(),
+                                                        dimensionsInWhat);
+        if (invalidConfigReason.has_value()) {
+            ALOGW("DistinctCountMetric's MetricStateLinks must be a subset of the dimensions in "
+                  "what");
+            return nullopt;
+        }
+    }
+
+    unordered_map<int, shared_ptr<Activation>> eventActivationMap;
+    unordered_map<int, vector<shared_ptr<Activation>>> eventDeactivationMap;
+    invalidConfigReason = handleMetricActivation(
+            config, metric.id(), metricIndex, metricToActivationMap, atomMatchingTrackerMap,
+            activationAtomTrackerToMetricMap, deactivationAtomTrackerToMetricMap,
+            metricsWithActivation, eventActivationMap, eventDeactivationMap);
+    if (invalidConfigReason.has_value()) {
+        return nullopt;
+    }
+
+    uint64_t metricHash;
+    invalidConfigReason =
+            getMetricProtoHash(config, metric, metric.id(), metricToActivationMap, metricHash);
+    if (invalidConfigReason.has_value()) {
+        return nullopt;
+    }
+
+    const TimeUnit bucketSizeTimeUnit =
+            metric.bucket() == TIME_UNIT_UNSPECIFIED ? ONE_HOUR : metric.bucket();
+    const int64_t bucketSizeNs =
+            MillisToNano(TimeUnitToBucketSizeInMillisGuardrailed(key.GetUid(), bucketSizeTimeUnit));
+
+    const bool containsAnyPositionInDimensionsInWhat = HasPositionANY(metric.dimensions_in_what());
+    const bool shouldUseNestedDimensions = ShouldUseNestedDimensions(metric.dimensions_in_what());
+
+    const sp<AtomMatchingTracker>& atomMatcher = allAtomMatchingTrackers.at(trackerIndex);
+    const int atomTagId = *(atomMatcher->getAtomIds().begin());
+    const auto [dimensionSoftLimit, dimensionHardLimit] =
+            StatsdStats::getAtomDimensionKeySizeLimits(
+                    atomTagId,
+                    StatsdStats::clampDimensionKeySizeLimit(metric.max_dimensions_per_bucket()));
+
+    sp<MetricProducer> metricProducer = new DistinctCountMetricProducer(
+            key, metric, metricHash, {/*pullTagId=*/-1, pullerManager},
+            {timeBaseNs, currentTimeNs, bucketSizeNs, metric.min_bucket_size_nanos(),
+             /*conditionCorrectionThresholdNs=*/nullopt, getAppUpgradeBucketSplit(metric)},
+            {containsAnyPositionInDimensionsInWhat, shouldUseNestedDimensions, trackerIndex,
+             matcherWizard, metric.dimensions_in_what(), fieldMatchers},
+            {conditionIndex, metric.links(), initialConditionCache, wizard},
+            {metric.state_link(), slicedStateAtoms, stateGroupMap},
+            {eventActivationMap, eventDeactivationMap},
+            {dimensionSoftLimit, dimensionHardLimit, /*rollUpOverflowDimensions=*/false});
+
+    SamplingInfo samplingInfo;
+    if (metric.has_dimensional_sampling_info()) {
+        invalidConfigReason = handleMetricWithDimensionalSampling(
+                metric.id(), metric.dimensional_sampling_info(), dimensionsInWhat, samplingInfo);
+        if (invalidConfigReason.has_value()) {
+            return nullopt;
+        }
+        metricProducer->setSamplingInfo(samplingInfo);
+    }
+
+    return metricProducer;
+}
+
 optional<sp<AnomalyTracker>> createAnomalyTracker(
         const Alert& alert, const sp<AlarmMonitor>& anomalyAlarmMonitor,
         const UpdateStatus& updateStatus, const int64_t currentTimeNs,
@@ -1533,12 +1863,13 @@ optional<InvalidConfigReason> initMetrics(
         std::set<int64_t>& noReportMetricIds,
         unordered_map<int, vector<int>>& activationAtomTrackerToMetricMap,
         unordered_map<int, vector<int>>& deactivationAtomTrackerToMetricMap,
-        vector<int>& metricsWithActivation) {
+        vector<int>& metricsWithActivation, const bool registerStateListeners) {
     sp<ConditionWizard> wizard = new ConditionWizard(allConditionTrackers);
     sp<EventMatcherWizard> matcherWizard = new EventMatcherWizard(allAtomMatchingTrackers);
     const int allMetricsCount = config.count_metric_size() + config.duration_metric_size() +
                                 config.event_metric_size() + config.gauge_metric_size() +
-                                config.value_metric_size() + config.kll_metric_size();
+                                config.value_metric_size() + config.kll_metric_size() +
+                                config.top_k_metric_size() + config.distinct_count_metric_size();
     allMetricProducers.reserve(allMetricsCount);
     optional<InvalidConfigReason> invalidConfigReason;
 
@@ -1670,6 +2001,41 @@ optional<InvalidConfigReason> initMetrics(
         }
         allMetricProducers.push_back(producer.value());
     }
+
+    // build TopKMetricProducer
+    for (int i = 0; i < config.top_k_metric_size(); i++) {
+        int metricIndex = allMetricProducers.size();
+        const TopKMetric& metric = config.top_k_metric(i);
+        metricMap.insert({metric.id(), metricIndex});
+        optional<sp<MetricProducer>> producer = createTopKMetricProducerAndUpdateMetadata(
+                key, config, timeBaseTimeNs, currentTimeNs, metric, metricIndex,
+                allAtomMatchingTrackers, atomMatchingTrackerMap, allConditionTrackers,
+                conditionTrackerMap, initialConditionCache, wizard, metricToActivationMap,
+                trackerToMetricMap, conditionToMetricMap, activationAtomTrackerToMetricMap,
+                deactivationAtomTrackerToMetricMap, metricsWithActivation, invalidConfigReason);
+        if (!producer) {
+            return invalidConfigReason;
+        }
+        allMetricProducers.push_back(producer.value());
+    }
+
+    // build DistinctCountMetricProducer
+    for (int i = 0; i < config.distinct_count_metric_size(); i++) {
+        int metricIndex = allMetricProducers.size();
+        const DistinctCountMetric& metric = config.distinct_count_metric(i);
+        metricMap.insert({metric.id(), metricIndex});
+        optional<sp<MetricProducer>> producer = createDistinctCountMetricProducerAndUpdateMetadata(
+                key, config, timeBaseTimeNs, currentTimeNs, pullerManager, metric, metricIndex,
+                allAtomMatchingTrackers, atomMatchingTrackerMap, allConditionTrackers,
+                conditionTrackerMap, initialConditionCache, wizard, matcherWizard, stateAtomIdMap,
+                allStateGroupMaps, metricToActivationMap, trackerToMetricMap, conditionToMetricMap,
+                activationAtomTrackerToMetricMap, deactivationAtomTrackerToMetricMap,
+                metricsWithActivation, invalidConfigReason);
+        if (!producer) {
+            return invalidConfigReason;
+        }
+        allMetricProducers.push_back(producer.value());
+    }
     for (int i = 0; i < config.no_report_metric_size(); ++i) {
         const auto no_report_metric = config.no_report_metric(i);
         if (metricMap.find(no_report_metric) == metricMap.end()) {
@@ -1688,7 +2054,9 @@ optional<InvalidConfigReason> initMetrics(
             // Register listener for non-whitelisted atoms only. Using whitelisted atom as a sliced
             // state atom is not allowed.
             if (whitelistedAtomIds.find(atomId) == whitelistedAtomIds.end()) {
-                StateManager::getInstance().registerListener(atomId, it);
+                if (registerStateListeners) {
+                    StateManager::getInstance().registerListener(atomId, it);
+                }
             } else {
                 return InvalidConfigReason(
                         INVALID_CONFIG_REASON_METRIC_SLICED_STATE_ATOM_ALLOWED_FROM_ANY_UID,
@@ -1768,7 +2136,8 @@ optional<InvalidConfigReason> initStatsdConfig(
         unordered_map<int, std::vector<int>>& activationAtomTrackerToMetricMap,
         unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
         unordered_map<int64_t, int>& alertTrackerMap, vector<int>& metricsWithActivation,
-        map<int64_t, uint64_t>& stateProtoHashes, set<int64_t>& noReportMetricIds) {
+        map<int64_t, uint64_t>& stateProtoHashes, set<int64_t>& noReportMetricIds,
+        const bool registerStateListeners) {
     vector<ConditionState> initialConditionCache;
     unordered_map<int64_t, int> stateAtomIdMap;
     unordered_map<int64_t, unordered_map<int, int64_t>> allStateGroupMaps;
@@ -1808,7 +2177,7 @@ optional<InvalidConfigReason> initStatsdConfig(
             allConditionTrackers, initialConditionCache, allMetricProducers, conditionToMetricMap,
             trackerToMetricMap, metricProducerMap, noReportMetricIds,
             activationAtomTrackerToMetricMap, deactivationAtomTrackerToMetricMap,
-            metricsWithActivation);
+            metricsWithActivation, registerStateListeners);
     if (invalidConfigReason.has_value()) {
         ALOGE("initMetricProducers failed");
         return invalidConfigReason;
@@ -1828,6 +2197,14 @@ optional<InvalidConfigReason> initStatsdConfig(
         return invalidConfigReason;
     }
 
+    invalidConfigReason = checkConfigCostCeilings(
+            config, allTagIdsToMatchersMap, allAtomMatchingTrackers, atomMatchingTrackerMap,
+            trackerToConditionMap, trackerToMetricMap, conditionToMetricMap);
+    if (invalidConfigReason.has_value()) {
+        ALOGE("checkConfigCostCeilings failed");
+        return invalidConfigReason;
+    }
+
     return nullopt;
 }
 
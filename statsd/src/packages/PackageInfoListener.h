@@ -19,6 +19,7 @@
 
 #include <utils/RefBase.h>
 
+#include <set>
 #include <string>
 
 namespace android {
@@ -35,8 +36,11 @@ public:
     // Notify interested listeners that the given apk and uid combination no longer exits.
     virtual void notifyAppRemoved(int64_t eventTimeNs, const std::string& apk, const int uid) = 0;
 
-    // Notify the listener that the UidMap snapshot is available.
-    virtual void onUidMapReceived(int64_t eventTimeNs) = 0;
+    // Notify the listener that the UidMap snapshot is available. changedPackages holds the packages
+    // that were installed, removed or had their version changed by the snapshot. The listener is
+    // not notified if the snapshot did not change anything.
+    virtual void onUidMapReceived(int64_t eventTimeNs,
+                                  const std::set<std::string>& changedPackages) = 0;
 };
 
 }  // namespace statsd
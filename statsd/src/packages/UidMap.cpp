@@ -23,6 +23,8 @@
 
 #include <inttypes.h>
 
+#include <unordered_set>
+
 using namespace android;
 
 using android::util::FIELD_COUNT_REPEATED;
@@ -120,44 +122,83 @@ int64_t UidMap::getAppVersion(int uid, const string& packageName) const {
 
 void UidMap::updateMap(const int64_t timestamp, const UidData& uidData) {
     wp<PackageInfoListener> broadcast = NULL;
+    std::set<string> changedPackages;
     {
         lock_guard<mutex> lock(mMutex);  // Exclusively lock for updates.
 
-        std::unordered_map<std::pair<int, string>, AppData, PairHash> deletedApps;
-
-        // Copy all the deleted apps.
-        for (const auto& kv : mMap) {
-            if (kv.second.deleted) {
-                deletedApps[kv.first] = kv.second;
-            }
-        }
+        // Changes are only recorded when refreshing a previously received map. The first map is
+        // reported in full by the next snapshot.
+        const bool recordChanges = !mMap.empty();
 
-        mMap.clear();
+        // Apply the difference between the current map and the new one instead of rebuilding it,
+        // so that a refresh with few changes does not copy every entry.
+        std::unordered_set<std::pair<int, string>, PairHash> seenApps;
+        seenApps.reserve(uidData.app_info_size());
         for (const auto& appInfo : uidData.app_info()) {
-            mMap[std::make_pair(appInfo.uid(), appInfo.package_name())] =
-                    AppData(appInfo.version(), appInfo.version_string(), appInfo.installer(),
-                            appInfo.certificate_hash());
+            auto key = std::make_pair(appInfo.uid(), appInfo.package_name());
+            auto it = mMap.find(key);
+            if (it == mMap.end()) {
+                mMap.emplace(key, AppData(appInfo.version(), appInfo.version_string(),
+                                          appInfo.installer(), appInfo.certificate_hash()));
+                changedPackages.insert(appInfo.package_name());
+                if (recordChanges) {
+                    mChanges.emplace_back(false, timestamp, appInfo.package_name(), appInfo.uid(),
+                                          appInfo.version(), appInfo.version_string(), 0, "");
+                    mBytesUsed += kBytesChangeRecord;
+                }
+            } else if (!it->second.deleted) {
+                // Deleted apps keep their data until they are updated through updateApp.
+                AppData& appData = it->second;
+                if (appData.versionCode != appInfo.version() ||
+                    appData.versionString != appInfo.version_string()) {
+                    changedPackages.insert(appInfo.package_name());
+                    if (recordChanges) {
+                        mChanges.emplace_back(false, timestamp, appInfo.package_name(),
+                                              appInfo.uid(), appInfo.version(),
+                                              appInfo.version_string(), appData.versionCode,
+                                              appData.versionString);
+                        mBytesUsed += kBytesChangeRecord;
+                    }
+                    appData.versionCode = appInfo.version();
+                    appData.versionString = appInfo.version_string();
+                }
+                appData.installer = appInfo.installer();
+                appData.certificateHash = appInfo.certificate_hash();
+            }
+            seenApps.insert(std::move(key));
         }
 
-        for (const auto& kv : deletedApps) {
-            auto mMapIt = mMap.find(kv.first);
-            if (mMapIt != mMap.end()) {
-                // Insert this deleted app back into the current map.
-                mMap[kv.first] = kv.second;
+        for (auto it = mMap.begin(); it != mMap.end();) {
+            if (seenApps.find(it->first) != seenApps.end()) {
+                ++it;
+                continue;
+            }
+            if (!it->second.deleted) {
+                changedPackages.insert(it->first.second);
+                if (recordChanges) {
+                    mChanges.emplace_back(true, timestamp, it->first.second, it->first.first, 0,
+                                          "", it->second.versionCode, it->second.versionString);
+                    mBytesUsed += kBytesChangeRecord;
+                }
             }
+            it = mMap.erase(it);
         }
 
         ensureBytesUsedBelowLimit();
         StatsdStats::getInstance().setCurrentUidMapMemory(mBytesUsed);
+        StatsdStats::getInstance().setUidMapChanges(mChanges.size());
         broadcast = mSubscriber;
     }
+    if (changedPackages.empty()) {
+        return;
+    }
     // To avoid invoking callback while holding the internal lock. we get a copy of the listener
     // and invoke the callback. It's still possible that after we copy the listener, it removes
     // itself before we call it. It's then the listener's job to handle it (expect the callback to
     // be called after listener is removed, and the listener should properly ignore it).
     auto strongPtr = broadcast.promote();
     if (strongPtr != nullptr) {
-        strongPtr->onUidMapReceived(timestamp);
+        strongPtr->onUidMapReceived(timestamp, changedPackages);
     }
 }
 
@@ -229,6 +229,7 @@ private:
     FRIEND_TEST(UidMapTest, TestOutputIncludesAtLeastOneSnapshot);
     FRIEND_TEST(UidMapTest, TestMemoryComputed);
     FRIEND_TEST(UidMapTest, TestMemoryGuardrail);
+    FRIEND_TEST(UidMapTest, TestUpdateMapAppliesDiff);
 };
 
 }  // namespace statsd
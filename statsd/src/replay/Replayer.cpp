@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "replay/Replayer.h"
+
+#include <aidl/android/os/BnPullAtomCallback.h>
+#include <aidl/android/os/IPullAtomResultReceiver.h>
+#include <aidl/android/util/StatsEventParcel.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "StatsLogProcessor.h"
+#include "anomaly/AlarmMonitor.h"
+#include "external/StatsPullerManager.h"
+#include "guardrail/StatsdStats.h"
+#include "packages/UidMap.h"
+#include "socket/LogEventFilter.h"
+#include "stats_log_util.h"
+#include "utils/Clock.h"
+#include "utils/ShardOffsetProvider.h"
+
+using aidl::android::os::BnPullAtomCallback;
+using aidl::android::os::IPullAtomResultReceiver;
+using aidl::android::util::StatsEventParcel;
+using Status = ::ndk::ScopedAStatus;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::make_shared;
+using std::map;
+using std::pair;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::unordered_set;
+using std::vector;
+
+namespace {
+
+int64_t hostNanosSince(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                start)
+            .count();
+}
+
+// Serves the pull fixture of one atom and puller uid. The records are sorted by receive time.
+class FixturePullAtomCallback : public BnPullAtomCallback {
+public:
+    explicit FixturePullAtomCallback(vector<const AtomRecord*> records)
+        : mRecords(std::move(records)) {
+    }
+
+    Status onPullAtom(int atomTag,
+                      const shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        const auto byReceiveTime = [](int64_t timeNs, const AtomRecord* record) {
+            return timeNs < record->receiveElapsedNs;
+        };
+        const auto end = std::upper_bound(mRecords.begin(), mRecords.end(),
+                                          getElapsedRealtimeNs(), byReceiveTime);
+        vector<StatsEventParcel> parcels;
+        if (end != mRecords.begin()) {
+            const int64_t sampleTimeNs = (*(end - 1))->receiveElapsedNs;
+            auto it = std::upper_bound(mRecords.begin(), end, sampleTimeNs - 1, byReceiveTime);
+            for (; it != end; ++it) {
+                StatsEventParcel parcel;
+                parcel.buffer = (*it)->payload;
+                parcels.push_back(std::move(parcel));
+            }
+        }
+        resultReceiver->pullFinished(atomTag, /*success=*/true, parcels);
+        return Status::ok();
+    }
+
+private:
+    const vector<const AtomRecord*> mRecords;
+};
+
+// State of the replay of one config.
+class ReplaySession {
+public:
+    ReplaySession(const ReplayOptions& options, const ConfigKey& key, int64_t startNs,
+                  ReplayResult* result)
+        : mKey(key),
+          mClock(make_shared<SimulatedClock>(startNs, options.startWallClockNs)),
+          mPullerManager(new StatsPullerManager()),
+          mPeriodicAlarmMonitor(new AlarmMonitor(
+                  /*minDiffToUpdateRegisteredAlarmTimeSec=*/1,
+                  [](const shared_ptr<IStatsCompanionService>&, int64_t) {},
+                  [](const shared_ptr<IStatsCompanionService>&) {})),
+          mResult(result) {
+        Clock::set(mClock);
+
+        sp<UidMap> uidMap = new UidMap();
+        if (options.uidData) {
+            uidMap->updateMap(startNs, *options.uidData);
+        }
+        registerPullFixtures(options.pullFixtures);
+
+        sp<AlarmMonitor> anomalyAlarmMonitor =
+                new AlarmMonitor(/*minDiffToUpdateRegisteredAlarmTimeSec=*/1,
+                                 [](const shared_ptr<IStatsCompanionService>&, int64_t) {},
+                                 [](const shared_ptr<IStatsCompanionService>&) {});
+        mProcessor = new StatsLogProcessor(
+                uidMap, mPullerManager, anomalyAlarmMonitor, mPeriodicAlarmMonitor, startNs,
+                [](const ConfigKey&) { return true; },
+                [](const int&, const vector<int64_t>&) { return true; },
+                [](const ConfigKey&, const string&, const vector<int64_t>&) {},
+                make_shared<LogEventFilter>());
+    }
+
+    ~ReplaySession() {
+        Clock::set(nullptr);
+    }
+
+    void updateConfig(const StatsdConfig& config) {
+        mProcessor->OnConfigUpdated(mClock->getElapsedRealtimeNs(), mClock->getWallClockNs(), mKey,
+                                    config);
+    }
+
+    void onAtom(const AtomRecord& record) {
+        advanceTo(record.receiveElapsedNs);
+
+        unique_ptr<LogEvent> event = record.toLogEvent();
+        if (event == nullptr) {
+            mResult->numInvalidEvents++;
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        mProcessor->OnLogEvent(event.get());
+        const int64_t durationNs = hostNanosSince(start);
+
+        mResult->numEvents++;
+        mResult->onLogEventNs += durationNs;
+        AtomReplayStats& atomStats = mResult->atomStats[event->GetTagId()];
+        atomStats.count++;
+        atomStats.onLogEventNs += durationNs;
+    }
+
+    void dumpReport() {
+        mResult->metricsBytes = mProcessor->GetMetricsSize(mKey);
+        mResult->maxMetricsBytes = std::max(mResult->maxMetricsBytes, mResult->metricsBytes);
+
+        const auto start = std::chrono::steady_clock::now();
+        mProcessor->onDumpReport(mKey, mClock->getElapsedRealtimeNs(), mClock->getWallClockNs(),
+                                 /*include_current_partial_bucket=*/true, /*erase_data=*/true,
+                                 ADB_DUMP, NO_TIME_CONSTRAINTS, &mResult->report);
+        mResult->dumpReportNs = hostNanosSince(start);
+    }
+
+private:
+    void registerPullFixtures(const vector<AtomRecord>& pullFixtures) {
+        map<pair<int32_t, int32_t>, vector<const AtomRecord*>> recordsByAtomAndUid;
+        for (const AtomRecord& record : pullFixtures) {
+            recordsByAtomAndUid[{record.atomId, record.uid}].push_back(&record);
+        }
+        for (auto& [atomAndUid, records] : recordsByAtomAndUid) {
+            std::stable_sort(records.begin(), records.end(),
+                             [](const AtomRecord* lhs, const AtomRecord* rhs) {
+                                 return lhs->receiveElapsedNs < rhs->receiveElapsedNs;
+                             });
+            mPullerManager->RegisterPullAtomCallback(
+                    atomAndUid.second, atomAndUid.first, /*coolDownNs=*/NS_PER_SEC,
+                    /*timeoutNs=*/10 * NS_PER_SEC, /*additiveFields=*/{},
+                    ndk::SharedRefBase::make<FixturePullAtomCallback>(std::move(records)));
+        }
+    }
+
+    // Moves the clock to timeNs, firing the pull and periodic alarms that are due on the way.
+    // The clock never goes backwards: atoms received out of order are processed at the current
+    // time, like statsd would.
+    void advanceTo(int64_t timeNs) {
+        bool alarmFired = false;
+        const auto start = std::chrono::steady_clock::now();
+
+        int64_t nextPullTimeNs = mPullerManager->getNextPullTimeNs();
+        while (nextPullTimeNs <= timeNs) {
+            setTime(nextPullTimeNs);
+            mProcessor->informPullAlarmFired(mClock->getElapsedRealtimeNs());
+            mResult->numPullAlarms++;
+            alarmFired = true;
+
+            const int64_t previousPullTimeNs = nextPullTimeNs;
+            nextPullTimeNs = mPullerManager->getNextPullTimeNs();
+            if (nextPullTimeNs <= previousPullTimeNs) {
+                break;
+            }
+        }
+        setTime(timeNs);
+
+        const int64_t nowSec = NanoToSeconds(mClock->getElapsedRealtimeNs());
+        unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> alarmSet =
+                mPeriodicAlarmMonitor->popSoonerThan(static_cast<uint32_t>(nowSec));
+        if (!alarmSet.empty()) {
+            mProcessor->onPeriodicAlarmFired(nowSec * NS_PER_SEC, alarmSet);
+            mResult->numPeriodicAlarms++;
+            alarmFired = true;
+        }
+
+        if (alarmFired) {
+            mResult->alarmNs += hostNanosSince(start);
+            mResult->maxMetricsBytes =
+                    std::max(mResult->maxMetricsBytes, mProcessor->GetMetricsSize(mKey));
+        }
+    }
+
+    void setTime(int64_t timeNs) {
+        const int64_t nowNs = mClock->getElapsedRealtimeNs();
+        if (timeNs > nowNs) {
+            mClock->advance(timeNs - nowNs);
+        }
+    }
+
+    const ConfigKey mKey;
+
+    const shared_ptr<SimulatedClock> mClock;
+
+    const sp<StatsPullerManager> mPullerManager;
+
+    const sp<AlarmMonitor> mPeriodicAlarmMonitor;
+
+    sp<StatsLogProcessor> mProcessor;
+
+    ReplayResult* const mResult;
+};
+
+}  // anonymous namespace
+
+Replayer::Replayer(ReplayOptions options) : mOptions(std::move(options)) {
+    // StatsdStats draws its id from rand() when it is first used and keeps it for the rest of the
+    // process. Creating it right after seeding ties the id in the reports to the seed, as long as
+    // nothing used StatsdStats before the Replayer was created.
+    srand(mOptions.seed);
+    StatsdStats::getInstance();
+}
+
+ReplayResult Replayer::replay(const ConfigKey& key, const StatsdConfig& config) const {
+    // Reseed for every config so that its report does not depend on the configs replayed before.
+    // The shard offset is drawn once per process, so it is pinned to the seed as well.
+    srand(mOptions.seed);
+    ShardOffsetProvider::getInstance().setShardOffset(rand());
+
+    ReplayResult result;
+    result.key = key;
+    const int64_t startNs =
+            mOptions.atoms.empty() ? NS_PER_SEC : mOptions.atoms.front().receiveElapsedNs;
+
+    ReplaySession session(mOptions, key, startNs, &result);
+    session.updateConfig(config);
+    for (const AtomRecord& record : mOptions.atoms) {
+        session.onAtom(record);
+    }
+    session.dumpReport();
+    return result;
+}
+
+void printReplayResult(const ReplayResult& result, FILE* out) {
+    fprintf(out, "Config %s\n", result.key.ToString().c_str());
+    fprintf(out, "  events: %lld (%lld invalid)\n", (long long)result.numEvents,
+            (long long)result.numInvalidEvents);
+    fprintf(out, "  OnLogEvent: %lld us total, %lld ns per event\n",
+            (long long)(result.onLogEventNs / 1000),
+            (long long)(result.numEvents == 0 ? 0 : result.onLogEventNs / result.numEvents));
+    fprintf(out, "  alarms: %lld pull, %lld periodic, %lld us total\n",
+            (long long)result.numPullAlarms, (long long)result.numPeriodicAlarms,
+            (long long)(result.alarmNs / 1000));
+    fprintf(out, "  onDumpReport: %lld us, report %zu bytes\n",
+            (long long)(result.dumpReportNs / 1000), result.report.size());
+    fprintf(out, "  metrics memory: %zu bytes at the end, %zu bytes max\n", result.metricsBytes,
+            result.maxMetricsBytes);
+
+    // Most expensive atoms first.
+    vector<pair<int32_t, AtomReplayStats>> atomStats(result.atomStats.begin(),
+                                                     result.atomStats.end());
+    std::sort(atomStats.begin(), atomStats.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second.onLogEventNs > rhs.second.onLogEventNs;
+    });
+    for (const auto& [atomId, stats] : atomStats) {
+        fprintf(out, "    atom %d: %lld events, %lld us, %lld ns per event\n", atomId,
+                (long long)stats.count, (long long)(stats.onLogEventNs / 1000),
+                (long long)(stats.onLogEventNs / stats.count));
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <optional>
+#include <vector>
+
+#include "config/ConfigKey.h"
+#include "logd/AtomStream.h"
+#include "src/statsd_config.pb.h"
+#include "src/uid_data.pb.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+struct ReplayOptions {
+    // Atoms to feed to the configs, in the order statsd received them.
+    std::vector<AtomRecord> atoms;
+
+    // Atoms served to pulls. A pull of an atom at time t returns the records of that atom with the
+    // latest receive time that is not after t. The uid of a record is the uid of the puller.
+    std::vector<AtomRecord> pullFixtures;
+
+    // Installed packages, set on the UidMap before the replay starts.
+    std::optional<UidData> uidData;
+
+    // Wall clock at the receive time of the first atom. The recorded stream only has elapsed
+    // times, so the wall clock is made up to keep the reports reproducible.
+    int64_t startWallClockNs = 1700000000LL * 1000000000LL;
+
+    // Seed for the pseudo random numbers used by statsd (shard offsets, sampling).
+    uint32_t seed = 0;
+};
+
+struct AtomReplayStats {
+    int64_t count = 0;
+    int64_t onLogEventNs = 0;
+};
+
+struct ReplayResult {
+    ConfigKey key;
+
+    int64_t numEvents = 0;
+
+    // Records that could not be parsed into a LogEvent.
+    int64_t numInvalidEvents = 0;
+
+    int64_t numPullAlarms = 0;
+
+    int64_t numPeriodicAlarms = 0;
+
+    // Host time spent in StatsLogProcessor::OnLogEvent, in total and per atom id.
+    int64_t onLogEventNs = 0;
+    std::map<int32_t, AtomReplayStats> atomStats;
+
+    // Host time spent pulling and handling periodic alarms.
+    int64_t alarmNs = 0;
+
+    // Host time spent in StatsLogProcessor::onDumpReport.
+    int64_t dumpReportNs = 0;
+
+    // Bytes held by the metrics of the config right before the final report, and the largest
+    // value observed at an alarm.
+    size_t metricsBytes = 0;
+    size_t maxMetricsBytes = 0;
+
+    // Serialized ConfigMetricsReportList.
+    std::vector<uint8_t> report;
+};
+
+/**
+ * Feeds a recorded atom stream through a StatsLogProcessor on the host, to compare the reports
+ * and the cost of configs offline. Time is driven by a SimulatedClock that follows the receive
+ * times of the recorded atoms, so that buckets, pulls and alarms happen at the recorded times and
+ * the reports only depend on the inputs and the seed.
+ */
+class Replayer {
+public:
+    explicit Replayer(ReplayOptions options);
+
+    // Replays the whole stream against config in a fresh StatsLogProcessor and dumps a final
+    // report that includes the current partial buckets.
+    ReplayResult replay(const ConfigKey& key, const StatsdConfig& config) const;
+
+private:
+    const ReplayOptions mOptions;
+};
+
+// Prints the timing and memory breakdown of result to out.
+void printReplayResult(const ReplayResult& result, FILE* out);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a recorded atom stream through statsd on the host. For example:
+//
+//   statsd_replay --config battery.pb --config wakelocks.pb --atoms atoms.bin \
+//       --uid_map uid_map.pb --pull_fixture pulled.bin --seed 42 --out_dir /tmp/reports
+//
+// writes <out_dir>/report_<config uid>_<config id>.pb with the ConfigMetricsReportList of each
+// config and prints the timing and memory breakdown of each config to stdout.
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "replay/Replayer.h"
+
+using android::os::statsd::ConfigKey;
+using android::os::statsd::printReplayResult;
+using android::os::statsd::readAtomStreamFile;
+using android::os::statsd::Replayer;
+using android::os::statsd::ReplayOptions;
+using android::os::statsd::ReplayResult;
+using android::os::statsd::StatsdConfig;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Configs are keyed as if they were added with "adb shell cmd stats config update".
+const int kConfigUid = 2000;  // AID_SHELL
+
+void printUsage(const char* name) {
+    fprintf(stderr,
+            "Usage: %s --config <StatsdConfig> [--config ...] --atoms <atom stream>\n"
+            "          [--uid_map <UidData>] [--pull_fixture <atom stream>] [--seed <n>]\n"
+            "          [--wall_clock_ns <n>] --out_dir <dir>\n",
+            name);
+}
+
+bool readProto(const string& path, google::protobuf::MessageLite* proto) {
+    string content;
+    if (!android::base::ReadFileToString(path, &content)) {
+        fprintf(stderr, "Failed to read %s\n", path.c_str());
+        return false;
+    }
+    if (!proto->ParseFromString(content)) {
+        fprintf(stderr, "Failed to parse %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+}  // anonymous namespace
+
+int main(int argc, char** argv) {
+    vector<string> configPaths;
+    string atomsPath;
+    string uidMapPath;
+    string pullFixturePath;
+    string outDir;
+    ReplayOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const char* value = argv[++i];
+        if (arg == "--config") {
+            configPaths.push_back(value);
+        } else if (arg == "--atoms") {
+            atomsPath = value;
+        } else if (arg == "--uid_map") {
+            uidMapPath = value;
+        } else if (arg == "--pull_fixture") {
+            pullFixturePath = value;
+        } else if (arg == "--out_dir") {
+            outDir = value;
+        } else if (arg == "--seed") {
+            if (!android::base::ParseUint(value, &options.seed)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--wall_clock_ns") {
+            if (!android::base::ParseInt(value, &options.startWallClockNs)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (configPaths.empty() || atomsPath.empty() || outDir.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!readAtomStreamFile(atomsPath, &options.atoms)) {
+        return 1;
+    }
+    if (!pullFixturePath.empty() && !readAtomStreamFile(pullFixturePath, &options.pullFixtures)) {
+        return 1;
+    }
+    if (!uidMapPath.empty()) {
+        android::os::statsd::UidData uidData;
+        if (!readProto(uidMapPath, &uidData)) {
+            return 1;
+        }
+        options.uidData = std::move(uidData);
+    }
+
+    vector<StatsdConfig> configs(configPaths.size());
+    std::set<int64_t> configIds;
+    for (size_t i = 0; i < configPaths.size(); i++) {
+        if (!readProto(configPaths[i], &configs[i])) {
+            return 1;
+        }
+        if (!configIds.insert(configs[i].id()).second) {
+            fprintf(stderr, "Duplicate config id %lld\n", (long long)configs[i].id());
+            return 1;
+        }
+    }
+
+    const Replayer replayer(std::move(options));
+    for (const StatsdConfig& config : configs) {
+        const ConfigKey key(kConfigUid, config.id());
+        const ReplayResult result = replayer.replay(key, config);
+
+        const string reportPath = outDir + "/report_" + std::to_string(key.GetUid()) + "_" +
+                                  std::to_string(key.GetId()) + ".pb";
+        const string report(result.report.begin(), result.report.end());
+        if (!android::base::WriteStringToFile(report, reportPath)) {
+            fprintf(stderr, "Failed to write %s\n", reportPath.c_str());
+            return 1;
+        }
+        printReplayResult(result, stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Stands in for the parts of statsd that reach other processes, when statsd runs outside of the
+// statsd process. Linked into libstatsd_offline instead of IncidentdReporter.cpp,
+// statscompanion_util.cpp and libstatslog_statsd, none of which builds for the host.
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "statscompanion_util.h"
+#include "statslog_statsd.h"
+#include "subscriber/IncidentdReporter.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+bool GenerateIncidentReport(const IncidentdDetails& config, int64_t rule_id, int64_t metricId,
+                            const MetricDimensionKey& dimensionKey, int64_t metricValue,
+                            const ConfigKey& configKey) {
+    VLOG("No incidentd, dropping the incident report for rule %lld", (long long)rule_id);
+    return false;
+}
+
+// There is no StatsCompanionService, so permission checks fail and nothing can be pulled from
+// system_server.
+shared_ptr<IStatsCompanionService> getStatsCompanionService() {
+    return nullptr;
+}
+
+namespace util {
+
+// ANOMALY_DETECTED is the only atom statsd logs outside of StatsService. A replay must not log it
+// to the statsd of the device it runs on, so it is dropped.
+int stats_write(int32_t code, int32_t arg1, int64_t arg2, int64_t arg3) {
+    return 0;
+}
+
+}  // namespace util
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -32,6 +32,15 @@ namespace os {
 namespace statsd {
 
 ShellSubscriber::~ShellSubscriber() {
+    {
+        std::lock_guard<std::mutex> queueLock(mQueueMutex);
+        mStopDispatch = true;
+    }
+    mQueueCV.notify_one();
+    mQueueDrainedCV.notify_all();
+    if (mDispatchThread.joinable()) {
+        mDispatchThread.join();
+    }
     {
         std::unique_lock<std::mutex> lock(mMutex);
         mClientSet.clear();
@@ -89,6 +98,12 @@ bool ShellSubscriber::startNewSubscriptionLocked(unique_ptr<ShellSubscriberClien
         mThread = thread([this] { pullAndSendHeartbeats(); });
     }
 
+    // The dispatch thread idles on mQueueCV while there are no clients, so it is only started
+    // once.
+    if (!mDispatchThread.joinable()) {
+        mDispatchThread = thread([this] { dispatchLogEvents(); });
+    }
+
     return true;
 }
 
@@ -135,8 +150,9 @@ void ShellSubscriber::onLogEvent(const LogEvent& event) {
         return;
     }
     std::unique_lock<std::mutex> lock(mMutex);
+    ShellEventEncodings encodings(event, mUidMap, &mAtomEncoder);
     for (auto clientIt = mClientSet.begin(); clientIt != mClientSet.end();) {
-        (*clientIt)->onLogEvent(event);
+        (*clientIt)->onLogEvent(encodings);
         if ((*clientIt)->isAlive()) {
             ++clientIt;
         } else {
@@ -149,7 +165,56 @@ void ShellSubscriber::onLogEvent(const LogEvent& event) {
     }
 }
 
+void ShellSubscriber::enqueueLogEvent(std::unique_ptr<LogEvent> event) {
+    if (!mHasClients || event->isParsedHeaderOnly() || event->isRestricted()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> queueLock(mQueueMutex);
+        if (mEventQueue.size() >= kMaxQueuedEvents) {
+            StatsdStats::getInstance().noteSubscriptionEventDropped();
+            return;
+        }
+        mEventQueue.push_back(std::move(event));
+    }
+    mQueueCV.notify_one();
+}
+
+void ShellSubscriber::dispatchLogEvents() {
+    VLOG("ShellSubscriber: dispatch thread starting");
+    std::deque<std::unique_ptr<LogEvent>> events;
+    std::unique_lock<std::mutex> queueLock(mQueueMutex);
+    while (true) {
+        mQueueCV.wait(queueLock, [this] { return mStopDispatch || !mEventQueue.empty(); });
+        if (mStopDispatch) {
+            VLOG("ShellSubscriber: dispatch thread done!");
+            return;
+        }
+        // Take the whole batch so that enqueueLogEvent() is not blocked while the clients are
+        // writing.
+        events.swap(mEventQueue);
+        mDispatching = true;
+        queueLock.unlock();
+        for (const std::unique_ptr<LogEvent>& event : events) {
+            onLogEvent(*event);
+        }
+        events.clear();
+        queueLock.lock();
+        mDispatching = false;
+        mQueueDrainedCV.notify_all();
+    }
+}
+
+void ShellSubscriber::waitForQueuedEvents() {
+    std::unique_lock<std::mutex> queueLock(mQueueMutex);
+    mQueueDrainedCV.wait(queueLock, [this] {
+        return mStopDispatch || (mEventQueue.empty() && !mDispatching);
+    });
+}
+
 void ShellSubscriber::flushSubscription(const shared_ptr<IStatsSubscriptionCallback>& callback) {
+    // Include the events logged before the flush was requested.
+    waitForQueuedEvents();
     std::unique_lock<std::mutex> lock(mMutex);
 
     // TODO(b/268822860): Consider storing callback clients in a map keyed by
@@ -175,6 +240,7 @@ void ShellSubscriber::flushSubscription(const shared_ptr<IStatsSubscriptionCallb
 }
 
 void ShellSubscriber::unsubscribe(const shared_ptr<IStatsSubscriptionCallback>& callback) {
+    waitForQueuedEvents();
     std::unique_lock<std::mutex> lock(mMutex);
 
     // TODO(b/268822860): Consider storing callback clients in a map keyed by
@@ -195,7 +261,8 @@ void ShellSubscriber::unsubscribe(const shared_ptr<IStatsSubscriptionCallback>&
     }
 }
 
-void ShellSubscriber::updateLogEventFilterLocked() const {
+void ShellSubscriber::updateLogEventFilterLocked() {
+    mHasClients = !mClientSet.empty();
     VLOG("ShellSubscriber: Updating allAtomIds");
     LogEventFilter::AtomIdSet allAtomIds;
     for (const auto& client : mClientSet) {
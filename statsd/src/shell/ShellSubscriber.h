@@ -17,8 +17,11 @@
 #pragma once
 
 #include <aidl/android/os/IStatsSubscriptionCallback.h>
+#include <gtest/gtest_prod.h>
 
+#include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <thread>
 
@@ -53,6 +56,9 @@ namespace statsd {
  * The stream would be in the following format:
  * |size_t|shellData proto|size_t|shellData proto|....
  *
+ * Pushed events from the log reader thread are handed over through a bounded queue and delivered
+ * to the clients on a separate dispatch thread, so a slow client never delays metric processing.
+ * Events that do not fit in the queue are dropped and counted in StatsdStats.
  */
 class ShellSubscriber : public virtual RefBase {
 public:
@@ -70,8 +76,13 @@ public:
             const vector<uint8_t>& subscriptionConfig,
             const shared_ptr<aidl::android::os::IStatsSubscriptionCallback>& callback);
 
+    // Delivers the event to the clients on the calling thread.
     void onLogEvent(const LogEvent& event);
 
+    // Takes ownership of the event and delivers it to the clients on the dispatch thread. Never
+    // blocks on the clients. The event must not be modified after it is handed over.
+    void enqueueLogEvent(std::unique_ptr<LogEvent> event);
+
     void flushSubscription(
             const shared_ptr<aidl::android::os::IStatsSubscriptionCallback>& callback);
 
@@ -85,13 +96,23 @@ public:
         return kMaxSubscriptions;
     }
 
+    static size_t getMaxQueuedEvents() {
+        return kMaxQueuedEvents;
+    }
+
 private:
     bool startNewSubscriptionLocked(unique_ptr<ShellSubscriberClient> client);
 
     void pullAndSendHeartbeats();
 
+    // Runs on mDispatchThread to deliver the events queued by enqueueLogEvent().
+    void dispatchLogEvents();
+
+    // Blocks until the events queued so far have been delivered to the clients.
+    void waitForQueuedEvents();
+
     /* Tells LogEventFilter about atom ids to parse */
-    void updateLogEventFilterLocked() const;
+    void updateLogEventFilterLocked();
 
     sp<UidMap> mUidMap;
 
@@ -99,9 +120,12 @@ private:
 
     std::shared_ptr<LogEventFilter> mLogEventFilter;
 
-    // Protects mClientSet, mThreadAlive, and ShellSubscriberClient
+    // Protects mClientSet, mThreadAlive, mAtomEncoder and ShellSubscriberClient
     mutable std::mutex mMutex;
 
+    // Encodes pushed events once for all the clients.
+    AtomEncoder mAtomEncoder;
+
     std::set<unique_ptr<ShellSubscriberClient>> mClientSet;
 
     bool mThreadAlive = false;
@@ -110,7 +134,34 @@ private:
 
     std::thread mThread;
 
+    // Whether mClientSet is non-empty. Read by enqueueLogEvent() without taking mMutex.
+    std::atomic<bool> mHasClients = false;
+
+    // Protects mEventQueue, mDispatching and mStopDispatch. Never held while delivering events to
+    // the clients.
+    std::mutex mQueueMutex;
+
+    // Signaled when events are queued or the dispatch thread should stop.
+    std::condition_variable mQueueCV;
+
+    // Signaled when the dispatch thread has delivered a batch of events.
+    std::condition_variable mQueueDrainedCV;
+
+    std::deque<std::unique_ptr<LogEvent>> mEventQueue;
+
+    // Whether the dispatch thread is delivering a batch taken from mEventQueue.
+    bool mDispatching = false;
+
+    bool mStopDispatch = false;
+
+    // Started with the first subscription and joined in the destructor.
+    std::thread mDispatchThread;
+
     static constexpr size_t kMaxSubscriptions = 20;
+
+    static constexpr size_t kMaxQueuedEvents = 2000;
+
+    FRIEND_TEST(ShellSubscriberCallbackTest, testFullQueueDropsEvents);
 };
 
 }  // namespace statsd
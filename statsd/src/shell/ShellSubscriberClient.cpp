@@ -37,6 +37,15 @@ const static int FIELD_ID_SHELL_DATA__ELAPSED_TIMESTAMP_NANOS = 2;
 // Not thread-safe; should only be accessed while holding ShellSubscriber::mMutex lock.
 static int nextSubId = 0;
 
+static vector<string> serializeMatchers(const vector<SimpleAtomMatcher>& matchers) {
+    vector<string> keys;
+    keys.reserve(matchers.size());
+    for (const SimpleAtomMatcher& matcher : matchers) {
+        keys.push_back(matcher.SerializeAsString());
+    }
+    return keys;
+}
+
 struct ReadConfigResult {
     vector<SimpleAtomMatcher> pushedMatchers;
     vector<ShellSubscriberClient::PullInfo> pullInfo;
@@ -78,6 +87,37 @@ static optional<ReadConfigResult> readConfig(const vector<uint8_t>& configBytes,
     return result;
 }
 
+ShellEventEncodings::ShellEventEncodings(const LogEvent& event, const sp<UidMap>& uidMap,
+                                         AtomEncoder* atomEncoder)
+    : mEvent(event), mUidMap(uidMap), mAtomEncoder(atomEncoder) {
+}
+
+const ShellEventEncodings::Encoding* ShellEventEncodings::getEncoding(
+        const string& matcherKey, const SimpleAtomMatcher& matcher) {
+    if (matcher.atom_id() != mEvent.GetTagId()) {
+        return nullptr;
+    }
+    auto [it, inserted] = mEncodings.try_emplace(matcherKey);
+    optional<Encoding>& encoding = it->second;
+    if (!inserted) {
+        return encoding.has_value() ? &encoding.value() : nullptr;
+    }
+
+    auto [matched, transformedEvent] = matchesSimple(mUidMap, matcher, mEvent);
+    if (!matched) {
+        return nullptr;
+    }
+    const LogEvent& eventRef = transformedEvent == nullptr ? mEvent : *transformedEvent;
+    ProtoOutputStream atomProto;
+    mAtomEncoder->write(eventRef.GetTagId(), eventRef.getValues(), &atomProto);
+
+    encoding.emplace();
+    atomProto.serializeToVector(&encoding->mAtomBytes);
+    encoding->mTimestampNs = truncateTimestampIfNecessary(eventRef);
+    encoding->mCacheSize = getSize(eventRef.getValues()) + sizeof(encoding->mTimestampNs);
+    return &encoding.value();
+}
+
 ShellSubscriberClient::PullInfo::PullInfo(const SimpleAtomMatcher& matcher, int64_t startTimeMs,
                                           int64_t intervalMs,
                                           const std::vector<std::string>& packages,
@@ -99,6 +139,7 @@ ShellSubscriberClient::ShellSubscriberClient(
       mPullerMgr(pullerMgr),
       mDupOut(fcntl(out, F_DUPFD_CLOEXEC, 0)),
       mPushedMatchers(pushedMatchers),
+      mPushedMatcherKeys(serializeMatchers(pushedMatchers)),
       mPulledInfo(pulledInfo),
       mCallback(callback),
       mTimeoutSec(timeoutSec),
@@ -185,7 +226,7 @@ bool ShellSubscriberClient::writeEventToProtoIfMatched(const LogEvent& event,
     // Cache atom event in mProtoOut.
     uint64_t atomToken = mProtoOut.start(util::FIELD_TYPE_MESSAGE | util::FIELD_COUNT_REPEATED |
                                          FIELD_ID_SHELL_DATA__ATOM);
-    eventRef.ToProto(mProtoOut);
+    mAtomEncoder.write(eventRef.GetTagId(), eventRef.getValues(), &mProtoOut);
     mProtoOut.end(atomToken);
 
     const int64_t timestampNs = truncateTimestampIfNecessary(eventRef);
@@ -199,10 +240,25 @@ bool ShellSubscriberClient::writeEventToProtoIfMatched(const LogEvent& event,
     return true;
 }
 
+void ShellSubscriberClient::writeEncodingToProto(const ShellEventEncodings::Encoding& encoding) {
+    // Same output as writeEventToProtoIfMatched, with the atom encoded beforehand.
+    mProtoOut.write(util::FIELD_TYPE_MESSAGE | util::FIELD_COUNT_REPEATED |
+                            FIELD_ID_SHELL_DATA__ATOM,
+                    reinterpret_cast<const char*>(encoding.mAtomBytes.data()),
+                    encoding.mAtomBytes.size());
+    mProtoOut.write(util::FIELD_TYPE_INT64 | util::FIELD_COUNT_REPEATED |
+                            FIELD_ID_SHELL_DATA__ELAPSED_TIMESTAMP_NANOS,
+                    static_cast<long long>(encoding.mTimestampNs));
+    mCacheSize += encoding.mCacheSize;
+}
+
 // Called by ShellSubscriber when a pushed event occurs
-void ShellSubscriberClient::onLogEvent(const LogEvent& event) {
-    for (const auto& matcher : mPushedMatchers) {
-        if (writeEventToProtoIfMatched(event, matcher, mUidMap)) {
+void ShellSubscriberClient::onLogEvent(ShellEventEncodings& encodings) {
+    for (size_t i = 0; i < mPushedMatchers.size(); i++) {
+        const ShellEventEncodings::Encoding* encoding =
+                encodings.getEncoding(mPushedMatcherKeys[i], mPushedMatchers[i]);
+        if (encoding != nullptr) {
+            writeEncodingToProto(*encoding);
             flushProtoIfNeeded();
             break;
         }
@@ -23,6 +23,10 @@
 #include <private/android_filesystem_config.h>
 
 #include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "external/StatsPullerManager.h"
 #include "logd/LogEvent.h"
@@ -30,6 +34,7 @@
 #include "socket/LogEventFilter.h"
 #include "src/shell/shell_config.pb.h"
 #include "src/statsd_config.pb.h"
+#include "utils/AtomEncoder.h"
 
 using aidl::android::os::IStatsSubscriptionCallback;
 using aidl::android::os::StatsSubscriptionCallbackReason;
@@ -38,6 +43,41 @@ namespace android {
 namespace os {
 namespace statsd {
 
+// Encodings of one pushed event for the matchers of the subscriptions that receive it.
+// ShellSubscriber shares one instance between all its subscriptions, so that the event is matched
+// and encoded once per distinct matcher rather than once per subscription.
+//
+// ShellEventEncodings is not thread-safe. All calls must be guarded by the mutex in
+// ShellSubscriber.h
+class ShellEventEncodings {
+public:
+    struct Encoding {
+        // Encoded Atom message, without its tag and length.
+        std::vector<uint8_t> mAtomBytes;
+        int64_t mTimestampNs;
+        // Approximate size of the event, counted towards the cache size of the subscriptions.
+        size_t mCacheSize;
+    };
+
+    ShellEventEncodings(const LogEvent& event, const sp<UidMap>& uidMap,
+                        AtomEncoder* atomEncoder);
+
+    // Returns the encoding of the event for the matcher, or nullptr if the event does not match.
+    // matcherKey is the serialized matcher. The pointer is valid for the lifetime of this object.
+    const Encoding* getEncoding(const std::string& matcherKey, const SimpleAtomMatcher& matcher);
+
+private:
+    const LogEvent& mEvent;
+
+    const sp<UidMap> mUidMap;
+
+    AtomEncoder* const mAtomEncoder;
+
+    // Matchers of the event's atom evaluated so far, keyed by the serialized matcher, with the
+    // encoding if the event matched.
+    std::unordered_map<std::string, std::optional<Encoding>> mEncodings;
+};
+
 // ShellSubscriberClient is not thread-safe. All calls must be
 // guarded by the mutex in ShellSubscriber.h
 class ShellSubscriberClient {
@@ -71,7 +111,7 @@ public:
                                    int64_t startTimeSec, const sp<UidMap>& uidMap,
                                    const sp<StatsPullerManager>& pullerMgr);
 
-    void onLogEvent(const LogEvent& event);
+    void onLogEvent(ShellEventEncodings& encodings);
 
     int64_t pullAndSendHeartbeatsIfNeeded(int64_t nowSecs, int64_t nowMillis, int64_t nowNanos);
 
@@ -116,6 +156,8 @@ private:
     bool writeEventToProtoIfMatched(const LogEvent& event, const SimpleAtomMatcher& matcher,
                                     const sp<UidMap>& uidMap);
 
+    void writeEncodingToProto(const ShellEventEncodings::Encoding& encoding);
+
     void clearCache();
 
     void triggerFdFlush();
@@ -135,6 +177,10 @@ private:
 
     const std::vector<SimpleAtomMatcher> mPushedMatchers;
 
+    // Serialized mPushedMatchers, used to share event encodings between subscriptions with the
+    // same matcher.
+    const std::vector<std::string> mPushedMatcherKeys;
+
     std::vector<PullInfo> mPulledInfo;
 
     std::shared_ptr<IStatsSubscriptionCallback> mCallback;
@@ -150,6 +196,8 @@ private:
     // Stores Atom proto messages for events along with their respective timestamps.
     ProtoOutputStream mProtoOut;
 
+    AtomEncoder mAtomEncoder;
+
     // Stores the total approximate encoded proto byte-size for cached Atom events in
     // mEventTimestampNs and mProtoOut.
     size_t mCacheSize;
@@ -30,6 +30,7 @@
 #include <unistd.h>
 
 #include "guardrail/StatsdStats.h"
+#include "logd/AtomCapture.h"
 #include "logd/logevent_util.h"
 #include "stats_log_util.h"
 #include "statslog_statsd.h"
@@ -150,6 +151,10 @@ void StatsSocketListener::processMessage(const uint8_t* msg, uint32_t len, uint3
     const bool isAtomSkipped = logEvent->isParsedHeaderOnly();
     const int64_t atomTimestamp = logEvent->GetElapsedTimestampNs();
 
+    if (AtomCapture::isCapturing()) {
+        AtomCapture::getInstance().noteAtom(msg, len, atomId, uid, pid);
+    }
+
     if (atomId == util::STATS_SOCKET_LOSS_REPORTED) {
         if (isAtomSkipped) {
             ALOGW("Atom STATS_SOCKET_LOSS_REPORTED should not be skipped");
@@ -17,12 +17,19 @@
 
 #include <utils/RefBase.h>
 
+#include <utility>
+#include <vector>
+
 #include "HashableDimensionKey.h"
 
 namespace android {
 namespace os {
 namespace statsd {
 
+// Links from the primary fields of a state atom to the fields of a listener's dimensions in what,
+// as (state field, what field) pairs.
+typedef std::vector<std::pair<Field, Field>> StateFieldLinks;
+
 class StateListener : public virtual RefBase {
 public:
     StateListener(){};
@@ -47,6 +54,27 @@ public:
     virtual void onStateChanged(const int64_t eventTimeNs, const int32_t atomId,
                                 const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                                 const FieldValue& newState) = 0;
+
+    /**
+     * Returns how the listener matches the primary key of a state atom against its dimensions in
+     * what. StateTrackers group the listeners with the same links and translate the primary key
+     * of each state change once per group, then call onLinkedStateChanged instead of
+     * onStateChanged. Listeners that do not use the primary key return no links.
+     */
+    virtual StateFieldLinks getStateFieldLinks(const int32_t atomId) const {
+        return {};
+    }
+
+    /**
+     * Same as onStateChanged, for listeners with state field links. [linkedKey] holds the values
+     * of [primaryKey] under the linked fields of the listener's dimensions in what.
+     */
+    virtual void onLinkedStateChanged(const int64_t eventTimeNs, const int32_t atomId,
+                                      const HashableDimensionKey& primaryKey,
+                                      const HashableDimensionKey& linkedKey,
+                                      const FieldValue& oldState, const FieldValue& newState) {
+        onStateChanged(eventTimeNs, atomId, primaryKey, oldState, newState);
+    }
 };
 
 }  // namespace statsd
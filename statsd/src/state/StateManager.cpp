@@ -109,6 +109,15 @@ void StateManager::notifyAppChanged(const string& apk, const sp<UidMap>& uidMap)
     }
 }
 
+void StateManager::notifyAppsChanged(const std::set<string>& apks, const sp<UidMap>& uidMap) {
+    for (const string& apk : apks) {
+        if (mAllowedPkg.find(apk) != mAllowedPkg.end()) {
+            updateLogSources(uidMap);
+            return;
+        }
+    }
+}
+
 void StateManager::addAllAtomIds(LogEventFilter::AtomIdSet& allIds) const {
     for (const auto& stateTracker : mStateTrackers) {
         allIds.insert(stateTracker.first);
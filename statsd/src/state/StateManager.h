@@ -73,6 +73,9 @@ public:
 
     void notifyAppChanged(const string& apk, const sp<UidMap>& uidMap);
 
+    // Updates mAllowedLogSources if any of the given packages is allowed to log.
+    void notifyAppsChanged(const std::set<string>& apks, const sp<UidMap>& uidMap);
+
     inline int getStateTrackersCount() const {
         return mStateTrackers.size();
     }
@@ -21,10 +21,54 @@
 
 #include "StateTracker.h"
 
+#include <algorithm>
+
+using std::vector;
+
 namespace android {
 namespace os {
 namespace statsd {
 
+namespace {
+
+// Returns the links of the listener for the atom, sorted by state field. A listener that links a
+// state field to several fields is matched field by field, so it gets no links.
+StateFieldLinks getSortedStateFieldLinks(const wp<StateListener>& listener, const int32_t atomId) {
+    const sp<StateListener> sl = listener.promote();
+    if (sl == nullptr) {
+        return {};
+    }
+    StateFieldLinks links = sl->getStateFieldLinks(atomId);
+    std::sort(links.begin(), links.end());
+    links.erase(std::unique(links.begin(), links.end()), links.end());
+    for (size_t i = 1; i < links.size(); i++) {
+        if (links[i].first == links[i - 1].first) {
+            return {};
+        }
+    }
+    return links;
+}
+
+// Puts the values of the primary key under the linked fields. Returns false if a primary field is
+// not linked, in which case no dimension in what contains the key.
+bool translatePrimaryKey(const StateFieldLinks& links, const HashableDimensionKey& primaryKey,
+                         HashableDimensionKey* linkedKey) {
+    for (const FieldValue& primaryValue : primaryKey.getValues()) {
+        const auto it = std::lower_bound(
+                links.begin(), links.end(), primaryValue.mField,
+                [](const std::pair<Field, Field>& link, const Field& field) {
+                    return link.first < field;
+                });
+        if (it == links.end() || it->first != primaryValue.mField) {
+            return false;
+        }
+        linkedKey->addValue(FieldValue(it->second, primaryValue.mValue));
+    }
+    return true;
+}
+
+}  // anonymous namespace
+
 StateTracker::StateTracker(int32_t atomId) : mField(atomId, 0) {
 }
 
@@ -59,15 +103,51 @@ void StateTracker::onLogEvent(const LogEvent& event) {
     }
 
     const bool nested = newState.mAnnotations.isNested();
-    updateStateForPrimaryKey(eventTimeNs, primaryKey, newState, nested, mStateMap[primaryKey]);
+    vector<StateChange> changes;
+    updateStateForPrimaryKey(primaryKey, newState, nested, mStateMap[primaryKey], changes);
+    notifyListeners(eventTimeNs, changes);
 }
 
 void StateTracker::registerListener(const wp<StateListener>& listener) {
-    mListeners.insert(listener);
+    for (const ListenerGroup& group : mListenerGroups) {
+        if (std::find(group.listeners.begin(), group.listeners.end(), listener) !=
+            group.listeners.end()) {
+            return;
+        }
+    }
+    StateFieldLinks links = getSortedStateFieldLinks(listener, mField.getTag());
+    for (ListenerGroup& group : mListenerGroups) {
+        if (group.links == links) {
+            group.listeners.push_back(listener);
+            return;
+        }
+    }
+    mListenerGroups.push_back({std::move(links), {listener}});
 }
 
 void StateTracker::unregisterListener(const wp<StateListener>& listener) {
-    mListeners.erase(listener);
+    for (ListenerGroup& group : mListenerGroups) {
+        group.listeners.erase(
+                std::remove(group.listeners.begin(), group.listeners.end(), listener),
+                group.listeners.end());
+    }
+    removeEmptyGroups();
+}
+
+void StateTracker::removeEmptyGroups() {
+    mListenerGroups.erase(std::remove_if(mListenerGroups.begin(), mListenerGroups.end(),
+                                         [](const ListenerGroup& group) {
+                                             return group.listeners.empty();
+                                         }),
+                          mListenerGroups.end());
+}
+
+int StateTracker::getListenersCount() const {
+    int count = 0;
+    for (const ListenerGroup& group : mListenerGroups) {
+        count += group.listeners.size();
+    }
+    return count;
 }
 
 bool StateTracker::getStateValue(const HashableDimensionKey& queryKey, FieldValue* output) const {
@@ -86,11 +166,16 @@ bool StateTracker::getStateValue(const HashableDimensionKey& queryKey, FieldValu
 
 void StateTracker::handleReset(const int64_t eventTimeNs, const FieldValue& newState) {
     VLOG("StateTracker handle reset");
+    // All the primary keys are reset by the same event, so the listeners are notified once with
+    // all the changes.
+    vector<StateChange> changes;
+    changes.reserve(mStateMap.size());
     for (auto& [primaryKey, stateValueInfo] : mStateMap) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, newState,
+        updateStateForPrimaryKey(primaryKey, newState,
                                  false /* nested; treat this state change as not nested */,
-                                 stateValueInfo);
+                                 stateValueInfo, changes);
     }
+    notifyListeners(eventTimeNs, changes);
 }
 
 void StateTracker::clearStateForPrimaryKey(const int64_t eventTimeNs,
@@ -103,16 +188,18 @@ void StateTracker::clearStateForPrimaryKey(const int64_t eventTimeNs,
     // kStateUnknown.
     const FieldValue state(mField, Value(kStateUnknown));
     if (it != mStateMap.end()) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, state,
+        vector<StateChange> changes;
+        updateStateForPrimaryKey(primaryKey, state,
                                  false /* nested; treat this state change as not nested */,
-                                 it->second);
+                                 it->second, changes);
+        notifyListeners(eventTimeNs, changes);
     }
 }
 
-void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
-                                            const HashableDimensionKey& primaryKey,
+void StateTracker::updateStateForPrimaryKey(const HashableDimensionKey& primaryKey,
                                             const FieldValue& newState, const bool nested,
-                                            StateValueInfo& stateValueInfo) {
+                                            StateValueInfo& stateValueInfo,
+                                            vector<StateChange>& changes) {
     FieldValue oldState;
     oldState.mField = mField;
     oldState.mValue.setInt(stateValueInfo.state);
@@ -125,7 +212,7 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
         if (newStateValue != oldStateValue) {
             stateValueInfo.state = newStateValue;
             stateValueInfo.count = 1;
-            notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+            changes.push_back({primaryKey, oldState, newState});
         }
 
     // Update state map for nested counting case.
@@ -140,18 +227,18 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
     // The atom must be logged correctly.
     } else if (newStateValue == kStateUnknown) {
         if (oldStateValue != kStateUnknown) {
-            notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+            changes.push_back({primaryKey, oldState, newState});
         }
     } else if (oldStateValue == kStateUnknown) {
         stateValueInfo.state = newStateValue;
         stateValueInfo.count = 1;
-        notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+        changes.push_back({primaryKey, oldState, newState});
     } else if (oldStateValue == newStateValue) {
         stateValueInfo.count++;
     } else if (--stateValueInfo.count == 0) {
         stateValueInfo.state = newStateValue;
         stateValueInfo.count = 1;
-        notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+        changes.push_back({primaryKey, oldState, newState});
     }
 
     // Clear primary key entry from state map if state is now unknown.
@@ -162,15 +249,54 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
     }
 }
 
-void StateTracker::notifyListeners(const int64_t eventTimeNs,
-                                   const HashableDimensionKey& primaryKey,
-                                   const FieldValue& oldState, const FieldValue& newState) {
-    for (const auto& l : mListeners) {
-        auto sl = l.promote();
-        if (sl != nullptr) {
-            sl->onStateChanged(eventTimeNs, mField.getTag(), primaryKey, oldState, newState);
+void StateTracker::notifyListeners(const int64_t eventTimeNs, const vector<StateChange>& changes) {
+    if (changes.empty()) {
+        return;
+    }
+    const int32_t atomId = mField.getTag();
+    bool hasExpiredListener = false;
+    vector<HashableDimensionKey> linkedKeys(changes.size());
+    vector<uint8_t> translated(changes.size(), false);
+    for (const ListenerGroup& group : mListenerGroups) {
+        if (!group.links.empty()) {
+            for (size_t i = 0; i < changes.size(); i++) {
+                linkedKeys[i] = HashableDimensionKey();
+                translated[i] =
+                        translatePrimaryKey(group.links, changes[i].primaryKey, &linkedKeys[i]);
+            }
         }
+        for (const wp<StateListener>& l : group.listeners) {
+            const sp<StateListener> sl = l.promote();
+            if (sl == nullptr) {
+                hasExpiredListener = true;
+                continue;
+            }
+            for (size_t i = 0; i < changes.size(); i++) {
+                const StateChange& change = changes[i];
+                if (!group.links.empty() && translated[i]) {
+                    sl->onLinkedStateChanged(eventTimeNs, atomId, change.primaryKey,
+                                             linkedKeys[i], change.oldState, change.newState);
+                } else {
+                    sl->onStateChanged(eventTimeNs, atomId, change.primaryKey, change.oldState,
+                                       change.newState);
+                }
+            }
+        }
+    }
+    if (hasExpiredListener) {
+        removeExpiredListeners();
+    }
+}
+
+void StateTracker::removeExpiredListeners() {
+    for (ListenerGroup& group : mListenerGroups) {
+        group.listeners.erase(std::remove_if(group.listeners.begin(), group.listeners.end(),
+                                             [](const wp<StateListener>& l) {
+                                                 return l.promote() == nullptr;
+                                             }),
+                              group.listeners.end());
     }
+    removeEmptyGroups();
 }
 
 bool getStateFieldValueFromLogEvent(const LogEvent& event, FieldValue* output) {
@@ -15,6 +15,7 @@
  */
 #pragma once
 
+#include <gtest/gtest_prod.h>
 #include <utils/RefBase.h>
 #include "HashableDimensionKey.h"
 #include "logd/LogEvent.h"
@@ -22,6 +23,7 @@
 #include "state/StateListener.h"
 
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 namespace os {
@@ -51,9 +53,7 @@ public:
     // number of primary fields, the output value is set to kStateUnknown.
     bool getStateValue(const HashableDimensionKey& queryKey, FieldValue* output) const;
 
-    inline int getListenersCount() const {
-        return mListeners.size();
-    }
+    int getListenersCount() const;
 
     const static int kStateUnknown = -1;
 
@@ -63,13 +63,31 @@ private:
         int count = 0;                  // nested count (only used for binary states)
     };
 
+    struct StateChange {
+        HashableDimensionKey primaryKey;
+        FieldValue oldState;
+        FieldValue newState;
+    };
+
     Field mField;
 
     // Maps primary key to state value info
     std::unordered_map<HashableDimensionKey, StateValueInfo> mStateMap;
 
-    // Set of all StateListeners (objects listening for state changes)
-    std::set<wp<StateListener>> mListeners;
+    // StateListeners with the same state field links. The primary key of a state change is
+    // translated to the linked fields once for the whole group.
+    struct ListenerGroup {
+        // Sorted by state field. Empty if the listeners are notified with the primary key only.
+        StateFieldLinks links;
+
+        // Without duplicates and in registration order. A flat list is cheaper to walk on every
+        // state change than a set, and listeners are only added or removed when configs are
+        // installed or removed.
+        std::vector<wp<StateListener>> listeners;
+    };
+
+    // All StateListeners (objects listening for state changes), grouped when they are registered.
+    std::vector<ListenerGroup> mListenerGroups;
 
     // Reset all state values in map to the given state.
     void handleReset(const int64_t eventTimeNs, const FieldValue& newState);
@@ -77,14 +95,24 @@ private:
     // Clears the state value mapped to the given primary key by setting it to kStateUnknown.
     void clearStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey);
 
-    // Update the StateMap based on the received state value.
-    void updateStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
+    // Update the StateMap based on the received state value. Appends the state change, if any,
+    // to [changes].
+    void updateStateForPrimaryKey(const HashableDimensionKey& primaryKey,
                                   const FieldValue& newState, const bool nested,
-                                  StateValueInfo& stateValueInfo);
+                                  StateValueInfo& stateValueInfo,
+                                  std::vector<StateChange>& changes);
+
+    // Notify registered state listeners of the state changes of one event. The primary keys are
+    // translated once per listener group, each listener is promoted once for all the changes, and
+    // listeners that no longer exist are removed.
+    void notifyListeners(const int64_t eventTimeNs, const std::vector<StateChange>& changes);
+
+    // Removes the listeners that no longer exist, and the groups left empty.
+    void removeExpiredListeners();
+
+    void removeEmptyGroups();
 
-    // Notify registered state listeners of state change.
-    void notifyListeners(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
-                         const FieldValue& oldState, const FieldValue& newState);
+    FRIEND_TEST(StateTrackerTest, TestListenersGroupedByLinks);
 };
 
 bool getStateFieldValueFromLogEvent(const LogEvent& event, FieldValue* output);
@@ -20,9 +20,9 @@
 #include <aidl/android/os/IStatsCompanionService.h>
 #include <private/android_filesystem_config.h>
 #include <set>
-#include <utils/SystemClock.h>
 
 #include "statscompanion_util.h"
+#include "utils/Clock.h"
 
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
@@ -555,33 +555,31 @@ void writeAtomMetricStatsToStream(const std::pair<int64_t, StatsdStats::AtomMetr
 }
 
 int64_t getElapsedRealtimeNs() {
-    return ::android::elapsedRealtimeNano();
+    return Clock::get().getElapsedRealtimeNs();
 }
 
 int64_t getElapsedRealtimeSec() {
-    return ::android::elapsedRealtimeNano() / NS_PER_SEC;
+    return getElapsedRealtimeNs() / NS_PER_SEC;
 }
 
 int64_t getElapsedRealtimeMillis() {
-    return ::android::elapsedRealtime();
+    return NanoToMillis(getElapsedRealtimeNs());
 }
 
 int64_t getSystemUptimeMillis() {
-    return ::android::uptimeMillis();
+    return NanoToMillis(Clock::get().getUptimeNs());
 }
 
 int64_t getWallClockNs() {
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    return ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+    return Clock::get().getWallClockNs();
 }
 
 int64_t getWallClockSec() {
-    return time(nullptr);
+    return getWallClockNs() / NS_PER_SEC;
 }
 
 int64_t getWallClockMillis() {
-    return time(nullptr) * MS_PER_SEC;
+    return getWallClockSec() * MS_PER_SEC;
 }
 
 int64_t truncateTimestampIfNecessary(const LogEvent& event) {
@@ -634,6 +632,14 @@ void mapIsolatedUidsToHostUidInLogEvent(const sp<UidMap>& uidMap, LogEvent& even
     }
 }
 
+void mapIsolatedUidsToHostUidInAttributionChain(const sp<UidMap>& uidMap, LogEvent& event) {
+    const size_t numNodes = event.getAttributionChainNodeCount();
+    for (size_t node = 0; node < numNodes; node++) {
+        Value& uid = event.getMutableAttributionUid(node).mValue;
+        uid.setInt(uidMap->getHostUidOrSelf(uid.int_value));
+    }
+}
+
 std::string toHexString(const string& bytes) {
     static const char* kLookup = "0123456789ABCDEF";
     string hex;
@@ -121,6 +121,9 @@ inline bool isPulledAtom(int atomId) {
 
 void mapIsolatedUidsToHostUidInLogEvent(const sp<UidMap>& uidMap, LogEvent& event);
 
+// Maps the uid of every node in the event's attribution chain to its host uid.
+void mapIsolatedUidsToHostUidInAttributionChain(const sp<UidMap>& uidMap, LogEvent& event);
+
 std::string toHexString(const string& bytes);
 
 }  // namespace statsd
@@ -39,6 +39,13 @@ enum UpdateStatus {
 const HashableDimensionKey DEFAULT_DIMENSION_KEY = HashableDimensionKey();
 const MetricDimensionKey DEFAULT_METRIC_DIMENSION_KEY = MetricDimensionKey();
 
+// Dimension in what of the key aggregating all dimensions past the dimension hard limit, for
+// metrics rolling up overflow dimensions. No atom has id 0, so no event has this dimension.
+const HashableDimensionKey OVERFLOW_DIMENSION_KEY =
+        HashableDimensionKey({FieldValue(Field(/*tag=*/0, /*field=*/0), Value((int32_t)0))});
+const MetricDimensionKey OVERFLOW_METRIC_DIMENSION_KEY =
+        MetricDimensionKey(OVERFLOW_DIMENSION_KEY, DEFAULT_DIMENSION_KEY);
+
 typedef std::map<int64_t, HashableDimensionKey> ConditionKey;
 
 typedef std::unordered_map<MetricDimensionKey, int64_t> DimToValMap;
@@ -49,6 +56,10 @@ using StateLinks = google::protobuf::RepeatedPtrField<MetricStateLink>;
 
 struct Empty {};
 
+inline bool isOverflowDimensionKey(const MetricDimensionKey& key) {
+    return key.getDimensionKeyInWhat() == OVERFLOW_DIMENSION_KEY;
+}
+
 inline bool isAtLeastS() {
     const static bool isAtLeastS = android::modules::sdklevel::IsAtLeastS();
     return isAtLeastS;
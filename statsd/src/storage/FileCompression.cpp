@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "storage/FileCompression.h"
+
+#include <string.h>
+#include <zlib.h>
+
+using std::string;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const char kMagic[] = {'\0', 'S', 'T', 'Z'};
+
+// Favors speed, since files are written while statsd holds its metrics lock. Report protos are
+// repetitive enough that the fastest level already removes most of their size.
+const int kCompressionLevel = Z_BEST_SPEED;
+
+bool hasCompressedFileHeader(const string& content) {
+    return content.size() >= kCompressedFileHeaderSize &&
+           memcmp(content.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+}  // anonymous namespace
+
+bool compressFileContent(const void* buffer, size_t size, string* output) {
+    uLongf compressedSize = compressBound(size);
+    output->resize(kCompressedFileHeaderSize + compressedSize);
+    char* header = output->data();
+    memcpy(header, kMagic, sizeof(kMagic));
+    header[4] = kCompressedFileVersion;
+    header[5] = kCompressedFileCodecZlib;
+    header[6] = 0;
+    header[7] = 0;
+    for (int i = 0; i < 8; i++) {
+        header[8 + i] = static_cast<char>(static_cast<uint64_t>(size) >> (8 * i));
+    }
+
+    const int result = compress2(
+            reinterpret_cast<Bytef*>(output->data() + kCompressedFileHeaderSize), &compressedSize,
+            static_cast<const Bytef*>(buffer), size, kCompressionLevel);
+    if (result != Z_OK) {
+        ALOGE("Failed to compress %zu bytes: %d", size, result);
+        output->clear();
+        return false;
+    }
+    output->resize(kCompressedFileHeaderSize + compressedSize);
+    VLOG("Compressed %zu bytes to %zu bytes", size, output->size());
+    return true;
+}
+
+bool decompressFileContent(string* content) {
+    if (!hasCompressedFileHeader(*content)) {
+        return true;
+    }
+    const uint8_t* header = reinterpret_cast<const uint8_t*>(content->data());
+    if (header[4] != kCompressedFileVersion || header[5] != kCompressedFileCodecZlib) {
+        ALOGE("Unsupported compressed file version %d codec %d", header[4], header[5]);
+        return false;
+    }
+    uint64_t size = 0;
+    for (int i = 0; i < 8; i++) {
+        size |= static_cast<uint64_t>(header[8 + i]) << (8 * i);
+    }
+    if (size > kMaxUncompressedFileSize) {
+        ALOGE("Compressed file is too large: %llu bytes", (unsigned long long)size);
+        return false;
+    }
+
+    string output(size, '\0');
+    uLongf outputSize = size;
+    const int result = uncompress(reinterpret_cast<Bytef*>(output.data()), &outputSize,
+                                  header + kCompressedFileHeaderSize,
+                                  content->size() - kCompressedFileHeaderSize);
+    if (result != Z_OK || outputSize != size) {
+        ALOGE("Failed to decompress file content: %d", result);
+        return false;
+    }
+    *content = std::move(output);
+    return true;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
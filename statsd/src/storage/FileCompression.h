@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Compressed files start with a 16 byte header:
+ *   - the magic bytes "\0STZ",
+ *   - the format version (1 byte) and the codec (1 byte),
+ *   - 2 reserved bytes,
+ *   - the uncompressed size (8 bytes, little endian),
+ * followed by the compressed content. A serialized proto never starts with a zero byte, so files
+ * written without compression are told apart by their first byte and remain readable.
+ */
+const size_t kCompressedFileHeaderSize = 16;
+const uint8_t kCompressedFileVersion = 1;
+const uint8_t kCompressedFileCodecZlib = 1;
+
+// Guards against bad allocations when reading corrupted files.
+const uint64_t kMaxUncompressedFileSize = 64 * 1024 * 1024;
+
+// Writes the header and the zlib compression of buffer to output. Returns false if the
+// compression failed.
+bool compressFileContent(const void* buffer, size_t size, std::string* output);
+
+// Replaces content with its decompression if it starts with the compressed file header. Other
+// content is left as is. Returns false if the content has the header but cannot be
+// decompressed.
+bool decompressFileContent(std::string* content);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -20,14 +20,17 @@
 #include "storage/StorageManager.h"
 
 #include <android-base/file.h>
+#include <errno.h>
 #include <private/android_filesystem_config.h>
 #include <sys/stat.h>
 
+#include <atomic>
 #include <fstream>
 
 #include "android-base/stringprintf.h"
 #include "guardrail/StatsdStats.h"
 #include "stats_log_util.h"
+#include "storage/FileCompression.h"
 #include "utils/DbUtils.h"
 
 namespace android {
@@ -48,8 +51,14 @@ using std::map;
 // for ConfigMetricsReportList
 const int FIELD_ID_REPORTS = 2;
 
+// How long the file ledger of a directory is trusted before it is rebuilt from a directory scan.
+// This picks up any change made to the directory outside of StorageManager.
+const int64_t kFileLedgerReconcileSec = 60 * 60;
+
 std::mutex StorageManager::sTrainInfoMutex;
 
+static std::atomic<bool> sCompressFiles(false);
+
 using android::base::StringPrintf;
 using std::unique_ptr;
 
@@ -122,6 +131,157 @@ static void parseFileName(char* name, FileName* output) {
     output->mIsHistory = (substr != nullptr && strcmp("history", substr) == 0);
 }
 
+struct FileLedgerEntry {
+    int64_t mTimestampSec;
+    bool mIsHistory;
+    int64_t mFileSizeBytes;
+};
+
+// In-memory view of the files in a directory, keyed by full file name. trimToFit() makes its
+// decisions from the ledger instead of scanning the directory on every write.
+struct FileLedger {
+    int64_t mLastReconcileSec = 0;
+    map<string, FileLedgerEntry> mFiles;
+};
+
+static std::mutex sFileLedgerMutex;
+
+// Keyed by directory. Only directories that have been trimmed have a ledger.
+static map<string, FileLedger> sFileLedgers;
+
+// Splits a full file path into its directory and the FileName encoded in its base name. Returns
+// false if the base name does not follow the statsd file name format.
+static bool parseFullFileName(const string& file, string* dir, FileName* output) {
+    size_t pos = file.rfind('/');
+    if (pos == string::npos) {
+        return false;
+    }
+    *dir = file.substr(0, pos);
+    string name = file.substr(pos + 1);
+    parseFileName(name.data(), output);
+    return output->mTimestampSec != -1;
+}
+
+// Removes a file from disk. Returns true if the file no longer exists.
+static bool removeFile(const char* file) {
+    if (remove(file) != 0) {
+        const bool notFound = errno == ENOENT;
+        VLOG("Attempt to delete %s but is not found", file);
+        return notFound;
+    }
+    VLOG("Successfully deleted %s", file);
+    return true;
+}
+
+static bool scanFileLedgerLocked(const char* path, int64_t nowSec, FileLedger* ledger) {
+    unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
+    if (dir == NULL) {
+        VLOG("Path %s does not exist", path);
+        return false;
+    }
+    ledger->mFiles.clear();
+    dirent* de;
+    while ((de = readdir(dir.get()))) {
+        char* name = de->d_name;
+        if (name[0] == '.' || de->d_type == DT_DIR) continue;
+
+        FileName output;
+        parseFileName(name, &output);
+        if (output.mTimestampSec == -1) continue;
+
+        string file_name = output.getFullFileName(path);
+        struct stat fileInfo;
+        int64_t fileSize = stat(file_name.c_str(), &fileInfo) == 0 ? fileInfo.st_size : 0;
+        ledger->mFiles[file_name] = {output.mTimestampSec, output.mIsHistory, fileSize};
+    }
+    ledger->mLastReconcileSec = nowSec;
+    return true;
+}
+
+// Returns the ledger of the directory, building it or reconciling it with the directory content
+// if needed. Returns nullptr if the directory does not exist.
+static FileLedger* getFileLedgerLocked(const char* path, int64_t nowSec) {
+    auto it = sFileLedgers.find(path);
+    if (it != sFileLedgers.end() && nowSec >= it->second.mLastReconcileSec &&
+        nowSec - it->second.mLastReconcileSec < kFileLedgerReconcileSec) {
+        return &it->second;
+    }
+    FileLedger ledger;
+    if (!scanFileLedgerLocked(path, nowSec, &ledger)) {
+        if (it != sFileLedgers.end()) {
+            sFileLedgers.erase(it);
+        }
+        return nullptr;
+    }
+    FileLedger& result = sFileLedgers[path];
+    result = std::move(ledger);
+    return &result;
+}
+
+// Records the current size of an opened file in the ledger of its directory, if that directory
+// has one. Files that are not already in the ledger are only added if addIfMissing is true.
+static void noteFileWritten(const string& file, int fd, bool addIfMissing) {
+    string dir;
+    FileName output;
+    if (!parseFullFileName(file, &dir, &output)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(sFileLedgerMutex);
+    auto it = sFileLedgers.find(dir);
+    if (it == sFileLedgers.end()) {
+        return;
+    }
+    string file_name = output.getFullFileName(dir.c_str());
+    auto entryIt = it->second.mFiles.find(file_name);
+    if (entryIt == it->second.mFiles.end() && !addIfMissing) {
+        return;
+    }
+    struct stat fileInfo;
+    int64_t fileSize = fstat(fd, &fileInfo) == 0 ? fileInfo.st_size : 0;
+    it->second.mFiles[file_name] = {output.mTimestampSec, output.mIsHistory, fileSize};
+}
+
+static void noteFileDeleted(const string& file) {
+    string dir;
+    FileName output;
+    if (!parseFullFileName(file, &dir, &output)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(sFileLedgerMutex);
+    auto it = sFileLedgers.find(dir);
+    if (it != sFileLedgers.end()) {
+        it->second.mFiles.erase(output.getFullFileName(dir.c_str()));
+    }
+}
+
+static void noteFileRenamed(const string& from, const string& to) {
+    string fromDir;
+    string toDir;
+    FileName fromOutput;
+    FileName toOutput;
+    const bool fromParsed = parseFullFileName(from, &fromDir, &fromOutput);
+    const bool toParsed = parseFullFileName(to, &toDir, &toOutput);
+    std::lock_guard<std::mutex> lock(sFileLedgerMutex);
+    int64_t fileSize = 0;
+    if (fromParsed) {
+        auto it = sFileLedgers.find(fromDir);
+        if (it != sFileLedgers.end()) {
+            auto entryIt = it->second.mFiles.find(fromOutput.getFullFileName(fromDir.c_str()));
+            if (entryIt != it->second.mFiles.end()) {
+                fileSize = entryIt->second.mFileSizeBytes;
+                it->second.mFiles.erase(entryIt);
+            }
+        }
+    }
+    if (toParsed) {
+        auto it = sFileLedgers.find(toDir);
+        if (it != sFileLedgers.end()) {
+            it->second.mFiles[toOutput.getFullFileName(toDir.c_str())] = {
+                    toOutput.mTimestampSec, toOutput.mIsHistory, fileSize};
+        }
+    }
+}
+
 // Returns array of int64_t which contains a sqlite db's uid and configId
 static ConfigKey parseDbName(char* name) {
     char* uid = strtok(name, "_");
@@ -138,6 +298,8 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
         VLOG("Attempt to access %s but failed", file);
         return;
     }
+    // The file is counted with its current size by the trims below, as a directory scan would.
+    noteFileWritten(file, fd, /*addIfMissing=*/true);
     trimToFit(STATS_SERVICE_DIR);
     trimToFit(STATS_DATA_DIR);
 
@@ -146,6 +308,8 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
     } else {
         ALOGE("Failed to write %s", file);
     }
+    // Do not bring the file back into the ledger if the trims above deleted it.
+    noteFileWritten(file, fd, /*addIfMissing=*/false);
 
     int result = fchown(fd, AID_STATSD, AID_STATSD);
     if (result) {
@@ -155,6 +319,20 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
     close(fd);
 }
 
+void StorageManager::setCompressFiles(bool compressFiles) {
+    sCompressFiles = compressFiles;
+}
+
+void StorageManager::writeCompressibleFile(const char* file, const void* buffer, int numBytes) {
+    string compressed;
+    if (sCompressFiles && compressFileContent(buffer, numBytes, &compressed)) {
+        // The directory size limits are enforced on the compressed size.
+        writeFile(file, compressed.data(), compressed.size());
+        return;
+    }
+    writeFile(file, buffer, numBytes);
+}
+
 bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
     std::lock_guard<std::mutex> lock(sTrainInfoMutex);
 
@@ -459,10 +637,8 @@ vector<InstallTrainInfo> StorageManager::readAllTrainInfo() {
 }
 
 void StorageManager::deleteFile(const char* file) {
-    if (remove(file) != 0) {
-        VLOG("Attempt to delete %s but is not found", file);
-    } else {
-        VLOG("Successfully deleted %s", file);
+    if (removeFile(file)) {
+        noteFileDeleted(file);
     }
 }
 
@@ -576,7 +752,11 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
         int fd = open(fullPathName.c_str(), O_RDONLY | O_CLOEXEC);
         if (fd != -1) {
             string content;
-            if (android::base::ReadFdToString(fd, &content)) {
+            if (!android::base::ReadFdToString(fd, &content)) {
+                ALOGE("Failed to read %s", fullPathName.c_str());
+            } else if (!decompressFileContent(&content)) {
+                ALOGE("Failed to decompress %s", fullPathName.c_str());
+            } else {
                 proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
                              content.c_str(), content.size());
             }
@@ -586,7 +766,7 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
         }
 
         if (erase_data) {
-            remove(fullPathName.c_str());
+            deleteFile(fullPathName.c_str());
         } else if (!output.mIsHistory && !isAdb) {
             // This means a real data owner has called to get this data. But the config says it
             // wants to keep a local history. So now this file must be renamed as a history file.
@@ -594,6 +774,8 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
             // again. rename returns 0 on success
             if (rename(fullPathName.c_str(), (fullPathName + "_history").c_str())) {
                 ALOGE("Failed to rename file %s", fullPathName.c_str());
+            } else {
+                noteFileRenamed(fullPathName, fullPathName + "_history");
             }
         }
     }
@@ -721,6 +903,10 @@ void StorageManager::sortFiles(vector<FileInfo>* fileNames) {
 }
 
 void StorageManager::trimToFit(const char* path, bool parseTimestampOnly) {
+    if (!parseTimestampOnly) {
+        trimToFitFromLedger(path);
+        return;
+    }
     unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
     if (dir == NULL) {
         VLOG("Path %s does not exist", path);
@@ -779,6 +965,50 @@ void StorageManager::trimToFit(const char* path, bool parseTimestampOnly) {
     }
 }
 
+void StorageManager::trimToFitFromLedger(const char* path) {
+    std::lock_guard<std::mutex> lock(sFileLedgerMutex);
+    auto nowSec = getWallClockSec();
+    FileLedger* ledger = getFileLedgerLocked(path, nowSec);
+    if (ledger == nullptr) {
+        return;
+    }
+    int totalFileSize = 0;
+    vector<FileInfo> fileNames;
+    for (auto it = ledger->mFiles.begin(); it != ledger->mFiles.end();) {
+        // Check for timestamp and delete if it's too old.
+        long fileAge = nowSec - it->second.mTimestampSec;
+        if (fileAge > StatsdStats::kMaxAgeSecond ||
+            (it->second.mIsHistory && fileAge > StatsdStats::kMaxLocalHistoryAgeSecond)) {
+            if (removeFile(it->first.c_str())) {
+                it = ledger->mFiles.erase(it);
+            } else {
+                it++;
+            }
+            continue;
+        }
+        int fileSize = it->second.mFileSizeBytes;
+        totalFileSize += fileSize;
+        fileNames.emplace_back(it->first, it->second.mIsHistory, fileSize, fileAge);
+        it++;
+    }
+
+    if (fileNames.size() > StatsdStats::kMaxFileNumber ||
+        totalFileSize > StatsdStats::kMaxFileSize) {
+        sortFiles(&fileNames);
+    }
+
+    // Start removing files from oldest to be under the limit.
+    while (fileNames.size() > 0 && (fileNames.size() > StatsdStats::kMaxFileNumber ||
+                                    totalFileSize > StatsdStats::kMaxFileSize)) {
+        const FileInfo& oldest = fileNames.at(fileNames.size() - 1);
+        totalFileSize -= oldest.mFileSizeBytes;
+        if (removeFile(oldest.mFileName.c_str())) {
+            ledger->mFiles.erase(oldest.mFileName);
+        }
+        fileNames.pop_back();
+    }
+}
+
 void StorageManager::printStats(int outFd) {
     printDirStats(outFd, STATS_SERVICE_DIR);
     printDirStats(outFd, STATS_DATA_DIR);
@@ -59,6 +59,17 @@ public:
      */
     static void writeFile(const char* file, const void* buffer, int numBytes);
 
+    /**
+     * Enables the compression of the files written by writeCompressibleFile.
+     */
+    static void setCompressFiles(bool compressFiles);
+
+    /**
+     * Writes a report or metadata file, compressed if enabled. The content read back must go
+     * through decompressFileContent, which also accepts files written without compression.
+     */
+    static void writeCompressibleFile(const char* file, const void* buffer, int numBytes);
+
     /**
      * Writes train info.
      */
@@ -142,6 +153,10 @@ public:
     /**
      * Trims files in the provided directory to limit the total size, number of
      * files, accumulation of outdated files.
+     *
+     * Unless parseTimestampOnly is set, the decisions are made from an in-memory ledger of the
+     * directory which is built by the first call, kept up to date by writeFile(), deleteFile()
+     * and appendConfigMetricsReport(), and periodically reconciled with the directory content.
      */
     static void trimToFit(const char* dir, bool parseTimestampOnly = false);
 
@@ -172,6 +187,11 @@ private:
      */
     static void printDirStats(int out, const char* path);
 
+    /**
+     * Same as trimToFit, but uses the in-memory ledger of the directory instead of scanning it.
+     */
+    static void trimToFitFromLedger(const char* path);
+
     static std::mutex sTrainInfoMutex;
 };
 
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "utils/AtomEncoder.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_FLOAT;
+using android::util::FIELD_TYPE_INT32;
+using android::util::FIELD_TYPE_INT64;
+using android::util::FIELD_TYPE_MESSAGE;
+using android::util::FIELD_TYPE_STRING;
+using android::util::ProtoOutputStream;
+using std::vector;
+
+// Mirrors writeFieldValueTreeToStreamHelper, but records the operations instead of writing them.
+// See the comment on writeFieldValueTreeToStreamHelper for the supported atom formats.
+void AtomEncoder::buildOps(const vector<FieldValue>& values, size_t* index, int depth, int prefix,
+                           vector<Op>* ops) {
+    size_t count = values.size();
+    while (*index < count) {
+        const auto& value = values[*index];
+        const int valueDepth = value.mField.getDepth();
+        const int valuePrefix = value.mField.getPrefix(depth);
+        const int fieldNum = value.mField.getPosAtDepth(depth);
+        const uint64_t repeatedFieldMask = (valueDepth == 1) ? FIELD_COUNT_REPEATED : 0;
+        if (valueDepth > 2) {
+            ALOGE("Depth > 2 not supported");
+            return;
+        }
+
+        if ((depth == valueDepth || valueDepth == 1) && valuePrefix == prefix) {
+            uint64_t fieldType = 0;
+            switch (value.mValue.getType()) {
+                case INT:
+                    fieldType = FIELD_TYPE_INT32 | repeatedFieldMask;
+                    break;
+                case LONG:
+                    fieldType = FIELD_TYPE_INT64 | repeatedFieldMask;
+                    break;
+                case FLOAT:
+                    fieldType = FIELD_TYPE_FLOAT | repeatedFieldMask;
+                    break;
+                case STRING:
+                    fieldType = FIELD_TYPE_STRING | repeatedFieldMask;
+                    break;
+                case STORAGE:
+                    fieldType = FIELD_TYPE_MESSAGE;
+                    break;
+                default:
+                    break;
+            }
+            if (fieldType != 0) {
+                ops->push_back({Op::WRITE, (uint32_t)*index, fieldType | fieldNum});
+            }
+            (*index)++;
+        } else if (valueDepth == depth + 2 && valuePrefix == prefix) {
+            ops->push_back({Op::START, 0, FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | fieldNum});
+            buildOps(values, index, valueDepth, value.mField.getPrefix(valueDepth), ops);
+            ops->push_back({Op::END, 0, 0});
+        } else {
+            return;
+        }
+    }
+}
+
+bool AtomEncoder::Plan::matches(const vector<FieldValue>& values) const {
+    const size_t count = values.size();
+    if (count != mFields.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (values[i].mField.getField() != mFields[i] || values[i].mValue.getType() != mTypes[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const AtomEncoder::Plan& AtomEncoder::getPlan(int tagId, const vector<FieldValue>& values) {
+    vector<Plan>& plans = mPlans[tagId];
+    for (const Plan& plan : plans) {
+        if (plan.matches(values)) {
+            return plan;
+        }
+    }
+
+    if (plans.size() >= kMaxPlansPerAtom) {
+        plans.erase(plans.begin());
+    }
+    Plan& plan = plans.emplace_back();
+    plan.mFields.reserve(values.size());
+    plan.mTypes.reserve(values.size());
+    for (const FieldValue& value : values) {
+        plan.mFields.push_back(value.mField.getField());
+        plan.mTypes.push_back(value.mValue.getType());
+    }
+    size_t index = 0;
+    buildOps(values, &index, 0, 0, &plan.mOps);
+    return plan;
+}
+
+void AtomEncoder::write(int tagId, const vector<FieldValue>& values,
+                        ProtoOutputStream* protoOutput) {
+    const uint64_t atomToken = protoOutput->start(FIELD_TYPE_MESSAGE | tagId);
+
+    // Only depths up to 2 are supported, so there is at most one open sub message.
+    uint64_t msgToken = 0ULL;
+    for (const Op& op : getPlan(tagId, values).mOps) {
+        switch (op.mKind) {
+            case Op::WRITE: {
+                const Value& value = values[op.mValueIndex].mValue;
+                switch (value.getType()) {
+                    case INT:
+                        protoOutput->write(op.mFieldId, value.int_value);
+                        break;
+                    case LONG:
+                        protoOutput->write(op.mFieldId, (long long)value.long_value);
+                        break;
+                    case FLOAT:
+                        protoOutput->write(op.mFieldId, value.float_value);
+                        break;
+                    case STRING:
+                        protoOutput->write(op.mFieldId, value.str_value);
+                        break;
+                    case STORAGE:
+                        protoOutput->write(op.mFieldId,
+                                           (const char*)value.storage_value.data(),
+                                           value.storage_value.size());
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            }
+            case Op::START:
+                msgToken = protoOutput->start(op.mFieldId);
+                break;
+            case Op::END:
+                if (msgToken != 0) {
+                    protoOutput->end(msgToken);
+                }
+                break;
+        }
+    }
+    protoOutput->end(atomToken);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
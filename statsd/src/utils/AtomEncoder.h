@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "FieldValue.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Writes atoms to a ProtoOutputStream. The output is identical to writeFieldValueTreeToStream.
+ *
+ * How an atom is nested (repeated fields, attribution chains) only depends on the fields and the
+ * value types of its FieldValues, i.e. on its layout. The encoder derives the sequence of proto
+ * operations for a layout once, and replays it for every following atom with the same layout
+ * instead of recomputing depths and position prefixes for every field.
+ *
+ * This class is not thread safe. Each owner holds its own encoder.
+ */
+class AtomEncoder {
+public:
+    AtomEncoder() = default;
+
+    AtomEncoder(const AtomEncoder&) = delete;
+    AtomEncoder& operator=(const AtomEncoder&) = delete;
+
+    void write(int tagId, const std::vector<FieldValue>& values,
+               android::util::ProtoOutputStream* protoOutput);
+
+private:
+    struct Op {
+        enum Kind : uint8_t { WRITE, START, END };
+        Kind mKind;
+        uint32_t mValueIndex;
+        // Full field id, including the type and repeated bits.
+        uint64_t mFieldId;
+    };
+
+    struct Plan {
+        // Layout this plan was built for.
+        std::vector<int32_t> mFields;
+        std::vector<Type> mTypes;
+
+        std::vector<Op> mOps;
+
+        bool matches(const std::vector<FieldValue>& values) const;
+    };
+
+    const Plan& getPlan(int tagId, const std::vector<FieldValue>& values);
+
+    static void buildOps(const std::vector<FieldValue>& values, size_t* index, int depth,
+                         int prefix, std::vector<Op>* ops);
+
+    // Atoms with an attribution chain or repeated fields have one layout per length, so a few
+    // plans are kept per atom.
+    static const size_t kMaxPlansPerAtom = 4;
+
+    std::unordered_map<int, std::vector<Plan>> mPlans;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
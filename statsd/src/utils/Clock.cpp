@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utils/Clock.h"
+
+#include <time.h>
+#include <utils/SystemClock.h>
+#include <utils/Timers.h>
+
+#include <mutex>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int64_t kNsPerSec = 1000000000LL;
+
+DeviceClock gDeviceClock;
+
+std::atomic<const Clock*> gClock = &gDeviceClock;
+
+}  // anonymous namespace
+
+const Clock& Clock::get() {
+    return *gClock.load(std::memory_order_acquire);
+}
+
+void Clock::set(std::shared_ptr<Clock> clock) {
+    static std::mutex mutex;
+    static std::vector<std::shared_ptr<Clock>>* installedClocks =
+            new std::vector<std::shared_ptr<Clock>>();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (clock == nullptr) {
+        gClock.store(&gDeviceClock, std::memory_order_release);
+        return;
+    }
+    installedClocks->push_back(clock);
+    gClock.store(clock.get(), std::memory_order_release);
+}
+
+int64_t DeviceClock::getElapsedRealtimeNs() const {
+    return ::android::elapsedRealtimeNano();
+}
+
+int64_t DeviceClock::getUptimeNs() const {
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+int64_t DeviceClock::getWallClockNs() const {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * kNsPerSec + ts.tv_nsec;
+}
+
+SimulatedClock::SimulatedClock(int64_t elapsedRealtimeNs, int64_t wallClockNs)
+    : mElapsedRealtimeNs(elapsedRealtimeNs),
+      mUptimeNs(elapsedRealtimeNs),
+      mWallClockNs(wallClockNs) {
+}
+
+int64_t SimulatedClock::getElapsedRealtimeNs() const {
+    return mElapsedRealtimeNs;
+}
+
+int64_t SimulatedClock::getUptimeNs() const {
+    return mUptimeNs;
+}
+
+int64_t SimulatedClock::getWallClockNs() const {
+    return mWallClockNs;
+}
+
+void SimulatedClock::advance(int64_t durationNs) {
+    mUptimeNs += durationNs;
+    suspend(durationNs);
+}
+
+void SimulatedClock::suspend(int64_t durationNs) {
+    mElapsedRealtimeNs += durationNs;
+    mWallClockNs += durationNs;
+}
+
+void SimulatedClock::setWallClockNs(int64_t wallClockNs) {
+    mWallClockNs = wallClockNs;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
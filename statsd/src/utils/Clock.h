@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Source of the current time in statsd. The time helpers in stats_log_util.h
+ * (getElapsedRealtimeNs, getWallClockNs, ...) read the installed clock, which is the device clock
+ * unless a test, benchmark or host tool installs another one with Clock::set.
+ */
+class Clock {
+public:
+    virtual ~Clock(){};
+
+    // Time since boot, including time spent in suspend.
+    virtual int64_t getElapsedRealtimeNs() const = 0;
+
+    // Time since boot, excluding time spent in suspend.
+    virtual int64_t getUptimeNs() const = 0;
+
+    // Time since the epoch.
+    virtual int64_t getWallClockNs() const = 0;
+
+    // Returns the installed clock.
+    static const Clock& get();
+
+    // Installs clock as the source of time for statsd. Passing nullptr reinstalls the device
+    // clock. Installed clocks are kept alive until the process exits so that a concurrent reader
+    // never sees a destroyed clock.
+    static void set(std::shared_ptr<Clock> clock);
+};
+
+// Reads the device clocks.
+class DeviceClock final : public Clock {
+public:
+    int64_t getElapsedRealtimeNs() const override;
+
+    int64_t getUptimeNs() const override;
+
+    int64_t getWallClockNs() const override;
+};
+
+/**
+ * Clock that only moves when it is advanced, so that scenarios spanning days of buckets, TTLs,
+ * activations and refractory periods can run deterministically and without sleeping.
+ * Thread safe.
+ */
+class SimulatedClock final : public Clock {
+public:
+    SimulatedClock(int64_t elapsedRealtimeNs, int64_t wallClockNs);
+
+    int64_t getElapsedRealtimeNs() const override;
+
+    int64_t getUptimeNs() const override;
+
+    int64_t getWallClockNs() const override;
+
+    // Moves all the clocks forward by durationNs, as if the device was awake.
+    void advance(int64_t durationNs);
+
+    // Moves the elapsed realtime and wall clock forward by durationNs, as if the device was
+    // suspended. The uptime does not change.
+    void suspend(int64_t durationNs);
+
+    // Sets the wall clock, as if the user or the network changed the time.
+    void setWallClockNs(int64_t wallClockNs);
+
+private:
+    std::atomic<int64_t> mElapsedRealtimeNs;
+
+    std::atomic<int64_t> mUptimeNs;
+
+    std::atomic<int64_t> mWallClockNs;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
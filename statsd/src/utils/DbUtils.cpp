@@ -22,6 +22,9 @@
 
 #include <android/api-level.h>
 
+#include <limits>
+#include <map>
+
 #include "FieldValue.h"
 #include "android-base/properties.h"
 #include "android-base/stringprintf.h"
@@ -42,6 +45,8 @@ using base::GetProperty;
 using base::StringPrintf;
 
 const string TABLE_NAME_PREFIX = "metric_";
+const string PARTITION_NAME_PREFIX = "_p";
+const string LEGACY_PARTITION_NAME_SUFFIX = "_legacy";
 const string COLUMN_NAME_ATOM_TAG = "atomId";
 const string COLUMN_NAME_EVENT_ELAPSED_CLOCK_NS = "elapsedTimestampNs";
 const string COLUMN_NAME_EVENT_WALL_CLOCK_NS = "wallTimestampNs";
@@ -83,6 +88,107 @@ static std::vector<std::string> getExpectedTableSchema(const LogEvent& logEvent)
     return result;
 }
 
+// Restricted data is partitioned into one table per wall clock day. The table that queries
+// read from, metric_<id>, is a view over the union of all partitions of the metric.
+static const int64_t kNsPerDay = 24 * 3600 * NS_PER_SEC;
+
+// Key of the partition holding a table created before partitioning was introduced.
+static const int64_t kLegacyPartitionDay = std::numeric_limits<int64_t>::min();
+
+static int64_t getPartitionDay(const int64_t wallClockNs) {
+    return wallClockNs < 0 ? 0 : wallClockNs / kNsPerDay;
+}
+
+static string getMetricTableName(const int64_t metricId) {
+    return TABLE_NAME_PREFIX + reformatMetricId(metricId);
+}
+
+static string getPartitionName(const int64_t metricId, const int64_t day) {
+    if (day == kLegacyPartitionDay) {
+        return getMetricTableName(metricId) + LEGACY_PARTITION_NAME_SUFFIX;
+    }
+    return StringPrintf("%s%s%lld", getMetricTableName(metricId).c_str(),
+                        PARTITION_NAME_PREFIX.c_str(), (long long)day);
+}
+
+static bool execSql(sqlite3* db, const string& zSql, string& err) {
+    char* error = nullptr;
+    sqlite3_exec(db, zSql.c_str(), nullptr, nullptr, &error);
+    if (error) {
+        err = error;
+        sqlite3_free(error);
+        return false;
+    }
+    return true;
+}
+
+/* Recreates the metric_<id> view over the given partitions. */
+static bool rebuildView(sqlite3* db, const int64_t metricId,
+                        const std::map<int64_t, string>& partitions, string& err) {
+    const string tableName = getMetricTableName(metricId);
+    if (!execSql(db, StringPrintf("DROP VIEW IF EXISTS %s", tableName.c_str()), err)) {
+        return false;
+    }
+    if (partitions.empty()) {
+        return true;
+    }
+    string zSql = StringPrintf("CREATE VIEW %s AS ", tableName.c_str());
+    for (const auto& [day, partitionName] : partitions) {
+        zSql += StringPrintf("SELECT * FROM %s UNION ALL ", partitionName.c_str());
+    }
+    zSql.resize(zSql.size() - strlen(" UNION ALL "));
+    return execSql(db, zSql, err);
+}
+
+/* Loads the partitions of the given metric, keyed by wall clock day. A table written by an older
+ * statsd version is renamed to the legacy partition.
+ */
+static bool loadPartitions(sqlite3* db, const int64_t metricId, std::map<int64_t, string>& partitions,
+                           string& err) {
+    const string tableName = getMetricTableName(metricId);
+    const string partitionPrefix = tableName + PARTITION_NAME_PREFIX;
+    const string legacyName = getPartitionName(metricId, kLegacyPartitionDay);
+    sqlite3_stmt* stmt = nullptr;
+    string zSql = "SELECT name, type FROM sqlite_master WHERE name = ? OR name = ? OR name GLOB ?";
+    if (sqlite3_prepare_v2(db, zSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        err = sqlite3_errmsg(db);
+        sqlite3_finalize(stmt);
+        return false;
+    }
+    const string partitionGlob = partitionPrefix + "[0-9]*";
+    sqlite3_bind_text(stmt, 1, tableName.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, legacyName.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, partitionGlob.c_str(), -1, SQLITE_STATIC);
+    bool hasUnpartitionedTable = false;
+    int result;
+    while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const string name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        const string type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        if (name == tableName) {
+            hasUnpartitionedTable = type == "table";
+        } else if (name == legacyName) {
+            partitions[kLegacyPartitionDay] = name;
+        } else {
+            partitions[std::stoll(name.substr(partitionPrefix.size()))] = name;
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (result != SQLITE_DONE) {
+        err = sqlite3_errmsg(db);
+        return false;
+    }
+    if (hasUnpartitionedTable) {
+        if (!execSql(db, StringPrintf("ALTER TABLE %s RENAME TO %s", tableName.c_str(),
+                                      legacyName.c_str()),
+                     err)) {
+            return false;
+        }
+        partitions[kLegacyPartitionDay] = legacyName;
+        return rebuildView(db, metricId, partitions, err);
+    }
+    return true;
+}
+
 static int integrityCheckCallback(void*, int colCount, char** queryResults, char**) {
     if (colCount == 0 || strcmp(queryResults[0], "ok") != 0) {
         // Returning 1 is an error code that causes exec to stop and error.
@@ -96,9 +202,8 @@ string getDbName(const ConfigKey& key) {
                         (long long)key.GetId());
 }
 
-static string getCreateSqlString(const int64_t metricId, const LogEvent& event) {
-    string result = StringPrintf("CREATE TABLE IF NOT EXISTS %s%s", TABLE_NAME_PREFIX.c_str(),
-                                 reformatMetricId(metricId).c_str());
+static string getCreateSqlString(const string& partitionName, const LogEvent& event) {
+    string result = StringPrintf("CREATE TABLE IF NOT EXISTS %s", partitionName.c_str());
     result += StringPrintf("(%s INTEGER,%s INTEGER,%s INTEGER,", COLUMN_NAME_ATOM_TAG.c_str(),
                            COLUMN_NAME_EVENT_ELAPSED_CLOCK_NS.c_str(),
                            COLUMN_NAME_EVENT_WALL_CLOCK_NS.c_str());
@@ -134,6 +239,37 @@ string reformatMetricId(const int64_t metricId) {
                         : StringPrintf("%lld", (long long)metricId);
 }
 
+/* Creates the partitions for the given days that do not exist yet, using the schema of the
+ * corresponding event, and refreshes the metric view if any partition was added.
+ */
+static bool createPartitionsIfNeeded(sqlite3* db, const int64_t metricId,
+                                     const std::map<int64_t, const LogEvent*>& eventsByDay,
+                                     std::map<int64_t, string>& partitions, string& err) {
+    bool partitionCreated = false;
+    for (const auto& [day, event] : eventsByDay) {
+        if (partitions.find(day) != partitions.end()) {
+            continue;
+        }
+        const string partitionName = getPartitionName(metricId, day);
+        if (!execSql(db, getCreateSqlString(partitionName, *event), err)) {
+            return false;
+        }
+        partitions[day] = partitionName;
+        partitionCreated = true;
+    }
+    return !partitionCreated || rebuildView(db, metricId, partitions, err);
+}
+
+/* Ends the transaction started on db, committing it only if success is true. */
+static bool endTransaction(sqlite3* db, const bool success, string& err) {
+    if (!success) {
+        string rollbackErr;
+        execSql(db, "ROLLBACK", rollbackErr);
+        return false;
+    }
+    return execSql(db, "COMMIT", err);
+}
+
 bool createTableIfNeeded(const ConfigKey& key, const int64_t metricId, const LogEvent& event) {
     const string dbName = getDbName(key);
     sqlite3* db;
@@ -142,12 +278,21 @@ bool createTableIfNeeded(const ConfigKey& key, const int64_t metricId, const Log
         return false;
     }
 
-    char* error = nullptr;
-    string zSql = getCreateSqlString(metricId, event);
-    sqlite3_exec(db, zSql.c_str(), nullptr, nullptr, &error);
+    string err;
+    std::map<int64_t, string> partitions;
+    bool success = execSql(db, "BEGIN IMMEDIATE", err);
+    if (success) {
+        success = loadPartitions(db, metricId, partitions, err);
+        if (success && partitions.empty()) {
+            std::map<int64_t, const LogEvent*> eventsByDay = {
+                    {getPartitionDay(event.GetLogdTimestampNs()), &event}};
+            success = createPartitionsIfNeeded(db, metricId, eventsByDay, partitions, err);
+        }
+        success = endTransaction(db, success, err);
+    }
     sqlite3_close(db);
-    if (error) {
-        ALOGW("Failed to create table to db: %s", error);
+    if (!success) {
+        ALOGW("Failed to create table to db: %s", err.c_str());
         return false;
     }
     return true;
@@ -194,12 +339,26 @@ bool deleteTable(const ConfigKey& key, const int64_t metricId) {
         sqlite3_close(db);
         return false;
     }
-    string zSql = StringPrintf("DROP TABLE metric_%s", reformatMetricId(metricId).c_str());
-    char* error = nullptr;
-    sqlite3_exec(db, zSql.c_str(), nullptr, nullptr, &error);
+    string err;
+    std::map<int64_t, string> partitions;
+    bool success = execSql(db, "BEGIN IMMEDIATE", err);
+    if (success) {
+        success = loadPartitions(db, metricId, partitions, err);
+        if (success && partitions.empty()) {
+            err = StringPrintf("no such table: %s", getMetricTableName(metricId).c_str());
+            success = false;
+        }
+        if (success) {
+            success = rebuildView(db, metricId, {}, err);
+        }
+        for (auto it = partitions.begin(); success && it != partitions.end(); ++it) {
+            success = execSql(db, StringPrintf("DROP TABLE %s", it->second.c_str()), err);
+        }
+        success = endTransaction(db, success, err);
+    }
     sqlite3_close(db);
-    if (error) {
-        ALOGW("Failed to drop table from db: %s", error);
+    if (!success) {
+        ALOGW("Failed to drop table from db: %s", err.c_str());
         return false;
     }
     return true;
@@ -223,15 +382,14 @@ void closeDb(sqlite3* db) {
     sqlite3_close(db);
 }
 
-static bool getInsertSqlStmt(sqlite3* db, sqlite3_stmt** stmt, const int64_t metricId,
-                             const vector<LogEvent>& events, string& err) {
-    string result =
-            StringPrintf("INSERT INTO metric_%s VALUES", reformatMetricId(metricId).c_str());
-    for (auto& logEvent : events) {
-        result += StringPrintf("(%d, %lld, %lld,", logEvent.GetTagId(),
-                               (long long)logEvent.GetElapsedTimestampNs(),
-                               (long long)logEvent.GetLogdTimestampNs());
-        for (auto& fieldValue : logEvent.getValues()) {
+static bool getInsertSqlStmt(sqlite3* db, sqlite3_stmt** stmt, const string& partitionName,
+                             const vector<const LogEvent*>& events, string& err) {
+    string result = StringPrintf("INSERT INTO %s VALUES", partitionName.c_str());
+    for (const LogEvent* logEvent : events) {
+        result += StringPrintf("(%d, %lld, %lld,", logEvent->GetTagId(),
+                               (long long)logEvent->GetElapsedTimestampNs(),
+                               (long long)logEvent->GetLogdTimestampNs());
+        for (auto& fieldValue : logEvent->getValues()) {
             if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
                 // Repeated fields and byte fields are not supported.
                 continue;
@@ -250,8 +408,8 @@ static bool getInsertSqlStmt(sqlite3* db, sqlite3_stmt** stmt, const int64_t met
     // ? parameters start with an index of 1 from start of query string to the
     // end.
     int32_t index = 1;
-    for (auto& logEvent : events) {
-        for (auto& fieldValue : logEvent.getValues()) {
+    for (const LogEvent* logEvent : events) {
+        for (auto& fieldValue : logEvent->getValues()) {
             if (fieldValue.mField.getDepth() > 0 || fieldValue.mValue.getType() == STORAGE) {
                 // Repeated fields and byte fields are not supported.
                 continue;
@@ -294,9 +452,10 @@ bool insert(const ConfigKey& key, const int64_t metricId, const vector<LogEvent>
     return success;
 }
 
-bool insert(sqlite3* db, const int64_t metricId, const vector<LogEvent>& events, string& error) {
+static bool insertIntoPartition(sqlite3* db, const string& partitionName,
+                                const vector<const LogEvent*>& events, string& error) {
     sqlite3_stmt* stmt = nullptr;
-    if (!getInsertSqlStmt(db, &stmt, metricId, events, error)) {
+    if (!getInsertSqlStmt(db, &stmt, partitionName, events, error)) {
         ALOGW("Failed to generate prepared sql insert query %s", error.c_str());
         sqlite3_finalize(stmt);
         return false;
@@ -311,6 +470,31 @@ bool insert(sqlite3* db, const int64_t metricId, const vector<LogEvent>& events,
     return true;
 }
 
+bool insert(sqlite3* db, const int64_t metricId, const vector<LogEvent>& events, string& error) {
+    std::map<int64_t, vector<const LogEvent*>> eventsByDay;
+    std::map<int64_t, const LogEvent*> schemaEventByDay;
+    for (const LogEvent& event : events) {
+        const int64_t day = getPartitionDay(event.GetLogdTimestampNs());
+        eventsByDay[day].push_back(&event);
+        schemaEventByDay.emplace(day, &event);
+    }
+    if (!execSql(db, "BEGIN IMMEDIATE", error)) {
+        ALOGW("Failed to begin insert transaction: %s", error.c_str());
+        return false;
+    }
+    std::map<int64_t, string> partitions;
+    bool success = loadPartitions(db, metricId, partitions, error) &&
+                   createPartitionsIfNeeded(db, metricId, schemaEventByDay, partitions, error);
+    for (auto it = eventsByDay.begin(); success && it != eventsByDay.end(); ++it) {
+        success = insertIntoPartition(db, partitions[it->first], it->second, error);
+    }
+    if (!endTransaction(db, success, error)) {
+        ALOGW("Failed to insert data to db: %s", error.c_str());
+        return false;
+    }
+    return true;
+}
+
 bool query(const ConfigKey& key, const string& zSql, vector<vector<string>>& rows,
            vector<int32_t>& columnTypes, vector<string>& columnNames, string& err) {
     const string dbName = getDbName(key);
@@ -361,15 +545,65 @@ bool query(const ConfigKey& key, const string& zSql, vector<vector<string>>& row
     return true;
 }
 
-bool flushTtl(sqlite3* db, const int64_t metricId, const int64_t ttlWallClockNs) {
-    string zSql = StringPrintf("DELETE FROM %s%s WHERE %s <= %lld", TABLE_NAME_PREFIX.c_str(),
-                               reformatMetricId(metricId).c_str(),
-                               COLUMN_NAME_EVENT_WALL_CLOCK_NS.c_str(), (long long)ttlWallClockNs);
+static bool deleteExpiredRows(sqlite3* db, const string& partitionName,
+                              const int64_t ttlWallClockNs, string& err) {
+    return execSql(db,
+                   StringPrintf("DELETE FROM %s WHERE %s <= %lld", partitionName.c_str(),
+                                COLUMN_NAME_EVENT_WALL_CLOCK_NS.c_str(), (long long)ttlWallClockNs),
+                   err);
+}
 
-    char* error = nullptr;
-    sqlite3_exec(db, zSql.c_str(), nullptr, nullptr, &error);
-    if (error) {
-        ALOGW("Failed to enforce ttl: %s", error);
+static bool isPartitionEmpty(sqlite3* db, const string& partitionName) {
+    sqlite3_stmt* stmt = nullptr;
+    string zSql = StringPrintf("SELECT 1 FROM %s LIMIT 1", partitionName.c_str());
+    if (sqlite3_prepare_v2(db, zSql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        sqlite3_finalize(stmt);
+        return false;
+    }
+    const bool empty = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_finalize(stmt);
+    return empty;
+}
+
+bool flushTtl(sqlite3* db, const int64_t metricId, const int64_t ttlWallClockNs) {
+    string err;
+    if (!execSql(db, "BEGIN IMMEDIATE", err)) {
+        ALOGW("Failed to enforce ttl: %s", err.c_str());
+        return false;
+    }
+    std::map<int64_t, string> partitions;
+    bool success = loadPartitions(db, metricId, partitions, err);
+    bool partitionDropped = false;
+    for (auto it = partitions.begin(); success && it != partitions.end();) {
+        const int64_t day = it->first;
+        const bool isNewestPartition = std::next(it) == partitions.end();
+        if (day == kLegacyPartitionDay || day * kNsPerDay <= ttlWallClockNs) {
+            // Whole partitions are dropped when all of their rows are expired. The newest
+            // partition is kept so that the metric view and its schema outlive the data.
+            const bool expired = day != kLegacyPartitionDay &&
+                                 (day + 1) * kNsPerDay - 1 <= ttlWallClockNs;
+            if (expired && !isNewestPartition) {
+                success = execSql(db, StringPrintf("DROP TABLE %s", it->second.c_str()), err);
+                it = partitions.erase(it);
+                partitionDropped = true;
+                continue;
+            }
+            success = deleteExpiredRows(db, it->second, ttlWallClockNs, err);
+            if (success && day == kLegacyPartitionDay && !isNewestPartition &&
+                isPartitionEmpty(db, it->second)) {
+                success = execSql(db, StringPrintf("DROP TABLE %s", it->second.c_str()), err);
+                it = partitions.erase(it);
+                partitionDropped = true;
+                continue;
+            }
+        }
+        ++it;
+    }
+    if (success && partitionDropped) {
+        success = rebuildView(db, metricId, partitions, err);
+    }
+    if (!endTransaction(db, success, err)) {
+        ALOGW("Failed to enforce ttl: %s", err.c_str());
         return false;
     }
     return true;
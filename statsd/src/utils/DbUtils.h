@@ -38,7 +38,10 @@ string getDbName(const ConfigKey& key);
 
 string reformatMetricId(const int64_t metricId);
 
-/* Creates a new data table for a specified metric if one does not yet exist. */
+/* Creates a new data table for a specified metric if one does not yet exist.
+ * Metric data is partitioned into one table per wall clock day; metric_<id> is a view over all
+ * partitions of the metric. Tables created before partitioning are migrated to a partition.
+ */
 bool createTableIfNeeded(const ConfigKey& key, int64_t metricId, const LogEvent& event);
 
 /* Checks whether the table schema for the given metric matches the event.
@@ -46,7 +49,7 @@ bool createTableIfNeeded(const ConfigKey& key, int64_t metricId, const LogEvent&
  */
 bool isEventCompatible(const ConfigKey& key, int64_t metricId, const LogEvent& event);
 
-/* Deletes a data table for the specified metric. */
+/* Deletes the data table and all its partitions for the specified metric. */
 bool deleteTable(const ConfigKey& key, int64_t metricId);
 
 /* Deletes the SQLite db data file. */
@@ -65,7 +68,9 @@ void closeDb(sqlite3* db);
  */
 bool insert(const ConfigKey& key, int64_t metricId, const vector<LogEvent>& events, string& error);
 
-/* Inserts new data into the specified sqlite db handle. */
+/* Inserts new data into the specified sqlite db handle.
+ * Partitions are created for events that fall on a day without one.
+ */
 bool insert(sqlite3* db, int64_t metricId, const vector<LogEvent>& events, string& error);
 
 /* Executes a sql query on the specified SQLite db.
@@ -74,6 +79,9 @@ bool insert(sqlite3* db, int64_t metricId, const vector<LogEvent>& events, strin
 bool query(const ConfigKey& key, const string& zSql, vector<vector<string>>& rows,
            vector<int32_t>& columnTypes, vector<string>& columnNames, string& err);
 
+/* Deletes data at or older than ttlWallClockNs for the specified metric. Partitions that are
+ * entirely expired are dropped; rows are only deleted from the partition spanning the ttl.
+ */
 bool flushTtl(sqlite3* db, int64_t metricId, int64_t ttlWallClockNs);
 
 /* Checks for database corruption and deletes the db if it is corrupted. */
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "HyperLogLog.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+HyperLogLog::HyperLogLog(int precision)
+    : mPrecision(std::clamp(precision, kMinPrecision, kMaxPrecision)),
+      mRegisters(1 << mPrecision, 0) {
+}
+
+void HyperLogLog::add(uint64_t hash) {
+    // The first bits of the hash select the register, the others give the rank.
+    const size_t index = hash >> (64 - mPrecision);
+    const uint64_t remaining = hash << mPrecision;
+    const uint8_t rank = remaining == 0 ? 64 - mPrecision + 1 : __builtin_clzll(remaining) + 1;
+    mRegisters[index] = std::max(mRegisters[index], rank);
+}
+
+bool HyperLogLog::merge(const HyperLogLog& other) {
+    if (mPrecision != other.mPrecision) {
+        ALOGE("Cannot merge HyperLogLog with precision %d into precision %d", other.mPrecision,
+              mPrecision);
+        return false;
+    }
+    for (size_t i = 0; i < mRegisters.size(); i++) {
+        mRegisters[i] = std::max(mRegisters[i], other.mRegisters[i]);
+    }
+    return true;
+}
+
+int64_t HyperLogLog::estimate() const {
+    const double m = mRegisters.size();
+    double alpha;
+    switch (mRegisters.size()) {
+        case 16:
+            alpha = 0.673;
+            break;
+        case 32:
+            alpha = 0.697;
+            break;
+        case 64:
+            alpha = 0.709;
+            break;
+        default:
+            alpha = 0.7213 / (1 + 1.079 / m);
+            break;
+    }
+
+    double sum = 0;
+    int zeroRegisters = 0;
+    for (const uint8_t rank : mRegisters) {
+        sum += std::ldexp(1.0, -rank);
+        if (rank == 0) {
+            zeroRegisters++;
+        }
+    }
+    double estimate = alpha * m * m / sum;
+
+    // Small cardinalities are estimated more accurately by linear counting of the empty
+    // registers. No large range correction is needed with 64-bit hashes.
+    if (estimate <= 2.5 * m && zeroRegisters > 0) {
+        estimate = m * std::log(m / zeroRegisters);
+    }
+    return std::llround(estimate);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * HyperLogLog sketch estimating the number of distinct 64-bit hashes added to it.
+ *
+ * The sketch has 2^precision one-byte registers, so its memory does not depend on the number of
+ * values added: 4 KiB for the default precision of 12. The relative standard error of the estimate
+ * is about 1.04 / sqrt(2^precision), 1.6% for the default precision. Sketches with the same
+ * precision can be merged, which gives the sketch of the union of their values.
+ *
+ * This class is not thread safe.
+ */
+class HyperLogLog {
+public:
+    static constexpr int kMinPrecision = 4;
+    static constexpr int kMaxPrecision = 14;
+    static constexpr int kDefaultPrecision = 12;
+
+    // precision must be in [kMinPrecision, kMaxPrecision].
+    explicit HyperLogLog(int precision);
+
+    void add(uint64_t hash);
+
+    // Merges the registers of a sketch with the same precision. Returns false if the precisions
+    // differ.
+    bool merge(const HyperLogLog& other);
+
+    int64_t estimate() const;
+
+    inline int getPrecision() const {
+        return mPrecision;
+    }
+
+    inline const std::vector<uint8_t>& getRegisters() const {
+        return mRegisters;
+    }
+
+    inline size_t getSizeBytes() const {
+        return mRegisters.size();
+    }
+
+private:
+    const int mPrecision;
+
+    // Largest rank (position of the first set bit) seen in the hashes of each register.
+    std::vector<uint8_t> mRegisters;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "utils/ProtoOutputStreamPool.h"
+
+#include <algorithm>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using android::util::ProtoOutputStream;
+using std::lock_guard;
+using std::unique_ptr;
+
+void ProtoOutputStreamPool::Releaser::operator()(ProtoOutputStream* stream) const {
+    if (mPool == nullptr) {
+        delete stream;
+        return;
+    }
+    mPool->release(stream, mCapacityBytes);
+}
+
+ProtoOutputStreamPool::ProtoOutputStreamPool() : mPooledBytes(0) {
+}
+
+ProtoOutputStreamPool& ProtoOutputStreamPool::getInstance() {
+    static ProtoOutputStreamPool pool;
+    return pool;
+}
+
+size_t ProtoOutputStreamPool::getSizeClass(size_t bytes) {
+    for (size_t i = 0; i < kNumSizeClasses - 1; i++) {
+        if (bytes <= kSizeClassBytes[i]) {
+            return i;
+        }
+    }
+    return kNumSizeClasses - 1;
+}
+
+ProtoOutputStreamPool::Stream ProtoOutputStreamPool::takeLocked(size_t sizeClass) {
+    PooledStream& pooled = mStreams[sizeClass].back();
+    Stream stream(pooled.mStream.release(), Releaser(this, pooled.mCapacityBytes));
+    mPooledBytes -= pooled.mCapacityBytes;
+    mStreams[sizeClass].pop_back();
+    return stream;
+}
+
+ProtoOutputStreamPool::Stream ProtoOutputStreamPool::acquire(size_t sizeHintBytes) {
+    lock_guard<std::mutex> lock(mMutex);
+    const size_t sizeClass = getSizeClass(sizeHintBytes);
+    // Prefer a buffer that is already large enough. Otherwise, the largest smaller one.
+    for (size_t i = sizeClass; i < kNumSizeClasses; i++) {
+        if (!mStreams[i].empty()) {
+            return takeLocked(i);
+        }
+    }
+    for (size_t i = sizeClass; i-- > 0;) {
+        if (!mStreams[i].empty()) {
+            return takeLocked(i);
+        }
+    }
+    return Stream(new ProtoOutputStream(), Releaser(this, 0));
+}
+
+void ProtoOutputStreamPool::release(ProtoOutputStream* stream, size_t capacityBytes) {
+    unique_ptr<ProtoOutputStream> owned(stream);
+    // The buffer keeps its chunks when cleared, so its capacity is at least its largest output.
+    capacityBytes = std::max(capacityBytes, owned->size());
+    owned->clear();
+
+    lock_guard<std::mutex> lock(mMutex);
+    std::vector<PooledStream>& streams = mStreams[getSizeClass(capacityBytes)];
+    if (streams.size() >= kMaxStreamsPerSizeClass ||
+        mPooledBytes + capacityBytes > kMaxPooledBytes) {
+        VLOG("Dropping output stream of %zu bytes, %zu bytes pooled", capacityBytes, mPooledBytes);
+        return;
+    }
+    mPooledBytes += capacityBytes;
+    streams.push_back({std::move(owned), capacityBytes});
+}
+
+void ProtoOutputStreamPool::trim() {
+    lock_guard<std::mutex> lock(mMutex);
+    for (size_t i = 0; i < kNumSizeClasses; i++) {
+        mStreams[i].clear();
+    }
+    mPooledBytes = 0;
+}
+
+size_t ProtoOutputStreamPool::getPooledBytes() const {
+    lock_guard<std::mutex> lock(mMutex);
+    return mPooledBytes;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
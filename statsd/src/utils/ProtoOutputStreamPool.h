@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Pool of ProtoOutputStreams for report, disk and stats dumps.
+ *
+ * A ProtoOutputStream keeps the chunks of its EncodedBuffer when it is cleared, so reusing one
+ * avoids growing a new buffer, and the allocations and page faults that come with it, on every
+ * dump. Pooled streams are grouped by the size their buffer has grown to, so that callers that
+ * expect large output get a stream that already has a large buffer.
+ *
+ * The memory held by idle streams is capped by kMaxPooledBytes, and all of it can be released with
+ * trim() when statsd is under memory pressure.
+ *
+ * This class is thread safe.
+ */
+class ProtoOutputStreamPool final {
+public:
+    class Releaser {
+    public:
+        Releaser() = default;
+
+        void operator()(android::util::ProtoOutputStream* stream) const;
+
+    private:
+        Releaser(ProtoOutputStreamPool* pool, size_t capacityBytes)
+            : mPool(pool), mCapacityBytes(capacityBytes) {
+        }
+
+        ProtoOutputStreamPool* mPool = nullptr;
+
+        // Largest size the buffer of the stream is known to have grown to.
+        size_t mCapacityBytes = 0;
+
+        friend class ProtoOutputStreamPool;
+    };
+
+    // A stream borrowed from the pool. It returns to the pool when the handle is destroyed.
+    using Stream = std::unique_ptr<android::util::ProtoOutputStream, Releaser>;
+
+    static ProtoOutputStreamPool& getInstance();
+
+    /**
+     * Returns an empty stream. sizeHintBytes is the expected size of the output, if known.
+     */
+    Stream acquire(size_t sizeHintBytes = 0);
+
+    /**
+     * Releases all idle streams.
+     */
+    void trim();
+
+    /**
+     * Returns the memory held by idle streams.
+     */
+    size_t getPooledBytes() const;
+
+    // Upper bound of each size class. Streams larger than the last bound are in the last class.
+    static constexpr size_t kSizeClassBytes[] = {64 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+
+    static constexpr size_t kNumSizeClasses = sizeof(kSizeClassBytes) / sizeof(size_t);
+
+    // Maximum memory held by idle streams.
+    static const size_t kMaxPooledBytes = 8 * 1024 * 1024;
+
+    // Maximum number of idle streams per size class.
+    static const size_t kMaxStreamsPerSizeClass = 4;
+
+private:
+    ProtoOutputStreamPool();
+
+    struct PooledStream {
+        std::unique_ptr<android::util::ProtoOutputStream> mStream;
+        size_t mCapacityBytes;
+    };
+
+    static size_t getSizeClass(size_t bytes);
+
+    Stream takeLocked(size_t sizeClass);
+
+    void release(android::util::ProtoOutputStream* stream, size_t capacityBytes);
+
+    mutable std::mutex mMutex;
+
+    std::vector<PooledStream> mStreams[kNumSizeClasses];
+
+    size_t mPooledBytes;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
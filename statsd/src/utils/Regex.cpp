@@ -16,54 +16,510 @@
 
 #include "Regex.h"
 
+#include <ctype.h>
 #include <log/log.h>
 
 namespace android {
 namespace os {
 namespace statsd {
 
+using std::bitset;
 using std::string;
+using std::string_view;
 using std::unique_ptr;
+using std::vector;
 
-Regex::Regex(regex_t impl) : mImpl(std::move(impl)) {
+namespace {
+
+using CharClass = bitset<256>;
+using Instruction = Regex::Instruction;
+using Op = Regex::Op;
+
+// Upper bound of {m,n} repetitions, RE_DUP_MAX.
+constexpr int kMaxRepetitions = 255;
+
+// Bounds the matching cost of a single pattern.
+constexpr size_t kMaxProgramSize = 4096;
+
+constexpr int kUnbounded = -1;
+
+bool addNamedClass(string_view name, CharClass* charClass) {
+    static const struct {
+        const char* name;
+        int (*isInClass)(int);
+    } kNamedClasses[] = {
+            {"alnum", isalnum}, {"alpha", isalpha}, {"blank", isblank}, {"cntrl", iscntrl},
+            {"digit", isdigit}, {"graph", isgraph}, {"lower", islower}, {"print", isprint},
+            {"punct", ispunct}, {"space", isspace}, {"upper", isupper}, {"xdigit", isxdigit},
+    };
+    for (const auto& namedClass : kNamedClasses) {
+        if (name == namedClass.name) {
+            // Only ASCII is classified, as in the C locale.
+            for (int c = 0; c < 128; c++) {
+                if (namedClass.isInClass(c)) {
+                    charClass->set(c);
+                }
+            }
+            return true;
+        }
+    }
+    return false;
 }
 
-Regex::~Regex() {
-    regfree(&mImpl);
+// Compiles a pattern to a program for Regex. The program of each branch is built separately, with
+// jump targets relative to the start of the branch, and relocated when the branches are joined.
+class Compiler {
+public:
+    explicit Compiler(const string& pattern) : mPattern(pattern) {
+    }
+
+    // Returns false and sets mError if the pattern is invalid or unsupported.
+    bool compile();
+
+    vector<Instruction> mProgram;
+    vector<CharClass> mClasses;
+    const char* mError = nullptr;
+
+private:
+    bool parseBranch(vector<Instruction>* branch);
+
+    bool parseAtom(Instruction* atom);
+
+    bool parseBracket(Instruction* atom);
+
+    bool parseBracketSymbol(uint8_t* c);
+
+    bool parseBound(int* minCount, int* maxCount);
+
+    bool parseCount(int* count);
+
+    bool emitPiece(const Instruction& atom, int minCount, int maxCount,
+                   vector<Instruction>* branch);
+
+    bool isRepetitionNext() const;
+
+    inline bool more(size_t n = 1) const {
+        return mPos + n <= mPattern.size();
+    }
+
+    inline uint8_t peek(size_t offset = 0) const {
+        return mPattern[mPos + offset];
+    }
+
+    inline bool fail(const char* error) {
+        mError = error;
+        return false;
+    }
+
+    const string& mPattern;
+    size_t mPos = 0;
+};
+
+bool Compiler::compile() {
+    if (mPattern.find('\0') != string::npos) {
+        return fail("NUL character in pattern");
+    }
+    vector<vector<Instruction>> branches;
+    while (true) {
+        branches.emplace_back();
+        if (!parseBranch(&branches.back())) {
+            return false;
+        }
+        if (!more()) {
+            break;
+        }
+        // parseBranch only stops early at '|'.
+        mPos++;
+    }
+
+    // Each branch but the last one is preceded by a SPLIT to the next branch and followed by a
+    // JUMP to the final MATCH.
+    size_t programSize = 1 + (branches.size() - 1) * 2;
+    for (const vector<Instruction>& branch : branches) {
+        programSize += branch.size();
+    }
+    if (programSize > kMaxProgramSize) {
+        return fail("pattern is too large");
+    }
+    const int32_t matchPc = programSize - 1;
+    for (size_t i = 0; i < branches.size(); i++) {
+        const bool isLast = i + 1 == branches.size();
+        const int32_t branchStart = mProgram.size() + (isLast ? 0 : 1);
+        if (!isLast) {
+            const int32_t nextBranch = branchStart + branches[i].size() + 1;
+            mProgram.push_back({Op::SPLIT, 0, branchStart, nextBranch});
+        }
+        for (Instruction instruction : branches[i]) {
+            if (instruction.op == Op::SPLIT || instruction.op == Op::JUMP) {
+                instruction.x += branchStart;
+                instruction.y += branchStart;
+            }
+            mProgram.push_back(instruction);
+        }
+        if (!isLast) {
+            mProgram.push_back({Op::JUMP, 0, matchPc, 0});
+        }
+    }
+    mProgram.push_back({Op::MATCH, 0, 0, 0});
+    return true;
 }
 
-unique_ptr<Regex> Regex::create(const string& pattern) {
-    regex_t impl;
-    int status = regcomp(&impl, pattern.c_str(), REG_EXTENDED);
+bool Compiler::parseBranch(vector<Instruction>* branch) {
+    bool isEmpty = true;
+    while (more() && peek() != '|') {
+        Instruction atom;
+        if (!parseAtom(&atom)) {
+            return false;
+        }
+        int minCount = 1;
+        int maxCount = 1;
+        if (isRepetitionNext()) {
+            if (atom.op == Op::BEGIN || atom.op == Op::END) {
+                return fail("repetition of an anchor");
+            }
+            const uint8_t c = peek();
+            mPos++;
+            if (c == '*') {
+                minCount = 0;
+                maxCount = kUnbounded;
+            } else if (c == '+') {
+                maxCount = kUnbounded;
+            } else if (c == '?') {
+                minCount = 0;
+            } else if (!parseBound(&minCount, &maxCount)) {
+                return false;
+            }
+            if (isRepetitionNext()) {
+                return fail("repeated repetition operator");
+            }
+        }
+        if (!emitPiece(atom, minCount, maxCount, branch)) {
+            return false;
+        }
+        isEmpty = false;
+    }
+    if (isEmpty) {
+        return fail("empty branch");
+    }
+    return true;
+}
 
-    if (status != 0) {  // Invalid regex pattern.
-        // Calculate size of string needed to store error description.
-        size_t errBufSize = regerror(status, &impl, nullptr, 0);
+bool Compiler::isRepetitionNext() const {
+    if (!more()) {
+        return false;
+    }
+    const uint8_t c = peek();
+    return c == '*' || c == '+' || c == '?' || c == '{';
+}
 
-        // Get the error description.
-        char errBuf[errBufSize];
-        regerror(status, &impl, errBuf, errBufSize);
+bool Compiler::parseAtom(Instruction* atom) {
+    const uint8_t c = peek();
+    mPos++;
+    switch (c) {
+        case '(':
+        case ')':
+            return fail("subexpressions are not allowed");
+        case '*':
+        case '+':
+        case '?':
+            return fail("repetition operator without operand");
+        case '{':
+            // An unescaped '{' that does not start a repetition count is ambiguous in POSIX.
+            return fail("'{' without operand");
+        case '.':
+            *atom = {Op::ANY, 0, 0, 0};
+            return true;
+        case '[':
+            return parseBracket(atom);
+        case '^':
+            *atom = {Op::BEGIN, 0, 0, 0};
+            return true;
+        case '$':
+            *atom = {Op::END, 0, 0, 0};
+            return true;
+        case '\\':
+            if (!more()) {
+                return fail("trailing backslash");
+            }
+            // Escaped letters and digits are extensions with implementation defined meaning.
+            if (isalnum(peek())) {
+                return fail("unsupported escape sequence");
+            }
+            *atom = {Op::CHAR, peek(), 0, 0};
+            mPos++;
+            return true;
+        default:
+            *atom = {Op::CHAR, c, 0, 0};
+            return true;
+    }
+}
 
-        ALOGE("regex_error: %s, pattern: %s", errBuf, pattern.c_str());
-        regfree(&impl);
-        return nullptr;
-    } else if (impl.re_nsub > 0) {
-        ALOGE("regex_error: subexpressions are not allowed, pattern: %s", pattern.c_str());
-        regfree(&impl);
+// Follows the bracket expression grammar of POSIX regcomp: a leading ']' or '-' is an ordinary
+// character, as is a '-' right before the closing ']'.
+bool Compiler::parseBracket(Instruction* atom) {
+    CharClass charClass;
+    bool negate = false;
+    if (more() && peek() == '^') {
+        negate = true;
+        mPos++;
+    }
+    if (more() && (peek() == ']' || peek() == '-')) {
+        charClass.set(peek());
+        mPos++;
+    }
+    while (more() && peek() != ']' && !(peek() == '-' && more(2) && peek(1) == ']')) {
+        if (peek() == '-') {
+            return fail("invalid range in bracket expression");
+        }
+        if (peek() == '[' && more(2) && (peek(1) == '=' || peek(1) == '.')) {
+            return fail("equivalence classes and collating elements are not supported");
+        }
+        if (peek() == '[' && more(2) && peek(1) == ':') {
+            const size_t nameStart = mPos + 2;
+            const size_t nameEnd = mPattern.find(":]", nameStart);
+            if (nameEnd == string::npos) {
+                return fail("unterminated character class");
+            }
+            if (!addNamedClass(string_view(mPattern).substr(nameStart, nameEnd - nameStart),
+                               &charClass)) {
+                return fail("unknown character class");
+            }
+            mPos = nameEnd + 2;
+            continue;
+        }
+        uint8_t first;
+        if (!parseBracketSymbol(&first)) {
+            return false;
+        }
+        uint8_t last = first;
+        if (more(2) && peek() == '-' && peek(1) != ']') {
+            mPos++;
+            if (peek() == '-') {
+                last = '-';
+                mPos++;
+            } else if (!parseBracketSymbol(&last)) {
+                return false;
+            }
+        }
+        if (first > last) {
+            return fail("invalid range in bracket expression");
+        }
+        for (int c = first; c <= last; c++) {
+            charClass.set(c);
+        }
+    }
+    if (more() && peek() == '-') {
+        charClass.set('-');
+        mPos++;
+    }
+    if (!more() || peek() != ']') {
+        return fail("unterminated bracket expression");
+    }
+    mPos++;
+    if (negate) {
+        charClass.flip();
+    }
+    *atom = {Op::CLASS, 0, static_cast<int32_t>(mClasses.size()), 0};
+    mClasses.push_back(charClass);
+    return true;
+}
+
+bool Compiler::parseBracketSymbol(uint8_t* c) {
+    if (!more()) {
+        return fail("unterminated bracket expression");
+    }
+    if (peek() == '[' && more(2) && (peek(1) == '.' || peek(1) == '=' || peek(1) == ':')) {
+        return fail("unsupported range endpoint in bracket expression");
+    }
+    *c = peek();
+    mPos++;
+    return true;
+}
+
+// Parses "m}", "m,}" or "m,n}" after the opening '{'.
+bool Compiler::parseBound(int* minCount, int* maxCount) {
+    if (!parseCount(minCount)) {
+        return false;
+    }
+    *maxCount = *minCount;
+    if (more() && peek() == ',') {
+        mPos++;
+        *maxCount = kUnbounded;
+        if (more() && isdigit(peek())) {
+            if (!parseCount(maxCount)) {
+                return false;
+            }
+            if (*minCount > *maxCount) {
+                return fail("invalid repetition count");
+            }
+        }
+    }
+    if (!more() || peek() != '}') {
+        return fail("unterminated repetition count");
+    }
+    mPos++;
+    return true;
+}
+
+bool Compiler::parseCount(int* count) {
+    int digits = 0;
+    *count = 0;
+    while (more() && isdigit(peek()) && *count <= kMaxRepetitions) {
+        *count = *count * 10 + (peek() - '0');
+        mPos++;
+        digits++;
+    }
+    if (digits == 0 || *count > kMaxRepetitions) {
+        return fail("invalid repetition count");
+    }
+    return true;
+}
+
+bool Compiler::emitPiece(const Instruction& atom, int minCount, int maxCount,
+                         vector<Instruction>* branch) {
+    const size_t optionalCount = maxCount == kUnbounded ? 1 : maxCount - minCount;
+    if (branch->size() + minCount + optionalCount * 3 > kMaxProgramSize) {
+        return fail("pattern is too large");
+    }
+    for (int i = 0; i < minCount; i++) {
+        branch->push_back(atom);
+    }
+    if (maxCount == kUnbounded) {
+        // L: SPLIT L+1, L+3; L+1: atom; L+2: JUMP L; L+3:
+        const int32_t loop = branch->size();
+        branch->push_back({Op::SPLIT, 0, loop + 1, loop + 3});
+        branch->push_back(atom);
+        branch->push_back({Op::JUMP, 0, loop, 0});
+        return true;
+    }
+    for (int i = minCount; i < maxCount; i++) {
+        // L: SPLIT L+1, L+2; L+1: atom; L+2:
+        const int32_t split = branch->size();
+        branch->push_back({Op::SPLIT, 0, split + 1, split + 2});
+        branch->push_back(atom);
+    }
+    return true;
+}
+
+}  // anonymous namespace
+
+Regex::Regex(vector<Instruction> program, vector<bitset<256>> classes)
+    : mProgram(std::move(program)), mClasses(std::move(classes)) {
+}
+
+unique_ptr<Regex> Regex::create(const string& pattern) {
+    Compiler compiler(pattern);
+    if (!compiler.compile()) {
+        ALOGE("regex_error: %s, pattern: %s", compiler.mError, pattern.c_str());
         return nullptr;
-    } else {
-        return std::make_unique<Regex>(impl);
     }
+    return std::make_unique<Regex>(std::move(compiler.mProgram), std::move(compiler.mClasses));
 }
 
-bool Regex::replace(string& str, const string& replacement) {
-    regmatch_t match;
-    int status = regexec(&mImpl, str.c_str(), 1 /* nmatch */, &match /* pmatch */, 0 /* flags */);
+// Simulates the program over str with one thread per program counter. Threads remember the start
+// of their match and are kept ordered by it, so when two threads reach the same program counter,
+// the first one has the leftmost start and the other one can be dropped: both would match the same
+// continuations. New threads are started at every position until a match is found. The longest
+// match with the leftmost start is kept.
+bool Regex::match(string_view str, size_t* matchStart, size_t* matchEnd) const {
+    struct Thread {
+        int32_t pc;
+        size_t start;
+    };
+    const size_t kNoMatch = string_view::npos;
+    vector<Thread> current;
+    vector<Thread> next;
+    current.reserve(mProgram.size());
+    next.reserve(mProgram.size());
+    // Position at which each program counter was last added to a thread list.
+    vector<size_t> lastAdded(mProgram.size(), kNoMatch);
+    vector<int32_t> stack;
+
+    // Adds the thread and follows the instructions that do not consume input.
+    auto addThread = [&](vector<Thread>& threads, int32_t startPc, size_t start, size_t pos) {
+        stack.push_back(startPc);
+        while (!stack.empty()) {
+            const int32_t pc = stack.back();
+            stack.pop_back();
+            if (lastAdded[pc] == pos) {
+                continue;
+            }
+            lastAdded[pc] = pos;
+            const Instruction& instruction = mProgram[pc];
+            switch (instruction.op) {
+                case Op::JUMP:
+                    stack.push_back(instruction.x);
+                    break;
+                case Op::SPLIT:
+                    stack.push_back(instruction.y);
+                    stack.push_back(instruction.x);
+                    break;
+                case Op::BEGIN:
+                    if (pos == 0) {
+                        stack.push_back(pc + 1);
+                    }
+                    break;
+                case Op::END:
+                    if (pos == str.size()) {
+                        stack.push_back(pc + 1);
+                    }
+                    break;
+                default:
+                    threads.push_back({pc, start});
+                    break;
+            }
+        }
+    };
+
+    size_t bestStart = kNoMatch;
+    size_t bestEnd = 0;
+    for (size_t pos = 0;; pos++) {
+        if (bestStart == kNoMatch) {
+            addThread(current, 0, pos, pos);
+        }
+        for (const Thread& thread : current) {
+            if (bestStart != kNoMatch && thread.start > bestStart) {
+                break;
+            }
+            const Instruction& instruction = mProgram[thread.pc];
+            if (instruction.op == Op::MATCH) {
+                if (thread.start < bestStart || pos > bestEnd) {
+                    bestStart = thread.start;
+                    bestEnd = pos;
+                }
+                continue;
+            }
+            if (pos == str.size()) {
+                continue;
+            }
+            const uint8_t c = str[pos];
+            if ((instruction.op == Op::CHAR && instruction.c == c) || instruction.op == Op::ANY ||
+                (instruction.op == Op::CLASS && mClasses[instruction.x].test(c))) {
+                addThread(next, thread.pc + 1, thread.start, pos + 1);
+            }
+        }
+        if (pos == str.size() || (next.empty() && bestStart != kNoMatch)) {
+            break;
+        }
+        current.swap(next);
+        next.clear();
+    }
+
+    if (bestStart == kNoMatch) {
+        return false;
+    }
+    *matchStart = bestStart;
+    *matchEnd = bestEnd;
+    return true;
+}
 
-    if (status != 0 || match.rm_so == -1) {  // No match.
+bool Regex::replace(string& str, const string& replacement) const {
+    size_t matchStart;
+    size_t matchEnd;
+    if (!match(str, &matchStart, &matchEnd)) {
         return false;
     }
-    str.replace(match.rm_so, match.rm_eo - match.rm_so, replacement);
+    str.replace(matchStart, matchEnd - matchStart, replacement);
     return true;
 }
 
@@ -16,31 +16,70 @@
 
 #pragma once
 
-#include <regex.h>
+#include <stdint.h>
 
+#include <bitset>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 namespace android {
 namespace os {
 namespace statsd {
 
+/**
+ * Regular expression matcher for the subset of POSIX extended regular expressions (REG_EXTENDED)
+ * accepted in string replacements: ordinary and escaped characters, '.', bracket expressions with
+ * ranges and character classes, the '^' and '$' anchors, the '*', '+', '?' and '{m,n}'
+ * repetitions, and '|' alternation. Subexpressions, back references, collating elements,
+ * equivalence classes and escaped letters or digits are rejected.
+ *
+ * The pattern is compiled to an NFA that is simulated over the input one character at a time, so
+ * matching takes O(pattern size * input size) time and never backtracks. The match is the
+ * leftmost-longest one, the same that regexec would report.
+ */
 class Regex {
 public:
-    Regex(regex_t impl);  // Do not use. It is public for std::make_unique. Use Regex::create.
-    ~Regex();
+    enum class Op : uint8_t {
+        CHAR,   // Matches the byte c.
+        ANY,    // Matches any byte.
+        CLASS,  // Matches the bytes in mClasses[x].
+        SPLIT,  // Continues at both x and y.
+        JUMP,   // Continues at x.
+        BEGIN,  // Matches at the start of the input.
+        END,    // Matches at the end of the input.
+        MATCH,
+    };
+
+    struct Instruction {
+        Op op;
+        uint8_t c;
+        int32_t x;
+        int32_t y;
+    };
+
+    // Do not use. It is public for std::make_unique. Use Regex::create.
+    Regex(std::vector<Instruction> program, std::vector<std::bitset<256>> classes);
     Regex& operator=(const Regex&) = delete;
     Regex(const Regex&) = delete;
 
-    // Returns nullptr if pattern is not valid POSIX regex.
+    // Returns nullptr if pattern is not valid POSIX extended regex or uses syntax outside the
+    // supported subset.
     static std::unique_ptr<Regex> create(const std::string& pattern);
 
+    // Looks for the leftmost-longest match in str. Returns true and sets [matchStart, matchEnd) if
+    // there was a match, false otherwise.
+    bool match(std::string_view str, size_t* matchStart, size_t* matchEnd) const;
+
     // Looks for a regex match in str and replaces the matched portion with replacement in-place.
     // Returns true if there was a match, false otherwise.
-    bool replace(std::string& str, const std::string& replacement);
+    bool replace(std::string& str, const std::string& replacement) const;
 
 private:
-    regex_t mImpl;
+    const std::vector<Instruction> mProgram;
+
+    const std::vector<std::bitset<256>> mClasses;
 };
 
 }  // namespace statsd
@@ -41,7 +41,7 @@ public:
 private:
     ShardOffsetProvider(const uint32_t shardOffset);
 
-    // Only used for testing.
+    // Only used for testing and by the Replayer.
     void setShardOffset(const uint32_t shardOffset) {
         mShardOffset = shardOffset;
     }
@@ -55,7 +55,10 @@ private:
     FRIEND_TEST(GaugeMetricProducerTest, TestPullDimensionalSampling);
     FRIEND_TEST(KllMetricE2eTest, TestDimensionalSampling);
     FRIEND_TEST(NumericValueMetricProducerTest, TestDimensionalSampling);
+    FRIEND_TEST(ReplayerTest, TestReportDoesNotDependOnConfigOrder);
     FRIEND_TEST(StatsdStatsTest, TestShardOffsetProvider);
+
+    friend class Replayer;
 };
 
 }  // namespace statsd
@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Space-Saving summary of the heaviest keys of a weighted stream, with a fixed number of counters.
+ *
+ * Each counter holds a key, an estimated weight and the maximum error of that estimate. When a key
+ * without a counter arrives and all counters are in use, the counter with the smallest estimate is
+ * given to the new key, which inherits that estimate as its error. For every monitored key:
+ *     estimate - error <= true weight <= estimate
+ * and every key whose true weight is above getTotalWeight() / capacity is monitored.
+ *
+ * Counters are kept in an indexed min-heap on the estimate, so adding a weight is O(log capacity)
+ * and the memory used only depends on the capacity.
+ *
+ * Weights must not be negative. This class is not thread safe.
+ */
+template <class Key, class Hash = std::hash<Key>>
+class SpaceSavingSummary {
+public:
+    struct Counter {
+        Key key;
+        int64_t estimate;
+        int64_t error;
+    };
+
+    explicit SpaceSavingSummary(size_t capacity) : mCapacity(std::max<size_t>(capacity, 1)) {
+        mHeap.reserve(mCapacity);
+        mIndices.reserve(mCapacity);
+    }
+
+    void add(const Key& key, int64_t weight = 1) {
+        mTotalWeight += weight;
+        const auto it = mIndices.find(key);
+        if (it != mIndices.end()) {
+            mHeap[it->second].estimate += weight;
+            siftDown(it->second);
+            return;
+        }
+        if (mHeap.size() < mCapacity) {
+            mHeap.push_back({key, weight, 0});
+            mIndices[key] = mHeap.size() - 1;
+            siftUp(mHeap.size() - 1);
+            return;
+        }
+        // Replace the smallest counter.
+        Counter& smallest = mHeap[0];
+        mIndices.erase(smallest.key);
+        smallest.error = smallest.estimate;
+        smallest.estimate += weight;
+        smallest.key = key;
+        mIndices[key] = 0;
+        siftDown(0);
+    }
+
+    // Returns up to k counters with the largest estimates, largest first.
+    std::vector<Counter> getTopK(size_t k) const {
+        std::vector<Counter> counters(mHeap);
+        const size_t count = std::min(k, counters.size());
+        std::partial_sort(counters.begin(), counters.begin() + count, counters.end(),
+                          [](const Counter& a, const Counter& b) {
+                              return a.estimate > b.estimate;
+                          });
+        counters.resize(count);
+        return counters;
+    }
+
+    // Smallest estimate once all counters are in use. This bounds the weight of any key without a
+    // counter.
+    int64_t getMinEstimate() const {
+        return mHeap.size() < mCapacity ? 0 : mHeap[0].estimate;
+    }
+
+    int64_t getTotalWeight() const {
+        return mTotalWeight;
+    }
+
+    size_t size() const {
+        return mHeap.size();
+    }
+
+    size_t getCapacity() const {
+        return mCapacity;
+    }
+
+    bool empty() const {
+        return mHeap.empty();
+    }
+
+    void clear() {
+        mHeap.clear();
+        mIndices.clear();
+        mTotalWeight = 0;
+    }
+
+private:
+    void swapCounters(size_t a, size_t b) {
+        std::swap(mHeap[a], mHeap[b]);
+        mIndices[mHeap[a].key] = a;
+        mIndices[mHeap[b].key] = b;
+    }
+
+    void siftUp(size_t index) {
+        while (index > 0) {
+            const size_t parent = (index - 1) / 2;
+            if (mHeap[parent].estimate <= mHeap[index].estimate) {
+                return;
+            }
+            swapCounters(parent, index);
+            index = parent;
+        }
+    }
+
+    void siftDown(size_t index) {
+        const size_t size = mHeap.size();
+        while (true) {
+            size_t smallest = index;
+            const size_t left = 2 * index + 1;
+            const size_t right = left + 1;
+            if (left < size && mHeap[left].estimate < mHeap[smallest].estimate) {
+                smallest = left;
+            }
+            if (right < size && mHeap[right].estimate < mHeap[smallest].estimate) {
+                smallest = right;
+            }
+            if (smallest == index) {
+                return;
+            }
+            swapCounters(smallest, index);
+            index = smallest;
+        }
+    }
+
+    const size_t mCapacity;
+
+    // Min-heap of the counters on their estimate.
+    std::vector<Counter> mHeap;
+
+    // Index of the counter of each key in mHeap.
+    std::unordered_map<Key, size_t, Hash> mIndices;
+
+    int64_t mTotalWeight = 0;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -386,6 +386,60 @@ TEST(AtomMatcherTest, TestAttributionMatcher) {
     EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
 }
 
+TEST(AtomMatcherTest, TestAttributionMatcherNotFirstField) {
+    sp<UidMap> uidMap = new UidMap();
+
+    // Set up the log event with the attribution chain between two other fields.
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, TAG_ID);
+    AStatsEvent_writeInt32(statsEvent, 1111);
+    writeAttribution(statsEvent, {1111, 2222, 3333}, {"location1", "location2", "location3"});
+    AStatsEvent_writeInt32(statsEvent, 3333);
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, &event);
+
+    // Set up the matcher
+    AtomMatcher matcher;
+    auto simpleMatcher = matcher.mutable_simple_atom_matcher();
+    simpleMatcher->set_atom_id(TAG_ID);
+    auto attributionMatcher = simpleMatcher->add_field_value_matcher();
+    attributionMatcher->set_field(FIELD_ID_2);
+    auto tupleMatcher = attributionMatcher->mutable_matches_tuple();
+    tupleMatcher->add_field_value_matcher()->set_field(ATTRIBUTION_UID_FIELD_ID);
+    tupleMatcher->add_field_value_matcher()->set_field(ATTRIBUTION_TAG_FIELD_ID);
+
+    // Uid and tag of the same node.
+    tupleMatcher->mutable_field_value_matcher(0)->set_eq_int(2222);
+    tupleMatcher->mutable_field_value_matcher(1)->set_eq_string("location2");
+    attributionMatcher->set_position(Position::FIRST);
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+    attributionMatcher->set_position(Position::LAST);
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+    attributionMatcher->set_position(Position::ANY);
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+
+    // Uid and tag of different nodes.
+    tupleMatcher->mutable_field_value_matcher(1)->set_eq_string("location3");
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+
+    tupleMatcher->mutable_field_value_matcher(0)->set_eq_int(3333);
+    attributionMatcher->set_position(Position::LAST);
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+    attributionMatcher->set_position(Position::FIRST);
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+    tupleMatcher->mutable_field_value_matcher(0)->set_eq_int(1111);
+    tupleMatcher->mutable_field_value_matcher(1)->set_eq_string("location1");
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+
+    // The fields around the chain are still matched by position.
+    auto fieldMatcher = simpleMatcher->add_field_value_matcher();
+    fieldMatcher->set_field(FIELD_ID_3);
+    fieldMatcher->set_eq_int(3333);
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+    fieldMatcher->set_field(FIELD_ID_1);
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event).matched);
+}
+
 TEST(AtomMatcherTest, TestUidFieldMatcher) {
     sp<UidMap> uidMap = new UidMap();
 
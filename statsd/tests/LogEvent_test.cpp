@@ -217,6 +217,7 @@ TEST_P(LogEventTest, TestPrimitiveParsing) {
     EXPECT_EQ(1000, logEvent.GetUid());
     EXPECT_EQ(1001, logEvent.GetPid());
     EXPECT_FALSE(logEvent.hasAttributionChain());
+    EXPECT_EQ(0, logEvent.getAttributionChainNodeCount());
 
     const vector<FieldValue>& values = logEvent.getValues();
     ASSERT_EQ(4, values.size());
@@ -477,6 +478,45 @@ TEST_P(LogEventTest, TestAttributionChain) {
     AStatsEvent_release(event);
 }
 
+TEST_P(LogEventTest, TestAttributionChainView) {
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, 100);
+
+    uint32_t uids[] = {1001, 1002, 1003};
+    const char* tags[] = {"tag1", "tag2", "tag3"};
+
+    AStatsEvent_writeInt32(event, 10);
+    AStatsEvent_writeAttributionChain(event, uids, tags, 3);
+    AStatsEvent_writeInt32(event, 20);
+    AStatsEvent_build(event);
+
+    size_t size;
+    const uint8_t* buf = AStatsEvent_getBuffer(event, &size);
+
+    LogEvent logEvent(/*uid=*/1000, /*pid=*/1001);
+    EXPECT_TRUE(ParseBuffer(logEvent, buf, size));
+
+    ASSERT_EQ(3, logEvent.getAttributionChainNodeCount());
+    EXPECT_EQ(1, logEvent.getAttributionChainStartIndex());
+    for (size_t node = 0; node < 3; node++) {
+        const FieldValue& uid = logEvent.getAttributionUid(node);
+        EXPECT_TRUE(isAttributionUidField(uid));
+        EXPECT_EQ(uids[node], uid.mValue.int_value);
+        EXPECT_EQ(node + 1, uid.mField.getPosAtDepth(1));
+
+        const FieldValue& tag = logEvent.getAttributionTag(node);
+        EXPECT_EQ(tags[node], tag.mValue.str_value);
+        EXPECT_EQ(node + 1, tag.mField.getPosAtDepth(1));
+        EXPECT_EQ(2, tag.mField.getPosAtDepth(2));
+    }
+
+    // Writes through the view are visible in the FieldValues.
+    logEvent.getMutableAttributionUid(2).mValue.setInt(2000);
+    EXPECT_EQ(2000, logEvent.getValues()[5].mValue.int_value);
+
+    AStatsEvent_release(event);
+}
+
 TEST_P(LogEventTest, TestEmptyAttributionChain) {
     AStatsEvent* event = AStatsEvent_obtain();
     AStatsEvent_setAtomId(event, 100);
@@ -394,6 +394,99 @@ TEST(StatsLogProcessorTest, TestOnDumpReportEraseData) {
     EXPECT_TRUE(noData);
 }
 
+TEST(StatsLogProcessorTest, TestWriteDataToDiskOnShutdownWritesAllConfigs) {
+    ConfigKey key1(3, 4);
+    ConfigKey key2(3, 5);
+    ConfigKey key3(3, 6);
+    StatsdConfig config = MakeConfig(true);
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, key1);
+    config.set_persistence_priority(10);
+    processor->OnConfigUpdated(2, key2, config);
+    config.set_persistence_priority(-10);
+    processor->OnConfigUpdated(2, key3, config);
+
+    // Past the cool down period of WriteDataToDisk.
+    processor->WriteDataToDisk(DEVICE_SHUTDOWN, FAST, 20 * NS_PER_SEC, getWallClockNs());
+
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(key1));
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(key2));
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(key3));
+    EXPECT_EQ(processor->mOnDiskDataConfigs, (std::set<ConfigKey>{key1, key2, key3}));
+    StorageManager::deleteAllFiles(STATS_DATA_DIR);
+}
+
+TEST(StatsLogProcessorTest, TestShutdownPersistenceOrder) {
+    ConfigKey key1(3, 4);
+    ConfigKey key2(3, 5);
+    ConfigKey key3(3, 6);
+    ConfigKey key4(2, 7);
+    StatsdConfig config = MakeConfig(true);
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, key1);
+    config.set_persistence_priority(-10);
+    processor->OnConfigUpdated(2, key2, config);
+    config.set_persistence_priority(10);
+    processor->OnConfigUpdated(2, key3, config);
+    config.set_persistence_priority(0);
+    processor->OnConfigUpdated(2, key4, config);
+
+    // Highest priority first, then by config key.
+    const vector<sp<MetricsManager>> order = processor->getShutdownPersistenceOrderLocked();
+    ASSERT_EQ(order.size(), 4);
+    EXPECT_EQ(order[0]->getConfigKey(), key3);
+    EXPECT_EQ(order[1]->getConfigKey(), key4);
+    EXPECT_EQ(order[2]->getConfigKey(), key1);
+    EXPECT_EQ(order[3]->getConfigKey(), key2);
+}
+
+TEST(StatsLogProcessorTest, TestWriteDataToDiskOnShutdownStartDeadlineMissed) {
+    StatsdStats::getInstance().reset();
+    ConfigKey key1(3, 4);
+    ConfigKey key2(3, 5);
+    StatsdConfig config = MakeConfig(true);
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, key1);
+    processor->OnConfigUpdated(2, key2, config);
+
+    // No config can start before a zero deadline.
+    processor->setShutdownPersistenceStartDeadlineNs(0);
+    processor->WriteDataToDisk(DEVICE_SHUTDOWN, FAST, 20 * NS_PER_SEC, getWallClockNs());
+
+    EXPECT_FALSE(StorageManager::hasConfigMetricsReport(key1));
+    EXPECT_FALSE(StorageManager::hasConfigMetricsReport(key2));
+    EXPECT_TRUE(processor->mOnDiskDataConfigs.empty());
+    EXPECT_EQ(processor->mMetricsManagers[key1]->getPersistenceDeadlineMissedCount(), 1);
+    EXPECT_EQ(processor->mMetricsManagers[key2]->getPersistenceDeadlineMissedCount(), 1);
+
+    StatsdStatsReport statsReport = getStatsdStatsReport();
+    int missedConfigs = 0;
+    for (const auto& configStats : statsReport.config_stats()) {
+        if (configStats.id() == key1.GetId() || configStats.id() == key2.GetId()) {
+            EXPECT_EQ(configStats.data_persistence_deadline_missed(), 1);
+            missedConfigs++;
+        }
+    }
+    EXPECT_EQ(missedConfigs, 2);
+
+    // The missed writes are kept in the metadata until it is saved to disk.
+    metadata::StatsMetadataList metadataList;
+    processor->WriteMetadataToProto(getWallClockNs(), 20 * NS_PER_SEC, &metadataList);
+    ASSERT_EQ(metadataList.stats_metadata_size(), 2);
+    EXPECT_EQ(metadataList.stats_metadata(0).persistence_deadline_missed_count(), 1);
+    EXPECT_EQ(metadataList.stats_metadata(1).persistence_deadline_missed_count(), 1);
+
+    processor->SaveMetadataToDisk(getWallClockNs(), 20 * NS_PER_SEC);
+    EXPECT_EQ(processor->mMetricsManagers[key1]->getPersistenceDeadlineMissedCount(), 0);
+    EXPECT_EQ(processor->mMetricsManagers[key2]->getPersistenceDeadlineMissedCount(), 0);
+    StorageManager::deleteAllFiles("/data/misc/stats-metadata");
+
+    // The configs are written once the deadline allows them to start.
+    processor->setShutdownPersistenceStartDeadlineNs(NS_PER_SEC);
+    processor->WriteDataToDisk(DEVICE_SHUTDOWN, FAST, 40 * NS_PER_SEC, getWallClockNs());
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(key1));
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(key2));
+    EXPECT_EQ(processor->mMetricsManagers[key1]->getPersistenceDeadlineMissedCount(), 0);
+    StorageManager::deleteAllFiles(STATS_DATA_DIR);
+}
+
 TEST(StatsLogProcessorTest, TestPullUidProviderSetOnConfigUpdate) {
     // Setup simple config key corresponding to empty config.
     ConfigKey key(3, 4);
@@ -2345,6 +2438,7 @@ TEST_F(StatsLogProcessorTestRestricted, RestrictedMetricNotWriteToDisk) {
 
     processor->WriteDataToDiskLocked(mConfigKey, /*timestampNs=*/0, /*wallClockNs=*/0,
                                      CONFIG_UPDATED, FAST);
+    StatsLogProcessor::writePendingFiles(processor->takePendingFilesLocked());
 
     ASSERT_FALSE(StorageManager::hasConfigMetricsReport(mConfigKey));
 }
@@ -2355,6 +2449,9 @@ TEST_F(StatsLogProcessorTestRestricted, NonRestrictedMetricWriteToDisk) {
 
     processor->WriteDataToDiskLocked(mConfigKey, /*timestampNs=*/0, /*wallClockNs=*/0,
                                      CONFIG_UPDATED, FAST);
+    // The report is written once the caller releases the lock.
+    ASSERT_FALSE(StorageManager::hasConfigMetricsReport(mConfigKey));
+    StatsLogProcessor::writePendingFiles(processor->takePendingFilesLocked());
 
     ASSERT_TRUE(StorageManager::hasConfigMetricsReport(mConfigKey));
 }
@@ -54,6 +54,22 @@ const vector<string> kInstallers{"", "", "com.android.vending"};
 const vector<vector<uint8_t>> kCertificateHashes{{'a', 'z'}, {'b', 'c'}, {'d', 'e'}};
 const vector<uint8_t> kDeleted(3, false);
 
+class RecordingPackageInfoListener : public PackageInfoListener {
+public:
+    void notifyAppUpgrade(int64_t eventTimeNs, const string& apk, const int uid,
+                          int64_t version) override {
+    }
+
+    void notifyAppRemoved(int64_t eventTimeNs, const string& apk, const int uid) override {
+    }
+
+    void onUidMapReceived(int64_t eventTimeNs, const std::set<string>& changedPackages) override {
+        receivedChanges.push_back(changedPackages);
+    }
+
+    vector<std::set<string>> receivedChanges;
+};
+
 void sendPackagesToStatsd(shared_ptr<StatsService> service, const vector<int32_t>& uids,
                           const vector<int64_t>& versions, const vector<string>& versionStrings,
                           const vector<string>& apps, const vector<string>& installers,
@@ -518,6 +534,57 @@ TEST(UidMapTest, TestMemoryGuardrail) {
     ASSERT_EQ(1U, m.mChanges.size());
 }
 
+TEST(UidMapTest, TestUpdateMapAppliesDiff) {
+    UidMap m;
+    sp<RecordingPackageInfoListener> listener = new RecordingPackageInfoListener();
+    m.setListener(listener);
+
+    UidData uidData;
+    *uidData.add_app_info() = createApplicationInfo(/*uid*/ 1000, /*version*/ 4, "v4", kApp1);
+    *uidData.add_app_info() = createApplicationInfo(/*uid*/ 1000, /*version*/ 5, "v5", kApp2);
+    m.updateMap(1 /* timestamp */, uidData);
+
+    // The first map is not recorded as changes, but the listener learns about every package.
+    EXPECT_EQ(0U, m.mChanges.size());
+    ASSERT_EQ(1U, listener->receivedChanges.size());
+    EXPECT_EQ((std::set<string>{kApp1, kApp2}), listener->receivedChanges[0]);
+
+    // Refreshing with the same data is a no-op.
+    m.updateMap(2 /* timestamp */, uidData);
+    EXPECT_EQ(0U, m.mChanges.size());
+    EXPECT_EQ(1U, listener->receivedChanges.size());
+
+    // Upgrade kApp1, remove kApp2 and install kApp3.
+    uidData.Clear();
+    *uidData.add_app_info() = createApplicationInfo(/*uid*/ 1000, /*version*/ 40, "v40", kApp1);
+    *uidData.add_app_info() = createApplicationInfo(/*uid*/ 1500, /*version*/ 6, "v6", kApp3);
+    m.updateMap(3 /* timestamp */, uidData);
+
+    ASSERT_EQ(2U, listener->receivedChanges.size());
+    EXPECT_EQ((std::set<string>{kApp1, kApp2, kApp3}), listener->receivedChanges[1]);
+    EXPECT_EQ(40, m.getAppVersion(1000, kApp1));
+    EXPECT_FALSE(m.hasApp(1000, kApp2));
+    EXPECT_TRUE(m.hasApp(1500, kApp3));
+
+    ASSERT_EQ(3U, m.mChanges.size());
+    for (const ChangeRecord& change : m.mChanges) {
+        EXPECT_EQ(3, change.timestampNs);
+        if (change.package == kApp1) {
+            EXPECT_FALSE(change.deletion);
+            EXPECT_EQ(4, change.prevVersion);
+            EXPECT_EQ(40, change.version);
+        } else if (change.package == kApp2) {
+            EXPECT_TRUE(change.deletion);
+            EXPECT_EQ(5, change.prevVersion);
+        } else {
+            EXPECT_EQ(kApp3, change.package);
+            EXPECT_FALSE(change.deletion);
+            EXPECT_EQ(1500, change.uid);
+            EXPECT_EQ(6, change.version);
+        }
+    }
+}
+
 class UidMapTestAppendUidMap : public Test {
 protected:
     const ConfigKey config1;
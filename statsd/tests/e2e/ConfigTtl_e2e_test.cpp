@@ -16,6 +16,8 @@
 
 #include "src/StatsLogProcessor.h"
 #include "src/stats_log_util.h"
+#include "src/storage/FileCompression.h"
+#include "src/storage/StorageManager.h"
 #include "tests/statsd_test_util.h"
 
 #include <vector>
@@ -104,6 +106,43 @@ TEST(ConfigTtlE2eTest, TestCountMetric) {
                             ADB_DUMP, FAST, &buffer);
 }
 
+TEST(ConfigTtlE2eTest, TestTtlResetReportIsCompressed) {
+    auto config = CreateStatsdConfig(/*num_buckets=*/1, /*threshold=*/3);
+    int64_t bucketStartTimeNs = 10000000000;
+
+    ConfigKey cfgKey(0, 98765);
+    auto processor = CreateStatsLogProcessor(bucketStartTimeNs, bucketStartTimeNs, config, cfgKey);
+    auto event = CreateAcquireWakelockEvent(bucketStartTimeNs + 2, {111}, {"App1"}, "wl1");
+    processor->OnLogEvent(event.get());
+
+    // The report written on ttl expiry is compressed like the others, once the log event thread
+    // has released the metrics lock.
+    StorageManager::setCompressFiles(true);
+    const long startWallClockSec = getWallClockSec();
+    event = CreateAcquireWakelockEvent(bucketStartTimeNs + 3 * 3600 * NS_PER_SEC, {111}, {"App1"},
+                                       "wl1");
+    processor->OnLogEvent(event.get());
+    const long endWallClockSec = getWallClockSec();
+    StorageManager::setCompressFiles(false);
+
+    string content;
+    for (long sec = startWallClockSec; sec <= endWallClockSec && content.empty(); sec++) {
+        const string fileName =
+                StorageManager::getDataFileName(sec, cfgKey.GetUid(), cfgKey.GetId());
+        StorageManager::readFileToString(fileName.c_str(), &content);
+    }
+    ASSERT_FALSE(content.empty());
+    EXPECT_EQ('\0', content[0]);
+    ASSERT_TRUE(decompressFileContent(&content));
+    ConfigMetricsReport report;
+    EXPECT_TRUE(report.ParseFromString(content));
+
+    // Clear the data stored on disk as a result of the ttl.
+    vector<uint8_t> buffer;
+    processor->onDumpReport(cfgKey, bucketStartTimeNs + 3 * 3600 * NS_PER_SEC + 1, false, true,
+                            ADB_DUMP, FAST, &buffer);
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
@@ -19,6 +19,10 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <future>
+#include <thread>
+
 #include "stats_event.h"
 #include "tests/statsd_test_util.h"
 
@@ -74,6 +78,17 @@ public:
     int32_t mUid;
 };
 
+// Holds the pull open until the test finishes it.
+class BlockingPullAtomCallback : public BnPullAtomCallback {
+public:
+    Status onPullAtom(int atomTag,
+                      const shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        mPullStarted.set_value(resultReceiver);
+        return Status::ok();
+    }
+    std::promise<shared_ptr<IPullAtomResultReceiver>> mPullStarted;
+};
+
 class FakePullUidProvider : public PullUidProvider {
 public:
     vector<int32_t> getPullAtomUids(int atomId) override {
@@ -86,6 +101,21 @@ public:
     }
 };
 
+class FakePullDataReceiver : public PullDataReceiver {
+public:
+    void onDataPulled(const vector<shared_ptr<LogEvent>>& data, PullResult pullResult,
+                      int64_t originalPullTimeNs) override {
+        mPullResults.push_back(pullResult);
+        mPullTimesNs.push_back(originalPullTimeNs);
+    }
+    bool isPullNeeded() const override {
+        return mPullNeeded;
+    }
+    bool mPullNeeded = true;
+    vector<PullResult> mPullResults;
+    vector<int64_t> mPullTimesNs;
+};
+
 sp<StatsPullerManager> createPullerManagerAndRegister() {
     sp<StatsPullerManager> pullerManager = new StatsPullerManager();
     shared_ptr<FakePullAtomCallback> cb1 = SharedRefBase::make<FakePullAtomCallback>(uid1);
@@ -145,6 +175,123 @@ TEST(StatsPullerManagerTest, TestPullConfigKeyNoPullerWithUid) {
     EXPECT_FALSE(pullerManager->Pull(pullTagId2, configKey, /*timestamp =*/1, &data));
 }
 
+TEST(StatsPullerManagerTest, TestPullDoesNotBlockOtherAtoms) {
+    sp<StatsPullerManager> pullerManager = createPullerManagerAndRegister();
+    const int blockingTagId = 10103;
+    shared_ptr<BlockingPullAtomCallback> blockingCb =
+            SharedRefBase::make<BlockingPullAtomCallback>();
+    std::future<shared_ptr<IPullAtomResultReceiver>> pullStarted =
+            blockingCb->mPullStarted.get_future();
+    pullerManager->RegisterPullAtomCallback(uid1, blockingTagId, coolDownNs, 10 * NS_PER_SEC, {},
+                                            blockingCb);
+
+    std::atomic<bool> blockingPullDone = false;
+    std::thread blockingPull([&] {
+        vector<shared_ptr<LogEvent>> data;
+        pullerManager->Pull(blockingTagId, {uid1}, /*timestamp =*/1, &data);
+        blockingPullDone = true;
+    });
+    shared_ptr<IPullAtomResultReceiver> resultReceiver = pullStarted.get();
+
+    // Pulls of other atoms and puller registrations go through while the pull is in flight.
+    vector<shared_ptr<LogEvent>> data;
+    EXPECT_TRUE(pullerManager->Pull(pullTagId2, {uid1}, /*timestamp =*/1, &data));
+    pullerManager->RegisterPullAtomCallback(uid2, pullTagId2, coolDownNs, timeoutNs, {},
+                                            SharedRefBase::make<FakePullAtomCallback>(uid2));
+    pullerManager->UnregisterPullAtomCallback(uid2, pullTagId2);
+    EXPECT_FALSE(blockingPullDone);
+
+    resultReceiver->pullFinished(blockingTagId, /*success*/ true, {});
+    blockingPull.join();
+    EXPECT_TRUE(blockingPullDone);
+}
+
+TEST(StatsPullerManagerTest, TestConcurrentPullsAndRegistrations) {
+    sp<StatsPullerManager> pullerManager = createPullerManagerAndRegister();
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+
+    const int numPullThreads = 8;
+    const int numIterations = 200;
+    std::atomic<int> failedPulls = 0;
+    vector<std::thread> threads;
+    for (int t = 0; t < numPullThreads; t++) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < numIterations; i++) {
+                vector<shared_ptr<LogEvent>> data;
+                const int tagId = (t + i) % 2 == 0 ? pullTagId1 : pullTagId2;
+                if (!pullerManager->Pull(tagId, {uid1}, /*timestamp =*/i, &data)) {
+                    failedPulls++;
+                }
+                data.clear();
+                // Fails or succeeds depending on whether the uid2 puller is registered.
+                pullerManager->Pull(pullTagId2, configKey, /*timestamp =*/i, &data);
+            }
+        });
+    }
+    threads.emplace_back([&] {
+        shared_ptr<FakePullAtomCallback> cb = SharedRefBase::make<FakePullAtomCallback>(uid2);
+        for (int i = 0; i < numIterations; i++) {
+            pullerManager->RegisterPullAtomCallback(uid2, pullTagId2, coolDownNs, timeoutNs, {},
+                                                    cb);
+            pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+            pullerManager->ClearPullerCacheIfNecessary(/*timestampNs=*/i);
+            pullerManager->UnregisterPullAtomCallback(uid2, pullTagId2);
+        }
+    });
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, failedPulls);
+}
+
+TEST(StatsPullerManagerTest, TestAlarmPullDoesNotBlockReceivers) {
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    shared_ptr<BlockingPullAtomCallback> blockingCb =
+            SharedRefBase::make<BlockingPullAtomCallback>();
+    std::future<shared_ptr<IPullAtomResultReceiver>> pullStarted =
+            blockingCb->mPullStarted.get_future();
+    pullerManager->RegisterPullAtomCallback(uid1, pullTagId1, coolDownNs, 10 * NS_PER_SEC, {},
+                                            blockingCb);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+
+    const int64_t intervalNs = 60 * NS_PER_SEC;
+    const int64_t alarmTimeNs = 10 * NS_PER_SEC;
+    sp<FakePullDataReceiver> receiver = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(pullTagId1, configKey, receiver, alarmTimeNs, intervalNs);
+    sp<FakePullDataReceiver> idleReceiver = new FakePullDataReceiver();
+    idleReceiver->mPullNeeded = false;
+    pullerManager->RegisterReceiver(pullTagId2, configKey, idleReceiver, alarmTimeNs, intervalNs);
+
+    std::atomic<bool> alarmDone = false;
+    std::thread alarm([&] {
+        pullerManager->OnAlarmFired(alarmTimeNs);
+        alarmDone = true;
+    });
+    shared_ptr<IPullAtomResultReceiver> resultReceiver = pullStarted.get();
+
+    // The next pull time is already updated, and receivers can be registered and unregistered
+    // while the alarm pull is in flight.
+    EXPECT_EQ(alarmTimeNs + intervalNs, pullerManager->getNextPullTimeNs());
+    sp<FakePullDataReceiver> otherReceiver = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(pullTagId1, configKey, otherReceiver, alarmTimeNs + 1,
+                                    intervalNs);
+    EXPECT_EQ(alarmTimeNs + 1, pullerManager->getNextPullTimeNs());
+    pullerManager->UnRegisterReceiver(pullTagId1, configKey, otherReceiver);
+    EXPECT_FALSE(alarmDone);
+    ASSERT_EQ(1, idleReceiver->mPullResults.size());
+    EXPECT_EQ(PullResult::PULL_NOT_NEEDED, idleReceiver->mPullResults[0]);
+
+    resultReceiver->pullFinished(pullTagId1, /*success*/ true, {});
+    alarm.join();
+    EXPECT_TRUE(alarmDone);
+    ASSERT_EQ(1, receiver->mPullResults.size());
+    EXPECT_EQ(PullResult::PULL_RESULT_SUCCESS, receiver->mPullResults[0]);
+    EXPECT_EQ(alarmTimeNs, receiver->mPullTimesNs[0]);
+    EXPECT_TRUE(otherReceiver->mPullResults.empty());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
\ No newline at end of file
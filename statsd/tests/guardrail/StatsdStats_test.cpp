@@ -497,6 +497,8 @@ TEST(StatsdStatsTest, TestRestrictedMetricsStats) {
     stats.noteDbDeletionConfigRemoved(key);
     stats.noteDbDeletionConfigUpdated(key);
     stats.noteRestrictedConfigDbSize(key, 999, 111);
+    stats.noteDataPersistenceDeadlineMissed(key);
+    stats.noteDataPersistenceDeadlineMissed(key, /*count=*/2);
 
     StatsdStatsReport report = getStatsdStatsReport(stats, /* reset stats */ false);
     ASSERT_EQ(2, report.config_stats().size());
@@ -524,6 +526,8 @@ TEST(StatsdStatsTest, TestRestrictedMetricsStats) {
     EXPECT_EQ(1, report.config_stats(1).db_deletion_too_old());
     EXPECT_EQ(1, report.config_stats(1).db_deletion_config_removed());
     EXPECT_EQ(1, report.config_stats(1).db_deletion_config_updated());
+    EXPECT_EQ(3, report.config_stats(1).data_persistence_deadline_missed());
+    EXPECT_EQ(0, report.config_stats(0).data_persistence_deadline_missed());
 }
 
 TEST(StatsdStatsTest, TestRestrictedMetricsQueryStats) {
@@ -961,6 +965,18 @@ TEST(StatsdStatsTest, TestSubscriptionPullThreadWakeup) {
     EXPECT_EQ(subscriptionStats.pull_thread_wakeup_count(), 1);
 }
 
+TEST(StatsdStatsTest, TestSubscriptionEventDropped) {
+    StatsdStats stats;
+
+    stats.noteSubscriptionEventDropped();
+    stats.noteSubscriptionEventDropped();
+
+    StatsdStatsReport report = getStatsdStatsReport(stats, /* reset stats */ false);
+
+    auto subscriptionStats = report.subscription_stats();
+    EXPECT_EQ(subscriptionStats.event_dropped_count(), 2);
+}
+
 TEST(StatsdStatsTest, TestSubscriptionStartedMaxActiveSubscriptions) {
     StatsdStats stats;
 
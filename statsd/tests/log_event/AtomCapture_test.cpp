@@ -0,0 +1,143 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "logd/AtomCapture.h"
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+#include "socket/StatsSocketListener.h"
+#include "stats_event.h"
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+const int32_t kUid = 1001;
+const int32_t kPid = 1002;
+
+// Logs an atom with a string of stringSize bytes through the socket listener.
+void logAtom(int32_t atomId, int64_t timestampNs, size_t stringSize,
+             const std::shared_ptr<LogEventQueue>& queue,
+             const std::shared_ptr<LogEventFilter>& filter) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, atomId);
+    AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
+    AStatsEvent_writeString(statsEvent, string(stringSize, 'a').c_str());
+    AStatsEvent_build(statsEvent);
+    size_t size;
+    const uint8_t* buffer = AStatsEvent_getBuffer(statsEvent, &size);
+    StatsSocketListener::processMessage(buffer, size, kUid, kPid, queue, filter);
+    AStatsEvent_release(statsEvent);
+}
+
+}  // anonymous namespace
+
+TEST(AtomCaptureTest, TestCaptureFromSocket) {
+    std::shared_ptr<LogEventQueue> queue = std::make_shared<LogEventQueue>(100);
+    std::shared_ptr<LogEventFilter> filter = std::make_shared<LogEventFilter>();
+    filter->setFilteringEnabled(false);
+    TemporaryFile file;
+    AtomCapture& capture = AtomCapture::getInstance();
+
+    // Not captured, no capture running.
+    logAtom(/*atomId=*/10, /*timestampNs=*/100, /*stringSize=*/1, queue, filter);
+
+    ASSERT_TRUE(capture.start(file.path, AtomCapture::kDefaultCapacityBytes, {10, 12}));
+    EXPECT_TRUE(AtomCapture::isCapturing());
+    EXPECT_FALSE(capture.start(file.path, AtomCapture::kDefaultCapacityBytes, {}));
+    logAtom(/*atomId=*/10, /*timestampNs=*/200, /*stringSize=*/1, queue, filter);
+    logAtom(/*atomId=*/11, /*timestampNs=*/300, /*stringSize=*/1, queue, filter);
+    logAtom(/*atomId=*/12, /*timestampNs=*/400, /*stringSize=*/1, queue, filter);
+
+    uint64_t numRecords = 0;
+    uint64_t numOverwritten = 0;
+    ASSERT_TRUE(capture.stop(&numRecords, &numOverwritten));
+    EXPECT_FALSE(AtomCapture::isCapturing());
+    EXPECT_FALSE(capture.stop(&numRecords, &numOverwritten));
+    EXPECT_EQ(2, numRecords);
+    EXPECT_EQ(0, numOverwritten);
+
+    // The capture does not take the atoms away from statsd.
+    EXPECT_EQ(4, queue->mQueue.size());
+
+    vector<AtomRecord> records;
+    ASSERT_TRUE(readAtomStreamFile(file.path, &records));
+    ASSERT_EQ(2, records.size());
+    EXPECT_EQ(10, records[0].atomId);
+    EXPECT_EQ(kUid, records[0].uid);
+    EXPECT_EQ(kPid, records[0].pid);
+    EXPECT_EQ(12, records[1].atomId);
+    EXPECT_LE(records[0].receiveElapsedNs, records[1].receiveElapsedNs);
+
+    std::unique_ptr<LogEvent> event = records[1].toLogEvent();
+    ASSERT_NE(nullptr, event);
+    EXPECT_EQ(12, event->GetTagId());
+    EXPECT_EQ(kUid, event->GetUid());
+    EXPECT_EQ(400, event->GetElapsedTimestampNs());
+}
+
+TEST(AtomCaptureTest, TestRingOverwritesOldestAtoms) {
+    std::shared_ptr<LogEventQueue> queue = std::make_shared<LogEventQueue>(1000);
+    std::shared_ptr<LogEventFilter> filter = std::make_shared<LogEventFilter>();
+    filter->setFilteringEnabled(false);
+    TemporaryFile file;
+    AtomCapture& capture = AtomCapture::getInstance();
+
+    // Wrap around the ring a few times. Records straddle the end of the ring.
+    const int kNumAtoms = 300;
+    ASSERT_TRUE(capture.start(file.path, AtomCapture::kMinCapacityBytes, {}));
+    for (int i = 0; i < kNumAtoms; i++) {
+        logAtom(/*atomId=*/10, /*timestampNs=*/i, /*stringSize=*/1000, queue, filter);
+    }
+
+    string ring;
+    ASSERT_TRUE(android::base::ReadFileToString(file.path, &ring));
+    vector<AtomRecord> ringRecords;
+    ASSERT_TRUE(AtomCapture::readAtomRing(reinterpret_cast<const uint8_t*>(ring.data()),
+                                          ring.size(), &ringRecords));
+
+    uint64_t numRecords = 0;
+    uint64_t numOverwritten = 0;
+    ASSERT_TRUE(capture.stop(&numRecords, &numOverwritten));
+    EXPECT_GT(numOverwritten, 0);
+    EXPECT_EQ(kNumAtoms, numRecords + numOverwritten);
+    EXPECT_EQ(numRecords, ringRecords.size());
+
+    vector<AtomRecord> records;
+    ASSERT_TRUE(readAtomStreamFile(file.path, &records));
+    ASSERT_EQ(numRecords, records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        std::unique_ptr<LogEvent> event = records[i].toLogEvent();
+        ASSERT_NE(nullptr, event);
+        // The newest atoms are kept, oldest first.
+        EXPECT_EQ(numOverwritten + i, event->GetElapsedTimestampNs());
+        EXPECT_EQ(ringRecords[i].payload, records[i].payload);
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
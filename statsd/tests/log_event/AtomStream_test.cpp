@@ -0,0 +1,112 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "logd/AtomStream.h"
+
+#include <gtest/gtest.h>
+
+#include "stats_event.h"
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::vector;
+
+namespace {
+
+AtomRecord createRecord(int32_t atomId, int32_t value, int64_t timestampNs) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, atomId);
+    AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
+    AStatsEvent_writeInt32(statsEvent, value);
+    AStatsEvent_build(statsEvent);
+    size_t size;
+    const uint8_t* buffer = AStatsEvent_getBuffer(statsEvent, &size);
+
+    AtomRecord record;
+    record.atomId = atomId;
+    record.uid = 1000;
+    record.pid = 1234;
+    record.receiveElapsedNs = timestampNs + 10;
+    record.payload.assign(buffer, buffer + size);
+    AStatsEvent_release(statsEvent);
+    return record;
+}
+
+}  // anonymous namespace
+
+TEST(AtomStreamTest, TestRoundTrip) {
+    vector<uint8_t> buffer;
+    writeAtomStreamHeader(&buffer);
+    writeAtomRecord(createRecord(/*atomId=*/10, /*value=*/1, /*timestampNs=*/100), &buffer);
+    writeAtomRecord(createRecord(/*atomId=*/11, /*value=*/2, /*timestampNs=*/200), &buffer);
+
+    vector<AtomRecord> records;
+    ASSERT_TRUE(readAtomStream(buffer.data(), buffer.size(), &records));
+    ASSERT_EQ(2, records.size());
+    EXPECT_EQ(10, records[0].atomId);
+    EXPECT_EQ(1000, records[0].uid);
+    EXPECT_EQ(1234, records[0].pid);
+    EXPECT_EQ(110, records[0].receiveElapsedNs);
+    EXPECT_EQ(11, records[1].atomId);
+    EXPECT_EQ(210, records[1].receiveElapsedNs);
+
+    std::unique_ptr<LogEvent> event = records[1].toLogEvent();
+    ASSERT_NE(nullptr, event);
+    EXPECT_EQ(11, event->GetTagId());
+    EXPECT_EQ(1000, event->GetUid());
+    EXPECT_EQ(1234, event->GetPid());
+    EXPECT_EQ(200, event->GetElapsedTimestampNs());
+    ASSERT_EQ(1, event->getValues().size());
+    EXPECT_EQ(2, event->getValues()[0].mValue.int_value);
+}
+
+TEST(AtomStreamTest, TestInvalidStream) {
+    vector<uint8_t> buffer;
+    vector<AtomRecord> records;
+    EXPECT_FALSE(readAtomStream(buffer.data(), buffer.size(), &records));
+
+    writeAtomStreamHeader(&buffer);
+    EXPECT_TRUE(readAtomStream(buffer.data(), buffer.size(), &records));
+    EXPECT_TRUE(records.empty());
+
+    // Truncated payload. The records before the truncated one are kept.
+    writeAtomRecord(createRecord(/*atomId=*/10, /*value=*/1, /*timestampNs=*/100), &buffer);
+    writeAtomRecord(createRecord(/*atomId=*/10, /*value=*/2, /*timestampNs=*/200), &buffer);
+    EXPECT_FALSE(readAtomStream(buffer.data(), buffer.size() - 1, &records));
+    ASSERT_EQ(1, records.size());
+
+    // Unsupported version.
+    buffer[4]++;
+    records.clear();
+    EXPECT_FALSE(readAtomStream(buffer.data(), buffer.size(), &records));
+    EXPECT_TRUE(records.empty());
+}
+
+TEST(AtomStreamTest, TestInvalidPayload) {
+    AtomRecord record = createRecord(/*atomId=*/10, /*value=*/1, /*timestampNs=*/100);
+    record.payload.resize(record.payload.size() / 2);
+    EXPECT_EQ(nullptr, record.toLogEvent());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -19,9 +19,11 @@
 #include <math.h>
 #include <stdio.h>
 
+#include <future>
 #include <vector>
 
 #include "metrics_test_helper.h"
+#include "src/metrics/BucketFinalizer.h"
 #include "src/stats_log_util.h"
 #include "stats_event.h"
 #include "tests/statsd_test_util.h"
@@ -521,6 +523,95 @@ TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced) {
               std::ceil(1.0 * event7.GetElapsedTimestampNs() / NS_PER_SEC + refPeriodSec));
 }
 
+TEST(CountMetricProducerTest, TestRollUpOverflowDimensions) {
+    sp<AlarmMonitor> alarmMonitor;
+    Alert alert;
+    alert.set_id(11);
+    alert.set_metric_id(1);
+    alert.set_trigger_if_sum_gt(150);
+    alert.set_num_buckets(1);
+    alert.set_refractory_period_secs(1);
+
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+    const int numDimensions = StatsdStats::kDimensionKeySizeHardLimitMin + 200;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1});
+    metric.set_roll_up_overflow_dimensions(true);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    CountMetricProducer countProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, bucketStartTimeNs, bucketStartTimeNs);
+    sp<AnomalyTracker> anomalyTracker =
+            countProducer.addAnomalyTracker(alert, alarmMonitor, UPDATE_NEW, bucketStartTimeNs);
+
+    for (int i = 0; i < numDimensions; i++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, tagId, bucketStartTimeNs + 1, i);
+        countProducer.onMatchedLogEvent(1 /*log matcher index*/, event);
+    }
+
+    // The dimensions past the limit are counted in a single overflow key.
+    ASSERT_EQ((size_t)StatsdStats::kDimensionKeySizeHardLimitMin + 1,
+              countProducer.mCurrentSlicedCounter->size());
+    EXPECT_EQ(200L, (*countProducer.mCurrentSlicedCounter)[OVERFLOW_METRIC_DIMENSION_KEY]);
+    EXPECT_GT(anomalyTracker->getRefractoryPeriodEndsSec(OVERFLOW_METRIC_DIMENSION_KEY), 0U);
+
+    // Check dump report.
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    countProducer.onDumpReport(bucketStartTimeNs + bucketSizeNs + 1, true /* include partial */,
+                               true /* erase data */, FAST, &strSet, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    EXPECT_TRUE(report.dimension_guardrail_hit());
+    ASSERT_EQ(StatsdStats::kDimensionKeySizeHardLimitMin + 1, report.count_metrics().data_size());
+
+    int64_t totalCount = 0;
+    int numOverflow = 0;
+    for (const CountMetricData& data : report.count_metrics().data()) {
+        ASSERT_EQ(1, data.bucket_info_size());
+        totalCount += data.bucket_info(0).count();
+        if (data.is_overflow()) {
+            numOverflow++;
+            EXPECT_EQ(0, data.dimension_leaf_values_in_what_size());
+            EXPECT_EQ(200, data.bucket_info(0).count());
+        }
+    }
+    EXPECT_EQ(1, numOverflow);
+    EXPECT_EQ(numDimensions, totalCount);
+}
+
+TEST(CountMetricProducerTest, TestDropOverflowDimensionsByDefault) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int tagId = 1;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1});
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    CountMetricProducer countProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, bucketStartTimeNs, bucketStartTimeNs);
+
+    for (int i = 0; i < StatsdStats::kDimensionKeySizeHardLimitMin + 200; i++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, tagId, bucketStartTimeNs + 1, i);
+        countProducer.onMatchedLogEvent(1 /*log matcher index*/, event);
+    }
+
+    ASSERT_EQ((size_t)StatsdStats::kDimensionKeySizeHardLimitMin,
+              countProducer.mCurrentSlicedCounter->size());
+    EXPECT_EQ(countProducer.mCurrentSlicedCounter->end(),
+              countProducer.mCurrentSlicedCounter->find(OVERFLOW_METRIC_DIMENSION_KEY));
+}
+
 TEST(CountMetricProducerTest, TestOneWeekTimeUnit) {
     CountMetric metric;
     metric.set_id(1);
@@ -541,6 +632,109 @@ TEST(CountMetricProducerTest, TestOneWeekTimeUnit) {
     EXPECT_EQ(fiveWeeksOneDayNs, countProducer.getCurrentBucketEndTimeNs());
 }
 
+TEST(CountMetricProducerTest, TestDeferredBucketFinalization) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    sp<CountMetricProducer> countProducer =
+            new CountMetricProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {}, wizard,
+                                    protoHash, bucketStartTimeNs, bucketStartTimeNs);
+    ScopedDeferredBucketFinalization deferredFinalization;
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event1, bucketStartTimeNs + 1, tagId);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event2, bucketStartTimeNs + 2, tagId);
+    countProducer->onMatchedLogEvent(1 /*log matcher index*/, event1);
+    countProducer->onMatchedLogEvent(1 /*log matcher index*/, event2);
+
+    {
+        // Hold the lock so that the finalizer cannot run before the checks.
+        std::lock_guard<std::mutex> lock(countProducer->mMutex);
+        countProducer->flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+
+        // The bucket is sealed but not finalized yet.
+        EXPECT_EQ(0UL, countProducer->mPastBuckets.size());
+        ASSERT_EQ(1UL, countProducer->mPendingBuckets.size());
+        EXPECT_TRUE(countProducer->mCurrentSlicedCounter->empty());
+        EXPECT_EQ(bucketStartTimeNs + bucketSizeNs, countProducer->mCurrentBucketStartTimeNs);
+    }
+
+    BucketFinalizer::getInstance().waitForIdle();
+    {
+        std::lock_guard<std::mutex> lock(countProducer->mMutex);
+        EXPECT_TRUE(countProducer->mPendingBuckets.empty());
+        ASSERT_EQ(1UL, countProducer->mPastBuckets.size());
+        const auto& buckets = countProducer->mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY];
+        ASSERT_EQ(1UL, buckets.size());
+        EXPECT_EQ(bucketStartTimeNs, buckets[0].mBucketStartNs);
+        EXPECT_EQ(bucketStartTimeNs + bucketSizeNs, buckets[0].mBucketEndNs);
+        EXPECT_EQ(2LL, buckets[0].mCount);
+    }
+
+    // A dump report includes sealed buckets even if the finalizer has not run.
+    LogEvent event3(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event3, bucketStartTimeNs + bucketSizeNs + 2, tagId);
+    countProducer->onMatchedLogEvent(1 /*log matcher index*/, event3);
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    countProducer->onDumpReport(bucketStartTimeNs + 2 * bucketSizeNs + 1,
+                                false /* include partial */, true /* erase data */, FAST, &strSet,
+                                &output);
+
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_EQ(1, report.count_metrics().data_size());
+    const CountMetricData& data = report.count_metrics().data(0);
+    ASSERT_EQ(2, data.bucket_info_size());
+    EXPECT_EQ(2, data.bucket_info(0).count());
+    EXPECT_EQ(1, data.bucket_info(1).count());
+}
+
+TEST(CountMetricProducerTest, TestDeferredBucketFinalizationAfterProducerDestroyed) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    ScopedDeferredBucketFinalization deferredFinalization;
+
+    // Stall the finalizer so that the producer is destroyed while its finalization is queued.
+    std::promise<void> finalizerReleased;
+    std::shared_future<void> finalizerReleasedFuture = finalizerReleased.get_future().share();
+    BucketFinalizer::getInstance().schedule(
+            [finalizerReleasedFuture] { finalizerReleasedFuture.wait(); });
+
+    sp<CountMetricProducer> countProducer =
+            new CountMetricProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {}, wizard,
+                                    protoHash, bucketStartTimeNs, bucketStartTimeNs);
+    wp<CountMetricProducer> weakProducer = countProducer;
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event1, bucketStartTimeNs + 1, tagId);
+    countProducer->onMatchedLogEvent(1 /*log matcher index*/, event1);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event2, bucketStartTimeNs + bucketSizeNs + 1, tagId);
+    countProducer->onMatchedLogEvent(1 /*log matcher index*/, event2);
+
+    // The queued task does not keep the producer alive, so it is destroyed on this thread.
+    countProducer.clear();
+    EXPECT_EQ(nullptr, weakProducer.promote());
+
+    finalizerReleased.set_value();
+    BucketFinalizer::getInstance().waitForIdle();
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -0,0 +1,196 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/DistinctCountMetricProducer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "metrics_test_helper.h"
+#include "src/stats_log_util.h"
+#include "stats_event.h"
+#include "tests/statsd_test_util.h"
+
+using namespace testing;
+using android::sp;
+using std::optional;
+using std::unique_ptr;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const ConfigKey kConfigKey(0, 12345);
+const int atomId = 1;
+const int64_t metricId = 123;
+const uint64_t protoHash = 0x1234567890;
+const int logEventMatcherIndex = 0;
+const int64_t bucketStartTimeNs = 10000000000;
+const int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+const int64_t bucket2StartTimeNs = bucketStartTimeNs + bucketSizeNs;
+
+void makeStringLogEvent(LogEvent* logEvent, int64_t timestampNs, const string& value) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, atomId);
+    AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
+    AStatsEvent_writeInt32(statsEvent, 0);
+    AStatsEvent_writeString(statsEvent, value.c_str());
+
+    parseStatsEventToLogEvent(statsEvent, logEvent);
+}
+
+DistinctCountMetric createMetric() {
+    DistinctCountMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    metric.mutable_distinct_field()->set_field(atomId);
+    metric.mutable_distinct_field()->add_child()->set_field(2);
+    return metric;
+}
+
+sp<DistinctCountMetricProducer> createProducer(
+        const DistinctCountMetric& metric, optional<ConditionState> initialCondition = nullopt) {
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    vector<Matcher> fieldMatchers;
+    translateFieldMatcher(metric.distinct_field(), &fieldMatchers);
+
+    const auto [dimensionSoftLimit, dimensionHardLimit] =
+            StatsdStats::getAtomDimensionKeySizeLimits(
+                    atomId, StatsdStats::kDimensionKeySizeHardLimitMin);
+
+    int conditionIndex = initialCondition ? 0 : -1;
+    vector<ConditionState> initialConditionCache;
+    if (initialCondition) {
+        initialConditionCache.push_back(initialCondition.value());
+    }
+
+    return new DistinctCountMetricProducer(
+            kConfigKey, metric, protoHash, {/*pullAtomId=*/-1, /*pullerManager=*/nullptr},
+            {bucketStartTimeNs, bucketStartTimeNs, bucketSizeNs, metric.min_bucket_size_nanos(),
+             /*conditionCorrectionThresholdNs=*/nullopt, metric.split_bucket_for_app_upgrade()},
+            {/*containsAnyPositionInDimensionsInWhat=*/false,
+             /*shouldUseNestedDimensions=*/false, logEventMatcherIndex,
+             /*eventMatcherWizard=*/nullptr, metric.dimensions_in_what(), fieldMatchers},
+            {conditionIndex, metric.links(), initialConditionCache, wizard},
+            {metric.state_link(), /*slicedStateAtoms=*/{}, /*stateGroupMap=*/{}},
+            {/*eventActivationMap=*/{}, /*eventDeactivationMap=*/{}},
+            {dimensionSoftLimit, dimensionHardLimit, /*rollUpOverflowDimensions=*/false});
+}
+
+void logIntEvents(DistinctCountMetricProducer& producer, int64_t timestampNs, int begin, int end) {
+    for (int value = begin; value < end; value++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, atomId, timestampNs, value);
+        producer.onMatchedLogEvent(1 /*log matcher index*/, event);
+    }
+}
+
+}  // anonymous namespace
+
+TEST(DistinctCountMetricProducerTest, TestPushedEventsWithoutCondition) {
+    sp<DistinctCountMetricProducer> producer = createProducer(createMetric());
+
+    logIntEvents(*producer, bucketStartTimeNs + 10, 0, 50);
+    // Repeated values are counted once.
+    logIntEvents(*producer, bucketStartTimeNs + 20, 0, 50);
+
+    ASSERT_EQ(1UL, producer->mCurrentSlicedBucket.size());
+    const DistinctCountMetricProducer::Interval& curInterval0 =
+            producer->mCurrentSlicedBucket.begin()->second.intervals[0];
+    EXPECT_EQ(50, curInterval0.aggregate->estimate());
+    EXPECT_EQ(100, curInterval0.sampleSize);
+
+    producer->flushIfNeededLocked(bucket2StartTimeNs);
+    ASSERT_EQ(1UL, producer->mPastBuckets.size());
+    const auto& buckets = producer->mPastBuckets.begin()->second;
+    ASSERT_EQ(1UL, buckets.size());
+    EXPECT_EQ(bucketStartTimeNs, buckets[0].mBucketStartNs);
+    EXPECT_EQ(bucket2StartTimeNs, buckets[0].mBucketEndNs);
+    EXPECT_EQ(50, buckets[0].aggregates[0]->estimate());
+}
+
+TEST(DistinctCountMetricProducerTest, TestPushedEventsWithCondition) {
+    DistinctCountMetric metric = createMetric();
+    metric.set_condition(StringToId("SCREEN_ON"));
+    sp<DistinctCountMetricProducer> producer = createProducer(metric, ConditionState::kFalse);
+
+    logIntEvents(*producer, bucketStartTimeNs + 10, 0, 10);
+    ASSERT_EQ(0UL, producer->mCurrentSlicedBucket.size());
+
+    producer->onConditionChangedLocked(true, bucketStartTimeNs + 15);
+    logIntEvents(*producer, bucketStartTimeNs + 20, 10, 30);
+
+    producer->onConditionChangedLocked(false, bucketStartTimeNs + 35);
+    logIntEvents(*producer, bucketStartTimeNs + 40, 30, 60);
+
+    producer->flushIfNeededLocked(bucket2StartTimeNs);
+    ASSERT_EQ(1UL, producer->mPastBuckets.size());
+    const auto& buckets = producer->mPastBuckets.begin()->second;
+    ASSERT_EQ(1UL, buckets.size());
+    EXPECT_EQ(20, buckets[0].aggregates[0]->estimate());
+    EXPECT_EQ(20, buckets[0].mConditionTrueNs);
+}
+
+TEST(DistinctCountMetricProducerTest, TestStringField) {
+    sp<DistinctCountMetricProducer> producer = createProducer(createMetric());
+
+    for (const string& value : {"a", "b", "c", "a", "b", "d"}) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        makeStringLogEvent(&event, bucketStartTimeNs + 10, value);
+        producer->onMatchedLogEvent(1 /*log matcher index*/, event);
+    }
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    producer->onDumpReport(bucket2StartTimeNs + 10, true /* include current bucket */, true,
+                           NO_TIME_CONSTRAINTS /* dumpLatency */, &strSet, &output);
+
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_TRUE(report.has_distinct_count_metrics());
+    ASSERT_EQ(1, report.distinct_count_metrics().data_size());
+    const DistinctCountMetricData& data = report.distinct_count_metrics().data(0);
+    ASSERT_EQ(1, data.bucket_info_size());
+    ASSERT_EQ(1, data.bucket_info(0).sketches_size());
+    const DistinctCountBucketInfo::Sketch& sketch = data.bucket_info(0).sketches(0);
+    EXPECT_EQ(0, sketch.index());
+    EXPECT_EQ(4, sketch.estimate());
+    EXPECT_EQ(1UL << HyperLogLog::kDefaultPrecision, sketch.registers().size());
+}
+
+TEST(DistinctCountMetricProducerTest, TestByteSize) {
+    DistinctCountMetric metric = createMetric();
+    metric.set_precision(8);
+    sp<DistinctCountMetricProducer> producer = createProducer(metric);
+
+    logIntEvents(*producer, bucketStartTimeNs + 10, 0, 1000);
+    producer->flushIfNeededLocked(bucket2StartTimeNs);
+
+    const size_t expectedSize = producer->kBucketSize + 4 /* one int aggIndex entry */ +
+                                256 /* 2^precision registers */;
+    EXPECT_EQ(expectedSize, producer->byteSize());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -614,6 +614,98 @@ TEST(DurationMetricProducerTest, TestClearCurrentSlicedTrackerMapWhenStop) {
     EXPECT_EQ(1, durationProducer.getCurrentBucketNum());
 }
 
+TEST(DurationMetricProducerTest, TestDurationHistogram) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+
+    DurationMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+    metric.set_aggregation_type(DurationMetric_AggregationType_SUM);
+    HistogramBinConfig::ExplicitBins* bins =
+            metric.mutable_duration_histogram()->mutable_explicit_bins();
+    bins->add_bin(10);
+    bins->add_bin(1000);
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    FieldMatcher dimensions;
+
+    DurationMetricProducer durationProducer(
+            kConfigKey, metric, -1 /*no condition*/, {}, -1 /*what index not needed*/,
+            1 /* start index */, 2 /* stop index */, 3 /* stop_all index */, false /*nesting*/,
+            wizard, protoHash, dimensions, bucketStartTimeNs, bucketStartTimeNs);
+
+    // Intervals of 1ms, 100ms and 100ms.
+    const vector<std::pair<int64_t, int64_t>> intervals = {
+            {bucketStartTimeNs + 10, bucketStartTimeNs + 10 + 1000000},
+            {bucketStartTimeNs + NS_PER_SEC, bucketStartTimeNs + NS_PER_SEC + 100000000},
+            {bucketStartTimeNs + 2 * NS_PER_SEC, bucketStartTimeNs + 2 * NS_PER_SEC + 100000000}};
+    for (const auto& [startNs, stopNs] : intervals) {
+        LogEvent startEvent(/*uid=*/0, /*pid=*/0);
+        makeLogEvent(&startEvent, startNs, tagId);
+        durationProducer.onMatchedLogEvent(1 /* start index*/, startEvent);
+        LogEvent stopEvent(/*uid=*/0, /*pid=*/0);
+        makeLogEvent(&stopEvent, stopNs, tagId);
+        durationProducer.onMatchedLogEvent(2 /* stop index*/, stopEvent);
+    }
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    durationProducer.onDumpReport(bucketStartTimeNs + bucketSizeNs + 1,
+                                  true /* include current partial bucket */, true /* erase data */,
+                                  FAST, &strSet, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_EQ(1, report.duration_metrics().data_size());
+    ASSERT_EQ(1, report.duration_metrics().data(0).bucket_info_size());
+    const DurationBucketInfo& bucketInfo = report.duration_metrics().data(0).bucket_info(0);
+    EXPECT_EQ(201000000LL, bucketInfo.duration_nanos());
+    EXPECT_THAT(bucketInfo.duration_histogram().count(), ElementsAre(1, 2, 0));
+}
+
+TEST(DurationMetricProducerTest, TestRollUpOverflowDimensions) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+    const int hardLimit = StatsdStats::kDimensionKeySizeHardLimitMin;
+
+    DurationMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+    metric.set_aggregation_type(DurationMetric_AggregationType_SUM);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1});
+    metric.set_roll_up_overflow_dimensions(true);
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    FieldMatcher dimensions = CreateDimensions(tagId, {1});
+
+    DurationMetricProducer durationProducer(
+            kConfigKey, metric, -1 /*no condition*/, {}, -1 /*what index not needed*/,
+            1 /* start index */, 2 /* stop index */, 3 /* stop_all index */, false /*nesting*/,
+            wizard, protoHash, dimensions, bucketStartTimeNs, bucketStartTimeNs);
+
+    for (int i = 0; i < hardLimit + 2; i++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, tagId, bucketStartTimeNs + 1, i);
+        durationProducer.onMatchedLogEvent(1 /* start index*/, event);
+    }
+    // The two dimensions past the limit share the overflow tracker.
+    ASSERT_EQ((size_t)hardLimit + 1, durationProducer.mCurrentSlicedDurationTrackerMap.size());
+    ASSERT_TRUE(durationProducer.mCurrentSlicedDurationTrackerMap.find(OVERFLOW_DIMENSION_KEY) !=
+                durationProducer.mCurrentSlicedDurationTrackerMap.end());
+
+    LogEvent stopEvent1(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&stopEvent1, tagId, bucketStartTimeNs + 11, hardLimit);
+    durationProducer.onMatchedLogEvent(2 /* stop index*/, stopEvent1);
+    LogEvent stopEvent2(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&stopEvent2, tagId, bucketStartTimeNs + 21, hardLimit + 1);
+    durationProducer.onMatchedLogEvent(2 /* stop index*/, stopEvent2);
+
+    durationProducer.flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+    const auto& it = durationProducer.mPastBuckets.find(OVERFLOW_METRIC_DIMENSION_KEY);
+    ASSERT_TRUE(it != durationProducer.mPastBuckets.end());
+    ASSERT_EQ(1UL, it->second.size());
+    EXPECT_EQ(20LL, it->second[0].mDuration);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -23,6 +23,7 @@
 
 #include "logd/LogEvent.h"
 #include "metrics_test_helper.h"
+#include "src/metrics/BucketFinalizer.h"
 #include "src/matchers/SimpleAtomMatchingTracker.h"
 #include "src/metrics/MetricProducer.h"
 #include "src/stats_log_util.h"
@@ -999,6 +1000,142 @@ TEST(GaugeMetricProducerTest, TestPullDimensionalSampling) {
                              {bucketStartTimeNs + 10, bucketStartTimeNs + 20});
 }
 
+TEST(GaugeMetricProducerTest, TestRollUpOverflowDimensions) {
+    const size_t dimensionSoftLimit = 3;
+    const size_t dimensionHardLimit = 5;
+    const int numOverflowDimensions = 4;
+
+    GaugeMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    metric.mutable_gauge_fields_filter()->set_include_all(true);
+    metric.set_sampling_type(GaugeMetric::FIRST_N_SAMPLES);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1});
+    metric.set_roll_up_overflow_dimensions(true);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<EventMatcherWizard> eventMatcherWizard =
+            createEventMatcherWizard(tagId, logEventMatcherIndex);
+
+    GaugeMetricProducer gaugeProducer(
+            kConfigKey, metric, -1 /*-1 meaning no condition*/, {}, wizard, protoHash,
+            logEventMatcherIndex, eventMatcherWizard, -1 /* -1 means no pulling */, -1, tagId,
+            bucketStartTimeNs, bucketStartTimeNs, pullerManager, /*eventActivationMap=*/{},
+            /*eventDeactivationMap=*/{}, dimensionSoftLimit, dimensionHardLimit);
+    gaugeProducer.prepareFirstBucket();
+
+    const int numDimensions = dimensionHardLimit + numOverflowDimensions;
+    for (int i = 0; i < numDimensions; i++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, tagId, bucketStartTimeNs + 10 + i, i);
+        gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event);
+    }
+
+    // The atoms of the dimensions past the limit are kept under a single overflow key.
+    ASSERT_EQ(dimensionHardLimit + 1, gaugeProducer.mCurrentSlicedBucket->size());
+    EXPECT_EQ((size_t)numOverflowDimensions,
+              (*gaugeProducer.mCurrentSlicedBucket)[OVERFLOW_METRIC_DIMENSION_KEY].size());
+
+    // Check dump report.
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    gaugeProducer.onDumpReport(bucket2StartTimeNs + 1, true /* include current buckets */, true,
+                               FAST /* dumpLatency */, &strSet, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    backfillAggregatedAtoms(&report);
+    EXPECT_TRUE(report.dimension_guardrail_hit());
+    ASSERT_EQ((int)dimensionHardLimit + 1, report.gauge_metrics().data_size());
+
+    int numOverflow = 0;
+    for (const GaugeMetricData& data : report.gauge_metrics().data()) {
+        ASSERT_EQ(1, data.bucket_info_size());
+        if (data.is_overflow()) {
+            numOverflow++;
+            EXPECT_FALSE(data.has_dimensions_in_what());
+            EXPECT_EQ(0, data.dimension_leaf_values_in_what_size());
+            EXPECT_EQ(numOverflowDimensions, data.bucket_info(0).atom_size());
+        } else {
+            EXPECT_EQ(1, data.bucket_info(0).atom_size());
+        }
+    }
+    EXPECT_EQ(1, numOverflow);
+}
+
+TEST(GaugeMetricProducerTest, TestDeferredBucketFinalization) {
+    GaugeMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    metric.mutable_gauge_fields_filter()->set_include_all(true);
+    metric.set_sampling_type(GaugeMetric::FIRST_N_SAMPLES);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1});
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<EventMatcherWizard> eventMatcherWizard =
+            createEventMatcherWizard(tagId, logEventMatcherIndex);
+
+    sp<GaugeMetricProducer> gaugeProducer = new GaugeMetricProducer(
+            kConfigKey, metric, -1 /*-1 meaning no condition*/, {}, wizard, protoHash,
+            logEventMatcherIndex, eventMatcherWizard, -1 /* -1 means no pulling */, -1, tagId,
+            bucketStartTimeNs, bucketStartTimeNs, pullerManager);
+    gaugeProducer->prepareFirstBucket();
+    ScopedDeferredBucketFinalization deferredFinalization;
+
+    for (int i = 0; i < 3; i++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, tagId, bucketStartTimeNs + 10 + i, i % 2);
+        gaugeProducer->onMatchedLogEvent(1 /*log matcher index*/, event);
+    }
+
+    {
+        // Hold the lock so that the finalizer cannot run before the checks.
+        std::lock_guard<std::mutex> lock(gaugeProducer->mMutex);
+        gaugeProducer->flushIfNeededLocked(bucket2StartTimeNs + 1);
+
+        // The bucket is sealed but not finalized yet.
+        EXPECT_TRUE(gaugeProducer->mPastBuckets.empty());
+        ASSERT_EQ(1UL, gaugeProducer->mPendingBuckets.size());
+        EXPECT_EQ(2UL, gaugeProducer->mPendingBuckets[0].atoms->size());
+        EXPECT_TRUE(gaugeProducer->mCurrentSlicedBucket->empty());
+        EXPECT_EQ(bucket2StartTimeNs, gaugeProducer->mCurrentBucketStartTimeNs);
+    }
+
+    BucketFinalizer::getInstance().waitForIdle();
+    {
+        std::lock_guard<std::mutex> lock(gaugeProducer->mMutex);
+        EXPECT_TRUE(gaugeProducer->mPendingBuckets.empty());
+        ASSERT_EQ(2UL, gaugeProducer->mPastBuckets.size());
+        for (const auto& [dimensionKey, buckets] : gaugeProducer->mPastBuckets) {
+            ASSERT_EQ(1UL, buckets.size());
+            EXPECT_EQ(bucketStartTimeNs, buckets[0].mBucketStartNs);
+            EXPECT_EQ(bucket2StartTimeNs, buckets[0].mBucketEndNs);
+        }
+    }
+
+    // A dump report includes sealed buckets even if the finalizer has not run.
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&event, tagId, bucket2StartTimeNs + 10, 0);
+    gaugeProducer->onMatchedLogEvent(1 /*log matcher index*/, event);
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    gaugeProducer->onDumpReport(bucket3StartTimeNs + 1, false /* include partial bucket */,
+                                true /* erase data */, FAST, &strSet, &output);
+
+    StatsLogReport report = outputStreamToProto(&output);
+    backfillDimensionPath(&report);
+    backfillAggregatedAtoms(&report);
+    ASSERT_EQ(2, report.gauge_metrics().data_size());
+    int numAtoms = 0;
+    for (const GaugeMetricData& data : report.gauge_metrics().data()) {
+        for (const GaugeBucketInfo& bucketInfo : data.bucket_info()) {
+            numAtoms += bucketInfo.atom_size();
+        }
+    }
+    EXPECT_EQ(4, numAtoms);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/metrics/HistogramValue.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "src/stats_log.pb.h"
+
+#ifdef __ANDROID__
+
+using android::util::ProtoOutputStream;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const BinStarts binStarts = {0, 10, 20, 30};
+
+}  // anonymous namespace
+
+TEST(HistogramValueTest, TestAddValue) {
+    HistogramValue histogram;
+    EXPECT_TRUE(histogram.isEmpty());
+
+    for (double value : {-1.0, 0.0, 9.9, 10.0, 29.9, 30.0, 1000.0}) {
+        histogram.addValue(value, binStarts);
+    }
+    EXPECT_FALSE(histogram.isEmpty());
+    EXPECT_EQ(vector<int>({1, 2, 1, 1, 2}), histogram.getBinCounts());
+}
+
+TEST(HistogramValueTest, TestCompaction) {
+    EXPECT_EQ(vector<int>({}), HistogramValue().getCompactedHistogramValue().getBinCounts());
+    EXPECT_EQ(vector<int>({0, 5, -3, 2, -2}),
+              HistogramValue({0, 5, 0, 0, 0, 2, 0, 0}).getCompactedHistogramValue().getBinCounts());
+    EXPECT_EQ(vector<int>({-4}),
+              HistogramValue({0, 0, 0, 0}).getCompactedHistogramValue().getBinCounts());
+
+    // Compacting twice is a no-op.
+    HistogramValue compacted = HistogramValue({0, 0, 1}).getCompactedHistogramValue();
+    EXPECT_EQ(compacted, compacted.getCompactedHistogramValue());
+}
+
+TEST(HistogramValueTest, TestAddHistograms) {
+    HistogramValue histogram({1, 0, 2});
+    histogram += HistogramValue({0, 3, 1, 4});
+    EXPECT_EQ(vector<int>({1, 3, 3, 4}), histogram.getBinCounts());
+}
+
+TEST(HistogramValueTest, TestToProto) {
+    ProtoOutputStream protoOutput;
+    HistogramValue({0, 0, 0, 7, 0, 1}).toProto(protoOutput);
+
+    vector<uint8_t> bytes;
+    protoOutput.serializeToVector(&bytes);
+    HistogramBinCounts binCounts;
+    ASSERT_TRUE(binCounts.ParseFromArray(bytes.data(), bytes.size()));
+    EXPECT_EQ(vector<int>({-3, 7, 0, 1}),
+              vector<int>(binCounts.count().begin(), binCounts.count().end()));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
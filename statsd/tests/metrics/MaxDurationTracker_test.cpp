@@ -505,6 +505,32 @@ TEST(MaxDurationTrackerTest, TestNoAccumulatingDuration) {
     EXPECT_FALSE(tracker.hasAccumulatedDuration());
 }
 
+TEST(MaxDurationTrackerTest, TestDurationHistogram) {
+    const int64_t msNs = 1000000;
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    unordered_map<MetricDimensionKey, vector<DurationBucket>> buckets;
+
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketNum = 0;
+
+    MaxDurationTracker tracker(kConfigKey, metricId, eventKey, wizard, -1, false, bucketStartTimeNs,
+                               bucketNum, bucketStartTimeNs, bucketSizeNs, false, false, {});
+    tracker.setDurationBinStarts(std::make_shared<BinStarts>(BinStarts{0, 10, 100}));
+
+    // Each internal dimension is its own interval.
+    tracker.noteStart(key1, true, bucketStartTimeNs + 1, ConditionKey(),
+                      StatsdStats::kDimensionKeySizeHardLimitMin);
+    tracker.noteStart(key2, true, bucketStartTimeNs + 1, ConditionKey(),
+                      StatsdStats::kDimensionKeySizeHardLimitMin);
+    tracker.noteStop(key1, bucketStartTimeNs + 1 + 5 * msNs, false);
+    tracker.noteStop(key2, bucketStartTimeNs + 1 + 50 * msNs, false);
+
+    tracker.flushIfNeeded(bucketStartTimeNs + bucketSizeNs + 1, emptyThreshold, &buckets);
+    ASSERT_EQ(1u, buckets[eventKey].size());
+    EXPECT_EQ(50 * msNs, buckets[eventKey][0].mDuration);
+    EXPECT_EQ(vector<int>({0, 1, 1, 0}), buckets[eventKey][0].mDurationHistogram.getBinCounts());
+}
+
 class MaxDurationTrackerTest_DimLimit : public Test {
 protected:
     ~MaxDurationTrackerTest_DimLimit() {
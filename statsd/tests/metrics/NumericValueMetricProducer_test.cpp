@@ -61,7 +61,8 @@ const int64_t bucket6StartTimeNs = bucketStartTimeNs + 5 * bucketSizeNs;
 double epsilon = 0.001;
 
 static void assertPastBucketValuesSingleKey(
-        const std::unordered_map<MetricDimensionKey, std::vector<PastBucket<Value>>>& mPastBuckets,
+        const std::unordered_map<MetricDimensionKey, std::vector<PastBucket<NumericValue>>>&
+                mPastBuckets,
         const std::initializer_list<int>& expectedValuesList,
         const std::initializer_list<int64_t>& expectedDurationNsList,
         const std::initializer_list<int64_t>& expectedCorrectionNsList,
@@ -86,7 +87,7 @@ static void assertPastBucketValuesSingleKey(
     ASSERT_EQ(1, mPastBuckets.size());
     ASSERT_EQ(expectedValues.size(), mPastBuckets.begin()->second.size());
 
-    const vector<PastBucket<Value>>& buckets = mPastBuckets.begin()->second;
+    const vector<PastBucket<NumericValue>>& buckets = mPastBuckets.begin()->second;
     for (int i = 0; i < expectedValues.size(); i++) {
         EXPECT_EQ(expectedValues[i], buckets[i].aggregates[0].long_value)
                 << "Values differ at index " << i;
@@ -225,7 +226,7 @@ public:
                 {conditionIndex, metric.links(), initialConditionCache, wizard},
                 {metric.state_link(), slicedStateAtoms, stateGroupMap},
                 {/*eventActivationMap=*/{}, /*eventDeactivationMap=*/{}},
-                {dimensionSoftLimit, dimensionHardLimit});
+                {dimensionSoftLimit, dimensionHardLimit, metric.roll_up_overflow_dimensions()});
 
         valueProducer->prepareFirstBucket();
         if (conditionAfterFirstBucketPrepared) {
@@ -7734,6 +7735,141 @@ TEST(NumericValueMetricProducerTest, TestDimensionalSampling) {
                         0);  // Diff of 15 and 18
 }
 
+TEST(NumericValueMetricProducerTest, TestHistogramPushedEvents) {
+    ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
+    metric.set_aggregation_type(ValueMetric::HISTOGRAM);
+    HistogramBinConfig* binConfig = metric.add_histogram_bin_configs();
+    binConfig->set_id(1);
+    for (float bin : {0, 10, 20, 30, 40, 50}) {
+        binConfig->mutable_explicit_bins()->add_bin(bin);
+    }
+
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<NumericValueMetricProducer> valueProducer =
+            NumericValueMetricProducerTestHelper::createValueProducerNoConditions(
+                    pullerManager, metric, /*pullAtomId=*/-1);
+
+    for (int value : {-5, 5, 7, 45, 100}) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, tagId, bucketStartTimeNs + 10, value);
+        valueProducer->onMatchedLogEvent(1 /*log matcher index*/, event);
+    }
+
+    // One underflow count, two counts in [0, 10), one in [40, 50) and one overflow count.
+    ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
+    const NumericValueMetricProducer::Interval& curInterval =
+            valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
+    EXPECT_EQ(5, curInterval.sampleSize);
+    EXPECT_EQ(152, curInterval.aggregate.long_value);
+    EXPECT_EQ(vector<int>({1, 2, 0, 0, 0, 1, 1}), curInterval.aggregate.histogram.getBinCounts());
+
+    ProtoOutputStream output;
+    valueProducer->onDumpReport(bucket2StartTimeNs + 10000, false /* include recent buckets */,
+                                true, FAST /* dumpLatency */, nullptr, &output);
+
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_EQ(1, report.value_metrics().data_size());
+    const ValueMetricData& data = report.value_metrics().data(0);
+    ASSERT_EQ(1, data.bucket_info_size());
+    ASSERT_EQ(1, data.bucket_info(0).values_size());
+    const ValueBucketInfo::Value& value = data.bucket_info(0).values(0);
+    ASSERT_TRUE(value.has_histogram());
+    EXPECT_FALSE(value.has_value_long());
+    // The three empty bins are encoded as a single -3.
+    EXPECT_THAT(value.histogram().count(), ElementsAre(1, 2, -3, 1, 1));
+}
+
+TEST(NumericValueMetricProducerTest, TestHistogramPulledWithDiff) {
+    ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
+    metric.set_aggregation_type(ValueMetric::HISTOGRAM);
+    HistogramBinConfig::GeneratedBins* bins =
+            metric.add_histogram_bin_configs()->mutable_generated_bins();
+    bins->set_min(0);
+    bins->set_max(20);
+    bins->set_count(4);
+    bins->set_strategy(HistogramBinConfig::GeneratedBins::LINEAR);
+
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    EXPECT_CALL(*pullerManager, Pull(tagId, kConfigKey, bucketStartTimeNs, _))
+            .WillOnce(Invoke([](int tagId, const ConfigKey&, const int64_t,
+                                vector<std::shared_ptr<LogEvent>>* data) {
+                data->clear();
+                data->push_back(CreateRepeatedValueLogEvent(tagId, bucketStartTimeNs, 3));
+                return true;
+            }));
+
+    sp<NumericValueMetricProducer> valueProducer =
+            NumericValueMetricProducerTestHelper::createValueProducerNoConditions(pullerManager,
+                                                                                  metric);
+
+    vector<shared_ptr<LogEvent>> allData;
+    allData.push_back(CreateRepeatedValueLogEvent(tagId, bucket2StartTimeNs + 1, 11));
+    valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket2StartTimeNs);
+
+    allData.clear();
+    allData.push_back(CreateRepeatedValueLogEvent(tagId, bucket3StartTimeNs + 1, 11));
+    valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket3StartTimeNs);
+
+    // Diff of 8 in the first bucket and of 0 in the second one. A zero diff is still counted.
+    ASSERT_EQ(1UL, valueProducer->mPastBuckets.size());
+    const vector<PastBucket<NumericValue>>& buckets = valueProducer->mPastBuckets.begin()->second;
+    ASSERT_EQ(2UL, buckets.size());
+    EXPECT_EQ(vector<int>({-2, 1, -3}), buckets[0].aggregates[0].histogram.getBinCounts());
+    EXPECT_EQ(vector<int>({0, 1, -4}), buckets[1].aggregates[0].histogram.getBinCounts());
+}
+
+TEST(NumericValueMetricProducerTest, TestRollUpOverflowDimensions) {
+    ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
+    metric.set_aggregation_type(ValueMetric::SUM);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1});
+    metric.set_roll_up_overflow_dimensions(true);
+
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<NumericValueMetricProducer> valueProducer =
+            NumericValueMetricProducerTestHelper::createValueProducerNoConditions(
+                    pullerManager, metric, /*pullAtomId=*/-1);
+
+    const int hardLimit = StatsdStats::kDimensionKeySizeHardLimitMin;
+    const int numDimensions = hardLimit + 200;
+    int64_t overflowSum = 0;
+    for (int i = 0; i < numDimensions; i++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        CreateRepeatedValueLogEvent(&event, tagId, bucketStartTimeNs + 10, i);
+        valueProducer->onMatchedLogEvent(1 /*log matcher index*/, event);
+        if (i >= hardLimit) {
+            overflowSum += i;
+        }
+    }
+
+    // The values of the dimensions past the limit are summed under a single overflow key.
+    ASSERT_EQ((size_t)hardLimit + 1, valueProducer->mCurrentSlicedBucket.size());
+    const auto it = valueProducer->mCurrentSlicedBucket.find(OVERFLOW_METRIC_DIMENSION_KEY);
+    ASSERT_NE(it, valueProducer->mCurrentSlicedBucket.end());
+    EXPECT_EQ(overflowSum, it->second.intervals[0].aggregate.long_value);
+
+    // Check dump report.
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    valueProducer->onDumpReport(bucket2StartTimeNs + 10, true /* include current buckets */, true,
+                                FAST /* dumpLatency */, &strSet, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    EXPECT_TRUE(report.has_value_metrics());
+    ASSERT_EQ(hardLimit + 1, report.value_metrics().data_size());
+    EXPECT_EQ(0, report.value_metrics().skipped_size());
+
+    int numOverflow = 0;
+    for (const ValueMetricData& data : report.value_metrics().data()) {
+        ASSERT_EQ(1, data.bucket_info_size());
+        if (data.is_overflow()) {
+            numOverflow++;
+            EXPECT_FALSE(data.has_dimensions_in_what());
+            EXPECT_EQ(0, data.dimension_leaf_values_in_what_size());
+            EXPECT_EQ(overflowSum, data.bucket_info(0).values(0).value_long());
+        }
+    }
+    EXPECT_EQ(1, numOverflow);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
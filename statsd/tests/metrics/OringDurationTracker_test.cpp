@@ -708,6 +708,73 @@ TEST(OringDurationTrackerTest, TestClearStateKeyMapWhenNoTrackers) {
     EXPECT_FALSE(tracker.hasAccumulatedDuration());
 }
 
+TEST(OringDurationTrackerTest, TestDurationHistogram) {
+    const int64_t msNs = 1000000;
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    unordered_map<MetricDimensionKey, vector<DurationBucket>> buckets;
+
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketNum = 0;
+    int64_t eventStartTimeNs = bucketStartTimeNs + NS_PER_SEC;
+
+    OringDurationTracker tracker(kConfigKey, metricId, eventKey, wizard, 1, false,
+                                 bucketStartTimeNs, bucketNum, bucketStartTimeNs, bucketSizeNs,
+                                 false, false, {});
+    tracker.setDurationBinStarts(std::make_shared<BinStarts>(BinStarts{0, 10, 100}));
+
+    // Overlapping durations form a single 20ms interval.
+    tracker.noteStart(kEventKey1, true, eventStartTimeNs, ConditionKey(),
+                      StatsdStats::kDimensionKeySizeHardLimitMin);
+    tracker.noteStart(kEventKey2, true, eventStartTimeNs + 5 * msNs, ConditionKey(),
+                      StatsdStats::kDimensionKeySizeHardLimitMin);
+    tracker.noteStop(kEventKey1, eventStartTimeNs + 8 * msNs, false);
+    tracker.noteStop(kEventKey2, eventStartTimeNs + 20 * msNs, false);
+
+    // 3ms interval.
+    tracker.noteStart(kEventKey1, true, eventStartTimeNs + NS_PER_SEC, ConditionKey(),
+                      StatsdStats::kDimensionKeySizeHardLimitMin);
+    tracker.noteStop(kEventKey1, eventStartTimeNs + NS_PER_SEC + 3 * msNs, false);
+
+    // 150ms interval, not counting the time during which the condition is false.
+    tracker.noteStart(kEventKey1, true, eventStartTimeNs + 2 * NS_PER_SEC, ConditionKey(),
+                      StatsdStats::kDimensionKeySizeHardLimitMin);
+    tracker.onConditionChanged(false, eventStartTimeNs + 2 * NS_PER_SEC + 50 * msNs);
+    tracker.onConditionChanged(true, eventStartTimeNs + 3 * NS_PER_SEC);
+    tracker.noteStop(kEventKey1, eventStartTimeNs + 3 * NS_PER_SEC + 100 * msNs, false);
+
+    tracker.flushIfNeeded(bucketStartTimeNs + bucketSizeNs + 1, emptyThreshold, &buckets);
+    ASSERT_EQ(1u, buckets[eventKey].size());
+    EXPECT_EQ(173 * msNs, buckets[eventKey][0].mDuration);
+    EXPECT_EQ(vector<int>({0, 1, 1, 1}), buckets[eventKey][0].mDurationHistogram.getBinCounts());
+}
+
+TEST(OringDurationTrackerTest, TestDurationHistogramCrossBucketBoundary) {
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    unordered_map<MetricDimensionKey, vector<DurationBucket>> buckets;
+
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketNum = 0;
+
+    OringDurationTracker tracker(kConfigKey, metricId, eventKey, wizard, 1, false,
+                                 bucketStartTimeNs, bucketNum, bucketStartTimeNs, bucketSizeNs,
+                                 false, false, {});
+    tracker.setDurationBinStarts(std::make_shared<BinStarts>(BinStarts{1000, 60000}));
+
+    tracker.noteStart(kEventKey1, true, bucketStartTimeNs + NS_PER_SEC, ConditionKey(),
+                      StatsdStats::kDimensionKeySizeHardLimitMin);
+    tracker.flushIfNeeded(bucketStartTimeNs + bucketSizeNs + 1, emptyThreshold, &buckets);
+    // The interval has not ended yet.
+    ASSERT_EQ(1u, buckets[eventKey].size());
+    EXPECT_TRUE(buckets[eventKey][0].mDurationHistogram.isEmpty());
+
+    // The interval is counted with its full length in the bucket in which it ends.
+    tracker.noteStop(kEventKey1, bucketStartTimeNs + bucketSizeNs + NS_PER_SEC, false);
+    tracker.flushIfNeeded(bucketStartTimeNs + 2 * bucketSizeNs + 1, emptyThreshold, &buckets);
+    ASSERT_EQ(2u, buckets[eventKey].size());
+    EXPECT_EQ(NS_PER_SEC, buckets[eventKey][1].mDuration);
+    EXPECT_EQ(vector<int>({0, 1, 0}), buckets[eventKey][1].mDurationHistogram.getBinCounts());
+}
+
 class OringDurationTrackerTest_DimLimit : public Test {
 protected:
     ~OringDurationTrackerTest_DimLimit() {
@@ -0,0 +1,191 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/TopKMetricProducer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "metrics_test_helper.h"
+#include "src/stats_log_util.h"
+#include "stats_event.h"
+#include "tests/statsd_test_util.h"
+
+using namespace testing;
+using android::sp;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+const ConfigKey kConfigKey(0, 12345);
+const uint64_t protoHash = 0x1234567890;
+const int tagId = 1;
+const int64_t bucketStartTimeNs = 10000000000;
+const int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+
+void makeLogEvent(LogEvent* logEvent, int64_t timestampNs, int key, int64_t value) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, tagId);
+    AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
+    AStatsEvent_writeInt32(statsEvent, key);
+    AStatsEvent_writeInt64(statsEvent, value);
+
+    parseStatsEventToLogEvent(statsEvent, logEvent);
+}
+
+void logEvents(TopKMetricProducer& producer, int64_t timestampNs, int key, int numEvents,
+               int64_t value = 1) {
+    for (int i = 0; i < numEvents; i++) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        makeLogEvent(&event, timestampNs, key, value);
+        producer.onMatchedLogEvent(1 /*matcher index*/, event);
+    }
+}
+
+TopKMetric createMetric(int k, int numCounters) {
+    TopKMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1});
+    metric.set_k(k);
+    metric.set_num_counters(numCounters);
+    return metric;
+}
+
+int getKey(const TopKSummary::Counter& entry) {
+    return entry.key.getDimensionKeyInWhat().getValues()[0].mValue.int_value;
+}
+
+}  // namespace
+
+TEST(TopKMetricProducerTest, TestTopKByCount) {
+    TopKMetric metric = createMetric(/*k=*/2, /*numCounters=*/4);
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    TopKMetricProducer producer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {}, wizard,
+                                protoHash, bucketStartTimeNs, bucketStartTimeNs);
+
+    logEvents(producer, bucketStartTimeNs + 1, /*key=*/1, 5);
+    logEvents(producer, bucketStartTimeNs + 2, /*key=*/2, 3);
+    logEvents(producer, bucketStartTimeNs + 3, /*key=*/3, 1);
+    ASSERT_EQ(0UL, producer.mPastBuckets.size());
+
+    producer.flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+    ASSERT_EQ(1UL, producer.mPastBuckets.size());
+    const TopKBucket& bucket = producer.mPastBuckets[0];
+    EXPECT_EQ(bucketStartTimeNs, bucket.mBucketStartNs);
+    EXPECT_EQ(bucketStartTimeNs + bucketSizeNs, bucket.mBucketEndNs);
+    EXPECT_EQ(9, bucket.mTotalValue);
+    EXPECT_EQ(1, bucket.mUnreportedValueBound);
+    ASSERT_EQ(2UL, bucket.mEntries.size());
+    EXPECT_EQ(1, getKey(bucket.mEntries[0]));
+    EXPECT_EQ(5, bucket.mEntries[0].estimate);
+    EXPECT_EQ(0, bucket.mEntries[0].error);
+    EXPECT_EQ(2, getKey(bucket.mEntries[1]));
+    EXPECT_EQ(3, bucket.mEntries[1].estimate);
+    EXPECT_EQ(0, bucket.mEntries[1].error);
+
+    // The summary is reset for the next bucket.
+    EXPECT_TRUE(producer.mCurrentSummary.empty());
+}
+
+TEST(TopKMetricProducerTest, TestTopKByValueField) {
+    TopKMetric metric = createMetric(/*k=*/2, /*numCounters=*/4);
+    *metric.mutable_value_field() = CreateDimensions(tagId, {2});
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    TopKMetricProducer producer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {}, wizard,
+                                protoHash, bucketStartTimeNs, bucketStartTimeNs);
+
+    logEvents(producer, bucketStartTimeNs + 1, /*key=*/1, 5, /*value=*/1);
+    logEvents(producer, bucketStartTimeNs + 2, /*key=*/2, 1, /*value=*/100);
+    // Negative values are dropped.
+    logEvents(producer, bucketStartTimeNs + 3, /*key=*/3, 1, /*value=*/-50);
+
+    producer.flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+    ASSERT_EQ(1UL, producer.mPastBuckets.size());
+    const TopKBucket& bucket = producer.mPastBuckets[0];
+    EXPECT_EQ(105, bucket.mTotalValue);
+    EXPECT_EQ(0, bucket.mUnreportedValueBound);
+    ASSERT_EQ(2UL, bucket.mEntries.size());
+    EXPECT_EQ(2, getKey(bucket.mEntries[0]));
+    EXPECT_EQ(100, bucket.mEntries[0].estimate);
+    EXPECT_EQ(1, getKey(bucket.mEntries[1]));
+    EXPECT_EQ(5, bucket.mEntries[1].estimate);
+}
+
+TEST(TopKMetricProducerTest, TestEventsWithNonSlicedCondition) {
+    TopKMetric metric = createMetric(/*k=*/2, /*numCounters=*/4);
+    metric.set_condition(StringToId("SCREEN_ON"));
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    TopKMetricProducer producer(kConfigKey, metric, 0, {ConditionState::kUnknown}, wizard,
+                                protoHash, bucketStartTimeNs, bucketStartTimeNs);
+
+    producer.onConditionChanged(true, bucketStartTimeNs);
+    logEvents(producer, bucketStartTimeNs + 1, /*key=*/1, 2);
+
+    producer.onConditionChanged(false, bucketStartTimeNs + 2);
+    logEvents(producer, bucketStartTimeNs + 3, /*key=*/2, 10);
+
+    producer.flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+    ASSERT_EQ(1UL, producer.mPastBuckets.size());
+    const TopKBucket& bucket = producer.mPastBuckets[0];
+    EXPECT_EQ(2, bucket.mTotalValue);
+    ASSERT_EQ(1UL, bucket.mEntries.size());
+    EXPECT_EQ(1, getKey(bucket.mEntries[0]));
+    EXPECT_EQ(2, bucket.mEntries[0].estimate);
+}
+
+TEST(TopKMetricProducerTest, TestBoundedMemory) {
+    TopKMetric metric = createMetric(/*k=*/3, /*numCounters=*/10);
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    TopKMetricProducer producer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {}, wizard,
+                                protoHash, bucketStartTimeNs, bucketStartTimeNs);
+
+    // One heavy dimension among many light ones.
+    for (int key = 1; key <= 1000; key++) {
+        logEvents(producer, bucketStartTimeNs + 1, key, 1);
+        if (key % 10 == 0) {
+            logEvents(producer, bucketStartTimeNs + 1, /*key=*/0, 5);
+        }
+        ASSERT_LE(producer.mCurrentSummary.size(), 10UL);
+    }
+
+    producer.flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+    ASSERT_EQ(1UL, producer.mPastBuckets.size());
+    const TopKBucket& bucket = producer.mPastBuckets[0];
+    EXPECT_EQ(1500, bucket.mTotalValue);
+    ASSERT_EQ(3UL, bucket.mEntries.size());
+    const TopKSummary::Counter& heaviest = bucket.mEntries[0];
+    EXPECT_EQ(0, getKey(heaviest));
+    EXPECT_LE(heaviest.estimate - heaviest.error, 500);
+    EXPECT_GE(heaviest.estimate, 500);
+    EXPECT_LE(heaviest.error, 1500 / 10);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
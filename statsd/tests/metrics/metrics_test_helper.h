@@ -14,6 +14,7 @@
 #pragma once
 
 #include "src/condition/ConditionWizard.h"
+#include "src/metrics/BucketFinalizer.h"
 #include "src/external/StatsPullerManager.h"
 #include "src/packages/UidMap.h"
 
@@ -48,6 +49,21 @@ public:
                  void(const ConfigKey& configKey, const wp<PullUidProvider>& provider));
 };
 
+// Defers bucket finalization to the BucketFinalizer for its lifetime. The queued finalizations
+// are drained before it is turned off again, so a failed assertion does not leak the setting into
+// other tests.
+class ScopedDeferredBucketFinalization {
+public:
+    ScopedDeferredBucketFinalization() {
+        BucketFinalizer::setEnabled(true);
+    }
+
+    ~ScopedDeferredBucketFinalization() {
+        BucketFinalizer::getInstance().waitForIdle();
+        BucketFinalizer::setEnabled(false);
+    }
+};
+
 HashableDimensionKey getMockedDimensionKey(int tagId, int key, std::string value);
 MetricDimensionKey getMockedMetricDimensionKey(int tagId, int key, std::string value);
 
@@ -0,0 +1,200 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/parsing_utils/config_cost_estimator.h"
+
+#include <gtest/gtest.h>
+
+#include "src/state/StateManager.h"
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int64_t kBucketsPerDay = 24 * 60 / 5;
+
+// Counts wakelock acquisitions by tag and screen state while the screen is on.
+StatsdConfig createCountConfig() {
+    StatsdConfig config;
+    config.set_id(12345);
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+    *config.add_atom_matcher() = CreateAcquireWakelockAtomMatcher();
+    *config.add_predicate() = CreateScreenIsOnPredicate();
+    *config.add_state() = CreateScreenState();
+
+    CountMetric* metric = config.add_count_metric();
+    *metric = createCountMetric("WakelockAcquires", config.atom_matcher(2).id(),
+                                config.predicate(0).id(), {config.state(0).id()});
+    *metric->mutable_dimensions_in_what() =
+            CreateDimensions(util::WAKELOCK_STATE_CHANGED, {/*tag=*/3});
+    metric->set_bucket(FIVE_MINUTES);
+    return config;
+}
+
+ConfigCostPriors createPriors() {
+    ConfigCostPriors priors;
+    priors.eventsPerSec[util::SCREEN_STATE_CHANGED] = 0.5;
+    priors.eventsPerSec[util::WAKELOCK_STATE_CHANGED] = 2;
+    priors.fieldCardinalities[{util::WAKELOCK_STATE_CHANGED, 3}] = 50;
+    priors.stateCardinalities[util::SCREEN_STATE_CHANGED] = 3;
+    return priors;
+}
+
+}  // anonymous namespace
+
+TEST(ConfigCostEstimatorTest, TestCountMetric) {
+    ConfigCostEstimate estimate;
+    ASSERT_EQ(estimateConfigCost(createCountConfig(), createPriors(), estimate), nullopt);
+
+    ASSERT_EQ(estimate.atomCosts.size(), 2);
+    const AtomCost& wakelockCost = estimate.atomCosts[0];
+    EXPECT_EQ(wakelockCost.atomId, util::WAKELOCK_STATE_CHANGED);
+    EXPECT_EQ(wakelockCost.matchersPerEvent, 1);
+    EXPECT_EQ(wakelockCost.conditionsPerEvent, 0);
+    EXPECT_EQ(wakelockCost.metricsPerEvent, 1);
+    EXPECT_DOUBLE_EQ(wakelockCost.workUnitsPerSec, 4);
+
+    const AtomCost& screenCost = estimate.atomCosts[1];
+    EXPECT_EQ(screenCost.atomId, util::SCREEN_STATE_CHANGED);
+    EXPECT_EQ(screenCost.matchersPerEvent, 2);
+    EXPECT_EQ(screenCost.conditionsPerEvent, 1);
+    // The metric is updated when the condition changes.
+    EXPECT_EQ(screenCost.metricsPerEvent, 1);
+    EXPECT_DOUBLE_EQ(screenCost.workUnitsPerSec, 2);
+    EXPECT_DOUBLE_EQ(estimate.totalWorkUnitsPerSec, 6);
+
+    ASSERT_EQ(estimate.metricCosts.size(), 1);
+    const MetricCost& metricCost = estimate.metricCosts[0];
+    // 50 tags times 3 screen states.
+    EXPECT_EQ(metricCost.dimensionFanOut, 150);
+    EXPECT_EQ(metricCost.bucketSizeNs, 5 * 60 * NS_PER_SEC);
+    EXPECT_GT(metricCost.reportBytesPerBucket, 0);
+    EXPECT_EQ(metricCost.memoryBytes, metricCost.reportBytesPerBucket * (kBucketsPerDay + 1));
+    EXPECT_FALSE(metricCost.pulled);
+    EXPECT_EQ(estimate.totalReportBytes, metricCost.reportBytesPerBucket * kBucketsPerDay);
+    EXPECT_EQ(estimate.totalPullsPerHour, 0);
+}
+
+TEST(ConfigCostEstimatorTest, TestDimensionGuardrail) {
+    ConfigCostPriors priors = createPriors();
+    priors.fieldCardinalities[{util::WAKELOCK_STATE_CHANGED, 3}] = 100000;
+
+    ConfigCostEstimate estimate;
+    ASSERT_EQ(estimateConfigCost(createCountConfig(), priors, estimate), nullopt);
+    ASSERT_EQ(estimate.metricCosts.size(), 1);
+    EXPECT_EQ(estimate.metricCosts[0].dimensionFanOut, StatsdStats::kDimensionKeySizeHardLimit);
+}
+
+TEST(ConfigCostEstimatorTest, TestPulledGaugeMetric) {
+    StatsdConfig config;
+    config.set_id(12345);
+    *config.add_atom_matcher() =
+            CreateSimpleAtomMatcher("SubsystemSleep", util::SUBSYSTEM_SLEEP_STATE);
+    GaugeMetric* metric = config.add_gauge_metric();
+    *metric = createGaugeMetric("Gauge", config.atom_matcher(0).id(),
+                                GaugeMetric::RANDOM_ONE_SAMPLE, /*condition=*/nullopt,
+                                /*triggerEvent=*/nullopt);
+    metric->set_bucket(FIVE_MINUTES);
+
+    ConfigCostPriors priors;
+    priors.atomsPerPull[util::SUBSYSTEM_SLEEP_STATE] = 5;
+    ConfigCostEstimate estimate;
+    ASSERT_EQ(estimateConfigCost(config, priors, estimate), nullopt);
+
+    ASSERT_EQ(estimate.metricCosts.size(), 1);
+    const MetricCost& metricCost = estimate.metricCosts[0];
+    EXPECT_TRUE(metricCost.pulled);
+    EXPECT_DOUBLE_EQ(metricCost.pullsPerHour, 12);
+    EXPECT_EQ(metricCost.pullPayloadBytes, 5 * priors.bytesPerAtom);
+    EXPECT_EQ(metricCost.dimensionFanOut, 1);
+    EXPECT_DOUBLE_EQ(estimate.totalPullsPerHour, 12);
+}
+
+TEST(ConfigCostEstimatorTest, TestInvalidConfig) {
+    StatsdConfig config = createCountConfig();
+    config.mutable_count_metric(0)->set_what(999);
+
+    ConfigCostEstimate estimate;
+    const optional<InvalidConfigReason> reason =
+            estimateConfigCost(config, createPriors(), estimate);
+    ASSERT_NE(reason, nullopt);
+    EXPECT_EQ(reason->reason, INVALID_CONFIG_REASON_METRIC_MATCHER_NOT_FOUND);
+    EXPECT_TRUE(estimate.metricCosts.empty());
+}
+
+TEST(ConfigCostEstimatorTest, TestStateListenersNotRegistered) {
+    StateManager::getInstance().clear();
+    // A live config listening to the screen state.
+    ConfigKey cfgKey;
+    sp<StatsLogProcessor> processor =
+            CreateStatsLogProcessor(/*timeBaseNs=*/1, /*currentTimeNs=*/1, createCountConfig(),
+                                    cfgKey);
+    const int stateTrackersCount = StateManager::getInstance().getStateTrackersCount();
+    const int listenersCount =
+            StateManager::getInstance().getListenersCount(util::SCREEN_STATE_CHANGED);
+    ASSERT_EQ(listenersCount, 1);
+
+    ConfigCostEstimate estimate;
+    ASSERT_EQ(estimateConfigCost(createCountConfig(), createPriors(), estimate), nullopt);
+    EXPECT_EQ(StateManager::getInstance().getStateTrackersCount(), stateTrackersCount);
+    EXPECT_EQ(StateManager::getInstance().getListenersCount(util::SCREEN_STATE_CHANGED),
+              listenersCount);
+
+    StatsdConfig config = createCountConfig();
+    config.mutable_count_metric(0)->set_what(999);
+    ASSERT_NE(estimateConfigCost(config, createPriors(), estimate), nullopt);
+    EXPECT_EQ(StateManager::getInstance().getStateTrackersCount(), stateTrackersCount);
+    EXPECT_EQ(StateManager::getInstance().getListenersCount(util::SCREEN_STATE_CHANGED),
+              listenersCount);
+}
+
+TEST(ConfigCostEstimatorTest, TestCeilings) {
+    ConfigCostEstimate estimate;
+    ASSERT_EQ(estimateConfigCost(createCountConfig(), createPriors(), estimate), nullopt);
+
+    ConfigCostCeilings ceilings;
+    EXPECT_EQ(checkConfigCost(estimate, ceilings), nullopt);
+    ceilings.maxWorkUnitsPerSec = 10;
+    EXPECT_EQ(checkConfigCost(estimate, ceilings), nullopt);
+    ceilings.maxWorkUnitsPerSec = 5;
+    EXPECT_EQ(checkConfigCost(estimate, ceilings),
+              InvalidConfigReason(INVALID_CONFIG_REASON_CONFIG_COST_EXCEEDS_CEILING));
+
+    ceilings = ConfigCostCeilings();
+    ceilings.maxMemoryBytes = estimate.totalMemoryBytes - 1;
+    EXPECT_EQ(checkConfigCost(estimate, ceilings),
+              InvalidConfigReason(INVALID_CONFIG_REASON_CONFIG_COST_EXCEEDS_CEILING));
+
+    // initStatsdConfig checks the ceilings with the default priors once they are set.
+    ceilings.maxMemoryBytes = 1;
+    setConfigCostCeilings(ceilings);
+    EXPECT_EQ(estimateConfigCost(createCountConfig(), createPriors(), estimate),
+              InvalidConfigReason(INVALID_CONFIG_REASON_CONFIG_COST_EXCEEDS_CEILING));
+    setConfigCostCeilings(getDefaultConfigCostCeilings());
+    EXPECT_EQ(estimateConfigCost(createCountConfig(), createPriors(), estimate), nullopt);
+    setConfigCostCeilings(nullopt);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
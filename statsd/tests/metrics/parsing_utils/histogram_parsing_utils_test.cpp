@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "src/metrics/parsing_utils/histogram_parsing_utils.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "src/statsd_config.pb.h"
+
+#ifdef __ANDROID__
+
+using namespace testing;
+using std::optional;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int64_t metricId = 123;
+
+HistogramBinConfig createGeneratedBinConfig(float min, float max, int count,
+                                            HistogramBinConfig::GeneratedBins::Strategy strategy) {
+    HistogramBinConfig binConfig;
+    binConfig.set_id(1);
+    HistogramBinConfig::GeneratedBins* bins = binConfig.mutable_generated_bins();
+    bins->set_min(min);
+    bins->set_max(max);
+    bins->set_count(count);
+    bins->set_strategy(strategy);
+    return binConfig;
+}
+
+HistogramBinConfig createExplicitBinConfig(const std::vector<float>& bins) {
+    HistogramBinConfig binConfig;
+    binConfig.set_id(1);
+    for (float bin : bins) {
+        binConfig.mutable_explicit_bins()->add_bin(bin);
+    }
+    return binConfig;
+}
+
+optional<InvalidConfigReasonEnum> getInvalidConfigReason(const HistogramBinConfig& binConfig) {
+    BinStarts binStarts;
+    optional<InvalidConfigReason> reason = generateBinStarts(metricId, binConfig, binStarts);
+    if (!reason.has_value()) {
+        return std::nullopt;
+    }
+    EXPECT_EQ(metricId, reason->metricId);
+    return reason->reason;
+}
+
+}  // anonymous namespace
+
+TEST(HistogramParsingUtilsTest, TestLinearBins) {
+    BinStarts binStarts;
+    EXPECT_EQ(std::nullopt,
+              generateBinStarts(metricId,
+                                createGeneratedBinConfig(0, 100, 4,
+                                                         HistogramBinConfig::GeneratedBins::LINEAR),
+                                binStarts));
+    EXPECT_THAT(binStarts, ElementsAre(0, 25, 50, 75, 100));
+}
+
+TEST(HistogramParsingUtilsTest, TestExponentialBins) {
+    BinStarts binStarts;
+    EXPECT_EQ(std::nullopt,
+              generateBinStarts(
+                      metricId,
+                      createGeneratedBinConfig(1, 1000, 3,
+                                               HistogramBinConfig::GeneratedBins::EXPONENTIAL),
+                      binStarts));
+    EXPECT_THAT(binStarts, ElementsAre(1, FloatNear(10, 0.001), FloatNear(100, 0.01), 1000));
+}
+
+TEST(HistogramParsingUtilsTest, TestExplicitBins) {
+    BinStarts binStarts;
+    EXPECT_EQ(std::nullopt,
+              generateBinStarts(metricId, createExplicitBinConfig({-1, 0, 2.5, 7}), binStarts));
+    EXPECT_THAT(binStarts, ElementsAre(-1, 0, 2.5, 7));
+}
+
+TEST(HistogramParsingUtilsTest, TestInvalidConfigs) {
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_MISSING_BIN_CONFIG,
+              getInvalidConfigReason(HistogramBinConfig()));
+
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_GENERATED_BINS_INVALID_ARGS,
+              getInvalidConfigReason(createGeneratedBinConfig(
+                      10, 0, 4, HistogramBinConfig::GeneratedBins::LINEAR)));
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_GENERATED_BINS_INVALID_ARGS,
+              getInvalidConfigReason(createGeneratedBinConfig(
+                      0, 10, 0, HistogramBinConfig::GeneratedBins::LINEAR)));
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_GENERATED_BINS_INVALID_ARGS,
+              getInvalidConfigReason(createGeneratedBinConfig(
+                      0, 10, 4, HistogramBinConfig::GeneratedBins::EXPONENTIAL)));
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_GENERATED_BINS_INVALID_ARGS,
+              getInvalidConfigReason(createGeneratedBinConfig(
+                      0, 10, 4, HistogramBinConfig::GeneratedBins::UNKNOWN)));
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_TOO_MANY_BINS,
+              getInvalidConfigReason(createGeneratedBinConfig(
+                      0, 1000, 100, HistogramBinConfig::GeneratedBins::LINEAR)));
+
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_TOO_FEW_BINS,
+              getInvalidConfigReason(createExplicitBinConfig({1})));
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_TOO_MANY_BINS,
+              getInvalidConfigReason(createExplicitBinConfig(std::vector<float>(101, 1))));
+    EXPECT_EQ(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_EXPLICIT_BINS_NOT_STRICTLY_ORDERED,
+              getInvalidConfigReason(createExplicitBinConfig({1, 2, 2, 3})));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
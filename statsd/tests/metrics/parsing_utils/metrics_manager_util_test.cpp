@@ -564,6 +564,25 @@ TEST_F(MetricsManagerUtilTest, TestDurationMetricConditionlinkNoCondition) {
                                   StringToId("Duration")));
 }
 
+TEST_F(MetricsManagerUtilTest, TestDurationMetricInvalidDurationHistogram) {
+    StatsdConfig config;
+    DurationMetric* metric = config.add_duration_metric();
+    *metric = createDurationMetric(/*name=*/"Duration", /*what=*/StringToId("ScreenIsOn"),
+                                   /*condition=*/nullopt, /*states=*/{});
+    HistogramBinConfig::ExplicitBins* bins =
+            metric->mutable_duration_histogram()->mutable_explicit_bins();
+    bins->add_bin(100);
+    bins->add_bin(10);
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+    *config.add_predicate() = CreateScreenIsOnPredicate();
+
+    EXPECT_EQ(initConfig(config),
+              InvalidConfigReason(
+                      INVALID_CONFIG_REASON_VALUE_METRIC_HIST_EXPLICIT_BINS_NOT_STRICTLY_ORDERED,
+                      StringToId("Duration")));
+}
+
 TEST_F(MetricsManagerUtilTest, TestGaugeMetricMissingIdOrWhat) {
     StatsdConfig config;
     int64_t metricId = 1;
@@ -988,6 +1007,62 @@ TEST_F(MetricsManagerUtilTest, TestValueMetricHasIncorrectValueField) {
                                   metricId));
 }
 
+TEST_F(MetricsManagerUtilTest, TestValueMetricHistogramBinConfigCountMismatch) {
+    StatsdConfig config;
+    int64_t metricId = 1;
+    ValueMetric* metric = config.add_value_metric();
+    metric->set_id(metricId);
+    metric->set_what(1);
+    metric->set_aggregation_type(ValueMetric::HISTOGRAM);
+
+    metric->mutable_value_field()->set_field(10);
+    metric->mutable_value_field()->add_child()->set_field(2);
+    metric->mutable_value_field()->add_child()->set_field(3);
+    metric->add_histogram_bin_configs()->mutable_explicit_bins()->add_bin(0);
+
+    EXPECT_EQ(initConfig(config),
+              InvalidConfigReason(INVALID_CONFIG_REASON_VALUE_METRIC_HIST_COUNT_DNE_VALUE_FIELD,
+                                  metricId));
+}
+
+TEST_F(MetricsManagerUtilTest, TestValueMetricHistogramInvalidBinConfig) {
+    StatsdConfig config;
+    int64_t metricId = 1;
+    ValueMetric* metric = config.add_value_metric();
+    metric->set_id(metricId);
+    metric->set_what(1);
+    metric->set_aggregation_type(ValueMetric::HISTOGRAM);
+
+    metric->mutable_value_field()->set_field(10);
+    metric->mutable_value_field()->add_child()->set_field(2);
+    HistogramBinConfig::ExplicitBins* bins =
+            metric->add_histogram_bin_configs()->mutable_explicit_bins();
+    bins->add_bin(5);
+    bins->add_bin(1);
+
+    EXPECT_EQ(initConfig(config),
+              InvalidConfigReason(
+                      INVALID_CONFIG_REASON_VALUE_METRIC_HIST_EXPLICIT_BINS_NOT_STRICTLY_ORDERED,
+                      metricId));
+}
+
+TEST_F(MetricsManagerUtilTest, TestValueMetricRollUpOverflowWithDiff) {
+    StatsdConfig config;
+    int64_t metricId = 1;
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    ValueMetric* metric = config.add_value_metric();
+    metric->set_id(metricId);
+    metric->set_what(StringToId("ScreenTurnedOn"));
+    metric->mutable_value_field()->set_field(util::SCREEN_STATE_CHANGED);
+    metric->mutable_value_field()->add_child()->set_field(1);
+    metric->set_use_diff(true);
+    metric->set_roll_up_overflow_dimensions(true);
+
+    EXPECT_EQ(initConfig(config),
+              InvalidConfigReason(INVALID_CONFIG_REASON_VALUE_METRIC_ROLL_UP_OVERFLOW_WITH_DIFF,
+                                  metricId));
+}
+
 TEST_F(MetricsManagerUtilTest, TestKllMetricMissingKllField) {
     StatsdConfig config;
     int64_t metricId = 1;
@@ -1027,6 +1102,61 @@ TEST_F(MetricsManagerUtilTest, TestKllMetricHasIncorrectKllField) {
                                   metricId));
 }
 
+TEST_F(MetricsManagerUtilTest, TestTopKMetricMissingDimensions) {
+    StatsdConfig config;
+    int64_t metricId = 1;
+    TopKMetric* metric = config.add_top_k_metric();
+    metric->set_id(metricId);
+    metric->set_what(1);
+
+    EXPECT_EQ(initConfig(config),
+              InvalidConfigReason(INVALID_CONFIG_REASON_TOP_K_METRIC_MISSING_DIMENSIONS,
+                                  metricId));
+}
+
+TEST_F(MetricsManagerUtilTest, TestTopKMetricInvalidNumCounters) {
+    StatsdConfig config;
+    int64_t metricId = 1;
+    TopKMetric* metric = config.add_top_k_metric();
+    metric->set_id(metricId);
+    metric->set_what(1);
+    *metric->mutable_dimensions_in_what() = CreateDimensions(/*atomId=*/1, {1});
+    metric->set_k(10);
+    metric->set_num_counters(5);
+
+    EXPECT_EQ(initConfig(config),
+              InvalidConfigReason(INVALID_CONFIG_REASON_TOP_K_METRIC_INVALID_NUM_COUNTERS,
+                                  metricId));
+}
+
+TEST_F(MetricsManagerUtilTest, TestDistinctCountMetricMissingDistinctField) {
+    StatsdConfig config;
+    int64_t metricId = 1;
+    DistinctCountMetric* metric = config.add_distinct_count_metric();
+    metric->set_id(metricId);
+    metric->set_what(1);
+
+    EXPECT_EQ(initConfig(config),
+              InvalidConfigReason(
+                      INVALID_CONFIG_REASON_DISTINCT_COUNT_METRIC_MISSING_DISTINCT_FIELD,
+                      metricId));
+}
+
+TEST_F(MetricsManagerUtilTest, TestDistinctCountMetricInvalidPrecision) {
+    StatsdConfig config;
+    int64_t metricId = 1;
+    DistinctCountMetric* metric = config.add_distinct_count_metric();
+    metric->set_id(metricId);
+    metric->set_what(1);
+    metric->mutable_distinct_field()->set_field(1);
+    metric->mutable_distinct_field()->add_child()->set_field(2);
+    metric->set_precision(20);
+
+    EXPECT_EQ(initConfig(config),
+              InvalidConfigReason(INVALID_CONFIG_REASON_DISTINCT_COUNT_METRIC_INVALID_PRECISION,
+                                  metricId));
+}
+
 TEST_F(MetricsManagerUtilTest, TestGaugeMetricIncorrectFieldFilter) {
     StatsdConfig config;
     int64_t metricId = 1;
@@ -2035,6 +2165,26 @@ TEST_F(MetricsManagerUtilTest, TestMatcherWithStringReplacerOnly) {
     ASSERT_EQ(actualInvalidConfigReason, nullopt);
 }
 
+TEST_F(MetricsManagerUtilTest, TestMatcherWithUnsupportedStringReplaceRegex) {
+    StatsdConfig config;
+    config.set_id(12345);
+
+    AtomMatcher* matcher = config.add_atom_matcher();
+    matcher->set_id(111);
+    matcher->mutable_simple_atom_matcher()->set_atom_id(SCREEN_STATE_ATOM_ID);
+    FieldValueMatcher* fvm = matcher->mutable_simple_atom_matcher()->add_field_value_matcher();
+    fvm->set_field(5 /*string_field*/);
+    fvm->mutable_replace_string()->set_regex(R"(([a-z]+)[0-9]+$)");  // Subexpression.
+    fvm->mutable_replace_string()->set_replacement("#");
+
+    optional<InvalidConfigReason> actualInvalidConfigReason = initConfig(config);
+
+    ASSERT_NE(actualInvalidConfigReason, nullopt);
+    EXPECT_EQ(actualInvalidConfigReason->reason,
+              INVALID_CONFIG_REASON_MATCHER_STRING_REPLACE_INVALID_REGEX);
+    EXPECT_THAT(actualInvalidConfigReason->matcherIds, ElementsAre(111));
+}
+
 TEST_F(MetricsManagerUtilTest, TestValueMatcherWithPositionAll) {
     StatsdConfig config;
     config.set_id(12345);
@@ -0,0 +1,229 @@
+// Copyright (C) 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "replay/Replayer.h"
+
+#include <gtest/gtest.h>
+#include <private/android_filesystem_config.h>
+
+#include "src/stats_log.pb.h"
+#include "src/stats_log_util.h"
+#include "src/utils/ShardOffsetProvider.h"
+#include "stats_event.h"
+#include "statslog_statsd.h"
+
+// Runs on the host as well, so only uses what libstatsd_offline provides and not the helpers in
+// tests/statsd_test_util.h.
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::vector;
+
+namespace {
+
+const int64_t kStartNs = 1000 * NS_PER_SEC;
+const int64_t kBucketSizeNs = 5 * 60 * NS_PER_SEC;
+const int64_t kScreenOnMatcherId = 1;
+const int64_t kSubsystemSleepMatcherId = 2;
+
+AtomMatcher createScreenTurnedOnAtomMatcher() {
+    AtomMatcher matcher;
+    matcher.set_id(kScreenOnMatcherId);
+    SimpleAtomMatcher* simpleMatcher = matcher.mutable_simple_atom_matcher();
+    simpleMatcher->set_atom_id(util::SCREEN_STATE_CHANGED);
+    FieldValueMatcher* fieldValueMatcher = simpleMatcher->add_field_value_matcher();
+    fieldValueMatcher->set_field(1);  // State field.
+    fieldValueMatcher->set_eq_int(android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    return matcher;
+}
+
+AtomMatcher createSubsystemSleepAtomMatcher() {
+    AtomMatcher matcher;
+    matcher.set_id(kSubsystemSleepMatcherId);
+    matcher.mutable_simple_atom_matcher()->set_atom_id(util::SUBSYSTEM_SLEEP_STATE);
+    return matcher;
+}
+
+StatsdConfig createScreenOnCountConfig(int64_t configId) {
+    StatsdConfig config;
+    config.set_id(configId);
+    *config.add_atom_matcher() = createScreenTurnedOnAtomMatcher();
+    CountMetric* metric = config.add_count_metric();
+    metric->set_id(configId + 1);
+    metric->set_what(kScreenOnMatcherId);
+    metric->set_bucket(FIVE_MINUTES);
+    return config;
+}
+
+AtomRecord buildRecord(AStatsEvent* statsEvent, int32_t atomId, int64_t receiveElapsedNs) {
+    AStatsEvent_build(statsEvent);
+    size_t size;
+    const uint8_t* buffer = AStatsEvent_getBuffer(statsEvent, &size);
+
+    AtomRecord record;
+    record.atomId = atomId;
+    record.uid = AID_ROOT;
+    record.pid = 0;
+    record.receiveElapsedNs = receiveElapsedNs;
+    record.payload.assign(buffer, buffer + size);
+    AStatsEvent_release(statsEvent);
+    return record;
+}
+
+AtomRecord createScreenStateRecord(int64_t timeNs, android::view::DisplayStateEnum state) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, util::SCREEN_STATE_CHANGED);
+    AStatsEvent_overwriteTimestamp(statsEvent, timeNs);
+    AStatsEvent_writeInt32(statsEvent, state);
+    return buildRecord(statsEvent, util::SCREEN_STATE_CHANGED, timeNs);
+}
+
+AtomRecord createSubsystemSleepRecord(int64_t timeNs, int64_t timeMillis) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, util::SUBSYSTEM_SLEEP_STATE);
+    AStatsEvent_overwriteTimestamp(statsEvent, timeNs);
+    AStatsEvent_writeString(statsEvent, "subsystem");
+    AStatsEvent_writeString(statsEvent, "subname");
+    AStatsEvent_writeInt64(statsEvent, /*count=*/1);
+    AStatsEvent_writeInt64(statsEvent, timeMillis);
+    return buildRecord(statsEvent, util::SUBSYSTEM_SLEEP_STATE, timeNs);
+}
+
+ConfigMetricsReportList parseReports(const ReplayResult& result) {
+    ConfigMetricsReportList reports;
+    EXPECT_TRUE(reports.ParseFromArray(result.report.data(), result.report.size()));
+    return reports;
+}
+
+}  // anonymous namespace
+
+TEST(ReplayerTest, TestCountMetric) {
+    const StatsdConfig config = createScreenOnCountConfig(12345);
+
+    ReplayOptions options;
+    options.atoms.push_back(createScreenStateRecord(
+            kStartNs, android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    options.atoms.push_back(createScreenStateRecord(
+            kStartNs + 10, android::view::DisplayStateEnum::DISPLAY_STATE_OFF));
+    options.atoms.push_back(createScreenStateRecord(
+            kStartNs + 20, android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    options.atoms.push_back(createScreenStateRecord(
+            kStartNs + kBucketSizeNs + 10, android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    options.atoms.push_back(AtomRecord());  // Not a valid atom.
+    options.seed = 42;
+
+    const Replayer replayer(std::move(options));
+    const ConfigKey key(AID_SHELL, config.id());
+    const ReplayResult result = replayer.replay(key, config);
+    EXPECT_EQ(4, result.numEvents);
+    EXPECT_EQ(1, result.numInvalidEvents);
+    ASSERT_EQ(1, result.atomStats.size());
+    EXPECT_EQ(4, result.atomStats.at(util::SCREEN_STATE_CHANGED).count);
+
+    ConfigMetricsReportList reports = parseReports(result);
+    ASSERT_EQ(1, reports.reports_size());
+    EXPECT_EQ(kStartNs + kBucketSizeNs + 10, reports.reports(0).current_report_elapsed_nanos());
+    ASSERT_EQ(1, reports.reports(0).metrics_size());
+    const StatsLogReport::CountMetricDataWrapper& countMetrics =
+            reports.reports(0).metrics(0).count_metrics();
+    ASSERT_EQ(1, countMetrics.data_size());
+    ASSERT_EQ(2, countMetrics.data(0).bucket_info_size());
+    EXPECT_EQ(2, countMetrics.data(0).bucket_info(0).count());
+    EXPECT_EQ(1, countMetrics.data(0).bucket_info(1).count());
+
+    // Same inputs and seed, same report.
+    EXPECT_EQ(result.report, replayer.replay(key, config).report);
+}
+
+TEST(ReplayerTest, TestPullFixture) {
+    StatsdConfig config;
+    config.set_id(12346);
+    config.add_default_pull_packages("AID_ROOT");
+    *config.add_atom_matcher() = createSubsystemSleepAtomMatcher();
+    GaugeMetric* metric = config.add_gauge_metric();
+    metric->set_id(12347);
+    metric->set_what(kSubsystemSleepMatcherId);
+    metric->set_sampling_type(GaugeMetric::RANDOM_ONE_SAMPLE);
+    metric->mutable_gauge_fields_filter()->set_include_all(true);
+    metric->set_bucket(FIVE_MINUTES);
+    metric->set_max_pull_delay_sec(INT_MAX);
+    config.set_hash_strings_in_metric_report(false);
+
+    ReplayOptions options;
+    options.atoms.push_back(createScreenStateRecord(
+            kStartNs, android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    options.atoms.push_back(createScreenStateRecord(
+            kStartNs + kBucketSizeNs + 10, android::view::DisplayStateEnum::DISPLAY_STATE_OFF));
+    options.pullFixtures.push_back(createSubsystemSleepRecord(kStartNs, /*timeMillis=*/100));
+    options.pullFixtures.push_back(
+            createSubsystemSleepRecord(kStartNs + kBucketSizeNs, /*timeMillis=*/200));
+
+    const Replayer replayer(std::move(options));
+    const ReplayResult result = replayer.replay(ConfigKey(AID_SHELL, config.id()), config);
+    EXPECT_EQ(1, result.numPullAlarms);
+
+    const ConfigMetricsReportList reports = parseReports(result);
+    ASSERT_EQ(1, reports.reports_size());
+    ASSERT_EQ(1, reports.reports(0).metrics_size());
+    const StatsLogReport::GaugeMetricDataWrapper& gaugeMetrics =
+            reports.reports(0).metrics(0).gauge_metrics();
+    ASSERT_EQ(1, gaugeMetrics.data_size());
+    const GaugeMetricData& data = gaugeMetrics.data(0);
+    ASSERT_EQ(2, data.bucket_info_size());
+
+    // Pulled when the config was added, then at the bucket boundary.
+    ASSERT_EQ(1, data.bucket_info(0).aggregated_atom_info_size());
+    EXPECT_EQ(100, data.bucket_info(0)
+                           .aggregated_atom_info(0)
+                           .atom()
+                           .subsystem_sleep_state()
+                           .time_millis());
+    ASSERT_EQ(1, data.bucket_info(1).aggregated_atom_info_size());
+    EXPECT_EQ(200, data.bucket_info(1)
+                           .aggregated_atom_info(0)
+                           .atom()
+                           .subsystem_sleep_state()
+                           .time_millis());
+}
+
+TEST(ReplayerTest, TestReportDoesNotDependOnConfigOrder) {
+    const StatsdConfig config1 = createScreenOnCountConfig(12348);
+    const StatsdConfig config2 = createScreenOnCountConfig(12350);
+
+    ReplayOptions options;
+    options.atoms.push_back(createScreenStateRecord(
+            kStartNs, android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    options.seed = 7;
+    const Replayer replayer(std::move(options));
+    const ConfigKey key1(AID_SHELL, config1.id());
+    const ConfigKey key2(AID_SHELL, config2.id());
+
+    // The shard offset that ends up in the reports is derived from the seed, not from what the
+    // process drew before.
+    srand(7);
+    const uint32_t shardOffset = rand();
+    ShardOffsetProvider::getInstance().setShardOffset(shardOffset + 1);
+    const ReplayResult result1 = replayer.replay(key1, config1);
+    EXPECT_EQ(shardOffset, ShardOffsetProvider::getInstance().getShardOffset());
+
+    rand();
+    replayer.replay(key2, config2);
+    EXPECT_EQ(result1.report, replayer.replay(key1, config1).report);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
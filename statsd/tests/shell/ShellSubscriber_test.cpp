@@ -19,7 +19,10 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include <chrono>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <vector>
 
 #include "frameworks/proto_logging/stats/atoms.pb.h"
@@ -46,6 +49,7 @@ using android::os::statsd::util::TEST_ATOM_REPORTED;
 using std::vector;
 using testing::_;
 using testing::A;
+using testing::AtLeast;
 using testing::AtMost;
 using testing::ByMove;
 using testing::DoAll;
@@ -493,6 +497,149 @@ TEST_F(ShellSubscriberCallbackTest, testFlushTrigger) {
     EXPECT_EQ(perSubscriptionStats.flush_count(), 1);
 }
 
+TEST_F(ShellSubscriberCallbackTest, testEnqueuedEventsAreFlushed) {
+    // Expect callback to be invoked once.
+    EXPECT_CALL(*callback, onSubscriptionData(_, _)).Times(Exactly(1)).RetiresOnSaturation();
+    EXPECT_CALL(
+            *mockLogEventFilter,
+            setAtomIds(CreateAtomIdSetFromShellSubscriptionBytes(configBytes), &shellSubscriber))
+            .Times(1);
+    shellSubscriber.startNewSubscription(configBytes, callback);
+
+    shellSubscriber.enqueueLogEvent(CreateScreenStateChangedEvent(
+            1000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    shellSubscriber.enqueueLogEvent(CreateScreenStateChangedEvent(
+            1100 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_OFF));
+
+    // The flush waits for the queued events to be delivered.
+    shellSubscriber.flushSubscription(callback);
+
+    EXPECT_THAT(reason, Eq(StatsSubscriptionCallbackReason::FLUSH_REQUESTED));
+
+    ShellData actualShellData;
+    ASSERT_TRUE(actualShellData.ParseFromArray(payload.data(), payload.size()));
+
+    ShellData expectedShellData;
+    expectedShellData.add_atom()->mutable_screen_state_changed()->set_state(
+            ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    expectedShellData.add_atom()->mutable_screen_state_changed()->set_state(
+            ::android::view::DisplayStateEnum::DISPLAY_STATE_OFF);
+    expectedShellData.add_elapsed_timestamp_nanos(1000);
+    expectedShellData.add_elapsed_timestamp_nanos(1100);
+
+    EXPECT_THAT(actualShellData, EqShellData(expectedShellData));
+    EXPECT_EQ(getStatsdStatsReport().subscription_stats().event_dropped_count(), 0);
+}
+
+TEST_F(ShellSubscriberCallbackTest, testFullQueueDropsEvents) {
+    // The client cache is small, so the events reach the callback over several flushes.
+    std::mutex shellDataMutex;
+    vector<ShellData> shellDataList;
+    EXPECT_CALL(*callback, onSubscriptionData(_, _))
+            .Times(AtLeast(1))
+            .WillRepeatedly(Invoke([&](StatsSubscriptionCallbackReason,
+                                       const vector<uint8_t>& callbackPayload) {
+                ShellData shellData;
+                EXPECT_TRUE(shellData.ParseFromArray(callbackPayload.data(),
+                                                     callbackPayload.size()));
+                std::lock_guard<std::mutex> lock(shellDataMutex);
+                shellDataList.push_back(std::move(shellData));
+                return Status::ok();
+            }));
+    EXPECT_CALL(
+            *mockLogEventFilter,
+            setAtomIds(CreateAtomIdSetFromShellSubscriptionBytes(configBytes), &shellSubscriber))
+            .Times(1);
+    shellSubscriber.startNewSubscription(configBytes, callback);
+
+    // Stall the dispatch thread on the clients lock once it has taken the first event, so that
+    // the following events pile up in the queue.
+    std::unique_lock<std::mutex> clientsLock(shellSubscriber.mMutex);
+    shellSubscriber.enqueueLogEvent(CreateScreenStateChangedEvent(
+            1 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    while (true) {
+        {
+            std::lock_guard<std::mutex> queueLock(shellSubscriber.mQueueMutex);
+            if (shellSubscriber.mDispatching) {
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const int maxQueuedEvents = ShellSubscriber::getMaxQueuedEvents();
+    const int numDroppedEvents = 5;
+    for (int i = 0; i < maxQueuedEvents + numDroppedEvents; i++) {
+        shellSubscriber.enqueueLogEvent(CreateScreenStateChangedEvent(
+                2 + i /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    }
+    EXPECT_EQ(getStatsdStatsReport().subscription_stats().event_dropped_count(),
+              numDroppedEvents);
+    clientsLock.unlock();
+
+    // Events still go through once the queue drains.
+    const int64_t lastTimestampNs = 10000;
+    shellSubscriber.enqueueLogEvent(CreateScreenStateChangedEvent(
+            lastTimestampNs, ::android::view::DisplayStateEnum::DISPLAY_STATE_OFF));
+    shellSubscriber.flushSubscription(callback);
+
+    std::lock_guard<std::mutex> lock(shellDataMutex);
+    int numAtoms = 0;
+    for (const ShellData& shellData : shellDataList) {
+        numAtoms += shellData.atom_size();
+    }
+    EXPECT_EQ(numAtoms, 1 + maxQueuedEvents + 1);
+    ASSERT_FALSE(shellDataList.empty());
+    const ShellData& lastShellData = shellDataList.back();
+    ASSERT_GT(lastShellData.atom_size(), 0);
+    EXPECT_EQ(lastShellData.atom(lastShellData.atom_size() - 1).screen_state_changed().state(),
+              ::android::view::DisplayStateEnum::DISPLAY_STATE_OFF);
+    EXPECT_EQ(lastShellData.elapsed_timestamp_nanos(lastShellData.elapsed_timestamp_nanos_size() -
+                                                    1),
+              lastTimestampNs);
+    EXPECT_EQ(getStatsdStatsReport().subscription_stats().event_dropped_count(),
+              numDroppedEvents);
+}
+
+TEST_F(ShellSubscriberCallbackTest, testIdenticalSubscriptionsReceiveSameData) {
+    EXPECT_CALL(*callback, onSubscriptionData(_, _)).Times(Exactly(1)).RetiresOnSaturation();
+    EXPECT_CALL(
+            *mockLogEventFilter,
+            setAtomIds(CreateAtomIdSetFromShellSubscriptionBytes(configBytes), &shellSubscriber))
+            .Times(AtLeast(1));
+    std::shared_ptr<MockStatsSubscriptionCallback> callback2 =
+            SharedRefBase::make<NiceMock<MockStatsSubscriptionCallback>>();
+    vector<uint8_t> payload2;
+    ON_CALL(*callback2, onSubscriptionData(_, _))
+            .WillByDefault(DoAll(SaveArg<1>(&payload2), [] { return Status::ok(); }));
+    shellSubscriber.startNewSubscription(configBytes, callback);
+    shellSubscriber.startNewSubscription(configBytes, callback2);
+
+    shellSubscriber.onLogEvent(*CreateScreenStateChangedEvent(
+            1000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON));
+    // The tag of the attribution node is transformed by the matcher.
+    shellSubscriber.onLogEvent(*createTestAtomReportedEvent(/*timestampNs=*/1100,
+                                                            /*intFieldValue=*/1, /*expIds=*/{}));
+
+    shellSubscriber.flushSubscription(callback);
+    shellSubscriber.flushSubscription(callback2);
+    shellSubscriber.unsubscribe(callback2);
+
+    ShellData actualShellData;
+    ASSERT_TRUE(actualShellData.ParseFromArray(payload.data(), payload.size()));
+
+    ShellData expectedShellData;
+    expectedShellData.add_atom()->mutable_screen_state_changed()->set_state(
+            ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    *expectedShellData.add_atom()->mutable_test_atom_reported() =
+            createTestAtomReportedProto(/* intFieldValue=*/1, /*expIds=*/{});
+    expectedShellData.add_elapsed_timestamp_nanos(1000);
+    expectedShellData.add_elapsed_timestamp_nanos(1100);
+
+    EXPECT_THAT(actualShellData, EqShellData(expectedShellData));
+    EXPECT_EQ(payload, payload2);
+}
+
 TEST_F(ShellSubscriberCallbackTest, testFlushTriggerEmptyCache) {
     // Expect callback to be invoked once.
     EXPECT_CALL(*callback, onSubscriptionData(_, _)).Times(Exactly(1)).RetiresOnSaturation();
@@ -51,13 +51,43 @@ public:
 
     std::vector<Update> updates;
 
+    // Updates received through onLinkedStateChanged, keyed by the linked key.
+    std::vector<Update> linkedUpdates;
+
+    StateFieldLinks links;
+
     void onStateChanged(const int64_t eventTimeNs, const int32_t atomId,
                         const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                         const FieldValue& newState) {
         updates.emplace_back(primaryKey, newState.mValue.int_value);
     }
+
+    StateFieldLinks getStateFieldLinks(const int32_t atomId) const {
+        return links;
+    }
+
+    void onLinkedStateChanged(const int64_t eventTimeNs, const int32_t atomId,
+                              const HashableDimensionKey& primaryKey,
+                              const HashableDimensionKey& linkedKey, const FieldValue& oldState,
+                              const FieldValue& newState) {
+        linkedUpdates.emplace_back(linkedKey, newState.mValue.int_value);
+    }
 };
 
+// Links the given fields of the state atom to the given fields of the what atom, in order.
+StateFieldLinks createStateFieldLinks(int stateAtomId, const std::vector<int>& stateFields,
+                                      int whatAtomId, const std::vector<int>& whatFields) {
+    std::vector<Matcher> stateMatchers;
+    translateFieldMatcher(CreateDimensions(stateAtomId, stateFields), &stateMatchers);
+    std::vector<Matcher> whatMatchers;
+    translateFieldMatcher(CreateDimensions(whatAtomId, whatFields), &whatMatchers);
+    StateFieldLinks links;
+    for (size_t i = 0; i < stateMatchers.size(); i++) {
+        links.emplace_back(stateMatchers[i].mMatcher, whatMatchers[i].mMatcher);
+    }
+    return links;
+}
+
 int getStateInt(StateManager& mgr, int atomId, const HashableDimensionKey& queryKey) {
     FieldValue output;
     mgr.getStateValue(atomId, queryKey, &output);
@@ -239,6 +269,93 @@ TEST(StateTrackerTest, TestUnregisterListener) {
     EXPECT_EQ(-1, mgr.getListenersCount(util::SCREEN_STATE_CHANGED));
 }
 
+/**
+ * Test that listeners destroyed without unregistering are dropped from the
+ * StateTracker the next time it notifies its listeners.
+ */
+TEST(StateTrackerTest, TestExpiredListenerRemoved) {
+    sp<TestStateListener> listener1 = new TestStateListener();
+    sp<TestStateListener> listener2 = new TestStateListener();
+    StateManager mgr;
+    mgr.registerListener(util::SCREEN_STATE_CHANGED, listener1);
+    mgr.registerListener(util::SCREEN_STATE_CHANGED, listener2);
+    EXPECT_EQ(2, mgr.getListenersCount(util::SCREEN_STATE_CHANGED));
+
+    listener2 = nullptr;  // let go of listener2 without unregistering it
+
+    std::unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+            timestampNs, android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    mgr.onLogEvent(*event);
+    ASSERT_EQ(1, listener1->updates.size());
+    EXPECT_EQ(android::view::DisplayStateEnum::DISPLAY_STATE_ON, listener1->updates[0].mState);
+    EXPECT_EQ(1, mgr.getStateTrackersCount());
+    EXPECT_EQ(1, mgr.getListenersCount(util::SCREEN_STATE_CHANGED));
+}
+
+/**
+ * Test that listeners with the same state field links share a group, and receive the primary key
+ * translated to the linked fields.
+ */
+TEST(StateTrackerTest, TestListenersGroupedByLinks) {
+    const int whatAtomId = 10;
+    sp<TestStateListener> listener1 = new TestStateListener();
+    listener1->links =
+            createStateFieldLinks(util::OVERLAY_STATE_CHANGED, {1, 2}, whatAtomId, {1, 3});
+    sp<TestStateListener> listener2 = new TestStateListener();
+    // Same links in another order.
+    listener2->links =
+            createStateFieldLinks(util::OVERLAY_STATE_CHANGED, {2, 1}, whatAtomId, {3, 1});
+    sp<TestStateListener> listener3 = new TestStateListener();
+    listener3->links =
+            createStateFieldLinks(util::OVERLAY_STATE_CHANGED, {1, 2}, whatAtomId, {2, 3});
+    // Only the uid is linked, so the package name of the primary key cannot be translated.
+    sp<TestStateListener> listener4 = new TestStateListener();
+    listener4->links = createStateFieldLinks(util::OVERLAY_STATE_CHANGED, {1}, whatAtomId, {1});
+    sp<TestStateListener> listener5 = new TestStateListener();
+
+    StateTracker tracker(util::OVERLAY_STATE_CHANGED);
+    tracker.registerListener(listener1);
+    tracker.registerListener(listener2);
+    tracker.registerListener(listener3);
+    tracker.registerListener(listener4);
+    tracker.registerListener(listener5);
+    EXPECT_EQ(5, tracker.getListenersCount());
+    ASSERT_EQ(4, tracker.mListenerGroups.size());
+    EXPECT_EQ(2, tracker.mListenerGroups[0].listeners.size());
+
+    std::unique_ptr<LogEvent> event = CreateOverlayStateChangedEvent(
+            timestampNs, 1000 /* uid */, "package1", true /*using_alert_window*/,
+            OverlayStateChanged::ENTERED);
+    tracker.onLogEvent(*event);
+
+    for (const sp<TestStateListener>& listener : {listener1, listener2}) {
+        EXPECT_EQ(0, listener->updates.size());
+        ASSERT_EQ(1, listener->linkedUpdates.size());
+        const std::vector<FieldValue>& values = listener->linkedUpdates[0].mKey.getValues();
+        ASSERT_EQ(2, values.size());
+        EXPECT_EQ(listener1->links[0].second, values[0].mField);
+        EXPECT_EQ(1000, values[0].mValue.int_value);
+        EXPECT_EQ(listener1->links[1].second, values[1].mField);
+        EXPECT_EQ("package1", values[1].mValue.str_value);
+        EXPECT_EQ(OverlayStateChanged::ENTERED, listener->linkedUpdates[0].mState);
+    }
+
+    ASSERT_EQ(1, listener3->linkedUpdates.size());
+    EXPECT_EQ(listener3->links[0].second,
+              listener3->linkedUpdates[0].mKey.getValues()[0].mField);
+
+    for (const sp<TestStateListener>& listener : {listener4, listener5}) {
+        EXPECT_EQ(0, listener->linkedUpdates.size());
+        ASSERT_EQ(1, listener->updates.size());
+        EXPECT_EQ(1000, listener->updates[0].mKey.getValues()[0].mValue.int_value);
+    }
+
+    // The group is removed with its last listener.
+    tracker.unregisterListener(listener3);
+    EXPECT_EQ(3, tracker.mListenerGroups.size());
+    EXPECT_EQ(4, tracker.getListenersCount());
+}
+
 /**
  * Test a binary state atom with nested counting.
  *
@@ -20,6 +20,7 @@
 #include <stdio.h>
 
 #include "android-base/stringprintf.h"
+#include "src/storage/FileCompression.h"
 #include "stats_log_util.h"
 #include "tests/statsd_test_util.h"
 #include "utils/DbUtils.h"
@@ -104,6 +105,57 @@ TEST(StorageManagerTest, SortFileTest) {
     EXPECT_EQ("300_2000_123454_history", list[3].mFileName);
 }
 
+TEST(StorageManagerTest, TrimToFitUsesWrittenFiles) {
+    TemporaryDir dir;
+    // Builds the ledger of the directory while it is still empty.
+    StorageManager::trimToFit(dir.path);
+
+    const int64_t nowSec = getWallClockSec();
+    const string expiredFile =
+            base::StringPrintf("%s/%lld_1066_1", dir.path,
+                               (long long)(nowSec - StatsdStats::kMaxAgeSecond - 1));
+    const string expiredHistoryFile =
+            base::StringPrintf("%s/%lld_1066_2_history", dir.path,
+                               (long long)(nowSec - StatsdStats::kMaxLocalHistoryAgeSecond - 1));
+    const string recentFile = base::StringPrintf("%s/%lld_1066_3", dir.path, (long long)nowSec);
+    for (const string& file : {expiredFile, expiredHistoryFile, recentFile}) {
+        StorageManager::writeFile(file.c_str(), "content", 7);
+        EXPECT_TRUE(StorageManager::hasFile(file.c_str()));
+    }
+
+    StorageManager::trimToFit(dir.path);
+    EXPECT_FALSE(StorageManager::hasFile(expiredFile.c_str()));
+    EXPECT_FALSE(StorageManager::hasFile(expiredHistoryFile.c_str()));
+    EXPECT_TRUE(StorageManager::hasFile(recentFile.c_str()));
+
+    StorageManager::deleteAllFiles(dir.path);
+}
+
+TEST(StorageManagerTest, TrimToFitRemovesOldestFilesOverLimit) {
+    TemporaryDir dir;
+    StorageManager::trimToFit(dir.path);
+
+    const int64_t nowSec = getWallClockSec();
+    vector<string> files;
+    for (int i = 0; i <= StatsdStats::kMaxFileNumber; i++) {
+        files.push_back(
+                base::StringPrintf("%s/%lld_1066_%d", dir.path, (long long)(nowSec - i), i));
+        StorageManager::writeFile(files.back().c_str(), "content", 7);
+    }
+    StorageManager::deleteFile(files[0].c_str());
+
+    // The deleted file brings the directory under the limit.
+    StorageManager::trimToFit(dir.path);
+    EXPECT_TRUE(StorageManager::hasFile(files.back().c_str()));
+
+    StorageManager::writeFile(files[0].c_str(), "content", 7);
+    StorageManager::trimToFit(dir.path);
+    EXPECT_TRUE(StorageManager::hasFile(files[0].c_str()));
+    EXPECT_FALSE(StorageManager::hasFile(files.back().c_str()));
+
+    StorageManager::deleteAllFiles(dir.path);
+}
+
 const string testDir = "/data/misc/stats-data/";
 const string file1 = testDir + "2557169347_1066_1";
 const string file2 = testDir + "2557169349_1066_1";
@@ -203,6 +255,60 @@ TEST(StorageManagerTest, AppendConfigReportTest4) {
     clearLocalHistoryTestFiles();
 }
 
+TEST(StorageManagerTest, CompressFileContentRoundTrip) {
+    string content;
+    for (int i = 0; i < 1000; i++) {
+        content += "repetitive report content ";
+    }
+    string compressed;
+    ASSERT_TRUE(compressFileContent(content.data(), content.size(), &compressed));
+    EXPECT_LT(compressed.size(), content.size());
+    EXPECT_EQ('\0', compressed[0]);
+
+    ASSERT_TRUE(decompressFileContent(&compressed));
+    EXPECT_EQ(content, compressed);
+}
+
+TEST(StorageManagerTest, DecompressUncompressedContent) {
+    string content = "content";
+    EXPECT_TRUE(decompressFileContent(&content));
+    EXPECT_EQ("content", content);
+
+    // Header with an unknown codec.
+    string compressed;
+    ASSERT_TRUE(compressFileContent(content.data(), content.size(), &compressed));
+    compressed[5] = 42;
+    EXPECT_FALSE(decompressFileContent(&compressed));
+}
+
+TEST(StorageManagerTest, AppendCompressedConfigReport) {
+    ConfigMetricsReport report;
+    report.set_last_report_elapsed_nanos(1);
+    for (int i = 0; i < 100; i++) {
+        report.add_strings("repetitive string");
+    }
+    const string reportBytes = report.SerializeAsString();
+
+    StorageManager::setCompressFiles(true);
+    StorageManager::writeCompressibleFile(file1.c_str(), reportBytes.data(), reportBytes.size());
+    StorageManager::setCompressFiles(false);
+
+    struct stat fileInfo;
+    ASSERT_EQ(0, stat(file1.c_str(), &fileInfo));
+    EXPECT_LT(fileInfo.st_size, (off_t)reportBytes.size());
+
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(ConfigKey(1066, 1), &out, true /*erase?*/,
+                                              true /*isAdb?*/);
+    ConfigMetricsReportList reports;
+    outputStreamToProto(&out, &reports);
+    ASSERT_EQ(1, reports.reports_size());
+    EXPECT_EQ(reportBytes, reports.reports(0).SerializeAsString());
+    EXPECT_FALSE(fileExist(file1));
+
+    clearLocalHistoryTestFiles();
+}
+
 TEST(StorageManagerTest, TrainInfoReadWrite32To64BitTest) {
     InstallTrainInfo trainInfo;
     trainInfo.trainVersionCode = 12345;
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/AtomEncoder.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "stats_log_util.h"
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+using android::util::ProtoOutputStream;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+vector<uint8_t> encodeWithHelper(const LogEvent& event) {
+    ProtoOutputStream proto;
+    writeFieldValueTreeToStream(event.GetTagId(), event.getValues(), &proto);
+    vector<uint8_t> bytes;
+    proto.serializeToVector(&bytes);
+    return bytes;
+}
+
+vector<uint8_t> encodeWithEncoder(AtomEncoder& encoder, const LogEvent& event) {
+    ProtoOutputStream proto;
+    encoder.write(event.GetTagId(), event.getValues(), &proto);
+    vector<uint8_t> bytes;
+    proto.serializeToVector(&bytes);
+    return bytes;
+}
+
+}  // anonymous namespace
+
+TEST(AtomEncoderTest, TestAttributionChain) {
+    AtomEncoder encoder;
+    unique_ptr<LogEvent> event =
+            CreateBleScanResultReceivedEvent(/*timestampNs=*/1000, {1111, 2222, 3333},
+                                             {"location1", "location2", ""}, /*numResults=*/999);
+    EXPECT_EQ(encodeWithHelper(*event), encodeWithEncoder(encoder, *event));
+    // Second write replays the cached plan.
+    EXPECT_EQ(encodeWithHelper(*event), encodeWithEncoder(encoder, *event));
+}
+
+TEST(AtomEncoderTest, TestAttributionChainsOfDifferentLengths) {
+    AtomEncoder encoder;
+    for (int i = 1; i <= 6; i++) {
+        vector<int> uids;
+        vector<string> tags;
+        for (int j = 0; j < i; j++) {
+            uids.push_back(1000 + j);
+            tags.push_back("tag" + std::to_string(j));
+        }
+        unique_ptr<LogEvent> event = CreateBleScanResultReceivedEvent(
+                /*timestampNs=*/1000, uids, tags, /*numResults=*/i);
+        EXPECT_EQ(encodeWithHelper(*event), encodeWithEncoder(encoder, *event));
+    }
+    // Layouts evicted from the cache are rebuilt.
+    unique_ptr<LogEvent> event = CreateBleScanResultReceivedEvent(
+            /*timestampNs=*/1000, {1000}, {"tag0"}, /*numResults=*/1);
+    EXPECT_EQ(encodeWithHelper(*event), encodeWithEncoder(encoder, *event));
+}
+
+TEST(AtomEncoderTest, TestAllFieldTypes) {
+    AtomEncoder encoder;
+    bool repeatedBoolField[] = {true, false, true};
+    unique_ptr<LogEvent> event = CreateTestAtomReportedEvent(
+            /*timestampNs=*/1000, {1001, 1002}, {"tag1", "tag2"}, /*intField=*/-5,
+            /*longField=*/1234567890123L, /*floatField=*/3.5f, /*stringField=*/"string",
+            /*boolField=*/true, TestAtomReported::ON, /*bytesField=*/{1, 2, 3},
+            /*repeatedIntField=*/{3, -6}, /*repeatedLongField=*/{1000L, 10002L},
+            /*repeatedFloatField=*/{0.3f, 0.09f}, /*repeatedStringField=*/{"str1", ""},
+            repeatedBoolField, /*repeatedBoolFieldLength=*/3,
+            /*repeatedEnumField=*/{TestAtomReported::ON, TestAtomReported::OFF});
+    EXPECT_EQ(encodeWithHelper(*event), encodeWithEncoder(encoder, *event));
+
+    // Same atom with a different layout for the repeated fields.
+    unique_ptr<LogEvent> event2 = CreateTestAtomReportedEvent(
+            /*timestampNs=*/2000, {1001}, {"tag1"}, /*intField=*/0, /*longField=*/0,
+            /*floatField=*/0, /*stringField=*/"", /*boolField=*/false, TestAtomReported::OFF,
+            /*bytesField=*/{}, /*repeatedIntField=*/{}, /*repeatedLongField=*/{7},
+            /*repeatedFloatField=*/{}, /*repeatedStringField=*/{"str"}, repeatedBoolField,
+            /*repeatedBoolFieldLength=*/0, /*repeatedEnumField=*/{});
+    EXPECT_EQ(encodeWithHelper(*event2), encodeWithEncoder(encoder, *event2));
+    EXPECT_EQ(encodeWithHelper(*event), encodeWithEncoder(encoder, *event));
+}
+
+TEST(AtomEncoderTest, TestSameLayoutDifferentValues) {
+    AtomEncoder encoder;
+    unique_ptr<LogEvent> event1 = CreateScreenStateChangedEvent(
+            /*timestampNs=*/1000, android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    unique_ptr<LogEvent> event2 = CreateScreenStateChangedEvent(
+            /*timestampNs=*/2000, android::view::DisplayStateEnum::DISPLAY_STATE_OFF);
+    EXPECT_EQ(encodeWithHelper(*event1), encodeWithEncoder(encoder, *event1));
+    EXPECT_EQ(encodeWithHelper(*event2), encodeWithEncoder(encoder, *event2));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
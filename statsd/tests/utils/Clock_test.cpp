@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/Clock.h"
+
+#include <gtest/gtest.h>
+
+#include "src/stats_log_util.h"
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int64_t kOneDayNs = 24 * 60 * 60 * NS_PER_SEC;
+const int64_t kStartElapsedNs = 100 * NS_PER_SEC;
+const int64_t kStartWallClockNs = 1700000000LL * NS_PER_SEC;
+
+}  // anonymous namespace
+
+TEST(ClockTest, TestSimulatedClock) {
+    SimulatedClock clock(kStartElapsedNs, kStartWallClockNs);
+    EXPECT_EQ(kStartElapsedNs, clock.getElapsedRealtimeNs());
+    EXPECT_EQ(kStartElapsedNs, clock.getUptimeNs());
+    EXPECT_EQ(kStartWallClockNs, clock.getWallClockNs());
+
+    clock.advance(NS_PER_SEC);
+    EXPECT_EQ(kStartElapsedNs + NS_PER_SEC, clock.getElapsedRealtimeNs());
+    EXPECT_EQ(kStartElapsedNs + NS_PER_SEC, clock.getUptimeNs());
+    EXPECT_EQ(kStartWallClockNs + NS_PER_SEC, clock.getWallClockNs());
+
+    // Suspend does not count towards the uptime.
+    clock.suspend(kOneDayNs);
+    EXPECT_EQ(kStartElapsedNs + NS_PER_SEC + kOneDayNs, clock.getElapsedRealtimeNs());
+    EXPECT_EQ(kStartElapsedNs + NS_PER_SEC, clock.getUptimeNs());
+    EXPECT_EQ(kStartWallClockNs + NS_PER_SEC + kOneDayNs, clock.getWallClockNs());
+
+    // The wall clock can move backwards independently.
+    clock.setWallClockNs(kStartWallClockNs);
+    EXPECT_EQ(kStartWallClockNs, clock.getWallClockNs());
+    EXPECT_EQ(kStartElapsedNs + NS_PER_SEC + kOneDayNs, clock.getElapsedRealtimeNs());
+}
+
+TEST(ClockTest, TestTimeHelpersReadInstalledClock) {
+    std::shared_ptr<SimulatedClock> clock =
+            std::make_shared<SimulatedClock>(kStartElapsedNs, kStartWallClockNs + 500 * 1000000);
+    Clock::set(clock);
+
+    EXPECT_EQ(kStartElapsedNs, getElapsedRealtimeNs());
+    EXPECT_EQ(NanoToMillis(kStartElapsedNs), getElapsedRealtimeMillis());
+    EXPECT_EQ(NanoToSeconds(kStartElapsedNs), getElapsedRealtimeSec());
+    EXPECT_EQ(NanoToMillis(kStartElapsedNs), getSystemUptimeMillis());
+    EXPECT_EQ(kStartWallClockNs + 500 * 1000000, getWallClockNs());
+    EXPECT_EQ(NanoToSeconds(kStartWallClockNs), getWallClockSec());
+    // Millis are truncated to the second, like time(nullptr) * 1000.
+    EXPECT_EQ(NanoToMillis(kStartWallClockNs), getWallClockMillis());
+
+    clock->advance(kOneDayNs);
+    EXPECT_EQ(kStartElapsedNs + kOneDayNs, getElapsedRealtimeNs());
+
+    Clock::set(nullptr);
+    EXPECT_LT(getElapsedRealtimeNs(), kStartElapsedNs + kOneDayNs);
+}
+
+TEST(ClockTest, TestSimulatedWeekOfBuckets) {
+    std::shared_ptr<SimulatedClock> clock =
+            std::make_shared<SimulatedClock>(kStartElapsedNs, kStartWallClockNs);
+    Clock::set(clock);
+
+    StatsdConfig config;
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    CountMetric* metric = config.add_count_metric();
+    *metric = createCountMetric("ScreenOn", config.atom_matcher(0).id(), /*condition=*/nullopt,
+                                /*states=*/{});
+    metric->set_bucket(ONE_DAY);
+
+    ConfigKey cfgKey(123, 987);
+    sp<StatsLogProcessor> processor =
+            CreateStatsLogProcessor(kStartElapsedNs, kStartElapsedNs, config, cfgKey);
+
+    // One screen on event a day for a week, without any real waiting.
+    for (int day = 0; day < 7; day++) {
+        clock->advance(NS_PER_SEC);
+        std::unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+                getElapsedRealtimeNs(), android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+        processor->OnLogEvent(event.get());
+        clock->advance(kOneDayNs - NS_PER_SEC);
+    }
+
+    vector<uint8_t> buffer;
+    processor->onDumpReport(cfgKey, getElapsedRealtimeNs() + 1, /*include_current_bucket=*/false,
+                            /*erase_data=*/true, ADB_DUMP, FAST, &buffer);
+    Clock::set(nullptr);
+
+    ConfigMetricsReportList reports;
+    ASSERT_TRUE(reports.ParseFromArray(&buffer[0], buffer.size()));
+    ASSERT_EQ(1, reports.reports_size());
+    const ConfigMetricsReport& report = reports.reports(0);
+    EXPECT_EQ(kStartWallClockNs + 7 * kOneDayNs, report.current_report_wall_clock_nanos());
+    ASSERT_EQ(1, report.metrics_size());
+    ASSERT_EQ(1, report.metrics(0).count_metrics().data_size());
+    const CountMetricData& data = report.metrics(0).count_metrics().data(0);
+    ASSERT_EQ(7, data.bucket_info_size());
+    for (const CountBucketInfo& bucketInfo : data.bucket_info()) {
+        EXPECT_EQ(1, bucketInfo.count());
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -270,6 +270,116 @@ TEST_F(DbUtilsTest, TestInsertTwoEventsEnforceTtl) {
                 ElementsAre("atomId", "elapsedTimestampNs", "wallTimestampNs", "field_1"));
 }
 
+TEST_F(DbUtilsTest, TestEnforceTtlDropsExpiredPartitions) {
+    const int64_t nsPerDay = 24 * 3600 * NS_PER_SEC;
+    int64_t eventElapsedTimeNs = 10000000000;
+
+    AStatsEvent* statsEvent1 = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent1, "111");
+    LogEvent logEvent1 = makeLogEvent(statsEvent1);
+    logEvent1.setLogdWallClockTimestampNs(1 * nsPerDay + 10);
+
+    AStatsEvent* statsEvent2 = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeString(statsEvent2, "222");
+    LogEvent logEvent2 = makeLogEvent(statsEvent2);
+    logEvent2.setLogdWallClockTimestampNs(3 * nsPerDay + 10);
+
+    AStatsEvent* statsEvent3 = makeAStatsEvent(tagId, eventElapsedTimeNs + 30);
+    AStatsEvent_writeString(statsEvent3, "333");
+    LogEvent logEvent3 = makeLogEvent(statsEvent3);
+    logEvent3.setLogdWallClockTimestampNs(3 * nsPerDay + 30);
+
+    vector<LogEvent> events{logEvent1, logEvent2, logEvent3};
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent1));
+    sqlite3* db = getDb(key);
+    string err;
+    EXPECT_TRUE(insert(db, metricId, events, err));
+    EXPECT_TRUE(flushTtl(db, metricId, 3 * nsPerDay + 20));
+    closeDb(db);
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_THAT(rows[0], ElementsAre("1", to_string(eventElapsedTimeNs + 30), _, "333"));
+
+    rows.clear();
+    columnTypes.clear();
+    columnNames.clear();
+    zSql = "SELECT name FROM sqlite_master WHERE type = 'table' AND name GLOB 'metric_111_*'";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_THAT(rows[0], ElementsAre("metric_111_p3"));
+}
+
+TEST_F(DbUtilsTest, TestEnforceTtlKeepsNewestPartition) {
+    int64_t eventElapsedTimeNs = 10000000000;
+    int64_t eventWallClockNs = 50000000000;
+
+    AStatsEvent* statsEvent = makeAStatsEvent(tagId, eventElapsedTimeNs + 10);
+    AStatsEvent_writeString(statsEvent, "111");
+    LogEvent logEvent = makeLogEvent(statsEvent);
+    logEvent.setLogdWallClockTimestampNs(eventWallClockNs);
+    vector<LogEvent> events{logEvent};
+
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent));
+    sqlite3* db = getDb(key);
+    string err;
+    EXPECT_TRUE(insert(db, metricId, events, err));
+    EXPECT_TRUE(flushTtl(db, metricId, 10 * 24 * 3600 * NS_PER_SEC));
+    closeDb(db);
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+    EXPECT_EQ(rows.size(), 0);
+    EXPECT_THAT(columnNames,
+                ElementsAre("atomId", "elapsedTimestampNs", "wallTimestampNs", "field_1"));
+}
+
+TEST_F(DbUtilsTest, TestUnpartitionedTableIsMigrated) {
+    int64_t eventElapsedTimeNs = 10000000000;
+    int64_t eventWallClockNs = 50000000000;
+
+    sqlite3* db = getDb(key);
+    string err;
+    ASSERT_EQ(sqlite3_exec(db,
+                           "CREATE TABLE metric_111(atomId INTEGER, elapsedTimestampNs INTEGER, "
+                           "wallTimestampNs INTEGER, field_1 TEXT) STRICT;"
+                           "INSERT INTO metric_111 VALUES(1, 10000000010, 50000000000, '111');",
+                           nullptr, nullptr, nullptr),
+              SQLITE_OK);
+
+    AStatsEvent* statsEvent = makeAStatsEvent(tagId, eventElapsedTimeNs + 20);
+    AStatsEvent_writeString(statsEvent, "222");
+    LogEvent logEvent = makeLogEvent(statsEvent);
+    logEvent.setLogdWallClockTimestampNs(eventWallClockNs + 10);
+    vector<LogEvent> events{logEvent};
+
+    EXPECT_TRUE(isEventCompatible(key, metricId, logEvent));
+    EXPECT_TRUE(createTableIfNeeded(key, metricId, logEvent));
+    EXPECT_TRUE(insert(db, metricId, events, err));
+    closeDb(db);
+
+    std::vector<int32_t> columnTypes;
+    std::vector<string> columnNames;
+    std::vector<std::vector<std::string>> rows;
+    string zSql = "SELECT * FROM metric_111 ORDER BY elapsedTimestampNs";
+    EXPECT_TRUE(query(key, zSql, rows, columnTypes, columnNames, err));
+    ASSERT_EQ(rows.size(), 2);
+    EXPECT_THAT(rows[0], ElementsAre("1", to_string(eventElapsedTimeNs + 10), _, "111"));
+    EXPECT_THAT(rows[1], ElementsAre("1", to_string(eventElapsedTimeNs + 20), _, "222"));
+
+    EXPECT_TRUE(deleteTable(key, metricId));
+    rows.clear();
+    EXPECT_FALSE(query(key, zSql, rows, columnTypes, columnNames, err));
+}
+
 TEST_F(DbUtilsTest, TestMaliciousQuery) {
     int64_t eventElapsedTimeNs = 10000000000;
 
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/HyperLogLog.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <string>
+
+#include "hash.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+uint64_t hashOf(int64_t value) {
+    return Hash64(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void addRange(HyperLogLog& sketch, int64_t begin, int64_t end) {
+    for (int64_t value = begin; value < end; value++) {
+        sketch.add(hashOf(value));
+    }
+}
+
+// Expects the estimate to be within 4 standard errors of the true cardinality.
+void expectWithinError(const HyperLogLog& sketch, int64_t cardinality) {
+    const double standardError = 1.04 / std::sqrt(1 << sketch.getPrecision());
+    const double relativeError = std::abs(sketch.estimate() - cardinality) / (double)cardinality;
+    EXPECT_LE(relativeError, 4 * standardError)
+            << "estimate " << sketch.estimate() << " for " << cardinality << " distinct values";
+}
+
+}  // anonymous namespace
+
+TEST(HyperLogLogTest, TestEmpty) {
+    HyperLogLog sketch(HyperLogLog::kDefaultPrecision);
+    EXPECT_EQ(0, sketch.estimate());
+}
+
+TEST(HyperLogLogTest, TestSmallCardinalityIsNearlyExact) {
+    HyperLogLog sketch(HyperLogLog::kDefaultPrecision);
+    addRange(sketch, 0, 100);
+    EXPECT_NEAR(100, sketch.estimate(), 2);
+}
+
+TEST(HyperLogLogTest, TestDuplicatesAreNotCounted) {
+    HyperLogLog sketch(HyperLogLog::kDefaultPrecision);
+    for (int i = 0; i < 50; i++) {
+        addRange(sketch, 0, 1000);
+    }
+    expectWithinError(sketch, 1000);
+}
+
+TEST(HyperLogLogTest, TestAccuracy) {
+    for (int precision : {HyperLogLog::kMinPrecision + 4, HyperLogLog::kDefaultPrecision,
+                          HyperLogLog::kMaxPrecision}) {
+        for (int64_t cardinality : {1000, 10000, 100000, 1000000}) {
+            HyperLogLog sketch(precision);
+            addRange(sketch, 0, cardinality);
+            expectWithinError(sketch, cardinality);
+        }
+    }
+}
+
+TEST(HyperLogLogTest, TestFixedMemory) {
+    HyperLogLog sketch(HyperLogLog::kDefaultPrecision);
+    EXPECT_EQ(4096UL, sketch.getSizeBytes());
+    addRange(sketch, 0, 100000);
+    EXPECT_EQ(4096UL, sketch.getSizeBytes());
+    EXPECT_EQ(4096UL, sketch.getRegisters().size());
+}
+
+TEST(HyperLogLogTest, TestPrecisionIsClamped) {
+    EXPECT_EQ(HyperLogLog::kMinPrecision, HyperLogLog(0).getPrecision());
+    EXPECT_EQ(HyperLogLog::kMaxPrecision, HyperLogLog(30).getPrecision());
+}
+
+TEST(HyperLogLogTest, TestMerge) {
+    HyperLogLog sketch1(HyperLogLog::kDefaultPrecision);
+    HyperLogLog sketch2(HyperLogLog::kDefaultPrecision);
+    addRange(sketch1, 0, 60000);
+    addRange(sketch2, 40000, 100000);
+
+    ASSERT_TRUE(sketch1.merge(sketch2));
+    expectWithinError(sketch1, 100000);
+}
+
+TEST(HyperLogLogTest, TestMergeDifferentPrecision) {
+    HyperLogLog sketch1(10);
+    HyperLogLog sketch2(12);
+    addRange(sketch2, 0, 1000);
+
+    EXPECT_FALSE(sketch1.merge(sketch2));
+    EXPECT_EQ(0, sketch1.estimate());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
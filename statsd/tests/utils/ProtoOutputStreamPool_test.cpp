@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/ProtoOutputStreamPool.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#ifdef __ANDROID__
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_STRING;
+using android::util::ProtoOutputStream;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+// Writes about sizeBytes bytes to the stream and serializes it.
+void writeBytes(ProtoOutputStream* proto, size_t sizeBytes) {
+    const string chunk(1024, 'a');
+    for (size_t written = 0; written < sizeBytes; written += chunk.size()) {
+        proto->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | 1, chunk);
+    }
+    vector<uint8_t> bytes;
+    proto->serializeToVector(&bytes);
+}
+
+}  // anonymous namespace
+
+TEST(ProtoOutputStreamPoolTest, TestReuse) {
+    ProtoOutputStreamPool& pool = ProtoOutputStreamPool::getInstance();
+    pool.trim();
+
+    ProtoOutputStream* first;
+    {
+        ProtoOutputStreamPool::Stream proto = pool.acquire();
+        first = proto.get();
+        writeBytes(proto.get(), 4 * 1024);
+    }
+    EXPECT_GE(pool.getPooledBytes(), 4 * 1024);
+
+    ProtoOutputStreamPool::Stream proto = pool.acquire();
+    EXPECT_EQ(first, proto.get());
+    EXPECT_EQ(0, proto->size());
+    EXPECT_EQ(0, pool.getPooledBytes());
+}
+
+TEST(ProtoOutputStreamPoolTest, TestSizeClass) {
+    ProtoOutputStreamPool& pool = ProtoOutputStreamPool::getInstance();
+    pool.trim();
+
+    ProtoOutputStream* small;
+    ProtoOutputStream* large;
+    {
+        ProtoOutputStreamPool::Stream smallProto = pool.acquire();
+        ProtoOutputStreamPool::Stream largeProto = pool.acquire();
+        small = smallProto.get();
+        large = largeProto.get();
+        writeBytes(smallProto.get(), 1024);
+        writeBytes(largeProto.get(), 2 * 1024 * 1024);
+    }
+
+    ProtoOutputStreamPool::Stream largeProto = pool.acquire(/*sizeHintBytes=*/2 * 1024 * 1024);
+    EXPECT_EQ(large, largeProto.get());
+    ProtoOutputStreamPool::Stream smallProto = pool.acquire();
+    EXPECT_EQ(small, smallProto.get());
+}
+
+TEST(ProtoOutputStreamPoolTest, TestBudget) {
+    ProtoOutputStreamPool& pool = ProtoOutputStreamPool::getInstance();
+    pool.trim();
+
+    {
+        vector<ProtoOutputStreamPool::Stream> protos;
+        for (int i = 0; i < 4; i++) {
+            protos.push_back(pool.acquire());
+            writeBytes(protos.back().get(), 3 * 1024 * 1024);
+        }
+    }
+    // Only two 3MB streams fit in the budget.
+    EXPECT_GT(pool.getPooledBytes(), 6 * 1024 * 1024);
+    EXPECT_LE(pool.getPooledBytes(), ProtoOutputStreamPool::kMaxPooledBytes);
+}
+
+TEST(ProtoOutputStreamPoolTest, TestTrim) {
+    ProtoOutputStreamPool& pool = ProtoOutputStreamPool::getInstance();
+    pool.trim();
+
+    {
+        ProtoOutputStreamPool::Stream proto = pool.acquire();
+        writeBytes(proto.get(), 4 * 1024);
+    }
+    EXPECT_GT(pool.getPooledBytes(), 0);
+
+    pool.trim();
+    EXPECT_EQ(0, pool.getPooledBytes());
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/Regex.h"
+
+#include <gtest/gtest.h>
+#include <regex.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+struct PosixResult {
+    bool compiled = false;
+    bool matched = false;
+    size_t start = 0;
+    size_t end = 0;
+};
+
+PosixResult posixMatch(const string& pattern, const string& str) {
+    PosixResult result;
+    regex_t impl;
+    if (regcomp(&impl, pattern.c_str(), REG_EXTENDED) != 0) {
+        return result;
+    }
+    result.compiled = impl.re_nsub == 0;
+    regmatch_t match;
+    if (result.compiled && regexec(&impl, str.c_str(), 1, &match, 0) == 0) {
+        result.matched = true;
+        result.start = match.rm_so;
+        result.end = match.rm_eo;
+    }
+    regfree(&impl);
+    return result;
+}
+
+// Expects Regex to find the same match as regexec, if it accepts the pattern.
+void expectSameAsPosix(const string& pattern, const string& str) {
+    std::unique_ptr<Regex> re = Regex::create(pattern);
+    if (re == nullptr) {
+        return;
+    }
+    const PosixResult expected = posixMatch(pattern, str);
+    ASSERT_TRUE(expected.compiled) << "pattern: " << pattern;
+    size_t start = 0;
+    size_t end = 0;
+    const bool matched = re->match(str, &start, &end);
+    ASSERT_EQ(expected.matched, matched) << "pattern: " << pattern << ", str: " << str;
+    if (matched) {
+        EXPECT_EQ(expected.start, start) << "pattern: " << pattern << ", str: " << str;
+        EXPECT_EQ(expected.end, end) << "pattern: " << pattern << ", str: " << str;
+    }
+}
+
+const vector<string> kPatterns = {
+        "[0-9]+$",
+        "^[0-9]+",
+        "foo",
+        "o*",
+        "a|ab|abc",
+        "ab|a",
+        "x*y+z?",
+        "a.c",
+        "a{2}",
+        "a{2,}",
+        "a{1,3}b",
+        "a{0,2}",
+        "[^a-z]+",
+        "[]a]+",
+        "[^]a]",
+        "[a-]+",
+        "[-a]+",
+        "[!--]+",
+        "[[:digit:][:upper:]]+",
+        "[[:alpha:]_]+[[:digit:]]*$",
+        "[[:space:][:punct:]]",
+        "\\.[0-9]+",
+        "\\$|\\^",
+        "^$",
+        "^|a",
+        "a$|b",
+        "a^b",
+        "$a",
+        "[.]",
+        "com\\.[a-z]+\\.[a-z0-9_]+",
+        "[0-9a-f]{8}",
+};
+
+const vector<string> kInputs = {
+        "",
+        "a",
+        "abc",
+        "abcabc",
+        "foo123",
+        "123foo",
+        "foofoo",
+        "aaab",
+        "xyyyz",
+        "a]b]",
+        "a-b-",
+        "AB12cd_34",
+        "com.android.app_1",
+        "deadbeef00",
+        "$^.",
+        "ab|a",
+        " \t!",
+};
+
+}  // anonymous namespace
+
+TEST(RegexTest, TestReplace) {
+    std::unique_ptr<Regex> re = Regex::create("[0-9]+$");
+    ASSERT_NE(re, nullptr);
+
+    string str = "location42";
+    EXPECT_TRUE(re->replace(str, "#"));
+    EXPECT_EQ("location#", str);
+
+    str = "location";
+    EXPECT_FALSE(re->replace(str, "#"));
+    EXPECT_EQ("location", str);
+}
+
+TEST(RegexTest, TestLeftmostLongest) {
+    std::unique_ptr<Regex> re = Regex::create("a|ab|abc");
+    ASSERT_NE(re, nullptr);
+
+    size_t start;
+    size_t end;
+    ASSERT_TRUE(re->match("xabcd", &start, &end));
+    EXPECT_EQ(1u, start);
+    EXPECT_EQ(4u, end);
+
+    // Empty matches are found at the first position.
+    re = Regex::create("b*");
+    ASSERT_NE(re, nullptr);
+    ASSERT_TRUE(re->match("abb", &start, &end));
+    EXPECT_EQ(0u, start);
+    EXPECT_EQ(0u, end);
+}
+
+TEST(RegexTest, TestUnsupportedPatterns) {
+    const vector<string> patterns = {
+            "",         "(a)",     "a)",       "*a",    "a**",   "a|",    "|a",
+            "a{1",      "a{2,1}",  "a{256}",   "{1}",   "a{b",   "^*",    "[a",
+            "[[:foo:]]", "[[.a.]]", "[[=a=]]", "[z-a]", "[a-z-0]", "\\d", "a\\",
+            string("a\0b", 3),
+    };
+    for (const string& pattern : patterns) {
+        EXPECT_EQ(Regex::create(pattern), nullptr) << "pattern: " << pattern;
+    }
+}
+
+TEST(RegexTest, TestMatchesPosixOnCorpus) {
+    for (const string& pattern : kPatterns) {
+        ASSERT_NE(Regex::create(pattern), nullptr) << "pattern: " << pattern;
+        for (const string& input : kInputs) {
+            expectSameAsPosix(pattern, input);
+        }
+    }
+}
+
+TEST(RegexTest, TestMatchesPosixOnRandomPatterns) {
+    const string patternAlphabet = "ab0.*+?|^$[]-{},:\\";
+    const string inputAlphabet = "ab0-]{,";
+    std::mt19937 generator(42);
+    for (int i = 0; i < 20000; i++) {
+        string pattern;
+        const int patternLength = 1 + generator() % 8;
+        for (int j = 0; j < patternLength; j++) {
+            pattern += patternAlphabet[generator() % patternAlphabet.size()];
+        }
+        string input;
+        const int inputLength = generator() % 12;
+        for (int j = 0; j < inputLength; j++) {
+            input += inputAlphabet[generator() % inputAlphabet.size()];
+        }
+        expectSameAsPosix(pattern, input);
+    }
+}
+
+TEST(RegexTest, TestPathologicalPattern) {
+    // (a?){n}a{n} makes backtracking matchers take exponential time on a^n.
+    string pattern;
+    for (int i = 0; i < 30; i++) {
+        pattern += "a?";
+    }
+    for (int i = 0; i < 30; i++) {
+        pattern += "a";
+    }
+    std::unique_ptr<Regex> re = Regex::create(pattern);
+    ASSERT_NE(re, nullptr);
+
+    size_t start;
+    size_t end;
+    ASSERT_TRUE(re->match(string(30, 'a'), &start, &end));
+    EXPECT_EQ(0u, start);
+    EXPECT_EQ(30u, end);
+}
+
+TEST(RegexTest, TestMatchesStringView) {
+    std::unique_ptr<Regex> re = Regex::create("[0-9]+$");
+    ASSERT_NE(re, nullptr);
+
+    const string str = "tag123 other";
+    size_t start;
+    size_t end;
+    ASSERT_TRUE(re->match(std::string_view(str).substr(0, 6), &start, &end));
+    EXPECT_EQ(3u, start);
+    EXPECT_EQ(6u, end);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
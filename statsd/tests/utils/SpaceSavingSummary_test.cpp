@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/SpaceSavingSummary.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __ANDROID__
+
+using std::unordered_map;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int kNumKeys = 10000;
+const int kNumEvents = 200000;
+
+// Draws keys in [0, kNumKeys) from a Zipfian distribution with the given exponent.
+vector<int> generateZipfianStream(double exponent, uint32_t seed) {
+    vector<double> weights(kNumKeys);
+    for (int i = 0; i < kNumKeys; i++) {
+        weights[i] = 1.0 / std::pow(i + 1, exponent);
+    }
+    std::discrete_distribution<int> distribution(weights.begin(), weights.end());
+    std::mt19937 generator(seed);
+    vector<int> stream(kNumEvents);
+    for (int& key : stream) {
+        key = distribution(generator);
+    }
+    return stream;
+}
+
+// Keys sorted by decreasing exact count.
+vector<int> getExactTopK(const unordered_map<int, int64_t>& exactCounts, size_t k) {
+    vector<std::pair<int64_t, int>> sorted;
+    for (const auto& [key, count] : exactCounts) {
+        sorted.push_back({count, key});
+    }
+    std::sort(sorted.rbegin(), sorted.rend());
+    vector<int> keys;
+    for (size_t i = 0; i < k && i < sorted.size(); i++) {
+        keys.push_back(sorted[i].second);
+    }
+    return keys;
+}
+
+}  // anonymous namespace
+
+TEST(SpaceSavingSummaryTest, TestExactBelowCapacity) {
+    SpaceSavingSummary<int> summary(4);
+    summary.add(1);
+    summary.add(2, 5);
+    summary.add(1);
+    summary.add(3);
+
+    const vector<SpaceSavingSummary<int>::Counter> topK = summary.getTopK(10);
+    ASSERT_EQ(3, topK.size());
+    EXPECT_EQ(2, topK[0].key);
+    EXPECT_EQ(5, topK[0].estimate);
+    EXPECT_EQ(0, topK[0].error);
+    EXPECT_EQ(1, topK[1].key);
+    EXPECT_EQ(2, topK[1].estimate);
+    EXPECT_EQ(0, topK[1].error);
+    EXPECT_EQ(3, topK[2].key);
+    EXPECT_EQ(1, topK[2].estimate);
+    EXPECT_EQ(0, topK[2].error);
+    EXPECT_EQ(8, summary.getTotalWeight());
+    EXPECT_EQ(0, summary.getMinEstimate());
+}
+
+TEST(SpaceSavingSummaryTest, TestEviction) {
+    SpaceSavingSummary<int> summary(2);
+    summary.add(1, 4);
+    summary.add(2, 1);
+    // Replaces key 2, which has the smallest estimate.
+    summary.add(3, 2);
+
+    const vector<SpaceSavingSummary<int>::Counter> topK = summary.getTopK(2);
+    ASSERT_EQ(2, topK.size());
+    EXPECT_EQ(1, topK[0].key);
+    EXPECT_EQ(4, topK[0].estimate);
+    EXPECT_EQ(0, topK[0].error);
+    EXPECT_EQ(3, topK[1].key);
+    EXPECT_EQ(3, topK[1].estimate);
+    EXPECT_EQ(1, topK[1].error);
+    EXPECT_EQ(2, summary.size());
+    EXPECT_EQ(3, summary.getMinEstimate());
+
+    summary.clear();
+    EXPECT_TRUE(summary.empty());
+    EXPECT_EQ(0, summary.getTotalWeight());
+}
+
+TEST(SpaceSavingSummaryTest, TestZipfianAccuracy) {
+    const size_t capacity = 200;
+    const size_t k = 20;
+    const vector<int> stream = generateZipfianStream(/*exponent=*/1.1, /*seed=*/42);
+
+    SpaceSavingSummary<int> summary(capacity);
+    unordered_map<int, int64_t> exactCounts;
+    for (const int key : stream) {
+        summary.add(key);
+        exactCounts[key]++;
+        // Memory is bounded by the capacity, whatever the number of distinct keys.
+        ASSERT_LE(summary.size(), capacity);
+    }
+    ASSERT_GT(exactCounts.size(), capacity);
+    EXPECT_EQ(kNumEvents, summary.getTotalWeight());
+
+    // Every estimate brackets the exact count, and errors are bounded by total / capacity.
+    const vector<SpaceSavingSummary<int>::Counter> all = summary.getTopK(capacity);
+    unordered_map<int, int64_t> estimates;
+    for (const auto& counter : all) {
+        const int64_t exact = exactCounts[counter.key];
+        EXPECT_LE(counter.estimate - counter.error, exact);
+        EXPECT_GE(counter.estimate, exact);
+        EXPECT_LE(counter.error, kNumEvents / (int64_t)capacity);
+        estimates[counter.key] = counter.estimate;
+    }
+
+    // Every key heavier than total / capacity is tracked, and untracked keys are bounded.
+    for (const auto& [key, count] : exactCounts) {
+        if (estimates.find(key) == estimates.end()) {
+            EXPECT_LE(count, kNumEvents / (int64_t)capacity);
+            EXPECT_LE(count, summary.getMinEstimate());
+        }
+    }
+
+    // The heavy hitters match the exact top k.
+    const vector<int> exactTopK = getExactTopK(exactCounts, k);
+    const vector<SpaceSavingSummary<int>::Counter> topK = summary.getTopK(k);
+    ASSERT_EQ(k, topK.size());
+    for (size_t i = 0; i < k; i++) {
+        EXPECT_EQ(exactTopK[i], topK[i].key) << "rank " << i;
+    }
+}
+
+TEST(SpaceSavingSummaryTest, TestZipfianWeighted) {
+    const size_t capacity = 100;
+    const vector<int> stream = generateZipfianStream(/*exponent=*/1.3, /*seed=*/7);
+
+    SpaceSavingSummary<int> summary(capacity);
+    unordered_map<int, int64_t> exactSums;
+    int64_t total = 0;
+    for (size_t i = 0; i < stream.size(); i++) {
+        const int64_t weight = 1 + i % 10;
+        summary.add(stream[i], weight);
+        exactSums[stream[i]] += weight;
+        total += weight;
+    }
+    EXPECT_EQ(total, summary.getTotalWeight());
+    EXPECT_LE(summary.size(), capacity);
+
+    for (const auto& counter : summary.getTopK(capacity)) {
+        const int64_t exact = exactSums[counter.key];
+        EXPECT_LE(counter.estimate - counter.error, exact);
+        EXPECT_GE(counter.estimate, exact);
+        EXPECT_LE(counter.error, total / (int64_t)capacity);
+    }
+
+    const vector<int> exactTopK = getExactTopK(exactSums, 5);
+    const vector<SpaceSavingSummary<int>::Counter> topK = summary.getTopK(5);
+    ASSERT_EQ(5, topK.size());
+    for (size_t i = 0; i < topK.size(); i++) {
+        EXPECT_EQ(exactTopK[i], topK[i].key) << "rank " << i;
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif